@@ -5,4 +5,9 @@
 #include "async_task_queue.h"
 #include "async_task_parallel.h"
 #include "async_task_graph.h"
+#include "async_compiled_graph.h"
+#include "async_parallel_for.h"
+#include "async_hobj_load_task.h"
+#include "async_coroutine.h"
+#include "async_profiler.h"
 #include "async_orchestrator.h"
\ No newline at end of file
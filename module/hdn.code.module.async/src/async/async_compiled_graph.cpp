@@ -0,0 +1,244 @@
+#include "async_compiled_graph.h"
+
+#include "async_orchestrator.h"
+
+namespace hdn
+{
+	CompiledTaskGraph::~CompiledTaskGraph()
+	{
+		Detach();
+	}
+
+	bool CompiledTaskGraph::Compile(ITask* root)
+	{
+		HASSERT_TASK(root);
+		HASSERT(!IsEnqueued() || Completed(), "Cannot compile a graph while it is running");
+
+		Detach();
+		m_NodeTasks.clear();
+		m_SuccessorOffsets.clear();
+		m_Successors.clear();
+		m_InDegree.clear();
+		m_TopologicalOrder.clear();
+		m_SourceNodes.clear();
+
+		// 1. Flatten the hierarchy into nodes and edges
+		unordered_map<ITask*, Endpoints> endpoints;
+		vector<pair<u32, u32>> edges;
+		Flatten(root, endpoints, edges);
+
+		// 2. Build the CSR adjacency and the in-degrees
+		const u32 nodeCount = GetNodeCount();
+		m_SuccessorOffsets.resize(nodeCount + 1, 0);
+		m_InDegree.resize(nodeCount, 0);
+		for (const auto& [from, to] : edges)
+		{
+			m_SuccessorOffsets[from + 1]++;
+			m_InDegree[to]++;
+		}
+		for (u32 i = 0; i < nodeCount; i++)
+		{
+			m_SuccessorOffsets[i + 1] += m_SuccessorOffsets[i];
+		}
+
+		m_Successors.resize(edges.size());
+		vector<u32> cursor(m_SuccessorOffsets.begin(), m_SuccessorOffsets.end() - 1);
+		for (const auto& [from, to] : edges)
+		{
+			m_Successors[cursor[from]++] = to;
+		}
+
+		// 3. Topological order (Kahn), the nodes left over are part of a cycle
+		vector<u32> inDegree = m_InDegree;
+		m_TopologicalOrder.reserve(nodeCount);
+		for (u32 i = 0; i < nodeCount; i++)
+		{
+			if (inDegree[i] == 0)
+			{
+				m_SourceNodes.push_back(i);
+				m_TopologicalOrder.push_back(i);
+			}
+		}
+		for (size_t i = 0; i < m_TopologicalOrder.size(); i++)
+		{
+			const u32 node = m_TopologicalOrder[i];
+			for (const u32* successor = SuccessorsBegin(node); successor != SuccessorsEnd(node); successor++)
+			{
+				if (--inDegree[*successor] == 0)
+				{
+					m_TopologicalOrder.push_back(*successor);
+				}
+			}
+		}
+
+		if (m_TopologicalOrder.size() != nodeCount)
+		{
+			HERR("The compiled task hierarchy '{0}' has a circular dependency!", root->GetName());
+			Detach();
+			m_NodeTasks.clear();
+			return false;
+		}
+
+		// 4. Route the completion of the node tasks to this graph
+		for (u32 i = 0; i < nodeCount; i++)
+		{
+			if (ITask* task = m_NodeTasks[i])
+			{
+				task->m_CompiledGraph = this;
+				task->m_CompiledNodeIndex = i;
+			}
+		}
+
+		m_PendingCounts = CreateScope<std::atomic<u32>[]>(nodeCount);
+		Reset();
+		return true;
+	}
+
+	void CompiledTaskGraph::Reset()
+	{
+		ITask::Reset();
+		const u32 nodeCount = GetNodeCount();
+		for (u32 i = 0; i < nodeCount; i++)
+		{
+			m_PendingCounts[i].store(m_InDegree[i], std::memory_order_relaxed);
+			if (ITask* task = m_NodeTasks[i])
+			{
+				task->Reset();
+			}
+		}
+		// The extra count is held by Execute() while it dispatches the source nodes
+		m_RemainingCount.store(nodeCount + 1, std::memory_order_release);
+	}
+
+	void CompiledTaskGraph::Execute()
+	{
+		for (const u32 node : m_SourceNodes)
+		{
+			ScheduleNode(node);
+		}
+
+		if (m_RemainingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			Complete();
+		}
+	}
+
+	const char* CompiledTaskGraph::GetName() const
+	{
+		return "CompiledTaskGraph";
+	}
+
+	u32 CompiledTaskGraph::AddNode(ITask* task)
+	{
+		const u32 node = GetNodeCount();
+		m_NodeTasks.push_back(task);
+		return node;
+	}
+
+	void CompiledTaskGraph::Flatten(ITask* task, unordered_map<ITask*, Endpoints>& endpoints, vector<pair<u32, u32>>& edges)
+	{
+		const auto& children = task->GetInternalDependencies();
+		if (children.empty())
+		{
+			const u32 node = AddNode(task);
+			Endpoints& taskEndpoints = endpoints[task];
+			taskEndpoints.sources.push_back(node);
+			taskEndpoints.sinks.push_back(node);
+			return;
+		}
+
+		for (ITask* child : children)
+		{
+			Flatten(child, endpoints, edges);
+		}
+
+		// Sibling dependencies become edges between the sinks of the source child and the sources of the dependent child
+		Endpoints taskEndpoints;
+		for (ITask* child : children)
+		{
+			const Endpoints& childEndpoints = endpoints[child];
+			if (child->GetInDependencies().empty())
+			{
+				taskEndpoints.sources.insert(taskEndpoints.sources.end(), childEndpoints.sources.begin(), childEndpoints.sources.end());
+			}
+			if (child->GetOutDependencies().empty())
+			{
+				taskEndpoints.sinks.insert(taskEndpoints.sinks.end(), childEndpoints.sinks.begin(), childEndpoints.sinks.end());
+			}
+			for (ITask* dependent : child->GetOutDependencies())
+			{
+				HASSERT(children.count(dependent), "Out dependencies are expected to share the same parent");
+				Connect(childEndpoints.sinks, endpoints[dependent].sources, edges);
+			}
+		}
+		endpoints[task] = std::move(taskEndpoints);
+	}
+
+	void CompiledTaskGraph::Connect(const vector<u32>& sinks, const vector<u32>& sources, vector<pair<u32, u32>>& edges)
+	{
+		if (sinks.size() > 1 && sources.size() > 1)
+		{
+			// N + M edges through a barrier instead of N * M
+			const u32 barrier = AddNode(nullptr);
+			for (const u32 sink : sinks)
+			{
+				edges.emplace_back(sink, barrier);
+			}
+			for (const u32 source : sources)
+			{
+				edges.emplace_back(barrier, source);
+			}
+			return;
+		}
+
+		for (const u32 sink : sinks)
+		{
+			for (const u32 source : sources)
+			{
+				edges.emplace_back(sink, source);
+			}
+		}
+	}
+
+	void CompiledTaskGraph::Detach()
+	{
+		for (ITask* task : m_NodeTasks)
+		{
+			if (task && task->m_CompiledGraph == this)
+			{
+				task->m_CompiledGraph = nullptr;
+			}
+		}
+	}
+
+	void CompiledTaskGraph::ScheduleNode(u32 node)
+	{
+		ITask* task = m_NodeTasks[node];
+		if (task)
+		{
+			task->m_Enqueued.store(true, std::memory_order_relaxed);
+			AsyncOrchestrator::Get().AddPendingTask(task);
+		}
+		else
+		{
+			// Barriers have no work, resolve them inline
+			NodeCompleted(node);
+		}
+	}
+
+	void CompiledTaskGraph::NodeCompleted(u32 node)
+	{
+		for (const u32* successor = SuccessorsBegin(node); successor != SuccessorsEnd(node); successor++)
+		{
+			if (m_PendingCounts[*successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				ScheduleNode(*successor);
+			}
+		}
+
+		if (m_RemainingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			Complete();
+		}
+	}
+}
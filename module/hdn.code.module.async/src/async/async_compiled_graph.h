@@ -0,0 +1,67 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/stl/vector.h"
+#include "core/stl/unordered_map.h"
+#include "core/stl/pair.h"
+
+#include "async_task.h"
+
+namespace hdn
+{
+	// Immutable, flattened version of a task hierarchy meant to be built once and executed every frame
+	// Compile() walks the hierarchy (ITaskParallel, ITaskQueue, ITaskGraph, ...) down to the tasks without internal dependencies
+	// and stores their dependencies as a CSR adjacency array with precomputed in-degrees and a topological order
+	// Composite tasks disappear in the process: their PreExecute()/Execute()/Complete() are not called anymore
+	// Once compiled, the node tasks report their completion to the compiled graph and must not be enqueued through their original hierarchy
+	class CompiledTaskGraph : public ITask
+	{
+	public:
+		CompiledTaskGraph() = default;
+		virtual ~CompiledTaskGraph();
+
+		// Returns false if the hierarchy contains a circular dependency
+		bool Compile(ITask* root);
+
+		// Restores the per-node counters from the precomputed in-degrees, no allocation
+		virtual void Reset() override;
+
+		virtual void Execute() override;
+		virtual const char* GetName() const override;
+
+		u32 GetNodeCount() const { return static_cast<u32>(m_NodeTasks.size()); }
+		const vector<u32>& GetTopologicalOrder() const { return m_TopologicalOrder; }
+		const vector<u32>& GetSourceNodes() const { return m_SourceNodes; }
+		// Barrier nodes (nullptr) are inserted instead of a full bipartite set of edges between two composites
+		ITask* GetNodeTask(u32 node) const { return m_NodeTasks[node]; }
+		const u32* SuccessorsBegin(u32 node) const { return m_Successors.data() + m_SuccessorOffsets[node]; }
+		const u32* SuccessorsEnd(u32 node) const { return m_Successors.data() + m_SuccessorOffsets[node + 1]; }
+	private:
+		struct Endpoints
+		{
+			vector<u32> sources;
+			vector<u32> sinks;
+		};
+
+		u32 AddNode(ITask* task);
+		void Flatten(ITask* task, unordered_map<ITask*, Endpoints>& endpoints, vector<pair<u32, u32>>& edges);
+		void Connect(const vector<u32>& sinks, const vector<u32>& sources, vector<pair<u32, u32>>& edges);
+		void Detach();
+
+		void ScheduleNode(u32 node);
+		void NodeCompleted(u32 node);
+	private:
+		vector<ITask*> m_NodeTasks;
+		vector<u32> m_SuccessorOffsets; // NodeCount + 1
+		vector<u32> m_Successors;
+		vector<u32> m_InDegree;
+		vector<u32> m_TopologicalOrder;
+		vector<u32> m_SourceNodes;
+
+		// Runtime state
+		Scope<std::atomic<u32>[]> m_PendingCounts;
+		std::atomic<u32> m_RemainingCount{ 0 };
+
+		friend class ITask;
+	};
+}
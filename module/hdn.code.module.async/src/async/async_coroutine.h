@@ -0,0 +1,423 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/stl/optional.h"
+#include "core/stl/span.h"
+#include "core/stl/vector.h"
+
+#include "async_task.h"
+#include "async_task_parallel.h"
+#include "async_orchestrator.h"
+#include "async_coroutine_allocator.h"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+namespace hdn
+{
+	template<typename T = void>
+	class Task;
+
+	namespace detail
+	{
+		// The promise is the ITask of the coroutine: executing it resumes the coroutine, so a Task<T> can be scheduled,
+		// waited on and added to an ITask hierarchy like any other task
+		class TaskPromiseBase : public ITask
+		{
+		public:
+			struct FinalAwaiter
+			{
+				bool await_ready() const noexcept { return false; }
+
+				template<typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					TaskPromiseBase& promise = handle.promise();
+					const uintptr_t continuation = promise.m_Continuation.exchange(TASK_COMPLETED, std::memory_order_acq_rel);
+					// Once completed, a task waited on by a regular thread can be destroyed, do not touch the promise after this point
+					promise.Complete();
+					if (continuation != 0)
+					{
+						return std::coroutine_handle<>::from_address(reinterpret_cast<void*>(continuation));
+					}
+					return std::noop_coroutine();
+				}
+
+				void await_resume() const noexcept {}
+			};
+
+			static void* operator new(size_t size) { return CoroutineFrameAllocator::Allocate(size); }
+			static void operator delete(void* block, size_t size) { CoroutineFrameAllocator::Deallocate(block, size); }
+
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			FinalAwaiter final_suspend() const noexcept { return {}; }
+			void unhandled_exception() const noexcept
+			{
+				HFATAL("Unhandled exception in a coroutine task");
+				std::terminate();
+			}
+
+			virtual void PreExecute() override
+			{
+				// Every resumption goes through the workers, only the first one starts the clock
+				if (!m_Resumed)
+				{
+					m_Resumed = true;
+					ITask::PreExecute();
+				}
+			}
+
+			virtual void Execute() override { m_Handle.resume(); }
+			virtual TaskAffinity Affinity() const override { return m_Affinity; }
+			virtual const char* GetName() const override { return "Task"; }
+
+			// The tasks awaited by the coroutine have it as parent, their completion resumes the coroutine
+			// Any other notification comes from an in dependency of the task in a queue or a graph, the last one enqueues it
+			virtual void DependencyCompletionNotification(ITask* task) override
+			{
+				if (task->GetParent() != this)
+				{
+					ITask::DependencyCompletionNotification(task);
+					return;
+				}
+				task->SetParent(nullptr);
+				Schedule();
+			}
+
+			// Returns false if the coroutine was already started
+			bool TryStart() { return TryMarkEnqueued(); }
+			void SetAffinity(TaskAffinity affinity) { m_Affinity = affinity; }
+			void Schedule() { AsyncOrchestrator::Get().AddPendingTask(this); }
+			std::coroutine_handle<> GetHandle() const { return m_Handle; }
+
+			// Returns false if the coroutine completed in the meantime, in which case the continuation will not be resumed
+			bool SetContinuation(std::coroutine_handle<> continuation)
+			{
+				uintptr_t expected = 0;
+				return m_Continuation.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(continuation.address()), std::memory_order_acq_rel);
+			}
+		protected:
+			static constexpr uintptr_t TASK_COMPLETED = 1;
+
+			std::coroutine_handle<> m_Handle;
+			// 0, the address of the coroutine awaiting this one, or TASK_COMPLETED
+			std::atomic<uintptr_t> m_Continuation{ 0 };
+			TaskAffinity m_Affinity = TaskAffinity::Compute;
+			bool m_Resumed = false;
+		};
+
+		template<typename T>
+		class TaskPromise : public TaskPromiseBase
+		{
+		public:
+			Task<T> get_return_object() noexcept;
+
+			template<typename U>
+			void return_value(U&& value) { m_Result.emplace(std::forward<U>(value)); }
+
+			T& GetResult()
+			{
+				HASSERT(m_Result, "The task has no result, it did not complete");
+				return *m_Result;
+			}
+		private:
+			optional<T> m_Result;
+		};
+
+		template<>
+		class TaskPromise<void> : public TaskPromiseBase
+		{
+		public:
+			Task<void> get_return_object() noexcept;
+
+			void return_void() const noexcept {}
+			void GetResult() const {}
+		};
+
+		template<typename T, bool MoveResult>
+		struct TaskAwaiter
+		{
+			TaskPromise<T>& promise;
+
+			bool await_ready() const noexcept { return promise.Completed(); }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				if (promise.TryStart())
+				{
+					// Not started yet: run it right away on this thread, it resumes us once it completes
+					promise.SetContinuation(awaiting);
+					promise.PreExecute();
+					return promise.GetHandle();
+				}
+				// Already running on the workers, resume immediately if it completed before we could register
+				return promise.SetContinuation(awaiting) ? std::noop_coroutine() : awaiting;
+			}
+
+			decltype(auto) await_resume()
+			{
+				if constexpr (std::is_void_v<T>)
+				{
+					return;
+				}
+				else if constexpr (MoveResult)
+				{
+					return T{ std::move(promise.GetResult()) };
+				}
+				else
+				{
+					return static_cast<T&>(promise.GetResult());
+				}
+			}
+		};
+
+		template<typename Promise>
+		inline TaskPromiseBase& GetTaskPromise(std::coroutine_handle<Promise> handle)
+		{
+			static_assert(std::is_base_of_v<TaskPromiseBase, Promise>, "Only Task<T> coroutines can use this awaiter");
+			return handle.promise();
+		}
+
+		// The awaited task becomes a child of the coroutine, which is resumed by the completion notification
+		struct ITaskAwaiter
+		{
+			ITask& task;
+
+			bool await_ready() const { return task.Completed(); }
+
+			template<typename Promise>
+			void await_suspend(std::coroutine_handle<Promise> awaiting)
+			{
+				TaskPromiseBase& promise = GetTaskPromise(awaiting);
+				HASSERT(!task.IsEnqueued(), "Awaited task '{0}' is already enqueued, the awaiting coroutine enqueues it", task.GetName());
+				HASSERT(task.GetParent() == nullptr, "Awaited task '{0}' already has a parent", task.GetName());
+				task.SetParent(&promise);
+				task.Enqueue();
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		class WhenAllAwaiter
+		{
+		public:
+			WhenAllAwaiter(span<ITask* const> tasks)
+			{
+				m_Tasks.reserve(tasks.size());
+				for (ITask* task : tasks)
+				{
+					HASSERT_TASK(task);
+					if (task->Completed())
+					{
+						continue;
+					}
+					HASSERT(!task->IsEnqueued(), "Task '{0}' is already enqueued, WhenAll() enqueues the tasks itself", task->GetName());
+					m_Group.AddTask(task);
+					m_Tasks.push_back(task);
+				}
+			}
+
+			bool await_ready() const { return m_Tasks.empty(); }
+
+			template<typename Promise>
+			void await_suspend(std::coroutine_handle<Promise> awaiting)
+			{
+				m_Group.SetParent(&GetTaskPromise(awaiting));
+				m_Group.Enqueue();
+			}
+
+			void await_resume()
+			{
+				// The group dies with the awaiter, the tasks must not point to it anymore
+				for (ITask* task : m_Tasks)
+				{
+					task->SetParent(nullptr);
+				}
+			}
+		private:
+			ITaskParallel m_Group;
+			vector<ITask*> m_Tasks;
+		};
+
+		struct SwitchToAffinityAwaiter
+		{
+			TaskAffinity affinity;
+
+			bool await_ready() const noexcept { return false; }
+
+			template<typename Promise>
+			bool await_suspend(std::coroutine_handle<Promise> awaiting)
+			{
+				TaskPromiseBase& promise = GetTaskPromise(awaiting);
+				promise.SetAffinity(affinity);
+				if (AsyncOrchestrator::Get().IsCurrentThreadAffinity(affinity))
+				{
+					return false;
+				}
+				promise.Schedule();
+				return true;
+			}
+
+			void await_resume() const noexcept {}
+		};
+	}
+
+	// Lazily started coroutine running on the AsyncOrchestrator pools
+	// - co_await on a Task starts it on the calling thread (if not started yet) and resumes the caller once it completes,
+	//   the caller then runs on the thread that completed the awaited coroutine
+	// - co_await SwitchToIO() / SwitchToCompute() / SwitchToMainThread() moves the rest of the coroutine to another pool
+	// - co_await on an ITask, or on WhenAll(...), enqueues the tasks and resumes the coroutine once they all completed
+	// - Start() schedules the coroutine on the compute pool, Get() waits for its result
+	template<typename T>
+	class Task
+	{
+	public:
+		using promise_type = detail::TaskPromise<T>;
+
+		Task() = default;
+		explicit Task(std::coroutine_handle<promise_type> handle)
+			: m_Handle{ handle }
+		{
+		}
+
+		Task(Task&& other) noexcept
+			: m_Handle{ std::exchange(other.m_Handle, nullptr) }
+		{
+		}
+
+		Task& operator=(Task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Destroy();
+				m_Handle = std::exchange(other.m_Handle, nullptr);
+			}
+			return *this;
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		~Task()
+		{
+			Destroy();
+		}
+
+		// Does nothing if the coroutine was already started
+		void Start()
+		{
+			HASSERT(m_Handle, "Empty task");
+			if (m_Handle.promise().TryStart())
+			{
+				m_Handle.promise().Schedule();
+			}
+		}
+
+		bool Completed() const
+		{
+			return m_Handle && m_Handle.promise().Completed();
+		}
+
+		// Starts the coroutine if needed and helps the workers until it completes
+		decltype(auto) Get()
+		{
+			Start();
+			AsyncOrchestrator::Get().Wait(&m_Handle.promise());
+			return m_Handle.promise().GetResult();
+		}
+
+		// The coroutine as a regular task, to add it to a hierarchy or to wait on it
+		ITask* GetTask() const
+		{
+			return m_Handle ? &m_Handle.promise() : nullptr;
+		}
+
+		detail::TaskAwaiter<T, false> operator co_await() & noexcept
+		{
+			return { m_Handle.promise() };
+		}
+
+		detail::TaskAwaiter<T, true> operator co_await() && noexcept
+		{
+			return { m_Handle.promise() };
+		}
+	private:
+		void Destroy()
+		{
+			if (m_Handle)
+			{
+				HASSERT(!m_Handle.promise().IsEnqueued() || m_Handle.promise().Completed(), "Cannot destroy a running task");
+				m_Handle.destroy();
+				m_Handle = nullptr;
+			}
+		}
+	private:
+		std::coroutine_handle<promise_type> m_Handle;
+	};
+
+	namespace detail
+	{
+		template<typename T>
+		inline Task<T> TaskPromise<T>::get_return_object() noexcept
+		{
+			const auto handle = std::coroutine_handle<TaskPromise<T>>::from_promise(*this);
+			m_Handle = handle;
+			return Task<T>{ handle };
+		}
+
+		inline Task<void> TaskPromise<void>::get_return_object() noexcept
+		{
+			const auto handle = std::coroutine_handle<TaskPromise<void>>::from_promise(*this);
+			m_Handle = handle;
+			return Task<void>{ handle };
+		}
+
+		inline ITask* AsTask(ITask& task) { return &task; }
+		inline ITask* AsTask(ITask* task) { return task; }
+
+		template<typename T>
+		inline ITask* AsTask(Task<T>& task) { return task.GetTask(); }
+	}
+
+	inline detail::ITaskAwaiter operator co_await(ITask& task)
+	{
+		return { task };
+	}
+
+	// The tasks must not be enqueued (or started) yet, WhenAll() enqueues them and resumes the coroutine once they all completed
+	template<typename... Tasks>
+	detail::WhenAllAwaiter WhenAll(Tasks&... tasks)
+	{
+		static_assert(sizeof...(Tasks) > 0, "WhenAll needs at least one task");
+		ITask* const taskList[] = { detail::AsTask(tasks)... };
+		return detail::WhenAllAwaiter{ span<ITask* const>{ taskList, sizeof...(Tasks) } };
+	}
+
+	inline detail::WhenAllAwaiter WhenAllOf(span<ITask* const> tasks)
+	{
+		return detail::WhenAllAwaiter{ tasks };
+	}
+
+	inline detail::SwitchToAffinityAwaiter SwitchTo(TaskAffinity affinity)
+	{
+		return { affinity };
+	}
+
+	inline detail::SwitchToAffinityAwaiter SwitchToCompute()
+	{
+		return { TaskAffinity::Compute };
+	}
+
+	inline detail::SwitchToAffinityAwaiter SwitchToIO()
+	{
+		return { TaskAffinity::IO };
+	}
+
+	inline detail::SwitchToAffinityAwaiter SwitchToMainThread()
+	{
+		return { TaskAffinity::MainThread };
+	}
+}
@@ -0,0 +1,125 @@
+#include "async_coroutine_allocator.h"
+
+#include "core/allocator/slab_allocator.h"
+
+#include <mutex>
+#include <new>
+
+namespace hdn
+{
+	static u32 GetSizeClass(size_t size)
+	{
+		u32 sizeClass = 0;
+		size_t blockSize = CoroutineFrameAllocator::MIN_BLOCK_SIZE;
+		while (blockSize < size)
+		{
+			blockSize <<= 1;
+			sizeClass++;
+		}
+		return sizeClass;
+	}
+
+	static size_t GetBlockSize(u32 sizeClass)
+	{
+		return CoroutineFrameAllocator::MIN_BLOCK_SIZE << sizeClass;
+	}
+
+	struct CoroutineFrameSlab
+	{
+		CoroutineFrameSlab(size_t blockSize)
+			: allocator{ blockSize, CoroutineFrameAllocator::BLOCKS_PER_SLAB }
+		{
+		}
+
+		std::mutex mutex;
+		slab_allocator allocator;
+	};
+
+	struct CoroutineFrameSlabs
+	{
+		CoroutineFrameSlab slabs[CoroutineFrameAllocator::SIZE_CLASS_COUNT] = {
+			{ GetBlockSize(0) }, { GetBlockSize(1) }, { GetBlockSize(2) },
+			{ GetBlockSize(3) }, { GetBlockSize(4) }, { GetBlockSize(5) }
+		};
+	};
+
+	static CoroutineFrameSlab& GetSlab(u32 sizeClass)
+	{
+		// Never destroyed: the workers flush their cache when they exit, which can happen during the static destruction
+		static CoroutineFrameSlabs* s_Slabs = new CoroutineFrameSlabs();
+		return s_Slabs->slabs[sizeClass];
+	}
+
+	struct CoroutineFrameCache
+	{
+		~CoroutineFrameCache()
+		{
+			for (u32 sizeClass = 0; sizeClass < CoroutineFrameAllocator::SIZE_CLASS_COUNT; sizeClass++)
+			{
+				Flush(sizeClass, counts[sizeClass]);
+			}
+		}
+
+		void Refill(u32 sizeClass)
+		{
+			CoroutineFrameSlab& slab = GetSlab(sizeClass);
+			std::lock_guard<std::mutex> lock(slab.mutex);
+			while (counts[sizeClass] < CoroutineFrameAllocator::THREAD_CACHE_CAPACITY / 2)
+			{
+				blocks[sizeClass][counts[sizeClass]++] = slab.allocator.Allocate();
+			}
+		}
+
+		void Flush(u32 sizeClass, u32 count)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+			CoroutineFrameSlab& slab = GetSlab(sizeClass);
+			std::lock_guard<std::mutex> lock(slab.mutex);
+			for (u32 i = 0; i < count; i++)
+			{
+				slab.allocator.Deallocate(blocks[sizeClass][--counts[sizeClass]]);
+			}
+		}
+
+		void* blocks[CoroutineFrameAllocator::SIZE_CLASS_COUNT][CoroutineFrameAllocator::THREAD_CACHE_CAPACITY];
+		u32 counts[CoroutineFrameAllocator::SIZE_CLASS_COUNT] = {};
+	};
+
+	static thread_local CoroutineFrameCache t_FrameCache;
+
+	void* CoroutineFrameAllocator::Allocate(size_t size)
+	{
+#if USING(HDN_ASYNC_POOL_COROUTINE_FRAMES)
+		if (size <= MAX_BLOCK_SIZE)
+		{
+			const u32 sizeClass = GetSizeClass(size);
+			if (t_FrameCache.counts[sizeClass] == 0)
+			{
+				t_FrameCache.Refill(sizeClass);
+			}
+			return t_FrameCache.blocks[sizeClass][--t_FrameCache.counts[sizeClass]];
+		}
+#endif
+		return ::operator new(size);
+	}
+
+	void CoroutineFrameAllocator::Deallocate(void* block, size_t size)
+	{
+#if USING(HDN_ASYNC_POOL_COROUTINE_FRAMES)
+		if (size <= MAX_BLOCK_SIZE)
+		{
+			const u32 sizeClass = GetSizeClass(size);
+			if (t_FrameCache.counts[sizeClass] == THREAD_CACHE_CAPACITY)
+			{
+				t_FrameCache.Flush(sizeClass, THREAD_CACHE_CAPACITY / 2);
+			}
+			t_FrameCache.blocks[sizeClass][t_FrameCache.counts[sizeClass]++] = block;
+			return;
+		}
+#endif
+		::operator delete(block);
+	}
+}
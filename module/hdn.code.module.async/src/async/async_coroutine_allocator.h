@@ -0,0 +1,25 @@
+#pragma once
+
+#include "core/core.h"
+
+// Coroutine frames come from per-size-class slabs instead of the global heap
+#define HDN_ASYNC_POOL_COROUTINE_FRAMES IN_USE
+
+namespace hdn
+{
+	// Frame allocator of the Task<T> coroutines
+	// A frame is often allocated on one worker and released on another, each thread keeps a small cache of blocks per size class
+	// and only goes to the shared slab (under a lock) to refill or flush half of it
+	class CoroutineFrameAllocator
+	{
+	public:
+		static void* Allocate(size_t size);
+		static void Deallocate(void* block, size_t size);
+
+		static constexpr size_t MIN_BLOCK_SIZE = 128;
+		static constexpr size_t MAX_BLOCK_SIZE = 4 * KB;
+		static constexpr u32 SIZE_CLASS_COUNT = 6; // 128, 256, 512, 1KB, 2KB, 4KB
+		static constexpr size_t BLOCKS_PER_SLAB = 64;
+		static constexpr u32 THREAD_CACHE_CAPACITY = 32;
+	};
+}
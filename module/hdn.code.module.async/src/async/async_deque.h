@@ -0,0 +1,161 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/stl/vector.h"
+
+#include <atomic>
+
+namespace hdn
+{
+	// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli - "Correct and Efficient Work-Stealing for Weak Memory Models")
+	// Only the owning worker can Push() and Pop() (LIFO end), any other thread can Steal() (FIFO end)
+	template<typename T>
+	class WorkStealingDeque
+	{
+		static_assert(std::is_pointer_v<T>, "WorkStealingDeque only stores pointers");
+	public:
+		WorkStealingDeque(i64 capacity = 1024)
+			: m_Top{ 0 }, m_Bottom{ 0 }
+		{
+			HASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0, "WorkStealingDeque capacity must be a power of two");
+			m_Array.store(new RingArray(capacity), std::memory_order_relaxed);
+		}
+
+		WorkStealingDeque(const WorkStealingDeque&) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+		~WorkStealingDeque()
+		{
+			for (RingArray* array : m_Garbage)
+			{
+				delete array;
+			}
+			delete m_Array.load(std::memory_order_relaxed);
+		}
+
+		// Owner only
+		void Push(T item)
+		{
+			const i64 bottom = m_Bottom.load(std::memory_order_relaxed);
+			const i64 top = m_Top.load(std::memory_order_acquire);
+			RingArray* array = m_Array.load(std::memory_order_relaxed);
+			if (bottom - top > array->Capacity() - 1)
+			{
+				array = Grow(array, bottom, top);
+			}
+			array->Put(bottom, item);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+
+		// Owner only
+		T Pop()
+		{
+			const i64 bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+			RingArray* array = m_Array.load(std::memory_order_relaxed);
+			m_Bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			i64 top = m_Top.load(std::memory_order_relaxed);
+
+			T item = nullptr;
+			if (top <= bottom)
+			{
+				item = array->Get(bottom);
+				if (top == bottom)
+				{
+					// Last item, race against the thieves
+					if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					{
+						item = nullptr;
+					}
+					m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+				}
+			}
+			else
+			{
+				m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return item;
+		}
+
+		// Any thread, returns nullptr if the deque is empty or if another thief won the race
+		T Steal()
+		{
+			i64 top = m_Top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const i64 bottom = m_Bottom.load(std::memory_order_acquire);
+
+			T item = nullptr;
+			if (top < bottom)
+			{
+				RingArray* array = m_Array.load(std::memory_order_acquire);
+				item = array->Get(top);
+				if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					return nullptr;
+				}
+			}
+			return item;
+		}
+
+		bool Empty() const
+		{
+			const i64 bottom = m_Bottom.load(std::memory_order_relaxed);
+			const i64 top = m_Top.load(std::memory_order_relaxed);
+			return bottom <= top;
+		}
+
+		i64 Size() const
+		{
+			const i64 bottom = m_Bottom.load(std::memory_order_relaxed);
+			const i64 top = m_Top.load(std::memory_order_relaxed);
+			return bottom > top ? bottom - top : 0;
+		}
+	private:
+		class RingArray
+		{
+		public:
+			RingArray(i64 capacity)
+				: m_Capacity{ capacity }, m_Mask{ capacity - 1 }, m_Buffer{ new std::atomic<T>[static_cast<size_t>(capacity)] }
+			{
+			}
+
+			~RingArray()
+			{
+				delete[] m_Buffer;
+			}
+
+			inline i64 Capacity() const { return m_Capacity; }
+			inline void Put(i64 index, T item) { m_Buffer[index & m_Mask].store(item, std::memory_order_relaxed); }
+			inline T Get(i64 index) const { return m_Buffer[index & m_Mask].load(std::memory_order_relaxed); }
+
+			RingArray* Resize(i64 bottom, i64 top) const
+			{
+				RingArray* array = new RingArray(m_Capacity * 2);
+				for (i64 i = top; i != bottom; i++)
+				{
+					array->Put(i, Get(i));
+				}
+				return array;
+			}
+		private:
+			i64 m_Capacity;
+			i64 m_Mask;
+			std::atomic<T>* m_Buffer;
+		};
+
+		RingArray* Grow(RingArray* array, i64 bottom, i64 top)
+		{
+			RingArray* newArray = array->Resize(bottom, top);
+			// Thieves may still be reading from the old array, keep it alive until the deque is destroyed
+			m_Garbage.push_back(array);
+			m_Array.store(newArray, std::memory_order_release);
+			return newArray;
+		}
+	private:
+		alignas(64) std::atomic<i64> m_Top;
+		alignas(64) std::atomic<i64> m_Bottom;
+		alignas(64) std::atomic<RingArray*> m_Array;
+		vector<RingArray*> m_Garbage;
+	};
+}
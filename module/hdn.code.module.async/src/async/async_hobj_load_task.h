@@ -0,0 +1,36 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/hobj/hobj_util.h"
+
+#include "async_task_leaf.h"
+
+namespace hdn
+{
+	// Loads an HObject from its path on the IO workers, so the file read does not stall a compute worker
+	template<typename T>
+	class HObjectLoadTask : public ITaskLeaf
+	{
+	public:
+		HObjectLoadTask(const string& path, HObjectLoadFlags flags = HObjectLoadFlags::Default)
+			: m_Path{ path }, m_Flags{ flags }
+		{
+		}
+
+		virtual void Execute() override
+		{
+			m_Object = HObjectUtil::GetObjectFromPath<T>(m_Path.c_str(), m_Flags);
+			Complete();
+		}
+
+		virtual TaskAffinity Affinity() const override { return TaskAffinity::IO; }
+		virtual const char* GetName() const override { return m_Path.c_str(); }
+
+		// Only valid once the task is completed
+		HObjPtr<T> GetObject() const { return m_Object; }
+	private:
+		string m_Path;
+		HObjectLoadFlags m_Flags;
+		HObjPtr<T> m_Object = nullptr;
+	};
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "core/core.h"
+
+#include <atomic>
+
+namespace hdn
+{
+	// Bounded lock-free multi-producer/multi-consumer queue (Vyukov), used to inject tasks from threads that do not own a worker deque
+	template<typename T>
+	class InjectionQueue
+	{
+	public:
+		InjectionQueue(u64 capacity = 4096)
+			: m_Mask{ capacity - 1 }, m_Cells{ new Cell[capacity] }, m_EnqueuePos{ 0 }, m_DequeuePos{ 0 }
+		{
+			HASSERT(capacity >= 2 && (capacity & (capacity - 1)) == 0, "InjectionQueue capacity must be a power of two");
+			for (u64 i = 0; i < capacity; i++)
+			{
+				m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		InjectionQueue(const InjectionQueue&) = delete;
+		InjectionQueue& operator=(const InjectionQueue&) = delete;
+
+		~InjectionQueue()
+		{
+			delete[] m_Cells;
+		}
+
+		// Returns false if the queue is full
+		bool TryPush(const T& item)
+		{
+			Cell* cell = nullptr;
+			u64 pos = m_EnqueuePos.load(std::memory_order_relaxed);
+			while (true)
+			{
+				cell = &m_Cells[pos & m_Mask];
+				const u64 sequence = cell->sequence.load(std::memory_order_acquire);
+				const i64 diff = static_cast<i64>(sequence) - static_cast<i64>(pos);
+				if (diff == 0)
+				{
+					if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_EnqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+			cell->data = item;
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Returns false if the queue is empty
+		bool TryPop(T& item)
+		{
+			Cell* cell = nullptr;
+			u64 pos = m_DequeuePos.load(std::memory_order_relaxed);
+			while (true)
+			{
+				cell = &m_Cells[pos & m_Mask];
+				const u64 sequence = cell->sequence.load(std::memory_order_acquire);
+				const i64 diff = static_cast<i64>(sequence) - static_cast<i64>(pos + 1);
+				if (diff == 0)
+				{
+					if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_DequeuePos.load(std::memory_order_relaxed);
+				}
+			}
+			item = cell->data;
+			cell->sequence.store(pos + m_Mask + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Approximation only, the value can be stale as soon as it is returned
+		bool Empty() const
+		{
+			return m_EnqueuePos.load(std::memory_order_relaxed) == m_DequeuePos.load(std::memory_order_relaxed);
+		}
+
+		u64 Size() const
+		{
+			const u64 enqueuePos = m_EnqueuePos.load(std::memory_order_relaxed);
+			const u64 dequeuePos = m_DequeuePos.load(std::memory_order_relaxed);
+			return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+		}
+	private:
+		struct Cell
+		{
+			std::atomic<u64> sequence;
+			T data;
+		};
+
+		const u64 m_Mask;
+		Cell* const m_Cells;
+		alignas(64) std::atomic<u64> m_EnqueuePos;
+		alignas(64) std::atomic<u64> m_DequeuePos;
+	};
+}
@@ -1,4 +1,7 @@
 #include "async_orchestrator.h"
+#include "async_profiler.h"
+
+#include <algorithm> // For std::min
 
 namespace hdn
 {
@@ -9,17 +12,130 @@ namespace hdn
 	}
 
 	AsyncOrchestrator::AsyncOrchestrator()
-		: m_WorkerSystem{ WorkerSystem::OptimalWorkerCount(true) }
+		: m_MainThreadId{ std::this_thread::get_id() }
+		, m_ComputeWorkers{ "Compute", WorkerSystem::OptimalWorkerCount(TaskAffinity::Compute), USING(HDN_ASYNC_PIN_COMPUTE_WORKERS) }
+		, m_IOWorkers{ "IO", WorkerSystem::OptimalWorkerCount(TaskAffinity::IO) }
+		, m_MainThreadQueue{ MAIN_THREAD_QUEUE_CAPACITY }
 	{
+		HASYNC_PROFILE_THREAD_NAME("Main", 0);
 	}
 
 	void AsyncOrchestrator::AddPendingTask(ITask* task)
 	{
-		m_WorkerSystem.AddPendingTask(task);
+		HASSERT_TASK(task);
+		switch (task->Affinity())
+		{
+		case TaskAffinity::Compute:
+			m_ComputeWorkers.AddPendingTask(task);
+			break;
+		case TaskAffinity::IO:
+			m_IOWorkers.AddPendingTask(task);
+			break;
+		case TaskAffinity::MainThread:
+			HASYNC_PROFILE_EVENT(AsyncEventType::Enqueue, task, static_cast<u32>(m_MainThreadQueue.Size() + 1));
+			while (!m_MainThreadQueue.TryPush(task))
+			{
+				if (IsMainThread())
+				{
+					// Nobody else can make room in the queue
+					task->PreExecute();
+					task->Execute();
+					return;
+				}
+				std::this_thread::yield();
+			}
+			break;
+		default:
+			HERR("Task '{0}' has an invalid affinity", task->GetName());
+			break;
+		}
+	}
+
+	void AsyncOrchestrator::Wait(const ITask* task)
+	{
+		HASSERT_TASK(task);
+		const bool mainThread = IsMainThread();
+		while (!task->Completed())
+		{
+			if (mainThread && DrainMainThreadTasks(1) != 0)
+			{
+				continue;
+			}
+			if (!m_ComputeWorkers.ExecutePendingTask())
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	bool AsyncOrchestrator::ExecutePendingTask()
+	{
+		return m_ComputeWorkers.ExecutePendingTask();
+	}
+
+	u32 AsyncOrchestrator::DrainMainThreadTasks(u32 maxTaskCount)
+	{
+		HASSERT(IsMainThread(), "Main-thread tasks can only be drained by the main thread");
+
+		// Tasks queued by the drained tasks wait for the next drain, otherwise a task re-enqueuing itself would never let the frame end
+		const u64 pendingCount = std::min<u64>(m_MainThreadQueue.Size(), maxTaskCount);
+		u32 executedCount = 0;
+		ITask* task = nullptr;
+		while (executedCount < pendingCount && m_MainThreadQueue.TryPop(task))
+		{
+			HASYNC_PROFILE_EVENT(AsyncEventType::Dequeue, task, static_cast<u32>(m_MainThreadQueue.Size()));
+			HASYNC_PROFILE_EVENT(AsyncEventType::Start, task);
+			task->PreExecute();
+			task->Execute();
+			HASYNC_PROFILE_EVENT(AsyncEventType::End, task);
+			executedCount++;
+		}
+		return executedCount;
+	}
+
+	bool AsyncOrchestrator::IsMainThread() const
+	{
+		return std::this_thread::get_id() == m_MainThreadId;
+	}
+
+	bool AsyncOrchestrator::IsCurrentThreadAffinity(TaskAffinity affinity) const
+	{
+		switch (affinity)
+		{
+		case TaskAffinity::Compute:
+			return m_ComputeWorkers.GetCurrentWorkerIndex() < m_ComputeWorkers.GetWorkerCount();
+		case TaskAffinity::IO:
+			return m_IOWorkers.GetCurrentWorkerIndex() < m_IOWorkers.GetWorkerCount();
+		case TaskAffinity::MainThread:
+			return IsMainThread();
+		default:
+			return false;
+		}
+	}
+
+	u64 AsyncOrchestrator::GetWorkerCount() const
+	{
+		return m_ComputeWorkers.GetWorkerCount();
+	}
+
+	u32 AsyncOrchestrator::GetCurrentWorkerIndex() const
+	{
+		return m_ComputeWorkers.GetCurrentWorkerIndex();
+	}
+
+	WorkerSystem& AsyncOrchestrator::GetWorkerSystem(TaskAffinity affinity)
+	{
+		HASSERT(affinity == TaskAffinity::Compute || affinity == TaskAffinity::IO, "Only the compute and IO affinities have a worker pool");
+		return affinity == TaskAffinity::IO ? m_IOWorkers : m_ComputeWorkers;
 	}
 
 	void AsyncOrchestrator::Shutdown()
 	{
-		m_WorkerSystem.Shutdown();
+		m_IOWorkers.Shutdown();
+		m_ComputeWorkers.Shutdown();
+		if (!m_MainThreadQueue.Empty())
+		{
+			HWARN("{0} main-thread task(s) were never drained", m_MainThreadQueue.Size());
+		}
 	}
 }
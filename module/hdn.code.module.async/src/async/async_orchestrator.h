@@ -2,18 +2,49 @@
 
 #include "async_task.h"
 #include "async_worker.h"
+#include "async_injection_queue.h"
+
+#include <limits>
+#include <thread>
+
+// Binds each compute worker to its own core, only worth it when the process owns the machine
+#define HDN_ASYNC_PIN_COMPUTE_WORKERS NOT_IN_USE
 
 namespace hdn
 {
+	// Owns one worker pool per TaskAffinity: compute tasks run on one worker per core, blocking IO on a larger pool
+	// and main-thread tasks wait in a queue until the main thread drains it
 	class AsyncOrchestrator
 	{
 	public:
 		static AsyncOrchestrator& Get();
+		// Routes the task to the pool matching its affinity
 		void AddPendingTask(ITask* task);
+		// Helps executing pending tasks on the calling thread until the task is completed
+		// On the main thread the main-thread tasks are drained as well, so waiting on them cannot dead lock
+		void Wait(const ITask* task);
+		// Runs one pending compute task on the calling thread
+		bool ExecutePendingTask();
+		// Runs the main-thread tasks queued before the call (at most maxTaskCount), returns the number of executed tasks
+		// Must be called by the main thread, once per frame
+		u32 DrainMainThreadTasks(u32 maxTaskCount = std::numeric_limits<u32>::max());
+		bool IsMainThread() const;
+		// True if the calling thread belongs to the pool of the affinity (the main thread for TaskAffinity::MainThread)
+		bool IsCurrentThreadAffinity(TaskAffinity affinity) const;
+		// Worker count and worker index of the compute pool
+		u64 GetWorkerCount() const;
+		u32 GetCurrentWorkerIndex() const;
+		WorkerSystem& GetWorkerSystem(TaskAffinity affinity);
 		void Shutdown();
 	private:
 		AsyncOrchestrator();
 	private:
-		WorkerSystem m_WorkerSystem;
+		static constexpr u64 MAIN_THREAD_QUEUE_CAPACITY = 4096;
+
+		// The orchestrator is created on first use, which is expected to happen on the main thread
+		std::thread::id m_MainThreadId;
+		WorkerSystem m_ComputeWorkers;
+		WorkerSystem m_IOWorkers;
+		InjectionQueue<ITask*> m_MainThreadQueue;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/stl/vector.h"
+#include "core/allocator/memory_tracker.h"
+
+#include "async_task_leaf.h"
+#include "async_orchestrator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+namespace hdn
+{
+	struct ParallelRange
+	{
+		u64 begin = 0;
+		u64 end = 0;
+
+		inline u64 Size() const { return end > begin ? end - begin : 0; }
+		inline bool Empty() const { return end <= begin; }
+	};
+
+	namespace detail
+	{
+		// Number of halvings a stolen range is allowed on top of the initial budget
+		static constexpr u32 PARALLEL_FOR_STOLEN_SPLIT_DEPTH = 2;
+
+		inline u32 ParallelForInitialSplitDepth(u64 workerCount)
+		{
+			// ~4 chunks per worker to start with, more only if the chunks get stolen
+			u32 depth = 2;
+			while ((1ull << depth) < workerCount * 4)
+			{
+				depth++;
+			}
+			return depth;
+		}
+
+		template<typename Func>
+		struct ParallelForContext
+		{
+			ParallelForContext(const Func& func, u64 grainSize, u64 pendingCount)
+				: func{ func }, grainSize{ grainSize }, pendingCount{ pendingCount }
+			{
+			}
+
+			inline void Invoke(u64 begin, u64 end) const
+			{
+#if USING(HDN_MEMORY_TRACKING)
+				// The allocations of the body belong to the subsystem that started the loop, not to the worker running it
+				const MemoryTagScope memoryTagScope{ memoryTag };
+#endif
+				if constexpr (std::is_invocable_v<const Func&, u64, u64>)
+				{
+					func(begin, end);
+				}
+				else
+				{
+					for (u64 i = begin; i < end; i++)
+					{
+						func(i);
+					}
+				}
+			}
+
+			const Func& func;
+			const u64 grainSize;
+			std::atomic<u64> pendingCount;
+#if USING(HDN_MEMORY_TRACKING)
+			const MemoryTag memoryTag = MemoryTracker::GetCurrentTag();
+#endif
+		};
+
+		// Lazy binary splitting: a range is halved while it is bigger than the grain and while it still has a split budget
+		// The right half is pushed to the local deque, so thieves take the largest remaining chunks first
+		// A range that was stolen gets a fresh budget, which lets the decomposition adapt to load imbalance
+		template<typename Func>
+		class ParallelForTask : public ITaskLeaf
+		{
+		public:
+			ParallelForTask(ParallelForContext<Func>* context, u64 begin, u64 end, u32 splitDepth, u32 ownerWorker, bool heapAllocated)
+				: m_Context{ context }, m_Begin{ begin }, m_End{ end }, m_SplitDepth{ splitDepth }, m_OwnerWorker{ ownerWorker }, m_HeapAllocated{ heapAllocated }
+			{
+			}
+
+			void Execute() override
+			{
+				AsyncOrchestrator& orchestrator = AsyncOrchestrator::Get();
+				const u32 currentWorker = orchestrator.GetCurrentWorkerIndex();
+				if (m_HeapAllocated && currentWorker != m_OwnerWorker)
+				{
+					m_SplitDepth += PARALLEL_FOR_STOLEN_SPLIT_DEPTH;
+				}
+
+				while (m_End - m_Begin > m_Context->grainSize && m_SplitDepth > 0)
+				{
+					const u64 middle = m_Begin + (m_End - m_Begin) / 2;
+					m_SplitDepth--;
+					m_Context->pendingCount.fetch_add(1, std::memory_order_relaxed);
+					orchestrator.AddPendingTask(new ParallelForTask(m_Context, middle, m_End, m_SplitDepth, currentWorker, true));
+					m_End = middle;
+				}
+
+				m_Context->Invoke(m_Begin, m_End);
+
+				// The context lives on the stack of the thread waiting on pendingCount, do not touch it after the decrement
+				const bool heapAllocated = m_HeapAllocated;
+				m_Context->pendingCount.fetch_sub(1, std::memory_order_acq_rel);
+				if (heapAllocated)
+				{
+					// Nothing depends on split tasks, and the worker does not touch a task once Execute() returns
+					delete this;
+				}
+			}
+
+			virtual const char* GetName() const override
+			{
+				return "ParallelForTask";
+			}
+		private:
+			ParallelForContext<Func>* m_Context;
+			u64 m_Begin;
+			u64 m_End;
+			u32 m_SplitDepth;
+			u32 m_OwnerWorker;
+			bool m_HeapAllocated;
+		};
+	}
+
+	// Runs func over the range on the orchestrator's workers and returns once every index was processed
+	// func is either void(u64 index) or void(u64 begin, u64 end), grainSize is the minimum amount of indices per invocation (0 = automatic)
+	// The calling thread takes part in the work, so ParallelFor can be called from inside a task
+	template<typename Func>
+	void ParallelFor(ParallelRange range, u64 grainSize, const Func& func)
+	{
+		if (range.Empty())
+		{
+			return;
+		}
+
+		grainSize = grainSize == 0 ? 1 : grainSize;
+		if (range.Size() <= grainSize)
+		{
+			// Not worth waking the workers
+			detail::ParallelForContext<Func> context{ func, grainSize, 0 };
+			context.Invoke(range.begin, range.end);
+			return;
+		}
+
+		AsyncOrchestrator& orchestrator = AsyncOrchestrator::Get();
+		detail::ParallelForContext<Func> context{ func, grainSize, 1 };
+		detail::ParallelForTask<Func> rootTask{
+			&context, range.begin, range.end,
+			detail::ParallelForInitialSplitDepth(orchestrator.GetWorkerCount()),
+			orchestrator.GetCurrentWorkerIndex(),
+			false
+		};
+		rootTask.Execute();
+
+		while (context.pendingCount.load(std::memory_order_acquire) != 0)
+		{
+			if (!orchestrator.ExecutePendingTask())
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	template<typename Func>
+	void ParallelFor(u64 begin, u64 end, u64 grainSize, const Func& func)
+	{
+		ParallelFor(ParallelRange{ begin, end }, grainSize, func);
+	}
+
+	// map is T(u64 begin, u64 end) and reduce is T(const T&, const T&), reduce must be associative but does not need to be commutative:
+	// the range is cut in fixed blocks of grainSize indices and the partial results are combined in block order, so the result is deterministic
+	template<typename T, typename MapFunc, typename ReduceFunc>
+	T ParallelReduce(ParallelRange range, u64 grainSize, const T& identity, const MapFunc& map, const ReduceFunc& reduce)
+	{
+		if (range.Empty())
+		{
+			return identity;
+		}
+
+		if (grainSize == 0)
+		{
+			const u64 blockTarget = AsyncOrchestrator::Get().GetWorkerCount() * 8;
+			grainSize = std::max<u64>(1, (range.Size() + blockTarget - 1) / blockTarget);
+		}
+
+		const u64 blockCount = (range.Size() + grainSize - 1) / grainSize;
+		if (blockCount == 1)
+		{
+			return reduce(identity, map(range.begin, range.end));
+		}
+
+		vector<T> partials(blockCount, identity);
+		ParallelFor(ParallelRange{ 0, blockCount }, 1, [&](u64 block) {
+			const u64 blockBegin = range.begin + block * grainSize;
+			const u64 blockEnd = std::min<u64>(blockBegin + grainSize, range.end);
+			partials[block] = map(blockBegin, blockEnd);
+		});
+
+		T result = identity;
+		for (const T& partial : partials)
+		{
+			result = reduce(result, partial);
+		}
+		return result;
+	}
+
+	template<typename T, typename MapFunc, typename ReduceFunc>
+	T ParallelReduce(u64 begin, u64 end, u64 grainSize, const T& identity, const MapFunc& map, const ReduceFunc& reduce)
+	{
+		return ParallelReduce(ParallelRange{ begin, end }, grainSize, identity, map, reduce);
+	}
+}
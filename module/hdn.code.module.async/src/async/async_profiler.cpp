@@ -0,0 +1,443 @@
+#include "async_profiler.h"
+
+#include "core/stl/unordered_map.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace hdn
+{
+	static constexpr u32 THREAD_NAME_LENGTH = 32;
+	static thread_local char t_ThreadName[THREAD_NAME_LENGTH] = {};
+
+	static inline u64 NowNanoseconds()
+	{
+		return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	static inline f64 ToMicroseconds(u64 nanoseconds)
+	{
+		return static_cast<f64>(nanoseconds) / 1000.0;
+	}
+
+	static f64 Percentile(vector<u64>& values, f64 percentile)
+	{
+		if (values.empty())
+		{
+			return 0.0;
+		}
+		const size_t index = std::min(values.size() - 1, static_cast<size_t>(percentile * static_cast<f64>(values.size())));
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return ToMicroseconds(values[index]);
+	}
+
+	static void WriteJsonString(std::ofstream& file, const char* text)
+	{
+		file << '"';
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				file << '\\';
+			}
+			if (static_cast<unsigned char>(*c) >= 0x20)
+			{
+				file << *c;
+			}
+		}
+		file << '"';
+	}
+
+	static const char* GetAffinityName(TaskAffinity affinity)
+	{
+		switch (affinity)
+		{
+		case TaskAffinity::Compute: return "Compute";
+		case TaskAffinity::IO: return "IO";
+		case TaskAffinity::MainThread: return "MainThread";
+		default: return "Unknown";
+		}
+	}
+
+	AsyncProfiler::ThreadBuffer::ThreadBuffer(const char* threadName, u64 capacity)
+		: name{ threadName }, events{ CreateScope<AsyncEvent[]>(capacity) }, capacity{ capacity }
+	{
+	}
+
+	AsyncProfiler& AsyncProfiler::Get()
+	{
+		static AsyncProfiler s_Instance;
+		return s_Instance;
+	}
+
+	void AsyncProfiler::BeginCapture()
+	{
+		m_CaptureStart = NowNanoseconds();
+		m_CaptureEnd = 0;
+		m_CaptureIndex.fetch_add(1, std::memory_order_release);
+		m_Capturing.store(true, std::memory_order_release);
+	}
+
+	void AsyncProfiler::EndCapture()
+	{
+		m_Capturing.store(false, std::memory_order_release);
+		m_CaptureEnd = NowNanoseconds();
+	}
+
+	void AsyncProfiler::SetCurrentThreadName(const char* name, u32 index)
+	{
+		snprintf(t_ThreadName, THREAD_NAME_LENGTH, "%s %u", name, index);
+	}
+
+	void AsyncProfiler::RecordEvent(AsyncEventType type, const ITask* task, u32 value)
+	{
+		ThreadBuffer* buffer = GetThreadBuffer();
+		const u64 captureIndex = m_CaptureIndex.load(std::memory_order_acquire);
+		if (buffer->captureIndex.load(std::memory_order_relaxed) != captureIndex)
+		{
+			buffer->writeIndex.store(0, std::memory_order_relaxed);
+			buffer->captureIndex.store(captureIndex, std::memory_order_release);
+		}
+
+		const u64 writeIndex = buffer->writeIndex.load(std::memory_order_relaxed);
+		AsyncEvent& event = buffer->events[writeIndex % buffer->capacity];
+		event.timestamp = NowNanoseconds();
+		event.task = task;
+		event.value = value;
+		event.type = type;
+		event.affinity = TaskAffinity::Count;
+		event.name[0] = '\0';
+		if (task && type != AsyncEventType::End)
+		{
+			event.affinity = task->Affinity();
+			const char* name = task->GetName();
+			u32 i = 0;
+			for (; i < AsyncEvent::NAME_LENGTH - 1 && name[i]; i++)
+			{
+				event.name[i] = name[i];
+			}
+			event.name[i] = '\0';
+		}
+		buffer->writeIndex.store(writeIndex + 1, std::memory_order_release);
+	}
+
+	AsyncProfiler::ThreadBuffer* AsyncProfiler::GetThreadBuffer()
+	{
+		static thread_local ThreadBuffer* t_Buffer = nullptr;
+		if (!t_Buffer)
+		{
+			std::lock_guard<std::mutex> lock(m_BuffersMutex);
+			if (t_ThreadName[0] == '\0')
+			{
+				snprintf(t_ThreadName, THREAD_NAME_LENGTH, "Thread %u", static_cast<u32>(m_Buffers.size()));
+			}
+			m_Buffers.push_back(CreateScope<ThreadBuffer>(t_ThreadName, EVENT_BUFFER_CAPACITY));
+			t_Buffer = m_Buffers.back().get();
+		}
+		return t_Buffer;
+	}
+
+	vector<AsyncProfiler::ThreadEvent> AsyncProfiler::CollectEvents(u64& droppedEventCount) const
+	{
+		vector<ThreadEvent> events;
+		droppedEventCount = 0;
+		const u64 captureIndex = m_CaptureIndex.load(std::memory_order_acquire);
+
+		std::lock_guard<std::mutex> lock(m_BuffersMutex);
+		for (u32 threadIndex = 0; threadIndex < m_Buffers.size(); threadIndex++)
+		{
+			const ThreadBuffer& buffer = *m_Buffers[threadIndex];
+			if (buffer.captureIndex.load(std::memory_order_acquire) != captureIndex)
+			{
+				continue;
+			}
+
+			const u64 writeIndex = buffer.writeIndex.load(std::memory_order_acquire);
+			const u64 readIndex = writeIndex > buffer.capacity ? writeIndex - buffer.capacity : 0;
+			droppedEventCount += readIndex;
+			for (u64 i = readIndex; i < writeIndex; i++)
+			{
+				events.push_back({ &buffer.events[i % buffer.capacity], threadIndex });
+			}
+		}
+
+		std::stable_sort(events.begin(), events.end(), [](const ThreadEvent& lhs, const ThreadEvent& rhs) {
+			return lhs.event->timestamp < rhs.event->timestamp;
+			});
+		return events;
+	}
+
+	bool AsyncProfiler::ExportChromeTrace(const char* path) const
+	{
+		u64 droppedEventCount = 0;
+		const vector<ThreadEvent> events = CollectEvents(droppedEventCount);
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			HERR("Could not open file '{0}' for writing", path);
+			return false;
+		}
+
+		file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+		{
+			std::lock_guard<std::mutex> lock(m_BuffersMutex);
+			for (u32 threadIndex = 0; threadIndex < m_Buffers.size(); threadIndex++)
+			{
+				file << (threadIndex == 0 ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << threadIndex << ",\"args\":{\"name\":";
+				WriteJsonString(file, m_Buffers[threadIndex]->name.c_str());
+				file << "}}";
+			}
+		}
+
+		// Queue depth per affinity, rebuilt from the depth sampled at every push and pop
+		u32 queueDepths[Underlying(TaskAffinity::Count)] = {};
+		file.precision(3);
+		file << std::fixed;
+		for (const ThreadEvent& threadEvent : events)
+		{
+			const AsyncEvent& event = *threadEvent.event;
+			const f64 timestamp = ToMicroseconds(event.timestamp - std::min(event.timestamp, m_CaptureStart));
+			file << ",\n{\"pid\":0,\"tid\":" << threadEvent.threadIndex << ",\"ts\":" << timestamp << ",";
+			switch (event.type)
+			{
+			case AsyncEventType::Start:
+				file << "\"ph\":\"B\",\"name\":";
+				WriteJsonString(file, event.name);
+				file << ",\"args\":{\"pool\":\"" << GetAffinityName(event.affinity) << "\"}}";
+				// The flow arrow goes from the enqueue to the start, its length is the queue wait
+				file << ",\n{\"ph\":\"f\",\"bp\":\"e\",\"name\":\"queue\",\"cat\":\"queue\",\"id\":" << reinterpret_cast<uintptr_t>(event.task)
+					<< ",\"pid\":0,\"tid\":" << threadEvent.threadIndex << ",\"ts\":" << timestamp << "}";
+				break;
+			case AsyncEventType::End:
+				file << "\"ph\":\"E\"}";
+				break;
+			case AsyncEventType::Park:
+				file << "\"ph\":\"B\",\"name\":\"Parked\",\"cat\":\"idle\"}";
+				break;
+			case AsyncEventType::Unpark:
+				file << "\"ph\":\"E\",\"cat\":\"idle\"}";
+				break;
+			case AsyncEventType::Steal:
+				file << "\"ph\":\"i\",\"s\":\"t\",\"name\":\"Steal\",\"args\":{\"task\":";
+				WriteJsonString(file, event.name);
+				file << ",\"victim\":" << event.value << "}}";
+				break;
+			case AsyncEventType::Enqueue:
+			case AsyncEventType::Dequeue:
+			{
+				const bool enqueue = event.type == AsyncEventType::Enqueue;
+				file << "\"ph\":\"i\",\"s\":\"t\",\"name\":\"" << (enqueue ? "Enqueue" : "Dequeue") << "\",\"args\":{\"task\":";
+				WriteJsonString(file, event.name);
+				file << "}}";
+				if (enqueue)
+				{
+					file << ",\n{\"ph\":\"s\",\"name\":\"queue\",\"cat\":\"queue\",\"id\":" << reinterpret_cast<uintptr_t>(event.task)
+						<< ",\"pid\":0,\"tid\":" << threadEvent.threadIndex << ",\"ts\":" << timestamp << "}";
+				}
+				if (event.affinity < TaskAffinity::Count)
+				{
+					queueDepths[Underlying(event.affinity)] = event.value;
+					file << ",\n{\"ph\":\"C\",\"name\":\"Queue depth\",\"pid\":0,\"ts\":" << timestamp << ",\"args\":{";
+					for (u8 affinity = 0; affinity < Underlying(TaskAffinity::Count); affinity++)
+					{
+						file << (affinity == 0 ? "" : ",") << "\"" << GetAffinityName(static_cast<TaskAffinity>(affinity)) << "\":" << queueDepths[affinity];
+					}
+					file << "}}";
+				}
+				break;
+			}
+			default:
+				file << "\"ph\":\"i\",\"name\":\"Unknown\"}";
+				break;
+			}
+		}
+		file << "\n],\"otherData\":{\"droppedEvents\":" << droppedEventCount << "}}\n";
+		file.close();
+
+		if (file.fail())
+		{
+			HERR("Failed to write to file '{0}'", path);
+			return false;
+		}
+		HINFO("Async trace exported to '{0}' ({1} events, {2} dropped)", path, events.size(), droppedEventCount);
+		return true;
+	}
+
+	AsyncProfileSummary AsyncProfiler::ComputeSummary() const
+	{
+		AsyncProfileSummary summary;
+		const vector<ThreadEvent> events = CollectEvents(summary.droppedEventCount);
+		if (events.empty())
+		{
+			return summary;
+		}
+
+		const u64 captureStart = std::min(m_CaptureStart, events.front().event->timestamp);
+		const u64 captureEnd = std::max(m_CaptureEnd, events.back().event->timestamp);
+		summary.duration = ToMicroseconds(captureEnd - captureStart);
+
+		struct RunningTask
+		{
+			const ITask* task;
+			const char* name;
+			u64 startTime;
+		};
+
+		struct ThreadState
+		{
+			vector<RunningTask> runningTasks; // Tasks nest when a thread helps while waiting
+			u64 busyTime = 0;
+			u64 parkedTime = 0;
+			u64 parkStart = 0;
+			bool parked = false;
+			u64 taskCount = 0;
+			u64 stealCount = 0;
+		};
+
+		struct TaskTypeSamples
+		{
+			vector<u64> executionTimes;
+			vector<u64> queueWaitTimes;
+		};
+
+		u32 threadCount = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_BuffersMutex);
+			threadCount = static_cast<u32>(m_Buffers.size());
+			summary.threads.resize(threadCount);
+			for (u32 i = 0; i < threadCount; i++)
+			{
+				summary.threads[i].name = m_Buffers[i]->name;
+			}
+		}
+
+		vector<ThreadState> threads(threadCount);
+		unordered_map<const ITask*, u64> enqueueTimes;
+		unordered_map<string, TaskTypeSamples> taskTypes;
+		u32 queueDepths[Underlying(TaskAffinity::Count)] = {};
+		u64 queueDepthSampleCount = 0;
+		u64 queueDepthSum = 0;
+
+		for (const ThreadEvent& threadEvent : events)
+		{
+			const AsyncEvent& event = *threadEvent.event;
+			ThreadState& thread = threads[threadEvent.threadIndex];
+			switch (event.type)
+			{
+			case AsyncEventType::Enqueue:
+			case AsyncEventType::Dequeue:
+				if (event.type == AsyncEventType::Enqueue)
+				{
+					enqueueTimes[event.task] = event.timestamp;
+				}
+				if (event.affinity < TaskAffinity::Count)
+				{
+					queueDepths[Underlying(event.affinity)] = event.value;
+					u32 totalDepth = 0;
+					for (const u32 depth : queueDepths)
+					{
+						totalDepth += depth;
+					}
+					summary.maxQueueDepth = std::max(summary.maxQueueDepth, totalDepth);
+					queueDepthSum += totalDepth;
+					queueDepthSampleCount++;
+				}
+				break;
+			case AsyncEventType::Steal:
+				thread.stealCount++;
+				break;
+			case AsyncEventType::Start:
+			{
+				thread.runningTasks.push_back({ event.task, event.name, event.timestamp });
+				auto enqueueTime = enqueueTimes.find(event.task);
+				if (enqueueTime != enqueueTimes.end())
+				{
+					taskTypes[string{ event.name }].queueWaitTimes.push_back(event.timestamp - enqueueTime->second);
+					enqueueTimes.erase(enqueueTime);
+				}
+				break;
+			}
+			case AsyncEventType::End:
+				if (!thread.runningTasks.empty())
+				{
+					const RunningTask runningTask = thread.runningTasks.back();
+					thread.runningTasks.pop_back();
+					const u64 executionTime = event.timestamp - runningTask.startTime;
+					taskTypes[string{ runningTask.name }].executionTimes.push_back(executionTime);
+					thread.taskCount++;
+					// Nested tasks run inside the time of the outer one
+					if (thread.runningTasks.empty())
+					{
+						thread.busyTime += executionTime;
+					}
+				}
+				break;
+			case AsyncEventType::Park:
+				thread.parked = true;
+				thread.parkStart = event.timestamp;
+				break;
+			case AsyncEventType::Unpark:
+				if (thread.parked)
+				{
+					thread.parked = false;
+					thread.parkedTime += event.timestamp - thread.parkStart;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		const f64 duration = static_cast<f64>(std::max<u64>(captureEnd - captureStart, 1));
+		for (u32 i = 0; i < threadCount; i++)
+		{
+			ThreadState& thread = threads[i];
+			if (thread.parked)
+			{
+				thread.parkedTime += captureEnd - thread.parkStart;
+			}
+			AsyncThreadStats& stats = summary.threads[i];
+			stats.busyRatio = static_cast<f64>(thread.busyTime) / duration;
+			stats.parkedRatio = static_cast<f64>(thread.parkedTime) / duration;
+			stats.taskCount = thread.taskCount;
+			stats.stealCount = thread.stealCount;
+		}
+
+		summary.averageQueueDepth = queueDepthSampleCount ? static_cast<f64>(queueDepthSum) / static_cast<f64>(queueDepthSampleCount) : 0.0;
+
+		summary.taskTypes.reserve(taskTypes.size());
+		for (auto& [name, samples] : taskTypes)
+		{
+			AsyncTaskTypeStats& stats = summary.taskTypes.emplace_back();
+			stats.name = name;
+			stats.count = samples.executionTimes.size();
+			stats.executionP50 = Percentile(samples.executionTimes, 0.50);
+			stats.executionP99 = Percentile(samples.executionTimes, 0.99);
+			stats.queueWaitP50 = Percentile(samples.queueWaitTimes, 0.50);
+			stats.queueWaitP99 = Percentile(samples.queueWaitTimes, 0.99);
+		}
+		std::sort(summary.taskTypes.begin(), summary.taskTypes.end(), [](const AsyncTaskTypeStats& lhs, const AsyncTaskTypeStats& rhs) {
+			return lhs.count > rhs.count;
+			});
+		return summary;
+	}
+
+	void AsyncProfiler::LogSummary() const
+	{
+		const AsyncProfileSummary summary = ComputeSummary();
+		HINFO("Async capture: {0:.0f}us, queue depth max {1} / avg {2:.2f}, {3} dropped events", summary.duration, summary.maxQueueDepth, summary.averageQueueDepth, summary.droppedEventCount);
+		for (const AsyncTaskTypeStats& stats : summary.taskTypes)
+		{
+			HINFO("  {0}: {1} runs, execution p50 {2:.1f}us p99 {3:.1f}us, queue wait p50 {4:.1f}us p99 {5:.1f}us",
+				stats.name.c_str(), stats.count, stats.executionP50, stats.executionP99, stats.queueWaitP50, stats.queueWaitP99);
+		}
+		for (const AsyncThreadStats& stats : summary.threads)
+		{
+			HINFO("  [{0}] busy {1:.1f}%, parked {2:.1f}%, {3} tasks, {4} steals",
+				stats.name.c_str(), stats.busyRatio * 100.0, stats.parkedRatio * 100.0, stats.taskCount, stats.stealCount);
+		}
+	}
+}
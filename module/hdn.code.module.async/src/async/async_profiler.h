@@ -0,0 +1,140 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/stl/vector.h"
+
+#include "async_task.h"
+
+#include <atomic>
+#include <mutex>
+
+// Records the scheduler events of every thread while a capture is running, compiled out of release builds
+#define HDN_ASYNC_PROFILING USE_IF( USING(DEV) )
+
+#if USING(HDN_ASYNC_PROFILING)
+#define HASYNC_PROFILE_EVENT(type, task, ...) { ::hdn::AsyncProfiler::Get().Record(type, task, ##__VA_ARGS__); }
+#define HASYNC_PROFILE_THREAD_NAME(name, index) { ::hdn::AsyncProfiler::SetCurrentThreadName(name, index); }
+#else
+#define HASYNC_PROFILE_EVENT(type, task, ...)
+#define HASYNC_PROFILE_THREAD_NAME(name, index)
+#endif
+
+namespace hdn
+{
+	enum class AsyncEventType : u8
+	{
+		Enqueue,	// value: depth of the queue the task was pushed to
+		Dequeue,	// value: depth of the queue after the pop
+		Steal,		// value: index of the victim worker
+		Start,
+		End,		// The task can be destroyed by then, only its address is recorded
+		Park,
+		Unpark
+	};
+
+	// One cache line per event
+	struct AsyncEvent
+	{
+		static constexpr u32 NAME_LENGTH = 40;
+
+		u64 timestamp; // Nanoseconds, steady clock
+		const ITask* task;
+		u32 value;
+		AsyncEventType type;
+		TaskAffinity affinity;
+		char name[NAME_LENGTH]; // Copied, the task does not necessarily outlive the capture
+	};
+
+	struct AsyncTaskTypeStats
+	{
+		string name;
+		u64 count = 0;
+		f64 executionP50 = 0.0; // Microseconds
+		f64 executionP99 = 0.0;
+		f64 queueWaitP50 = 0.0;
+		f64 queueWaitP99 = 0.0;
+	};
+
+	struct AsyncThreadStats
+	{
+		string name;
+		f64 busyRatio = 0.0;
+		f64 parkedRatio = 0.0;
+		u64 taskCount = 0;
+		u64 stealCount = 0;
+	};
+
+	struct AsyncProfileSummary
+	{
+		f64 duration = 0.0; // Microseconds
+		vector<AsyncTaskTypeStats> taskTypes;
+		vector<AsyncThreadStats> threads;
+		u32 maxQueueDepth = 0;
+		f64 averageQueueDepth = 0.0;
+		u64 droppedEventCount = 0;
+	};
+
+	// Each thread writes its events to its own ring buffer, so recording is a clock read and a 64 bytes copy without any contention
+	// When a buffer wraps the oldest events are dropped, the exporters report how many
+	// Export while the workers are idle: the buffers are read without synchronizing with the writers
+	class AsyncProfiler
+	{
+	public:
+		static AsyncProfiler& Get();
+
+		// Clears the previous capture
+		void BeginCapture();
+		void EndCapture();
+		bool IsCapturing() const { return m_Capturing.load(std::memory_order_relaxed); }
+
+		inline void Record(AsyncEventType type, const ITask* task, u32 value = 0)
+		{
+			if (IsCapturing())
+			{
+				RecordEvent(type, task, value);
+			}
+		}
+
+		// Name displayed for the calling thread in the trace ("Compute 3", "IO 0", ...), must be called before its first event
+		static void SetCurrentThreadName(const char* name, u32 index);
+
+		// Chrome trace event format, can be opened in chrome://tracing or ui.perfetto.dev
+		bool ExportChromeTrace(const char* path) const;
+		AsyncProfileSummary ComputeSummary() const;
+		void LogSummary() const;
+	private:
+		struct ThreadBuffer
+		{
+			ThreadBuffer(const char* threadName, u64 capacity);
+
+			string name;
+			Scope<AsyncEvent[]> events;
+			u64 capacity;
+			std::atomic<u64> writeIndex{ 0 };
+			// The owning thread clears its buffer when it notices a new capture, a buffer from an older capture is ignored
+			std::atomic<u64> captureIndex{ 0 };
+		};
+
+		struct ThreadEvent
+		{
+			const AsyncEvent* event;
+			u32 threadIndex;
+		};
+
+		AsyncProfiler() = default;
+		void RecordEvent(AsyncEventType type, const ITask* task, u32 value);
+		ThreadBuffer* GetThreadBuffer();
+		// Events of every thread, sorted by timestamp
+		vector<ThreadEvent> CollectEvents(u64& droppedEventCount) const;
+	private:
+		static constexpr u64 EVENT_BUFFER_CAPACITY = 16 * 1024;
+
+		std::atomic<bool> m_Capturing{ false };
+		std::atomic<u64> m_CaptureIndex{ 0 };
+		u64 m_CaptureStart = 0;
+		u64 m_CaptureEnd = 0;
+
+		mutable std::mutex m_BuffersMutex;
+		vector<Scope<ThreadBuffer>> m_Buffers;
+	};
+}
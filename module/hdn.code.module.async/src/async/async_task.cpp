@@ -1,10 +1,26 @@
 #include "async_task.h"
 
 #include "async_orchestrator.h"
+#include "async_compiled_graph.h"
 
 namespace hdn
 {
-	static std::mutex m_EnqueueFuncMutex;
+	void* ITask::operator new(size_t size)
+	{
+		return GetPool().Allocate(size);
+	}
+
+	void ITask::operator delete(void* block, size_t size)
+	{
+		GetPool().Deallocate(block, size);
+	}
+
+	ConcurrentObjectPool& ITask::GetPool()
+	{
+		// Never destroyed, tasks can outlive the static destruction
+		static ConcurrentObjectPool* s_Pool = new ConcurrentObjectPool("ITask");
+		return *s_Pool;
+	}
 
 	void ITask::PreExecute()
 	{
@@ -14,18 +30,36 @@ namespace hdn
 	void ITask::Complete()
 	{
 		m_EndTime = std::chrono::high_resolution_clock::now();
-		// Notify the parent if there is one
-		if (m_Parent)
+
+		if (m_CompiledGraph)
 		{
-			m_Parent->DependencyCompletionNotification(this);
+			CompiledTaskGraph* graph = m_CompiledGraph;
+			const u32 nodeIndex = m_CompiledNodeIndex;
+			m_Completed.store(true, std::memory_order_release);
+			graph->NodeCompleted(nodeIndex);
+			return;
 		}
 
-		// Notify all the tasks that depend on this one, the let the dependencies enqueue themselve in the orchestrator
+		// Notify all the tasks that depend on this one, the last notified dependency enqueues itself in the orchestrator
+		// Out dependencies are siblings, they are kept alive by the parent which cannot complete before we notify it below
 		for (ITask* task : m_OutDep)
 		{
 			HASSERT_TASK(task);
 			task->DependencyCompletionNotification(this);
 		}
+
+		// Once the completed flag is visible the owner of a root task is free to destroy it, do not touch any member after this point
+		ITask* parent = m_Parent;
+		m_Completed.store(true, std::memory_order_release);
+		if (parent)
+		{
+			parent->DependencyCompletionNotification(this);
+		}
+	}
+
+	bool ITask::Completed() const
+	{
+		return m_Completed.load(std::memory_order_acquire);
 	}
 
 	bool ITask::Independent() const
@@ -36,24 +70,41 @@ namespace hdn
 	void ITask::Enqueue()
 	{
 		// HASSERT(!IsEnqueued(), "Cannot enqueue the same task two times!");
-		if (IsEnqueued())
+		if (!TryMarkEnqueued())
 		{
 			return;
 		}
-
-		std::lock_guard<std::mutex> lock(m_EnqueueFuncMutex);
 		AsyncOrchestrator::Get().AddPendingTask(this);
-		m_Enqueued = true;
+	}
+
+	bool ITask::TryMarkEnqueued()
+	{
+		return !m_Enqueued.exchange(true, std::memory_order_acq_rel);
 	}
 
 	bool ITask::IsEnqueued()
 	{
-		return m_Enqueued;
+		return m_Enqueued.load(std::memory_order_acquire);
+	}
+
+	void ITask::Reset()
+	{
+		m_Enqueued.store(false, std::memory_order_relaxed);
+		m_Completed.store(false, std::memory_order_relaxed);
+		m_PendingInDep.store(static_cast<u32>(m_InDep.size()), std::memory_order_relaxed);
+		m_PendingInternalDep.store(static_cast<u32>(m_InternalDep.size()), std::memory_order_relaxed);
+		for (ITask* task : m_InternalDep)
+		{
+			task->Reset();
+		}
 	}
 
 	void ITask::AddInDependency(ITask* task)
 	{
-		m_InDep.insert(task);
+		if (m_InDep.insert(task).second)
+		{
+			m_PendingInDep.fetch_add(1, std::memory_order_relaxed);
+		}
 	}
 
 	void ITask::AddOutDependency(ITask* task)
@@ -63,7 +114,10 @@ namespace hdn
 
 	void ITask::AddInternalDependency(ITask* task)
 	{
-		m_InternalDep.insert(task);
+		if (m_InternalDep.insert(task).second)
+		{
+			m_PendingInternalDep.fetch_add(1, std::memory_order_relaxed);
+		}
 	}
 
 	void ITask::SetParent(ITask* parent)
@@ -71,30 +125,46 @@ namespace hdn
 		m_Parent = parent;
 	}
 
-	bool ITask::AreInDepResolved() const
+	void ITask::DependencyCompletionNotification(ITask* task)
 	{
-		for (ITask* task : m_InDep)
+		HASSERT_TASK(task);
+		// A task notifies its parent and its out dependencies, the latter always being siblings, so the parent link tells them apart
+		if (task->m_Parent == this)
 		{
-			HASSERT_TASK(task);
-			if (!task->Completed())
+			HASSERT(m_PendingInternalDep.load(std::memory_order_relaxed) > 0, "Internal dependency notified more times than registered");
+			ReleaseCompletion();
+		}
+		else
+		{
+			HASSERT(m_PendingInDep.load(std::memory_order_relaxed) > 0, "In dependency notified more times than registered");
+			if (m_PendingInDep.fetch_sub(1, std::memory_order_acq_rel) == 1)
 			{
-				return false;
+				Enqueue();
 			}
 		}
-		return true;
 	}
 
-	bool ITask::AreInternalDepResolved() const
+	void ITask::HoldCompletion()
 	{
-		for (ITask* task : m_InternalDep)
+		m_PendingInternalDep.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void ITask::ReleaseCompletion()
+	{
+		if (m_PendingInternalDep.fetch_sub(1, std::memory_order_acq_rel) == 1)
 		{
-			HASSERT_TASK(task);
-			if (!task->Completed())
-			{
-				return false;
-			}
+			Complete();
 		}
-		return true;
+	}
+
+	bool ITask::AreInDepResolved() const
+	{
+		return m_PendingInDep.load(std::memory_order_acquire) == 0;
+	}
+
+	bool ITask::AreInternalDepResolved() const
+	{
+		return m_PendingInternalDep.load(std::memory_order_acquire) == 0;
 	}
 
 	const unordered_set<ITask*>& ITask::GetInternalDependencies() const
@@ -111,4 +181,4 @@ namespace hdn
 	{
 		return m_OutDep;
 	}
-}
\ No newline at end of file
+}
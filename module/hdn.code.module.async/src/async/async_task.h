@@ -2,23 +2,44 @@
 
 #include "core/core.h"
 #include "core/stl/unordered_set.h"
+#include "core/allocator/concurrent_object_pool.h"
 
 #include <chrono>
+#include <atomic>
+#include <new>
 
 #define HASSERT_TASK(task) HASSERT(task, "Task cannot be null!")
 
 namespace hdn
 {
+	class CompiledTaskGraph;
+
+	// Selects the pool a task runs on, so blocking work never occupies a compute worker
+	enum class TaskAffinity : u8
+	{
+		Compute = 0,	// CPU bound work, one worker per core
+		IO = 1,			// Work that blocks on the file system (or any other syscall), runs on a larger pool
+		MainThread = 2,	// Work that must run on the main (render) thread, executed by AsyncOrchestrator::DrainMainThreadTasks()
+		Count = 3
+	};
+
 	class ITask
 	{
 	public:
 
 		virtual ~ITask() = default;
 
+		// Tasks are created and destroyed by every worker (ParallelFor splits, loads), they come from a shared pool
+		static void* operator new(size_t size);
+		static void operator delete(void* block, size_t size);
+		static void* operator new(size_t size, std::align_val_t alignment) { return ::operator new(size, alignment); }
+		static void operator delete(void* block, size_t size, std::align_val_t alignment) { ::operator delete(block, size, alignment); }
+		static ConcurrentObjectPool& GetPool();
+
 		virtual void PreExecute();
 		virtual void Execute() = 0;
 		virtual void Complete();
-		virtual bool Completed() const = 0;
+		virtual bool Completed() const;
 
 		// An independent task is a task without in dependencies
 		bool Independent() const;
@@ -29,6 +50,8 @@ namespace hdn
 		// Complexity cannot be 0
 		virtual u32 Complexity() const { return 1; }
 		float Importance() const { return static_cast<float>(Priority()) / static_cast<float>(Complexity()); }
+
+		virtual TaskAffinity Affinity() const { return TaskAffinity::Compute; }
 		
 		// TODO: Remove symbols from release build
 		virtual const char* GetName() const { return "ITask"; }
@@ -63,28 +86,52 @@ namespace hdn
 		void Enqueue();
 		bool IsEnqueued();
 
+		// Clears the enqueued/completed latches and restores the pending dependency counters so the hierarchy can run again
+		// Must only be called once the task (and its whole hierarchy) is completed or was never enqueued
+		virtual void Reset();
+
 		void AddInDependency(ITask* task);
 		void AddOutDependency(ITask* task);
 		void AddInternalDependency(ITask* task);
 		void SetParent(ITask* parent);
+		ITask* GetParent() const { return m_Parent; }
 
-		// This function is called each time a task is completed to let the out dependencies that the task is completed
-		virtual void DependencyCompletionNotification(ITask* task) = 0;
+		// This function is called each time a task is completed to let the out dependencies (or the parent) know that the task is completed
+		// The notification that brings a pending counter to zero is the one that enqueues (or completes) this task
+		virtual void DependencyCompletionNotification(ITask* task);
 
 		const unordered_set<ITask*>& GetInternalDependencies() const;
 		const unordered_set<ITask*>& GetInDependencies() const;
 		const unordered_set<ITask*>& GetOutDependencies() const;
 	protected:
+		// Sets the enqueued latch without scheduling the task, returns false if it was already set
+		bool TryMarkEnqueued();
+
 		bool AreInDepResolved() const;
 		bool AreInternalDepResolved() const;
+
+		// Composite tasks hold their own completion while dispatching their internal dependencies, otherwise the last child
+		// could complete (and let the owner destroy the hierarchy) while Execute() is still iterating
+		void HoldCompletion();
+		void ReleaseCompletion();
 	private:
 		unordered_set<ITask*> m_InDep;
 		unordered_set<ITask*> m_OutDep;
 		unordered_set<ITask*> m_InternalDep;
 		ITask* m_Parent = nullptr;
-		bool m_Enqueued = false;
+
+		std::atomic<u32> m_PendingInDep{ 0 };
+		std::atomic<u32> m_PendingInternalDep{ 0 };
+		std::atomic<bool> m_Enqueued{ false };
+		std::atomic<bool> m_Completed{ false };
+
+		// Set when the task is a node of a compiled graph, completion is then reported to the graph instead of the hierarchy
+		CompiledTaskGraph* m_CompiledGraph = nullptr;
+		u32 m_CompiledNodeIndex = 0;
 
 		std::chrono::steady_clock::time_point m_StartTime;
 		std::chrono::steady_clock::time_point m_EndTime;
+
+		friend class CompiledTaskGraph;
 	};
 }
\ No newline at end of file
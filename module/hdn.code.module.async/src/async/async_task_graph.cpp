@@ -6,6 +6,12 @@ namespace hdn
 	{
 	}
 
+	void ITaskGraph::AddTask(ITask* task)
+	{
+		AddInternalDependency(task);
+		task->SetParent(this);
+	}
+
 	void ITaskGraph::AddEdge(ITask* from, ITask* to)
 	{
 		AddInternalDependency(from);
@@ -46,11 +52,6 @@ namespace hdn
 		return false;
 	}
 
-	bool ITaskGraph::Completed() const
-	{
-		return AreInternalDepResolved();
-	}
-
 	void ITaskGraph::PreExecute()
 	{
 		HASSERT(!HasCycle(), "The provided task graph has a circular dependency!");
@@ -68,25 +69,12 @@ namespace hdn
 
 	void ITaskGraph::Execute()
 	{
+		HoldCompletion();
 		for (const auto& task : m_SourceTasks)
 		{
 			task->Enqueue();
 		}
-	}
-
-	void ITaskGraph::DependencyCompletionNotification(ITask* task)
-	{
-		HASSERT_TASK(task);
-		HASSERT(task->Completed(), "The task notified was not completed");
-		if (Completed())
-		{
-			ITask::Complete();
-		}
-
-		if (!IsEnqueued() && AreInDepResolved())
-		{
-			Enqueue();
-		}
+		ReleaseCompletion();
 	}
 
 	const char* ITaskGraph::GetName() const
@@ -13,13 +13,13 @@ namespace hdn
 		ITaskGraph();
 		virtual ~ITaskGraph() = default;
 		
+		// Adds a task without dependencies, tasks with dependencies are added by AddEdge()
+		void AddTask(ITask* task);
 		void AddEdge(ITask* from, ITask* to);
 		bool HasCycle() const;
 
-		virtual bool Completed() const override;
 		virtual void PreExecute() override;
 		virtual void Execute() override;
-		virtual void DependencyCompletionNotification(ITask* task) override;
 
 		virtual const char* GetName() const override;
 	private:
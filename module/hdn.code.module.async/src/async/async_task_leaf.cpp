@@ -6,26 +6,6 @@ namespace hdn
 	{
 	}
 
-	bool ITaskLeaf::Completed() const
-	{
-		return m_Completed;
-	}
-
-	void ITaskLeaf::Complete()
-	{
-		m_Completed = true;
-		ITask::Complete();
-	}
-
-	void ITaskLeaf::DependencyCompletionNotification(ITask* task)
-	{
-		MAYBE_UNUSED(task);
-		if (!IsEnqueued() && AreInDepResolved())
-		{
-			Enqueue();
-		}
-	}
-
 	const char* ITaskLeaf::GetName() const
 	{
 		return "ITaskLeaf";
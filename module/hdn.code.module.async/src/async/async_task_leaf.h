@@ -10,12 +10,7 @@ namespace hdn
 	public:
 		ITaskLeaf();
 		virtual ~ITaskLeaf() = default;
-		virtual bool Completed() const override;
-		virtual void Complete() override;
-		virtual void DependencyCompletionNotification(ITask* task) override;
 
 		virtual const char* GetName() const override;
-	private:
-		bool m_Completed = false;
 	};
 }
\ No newline at end of file
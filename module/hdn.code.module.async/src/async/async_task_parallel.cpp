@@ -15,32 +15,14 @@ namespace hdn
 		m_Tasks.insert(task);
 	}
 
-	bool ITaskParallel::Completed() const
-	{
-		return AreInternalDepResolved();
-	}
-
 	void ITaskParallel::Execute()
 	{
+		HoldCompletion();
 		for (const auto& task : m_Tasks)
 		{
 			task->Enqueue();
 		}
-	}
-
-	void ITaskParallel::DependencyCompletionNotification(ITask* task)
-	{
-		HASSERT_TASK(task);
-		HASSERT(task->Completed(), "The task notified was not completed");
-		if (Completed())
-		{
-			ITask::Complete();
-		}
-
-		if (!IsEnqueued() && AreInDepResolved())
-		{
-			Enqueue();
-		}
+		ReleaseCompletion();
 	}
 
 	const char* ITaskParallel::GetName() const
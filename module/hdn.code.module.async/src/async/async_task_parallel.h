@@ -13,9 +13,7 @@ namespace hdn
 		ITaskParallel();
 		virtual ~ITaskParallel() = default;
 		void AddTask(ITask* task);
-		virtual bool Completed() const override;
 		virtual void Execute() override;
-		virtual void DependencyCompletionNotification(ITask* task) override;
 
 		virtual const char* GetName() const override;
 	private:
@@ -19,31 +19,16 @@ namespace hdn
 		m_TaskQueue.push_back(task);
 	}
 
-	bool ITaskQueue::Completed() const
-	{
-		return AreInternalDepResolved();
-	}
-
 	void ITaskQueue::Execute()
 	{
-		ITask* firstTask = m_TaskQueue.front();
-		// We only need to queue the first task, the subsequent tasks will automatically register themselve once their in-dependencies are Completed()
-		firstTask->Enqueue();
-	}
-
-	void ITaskQueue::DependencyCompletionNotification(ITask* task)
-	{
-		HASSERT_TASK(task);
-		HASSERT(task->Completed(), "The task notified was not completed");
-		if (Completed())
-		{
-			ITask::Complete();
-		}
-
-		if (!IsEnqueued() && AreInDepResolved())
+		HoldCompletion();
+		if (!m_TaskQueue.empty())
 		{
-			Enqueue();
+			ITask* firstTask = m_TaskQueue.front();
+			// We only need to queue the first task, the subsequent tasks will automatically register themselve once their in-dependencies are Completed()
+			firstTask->Enqueue();
 		}
+		ReleaseCompletion();
 	}
 
 	const char* ITaskQueue::GetName() const
@@ -1,24 +1,102 @@
 #include "async_worker.h"
+#include "async_profiler.h"
 
-#include <algorithm> // For std::lower_bound
+#include "core/allocator/memory_tracker.h"
+
+#include <algorithm> // For std::min
+#include <immintrin.h> // For _mm_pause
+
+#if USING(HDN_PLATFORM_WINDOWS)
+#ifndef NOMINMAX
+#define NOMINMAX // Keeps std::min/std::max usable
+#endif
+#include <windows.h>
+#endif
+
+#if USING(HDN_PLATFORM_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace hdn
 {
-	struct SortTaskByImportance
+	// Lets AddPendingTask() push to the caller's own deque when it is called from inside a worker
+	static thread_local WorkerSystem* t_CurrentWorkerSystem = nullptr;
+	static thread_local u32 t_CurrentWorkerIndex = 0;
+
+	static inline void CpuRelax(u32 iterations)
+	{
+		for (u32 i = 0; i < iterations; i++)
+		{
+			_mm_pause();
+		}
+	}
+
+	static inline u64 NextRandom(u64& state)
+	{
+		// xorshift64
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	static void PinCurrentThread(u32 core)
+	{
+#if USING(HDN_PLATFORM_WINDOWS)
+		if (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << core) == 0)
+		{
+			HWARN("Could not pin worker thread to core {0}", core);
+		}
+#elif USING(HDN_PLATFORM_LINUX)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(core, &cpuSet);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0)
+		{
+			HWARN("Could not pin worker thread to core {0}", core);
+		}
+#else
+		MAYBE_UNUSED(core);
+#endif
+	}
+
+	TaskPriorityBand GetPriorityBand(const ITask* task)
 	{
-		bool operator()(ITask* lhs, ITask* rhs) const {
-			return lhs->Importance() < rhs->Importance();
+		const float importance = task->Importance();
+		if (importance > 1.0f)
+		{
+			return TaskPriorityBand::High;
+		}
+		if (importance < 1.0f)
+		{
+			return TaskPriorityBand::Low;
 		}
-	};
+		return TaskPriorityBand::Normal;
+	}
 
-	WorkerSystem::WorkerSystem(u64 numWorkers)
-		: m_StopFlag{ false }
+	WorkerSystem::WorkerSystem(const char* name, u64 numWorkers, bool pinWorkers)
+		: m_Name{ name }, m_PinWorkers{ pinWorkers }, m_ParkedCount{ 0 }, m_WakeEpoch{ 0 }, m_StopFlag{ false }
 	{
-		HINFO("Worker Count: {0}", numWorkers);
+		HINFO("[{0}] Worker Count: {1}{2}", name, numWorkers, pinWorkers ? " (pinned)" : "");
 
-		for (size_t i = 0; i < numWorkers; ++i)
+		for (u8 band = 0; band < Underlying(TaskPriorityBand::Count); band++)
 		{
-			m_Workers.emplace_back([this]() { this->WorkerThread(); });
+			m_InjectionQueues[band] = CreateScope<InjectionQueue<ITask*>>(INJECTION_QUEUE_CAPACITY);
+		}
+
+		// Every context must exist before the first worker starts stealing from its siblings
+		m_WorkerContexts.reserve(numWorkers);
+		for (u64 i = 0; i < numWorkers; ++i)
+		{
+			Scope<WorkerContext> context = CreateScope<WorkerContext>();
+			context->randomState = 0x9E3779B97F4A7C15ull * (i + 1);
+			m_WorkerContexts.push_back(std::move(context));
+		}
+
+		for (u32 i = 0; i < numWorkers; ++i)
+		{
+			m_Workers.emplace_back([this, i]() { this->WorkerThread(i); });
 		}
 	}
 
@@ -29,21 +107,80 @@ namespace hdn
 
 	void WorkerSystem::AddPendingTask(ITask* task)
 	{
+		const u8 band = Underlying(GetPriorityBand(task));
+		if (t_CurrentWorkerSystem == this)
 		{
-			std::lock_guard<std::mutex> lock(m_QueueMutex);
-			InsertTaskSorted(task);
-			HDEBUG("Task Enqueued: {0}", task->GetName());
+			// Recorded before the push, once pushed the task can be stolen, run and destroyed at any time
+			HASYNC_PROFILE_EVENT(AsyncEventType::Enqueue, task, static_cast<u32>(m_WorkerContexts[t_CurrentWorkerIndex]->deques[band].Size() + 1));
+			m_WorkerContexts[t_CurrentWorkerIndex]->deques[band].Push(task);
 		}
-		m_Condition.notify_one();
+		else
+		{
+			HASYNC_PROFILE_EVENT(AsyncEventType::Enqueue, task, static_cast<u32>(m_InjectionQueues[band]->Size() + 1));
+			while (!m_InjectionQueues[band]->TryPush(task))
+			{
+				std::this_thread::yield();
+			}
+		}
+		HDEBUG("Task Enqueued: {0}", task->GetName());
+		WakeWorker();
+	}
+
+	bool WorkerSystem::ExecutePendingTask()
+	{
+		ITask* task = nullptr;
+		if (t_CurrentWorkerSystem == this)
+		{
+			task = FindTask(t_CurrentWorkerIndex);
+		}
+		else
+		{
+			// External threads have no deque of their own, they can only help through the injection queues and by stealing
+			static thread_local u64 s_RandomState = 0x2545F4914F6CDD1Dull ^ std::hash<std::thread::id>{}(std::this_thread::get_id());
+			const u32 workerCount = static_cast<u32>(m_WorkerContexts.size());
+			for (u8 band = 0; band < Underlying(TaskPriorityBand::Count) && !task; band++)
+			{
+				if (m_InjectionQueues[band]->TryPop(task))
+				{
+					HASYNC_PROFILE_EVENT(AsyncEventType::Dequeue, task, static_cast<u32>(m_InjectionQueues[band]->Size()));
+				}
+				else
+				{
+					task = StealTask(workerCount, static_cast<TaskPriorityBand>(band), s_RandomState);
+				}
+			}
+		}
+
+		if (!task)
+		{
+			return false;
+		}
+		RunTask(task);
+		return true;
+	}
+
+	void WorkerSystem::RunTask(ITask* task)
+	{
+		HASYNC_PROFILE_EVENT(AsyncEventType::Start, task);
+		task->PreExecute();
+		task->Execute();
+		// The task may be destroyed by now, only its address is recorded
+		HASYNC_PROFILE_EVENT(AsyncEventType::End, task);
+	}
+
+	u32 WorkerSystem::GetCurrentWorkerIndex() const
+	{
+		return t_CurrentWorkerSystem == this ? t_CurrentWorkerIndex : static_cast<u32>(m_WorkerContexts.size());
 	}
 
 	void WorkerSystem::Shutdown()
 	{
 		{
-			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			std::lock_guard<std::mutex> lock(m_ParkMutex);
 			m_StopFlag = true;
+			m_WakeEpoch.fetch_add(1, std::memory_order_release);
 		}
-		m_Condition.notify_all();
+		m_ParkCondition.notify_all();
 
 		for (std::thread& worker : m_Workers)
 		{
@@ -54,45 +191,179 @@ namespace hdn
 		}
 	}
 
-	size_t WorkerSystem::OptimalWorkerCount(bool ioBound)
+	size_t WorkerSystem::OptimalWorkerCount(TaskAffinity affinity)
 	{
 		size_t hardwareThreads = std::thread::hardware_concurrency();
 		if (hardwareThreads == 0)
 		{
 			hardwareThreads = 4;
 		}
-		return ioBound ? 2 * hardwareThreads : hardwareThreads;
+
+		switch (affinity)
+		{
+		case TaskAffinity::Compute:
+			// The main thread takes part in the compute work when it waits, keep a core for it
+			return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		case TaskAffinity::IO:
+			// IO workers spend most of their time blocked in the kernel, oversubscribing is what keeps the disk busy
+			return 2 * hardwareThreads;
+		default:
+			return 0;
+		}
 	}
 
-	void WorkerSystem::InsertTaskSorted(ITask* task)
+	ITask* WorkerSystem::FindTask(u32 workerIndex)
 	{
-		auto pos = std::lower_bound(m_PendingTasks.begin(), m_PendingTasks.end(), task, SortTaskByImportance{});
-		m_PendingTasks.insert(pos, task);
+		WorkerContext& context = *m_WorkerContexts[workerIndex];
+		for (u8 band = 0; band < Underlying(TaskPriorityBand::Count); band++)
+		{
+			ITask* task = context.deques[band].Pop();
+			if (task)
+			{
+				HASYNC_PROFILE_EVENT(AsyncEventType::Dequeue, task, static_cast<u32>(context.deques[band].Size()));
+				return task;
+			}
+
+			if (m_InjectionQueues[band]->TryPop(task))
+			{
+				HASYNC_PROFILE_EVENT(AsyncEventType::Dequeue, task, static_cast<u32>(m_InjectionQueues[band]->Size()));
+				return task;
+			}
+
+			task = StealTask(workerIndex, static_cast<TaskPriorityBand>(band), context.randomState);
+			if (task)
+			{
+				return task;
+			}
+		}
+		return nullptr;
 	}
 
-	void WorkerSystem::WorkerThread()
+	ITask* WorkerSystem::StealTask(u32 workerIndex, TaskPriorityBand band, u64& randomState)
 	{
-		while (true)
+		const u32 workerCount = static_cast<u32>(m_WorkerContexts.size());
+		if (workerCount == 0)
 		{
-			ITask* task = nullptr;
+			return nullptr;
+		}
+
+		// Start from a random victim so thieves do not all hammer the same deque
+		const u32 start = static_cast<u32>(NextRandom(randomState) % workerCount);
+		for (u32 i = 0; i < workerCount; i++)
+		{
+			const u32 victim = (start + i) % workerCount;
+			if (victim == workerIndex)
 			{
-				std::unique_lock<std::mutex> lock(m_QueueMutex);
-				m_Condition.wait(lock, [this]() {
-					return !m_PendingTasks.empty() || m_StopFlag;
-					});
+				continue;
+			}
 
-				if (m_StopFlag && m_PendingTasks.empty())
+			ITask* task = m_WorkerContexts[victim]->deques[Underlying(band)].Steal();
+			if (task)
+			{
+				HASYNC_PROFILE_EVENT(AsyncEventType::Steal, task, victim);
+				return task;
+			}
+		}
+		return nullptr;
+	}
+
+	bool WorkerSystem::HasPendingTask() const
+	{
+		for (u8 band = 0; band < Underlying(TaskPriorityBand::Count); band++)
+		{
+			if (!m_InjectionQueues[band]->Empty())
+			{
+				return true;
+			}
+			for (const Scope<WorkerContext>& context : m_WorkerContexts)
+			{
+				if (!context->deques[band].Empty())
 				{
-					return;
+					return true;
 				}
-
-				task = std::move(m_PendingTasks.back());
-				m_PendingTasks.pop_back();
 			}
-			task->PreExecute();
-			task->Execute();
 		}
+		return false;
+	}
+
+	void WorkerSystem::WakeWorker()
+	{
+		// Pairs with the fence in Park(): either the parking worker sees the new task, or we see it parked
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_ParkedCount.load(std::memory_order_relaxed) == 0)
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_ParkMutex);
+			m_WakeEpoch.fetch_add(1, std::memory_order_release);
+		}
+		m_ParkCondition.notify_one();
 	}
 
+	void WorkerSystem::Park()
+	{
+		std::unique_lock<std::mutex> lock(m_ParkMutex);
+		const u64 epoch = m_WakeEpoch.load(std::memory_order_acquire);
+		m_ParkedCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
 
-}
\ No newline at end of file
+		if (!HasPendingTask() && !m_StopFlag)
+		{
+			HASYNC_PROFILE_EVENT(AsyncEventType::Park, nullptr);
+			m_ParkCondition.wait(lock, [this, epoch]() {
+				return m_WakeEpoch.load(std::memory_order_acquire) != epoch || m_StopFlag;
+				});
+			HASYNC_PROFILE_EVENT(AsyncEventType::Unpark, nullptr);
+		}
+		m_ParkedCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void WorkerSystem::WorkerThread(u32 workerIndex)
+	{
+		t_CurrentWorkerSystem = this;
+		t_CurrentWorkerIndex = workerIndex;
+		HASYNC_PROFILE_THREAD_NAME(m_Name, workerIndex);
+		HMEMORY_TAG("async");
+		if (m_PinWorkers)
+		{
+			const u32 coreCount = std::max<u32>(std::thread::hardware_concurrency(), 1);
+			PinCurrentThread((workerIndex + 1) % coreCount);
+		}
+
+		u32 idleRounds = 0;
+		while (true)
+		{
+			ITask* task = FindTask(workerIndex);
+			if (task)
+			{
+				idleRounds = 0;
+				RunTask(task);
+				continue;
+			}
+
+			if (m_StopFlag && !HasPendingTask())
+			{
+				return;
+			}
+
+			// Back off progressively: spin, then yield the time slice, then park until new work arrives
+			if (idleRounds < SPIN_COUNT_BEFORE_YIELD)
+			{
+				CpuRelax(1u << std::min<u32>(idleRounds, 6u));
+			}
+			else if (idleRounds < SPIN_COUNT_BEFORE_YIELD + YIELD_COUNT_BEFORE_PARK)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				Park();
+				idleRounds = 0;
+				continue;
+			}
+			idleRounds++;
+		}
+	}
+}
@@ -5,6 +5,8 @@
 
 #include "async_task.h"
 #include "async_thread.h"
+#include "async_deque.h"
+#include "async_injection_queue.h"
 
 #include <thread>
 #include <queue>
@@ -13,22 +15,62 @@
 
 namespace hdn
 {
+	// ITask::Importance() is continuous, the scheduler only needs a coarse ordering so tasks are bucketed in a few bands
+	enum class TaskPriorityBand : u8
+	{
+		High = 0,
+		Normal = 1,
+		Low = 2,
+		Count = 3
+	};
+
+	TaskPriorityBand GetPriorityBand(const ITask* task);
+
 	class WorkerSystem
 	{
 	public:
-		WorkerSystem(u64 numWorkers);
+		// Pinned workers are bound to one core each, core 0 being left to the main thread
+		WorkerSystem(const char* name, u64 numWorkers, bool pinWorkers = false);
 		~WorkerSystem();
 		void AddPendingTask(ITask* task);
+		// Pops (or steals) one pending task and runs it on the calling thread, returns false if no task was found
+		// Used by threads that need to wait on a result without blocking a worker
+		bool ExecutePendingTask();
 		void Shutdown();
-		static size_t OptimalWorkerCount(bool ioBound = false);
+		u64 GetWorkerCount() const { return m_WorkerContexts.size(); }
+		// Index of the calling worker, or GetWorkerCount() if the calling thread is not one of our workers
+		u32 GetCurrentWorkerIndex() const;
+		const char* GetName() const { return m_Name; }
+		static size_t OptimalWorkerCount(TaskAffinity affinity);
 	private:
-		void InsertTaskSorted(ITask* task);
-		void WorkerThread();
+		struct alignas(64) WorkerContext
+		{
+			WorkStealingDeque<ITask*> deques[Underlying(TaskPriorityBand::Count)];
+			u64 randomState = 0;
+		};
+
+		ITask* FindTask(u32 workerIndex);
+		ITask* StealTask(u32 workerIndex, TaskPriorityBand band, u64& randomState);
+		bool HasPendingTask() const;
+		void WakeWorker();
+		void Park();
+		void RunTask(ITask* task);
+		void WorkerThread(u32 workerIndex);
 	private:
+		static constexpr u32 SPIN_COUNT_BEFORE_YIELD = 64;
+		static constexpr u32 YIELD_COUNT_BEFORE_PARK = 16;
+		static constexpr u64 INJECTION_QUEUE_CAPACITY = 8192;
+
+		const char* m_Name;
+		const bool m_PinWorkers;
 		vector<std::thread> m_Workers;
-		vector<ITask*> m_PendingTasks;
-		std::mutex m_QueueMutex;
-		std::condition_variable m_Condition;
+		vector<Scope<WorkerContext>> m_WorkerContexts;
+		Scope<InjectionQueue<ITask*>> m_InjectionQueues[Underlying(TaskPriorityBand::Count)];
+
+		std::mutex m_ParkMutex;
+		std::condition_variable m_ParkCondition;
+		std::atomic<u32> m_ParkedCount;
+		std::atomic<u64> m_WakeEpoch;
 		std::atomic<bool> m_StopFlag;
 	};
-}
\ No newline at end of file
+}
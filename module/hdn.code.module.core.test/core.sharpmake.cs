@@ -25,5 +25,6 @@ public class CoreProjectTest : BaseCppTestProject
 
         conf.AddPublicDependency<Catch2Project>(target);
         conf.AddPublicDependency<CoreProject>(target);
+        conf.AddPublicDependency<HZoneProject>(target);
     }
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <catch2/catch_all.hpp>
+
+#include "core/core.h"
+#include "core/io/buffer_writer.h"
+#include "core/io/buffer_reader.h"
+#include "core/io/growable_buffer_writer.h"
+#include "core/io/block_compression.h"
+#include "core/random.h"
+#include "core/stl/vector.h"
+
+TEST_CASE("FBufferWriter bounds", "[io]")
+{
+	using namespace hdn;
+
+	SECTION("Fixed buffer overflow") {
+		byte buffer[12];
+		FBufferWriter writer{ buffer, sizeof(buffer) };
+		writer.Write<u64>(1);
+		REQUIRE_FALSE(writer.IsOverflowed());
+		writer.Write<u64>(2);
+		REQUIRE(writer.IsOverflowed());
+		REQUIRE(writer.BytesWritten() == sizeof(u64));
+	}
+
+	SECTION("Growable buffer") {
+		FGrowableBufferWriter writer{ 16 };
+		for (u64 i = 0; i < 1024; i++)
+		{
+			writer.Write(i);
+		}
+		REQUIRE_FALSE(writer.IsOverflowed());
+		REQUIRE(writer.BytesWritten() == 1024 * sizeof(u64));
+		REQUIRE(writer.begin<u64>()[1023] == 1023);
+	}
+
+	SECTION("Arena backed buffer") {
+		byte arenaMemory[256];
+		LinearAllocator arena{ sizeof(arenaMemory), arenaMemory };
+		FGrowableBufferWriter writer{ 64, &arena };
+		for (u64 i = 0; i < 32; i++)
+		{
+			writer.Write(i);
+		}
+		// 64 + 128 bytes fit in the arena, the next buffer does not
+		REQUIRE(writer.IsOverflowed());
+		REQUIRE(writer.BytesWritten() == 128);
+	}
+
+	SECTION("Buffer filling the arena exactly") {
+		byte arenaMemory[192];
+		LinearAllocator arena{ sizeof(arenaMemory), arenaMemory };
+		FGrowableBufferWriter writer{ 64, &arena };
+		for (u64 i = 0; i < 16; i++)
+		{
+			writer.Write(i);
+		}
+		REQUIRE_FALSE(writer.IsOverflowed());
+		REQUIRE(writer.BytesWritten() == 128);
+	}
+}
+
+TEST_CASE("FBufferReader truncation", "[io]")
+{
+	using namespace hdn;
+	const u64 values[] = { 1, 2 };
+	FBufferReader reader{ reinterpret_cast<const byte*>(values), sizeof(values) };
+	REQUIRE(reader.Read<u64>() == 1);
+	REQUIRE(reader.Read<u64>(2) == nullptr);
+	REQUIRE(reader.IsTruncated());
+	REQUIRE(reader.Read<u64>() == 0);
+	REQUIRE(reader.Remaining() == 0);
+
+	// A corrupted count whose size in bytes wraps around to 8 bytes
+	FBufferReader countReader{ reinterpret_cast<const byte*>(values), sizeof(values) };
+	REQUIRE(countReader.Read<u64>(UINT64_MAX / sizeof(u64) + 2) == nullptr);
+	REQUIRE(countReader.IsTruncated());
+}
+
+TEST_CASE("Block compression round trip", "[io]")
+{
+	using namespace hdn;
+	constexpr u64 BLOCK_SIZE = 64 * KB;
+	vector<byte> block(BLOCK_SIZE);
+	vector<byte> packed(BLOCK_SIZE);
+	vector<byte> unpacked(BLOCK_SIZE);
+
+	SECTION("Repetitive data shrinks") {
+		for (u64 i = 0; i < BLOCK_SIZE; i++)
+		{
+			block[i] = static_cast<byte>((i / 16) % 7);
+		}
+		const u64 packedSize = PackBlock(block.data(), BLOCK_SIZE, packed.data());
+		REQUIRE(packedSize < BLOCK_SIZE / 4);
+		REQUIRE(UnpackBlock(packed.data(), packedSize, unpacked.data(), BLOCK_SIZE));
+		REQUIRE(unpacked == block);
+		REQUIRE_FALSE(UnpackBlock(packed.data(), packedSize - 1, unpacked.data(), BLOCK_SIZE));
+	}
+
+	SECTION("Random data is stored as is") {
+		for (byte& value : block)
+		{
+			value = static_cast<byte>(GenerateUUID64());
+		}
+		const u64 packedSize = PackBlock(block.data(), BLOCK_SIZE, packed.data());
+		REQUIRE(packedSize == BLOCK_SIZE);
+		REQUIRE(UnpackBlock(packed.data(), packedSize, unpacked.data(), BLOCK_SIZE));
+		REQUIRE(unpacked == block);
+	}
+}
@@ -0,0 +1,92 @@
+#include <catch2/catch_all.hpp>
+
+#include "core/core.h"
+#include "core/allocator/concurrent_slab_allocator.h"
+#include "core/allocator/concurrent_pool_allocator.h"
+#include "core/allocator/concurrent_object_pool.h"
+#include "core/stl/vector.h"
+
+#include <atomic>
+#include <thread>
+
+TEST_CASE("Concurrent slab and pool allocators", "[allocator]")
+{
+	using namespace hdn;
+
+	SECTION("Blocks allocated on a thread and freed on another") {
+		constexpr u32 THREAD_COUNT = 8;
+		constexpr u32 OPERATION_COUNT = 20000;
+		constexpr u32 SLOT_COUNT = 1024;
+		concurrent_slab_allocator allocator{ 48, 16 };
+		static std::atomic<void*> slots[SLOT_COUNT] = {};
+		vector<std::thread> threads;
+		for (u32 threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+		{
+			threads.emplace_back([&allocator, threadIndex]() {
+				for (u32 i = 0; i < OPERATION_COUNT; i++)
+				{
+					byte* block = static_cast<byte*>(allocator.Allocate());
+					memset(block, static_cast<int>(threadIndex), 48);
+					if (void* previous = slots[(i * 31 + threadIndex * 7) % SLOT_COUNT].exchange(block))
+					{
+						allocator.Deallocate(previous);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		u64 liveBlockCount = 0;
+		for (std::atomic<void*>& slot : slots)
+		{
+			liveBlockCount += slot.load() != nullptr;
+		}
+		REQUIRE(allocator.GetLiveBlockCount() == liveBlockCount);
+		for (std::atomic<void*>& slot : slots)
+		{
+			if (void* block = slot.exchange(nullptr))
+			{
+				REQUIRE(reinterpret_cast<uintptr_t>(block) % concurrent_slab_allocator::DEFAULT_ALIGNMENT == 0);
+				allocator.Deallocate(block);
+			}
+		}
+		REQUIRE(allocator.ReportLeaks() == 0);
+	}
+
+	SECTION("Pool in caller memory") {
+		constexpr size_t BLOCK_COUNT = 100;
+		alignas(64) static byte memory[concurrent_pool_allocator::GetRequiredMemorySize(40, BLOCK_COUNT, 64)];
+		concurrent_pool_allocator pool{ 40, BLOCK_COUNT, memory, 64 };
+		vector<void*> blocks;
+		for (size_t i = 0; i < BLOCK_COUNT; i++)
+		{
+			byte* block = static_cast<byte*>(pool.Allocate());
+			REQUIRE(block >= memory);
+			REQUIRE(block < memory + sizeof(memory));
+			REQUIRE(reinterpret_cast<uintptr_t>(block) % 64 == 0);
+			blocks.push_back(block);
+		}
+		REQUIRE(pool.Allocate() == nullptr);
+		REQUIRE(pool.ReportLeaks() == BLOCK_COUNT);
+		for (void* block : blocks)
+		{
+			pool.Deallocate(block);
+		}
+		REQUIRE(pool.GetLiveBlockCount() == 0);
+	}
+
+	SECTION("Object pool size classes") {
+		ConcurrentObjectPool pool{ "test" };
+		for (size_t size : { 1, 32, 33, 200, 1 * KB, 1 * KB + 1, 10 * KB })
+		{
+			void* block = pool.Allocate(size);
+			memset(block, 0xCD, size);
+			REQUIRE(pool.GetLiveObjectCount() == (size <= ConcurrentObjectPool::MAX_OBJECT_SIZE ? 1 : 0));
+			pool.Deallocate(block, size);
+		}
+		REQUIRE(pool.GetLiveObjectCount() == 0);
+	}
+}
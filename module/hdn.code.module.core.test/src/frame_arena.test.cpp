@@ -0,0 +1,73 @@
+#include <catch2/catch_all.hpp>
+
+#include "core/core.h"
+#include "core/allocator/frame_arena.h"
+
+TEST_CASE("FrameArena containers", "[allocator]")
+{
+	using namespace hdn;
+
+	FrameArena frameArena{ 2, 4 * KB };
+	LinearAllocator* arena = frameArena.BeginFrame(0);
+
+	SECTION("Blocks come from the arena until it is full") {
+		frame_vector<u64> values{ arena_allocator{ arena } };
+		values.reserve(64);
+		REQUIRE(arena->Owns(values.data()));
+		for (u64 i = 0; i < 1024; i++)
+		{
+			values.push_back(i);
+		}
+		REQUIRE_FALSE(arena->Owns(values.data()));
+		REQUIRE(values[1023] == 1023);
+	}
+
+	SECTION("No heap allocation while the frame fits in its arena") {
+		// The per-frame sort of PointLightSystem, over a few frames
+		const MemStat before = GetMemStat();
+		for (u32 frame = 0; frame < 4; frame++)
+		{
+			LinearAllocator* frameAllocator = frameArena.BeginFrame(frame % 2);
+			frame_map<float, u64> sorted{ arena_allocator{ frameAllocator } };
+			frame_vector<u64> visible{ arena_allocator{ frameAllocator } };
+			visible.reserve(32);
+			for (u64 light = 0; light < 32; light++)
+			{
+				sorted[static_cast<float>((light * 7) % 32)] = light;
+				visible.push_back(light);
+			}
+		}
+		const MemStat after = GetMemStat();
+		REQUIRE(after.allocationCount == before.allocationCount);
+		REQUIRE(after.deallocationCount == before.deallocationCount);
+	}
+
+	SECTION("Overflow blocks are freed with their container") {
+		const MemStat before = GetMemStat();
+		{
+			frame_vector<u64> values{ arena_allocator{ arena } };
+			for (u64 i = 0; i < 1024; i++)
+			{
+				values.push_back(i);
+			}
+		}
+		const MemStat after = GetMemStat();
+		REQUIRE(after.allocationCount > before.allocationCount);
+		REQUIRE(after.allocationCount - before.allocationCount == after.deallocationCount - before.deallocationCount);
+		REQUIRE(after.allocated - before.allocated == after.deallocated - before.deallocated);
+	}
+
+	SECTION("Reset when the frame comes back") {
+		frame_map<u32, u32> sorted{ arena_allocator{ arena } };
+		sorted[2] = 20;
+		sorted[1] = 10;
+		REQUIRE(sorted.begin()->second == 10);
+		const size_t usedMemory = arena->GetUsedMemory();
+		REQUIRE(usedMemory > 0);
+		sorted.clear();
+
+		frameArena.BeginFrame(1);
+		REQUIRE(frameArena.BeginFrame(0)->GetUsedMemory() == 0);
+		REQUIRE(frameArena.GetPeakUsage() >= usedMemory);
+	}
+}
@@ -0,0 +1,104 @@
+#include <catch2/catch_all.hpp>
+
+#include "core/core.h"
+#include "core/allocator/general_allocator.h"
+#include "core/stl/vector.h"
+
+#include <atomic>
+#include <thread>
+
+TEST_CASE("GeneralAllocator blocks", "[allocator]")
+{
+	using namespace hdn;
+
+	SECTION("Sizes and alignments") {
+		for (size_t size : { 0, 1, 16, 17, 128, 129, 1000, 8 * KB, 8 * KB + 1, 100 * KB })
+		{
+			for (size_t alignment : { 1, 16, 64, 4 * KB, 128 * KB })
+			{
+				byte* block = static_cast<byte*>(GeneralAllocator::Allocate(size, alignment));
+				REQUIRE(block != nullptr);
+				REQUIRE(reinterpret_cast<uintptr_t>(block) % std::max(alignment, GeneralAllocator::DEFAULT_ALIGNMENT) == 0);
+				REQUIRE(GeneralAllocator::GetBlockSize(block) >= size);
+				memset(block, 0xCD, size);
+				GeneralAllocator::Deallocate(block);
+			}
+		}
+	}
+
+	SECTION("Alignment offset") {
+		for (size_t offset : { 4, 8, 24 })
+		{
+			byte* block = static_cast<byte*>(GeneralAllocator::Allocate(100, 32, offset));
+			REQUIRE(reinterpret_cast<uintptr_t>(block + offset) % 32 == 0);
+			GeneralAllocator::Deallocate(block);
+		}
+	}
+
+	SECTION("Statistics") {
+		const MemStat before = GetMemStat();
+		void* small = ::operator new(40);
+		void* large = ::operator new(64 * KB);
+		::operator delete(small);
+		::operator delete(large);
+		const MemStat after = GetMemStat();
+		REQUIRE(after.allocationCount - before.allocationCount == after.deallocationCount - before.deallocationCount);
+		REQUIRE(after.allocated - before.allocated == after.deallocated - before.deallocated);
+		REQUIRE(after.deallocated - before.deallocated >= 40 + 64 * KB);
+	}
+
+	SECTION("Blocks freed on another thread") {
+		constexpr u32 THREAD_COUNT = 4;
+		constexpr u32 BLOCK_COUNT = 10000;
+		static std::atomic<u64*> slots[BLOCK_COUNT] = {};
+		std::atomic<u32> corruptedBlockCount{ 0 };
+		// A block holds the thread and the iteration that allocated it in its first and last values, the thread that takes
+		// it out of its slot checks them, and that the block was in the slot they give, before freeing it
+		const auto blockLength = [](u64 value) { return 1 + ((value & 0xFFFFFFFF) + (value >> 32)) % 64; };
+		const auto freeBlock = [&](u32 slotIndex, u64* block) {
+			if (block == nullptr)
+			{
+				return;
+			}
+			const u64 value = block[0];
+			const u64 threadIndex = value >> 32;
+			const u64 iteration = value & 0xFFFFFFFF;
+			const bool valid = threadIndex < THREAD_COUNT && iteration < BLOCK_COUNT &&
+				(iteration * 7 + threadIndex) % BLOCK_COUNT == slotIndex && block[blockLength(value) - 1] == value;
+			corruptedBlockCount += valid ? 0 : 1;
+			delete[] block;
+		};
+
+		const MemStat before = GetMemStat();
+		{
+			vector<std::thread> threads;
+			for (u32 threadIndex = 0; threadIndex < THREAD_COUNT; threadIndex++)
+			{
+				threads.emplace_back([threadIndex, &blockLength, &freeBlock]() {
+					for (u32 i = 0; i < BLOCK_COUNT; i++)
+					{
+						const u64 value = (static_cast<u64>(threadIndex) << 32) | i;
+						u64* block = new u64[blockLength(value)];
+						block[0] = value;
+						block[blockLength(value) - 1] = value;
+						const u32 slotIndex = (i * 7 + threadIndex) % BLOCK_COUNT;
+						freeBlock(slotIndex, slots[slotIndex].exchange(block));
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+		for (u32 slotIndex = 0; slotIndex < BLOCK_COUNT; slotIndex++)
+		{
+			freeBlock(slotIndex, slots[slotIndex].exchange(nullptr));
+		}
+		const MemStat after = GetMemStat();
+		REQUIRE(corruptedBlockCount == 0);
+		REQUIRE(after.allocationCount - before.allocationCount == after.deallocationCount - before.deallocationCount);
+		REQUIRE(after.allocated - before.allocated == after.deallocated - before.deallocated);
+		REQUIRE(after.allocationCount - before.allocationCount >= THREAD_COUNT * BLOCK_COUNT);
+	}
+}
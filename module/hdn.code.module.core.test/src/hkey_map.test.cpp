@@ -0,0 +1,70 @@
+#include <catch2/catch_all.hpp>
+
+#include "core/core.h"
+#include "core/random.h"
+#include "core/stl/hkey_map.h"
+#include "core/stl/unordered_map.h"
+#include "core/stl/vector.h"
+
+#include <random>
+
+TEST_CASE("hkey_map", "[stl]")
+{
+	using namespace hdn;
+
+	SECTION("Same content as unordered_map") {
+		// Random keys, then sequential ones packed in the same clusters
+		for (u64 keyMask : { ~0ull, 0xFFFull })
+		{
+			std::mt19937_64 random{ 42 };
+			hkey_map<u64> map;
+			unordered_map<hkey, u64> expected;
+			for (u64 i = 0; i < 100000; i++)
+			{
+				const hkey key = random() & keyMask;
+				switch (random() % 4)
+				{
+				case 0:
+				case 1:
+					map[key] = i;
+					expected[key] = i;
+					break;
+				case 2:
+					REQUIRE(map.erase(key) == expected.erase(key));
+					break;
+				case 3:
+					REQUIRE(map.contains(key) == expected.contains(key));
+					break;
+				}
+			}
+
+			REQUIRE(map.size() == expected.size());
+			u64 count = 0;
+			for (const auto& [key, value] : map)
+			{
+				REQUIRE(expected.at(key) == value);
+				count++;
+			}
+			REQUIRE(count == expected.size());
+		}
+	}
+
+	SECTION("Erase keeps the following keys reachable") {
+		hkey_map<u64> map;
+		vector<hkey> keys;
+		for (u64 i = 0; i < 64; i++)
+		{
+			// Same home slot for all of them
+			keys.push_back(GenerateUUID64() << 12);
+			map.try_emplace(keys.back(), i);
+		}
+		for (u64 i = 0; i < keys.size(); i += 2)
+		{
+			map.erase(map.find(keys[i]));
+		}
+		for (u64 i = 0; i < keys.size(); i++)
+		{
+			REQUIRE(map.contains(keys[i]) == (i % 2 == 1));
+		}
+	}
+}
@@ -0,0 +1,151 @@
+#include <catch2/catch_all.hpp>
+
+#include "core/core.h"
+#include "core/random.h"
+#include "core/stl/vector.h"
+#include "core/hobj/hobj_registry.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+	class RegistryTestObject : public hdn::HObject
+	{
+	};
+
+	constexpr hdn::u32 THREAD_COUNT = 8;
+
+	hdn::vector<hdn::hkey> GenerateKeys(hdn::u64 count)
+	{
+		hdn::vector<hdn::hkey> keys(count);
+		for (hdn::hkey& key : keys)
+		{
+			key = static_cast<hdn::hkey>(hdn::GenerateUUID64());
+		}
+		return keys;
+	}
+
+	template<typename Func>
+	void RunOnThreads(hdn::u32 threadCount, const Func& func)
+	{
+		hdn::vector<std::thread> threads;
+		for (hdn::u32 i = 0; i < threadCount; i++)
+		{
+			threads.emplace_back([&func, i]() { func(i); });
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+}
+
+TEST_CASE("HObjectRegistry concurrent registration", "[hobj]")
+{
+	using namespace hdn;
+	HObjectRegistry& registry = HObjectRegistry::Get();
+	const vector<hkey> keys = GenerateKeys(64 * KB);
+	std::atomic<u64> duplicateCount{ 0 };
+
+	// Every thread registers every key, only the first registration of each key must stick
+	RunOnThreads(THREAD_COUNT, [&](u32) {
+		for (const hkey key : keys)
+		{
+			HObjPtr<HObject> object = new RegistryTestObject();
+			if (registry.Register(key, object) != object)
+			{
+				delete object;
+				duplicateCount++;
+			}
+		}
+	});
+
+	REQUIRE(duplicateCount == keys.size() * (THREAD_COUNT - 1));
+	for (const hkey key : keys)
+	{
+		REQUIRE(registry.Contains(key));
+	}
+}
+
+TEST_CASE("HObjectRegistry deduplicates in-flight loads", "[hobj]")
+{
+	using namespace hdn;
+	HObjectRegistry& registry = HObjectRegistry::Get();
+	const hkey key = static_cast<hkey>(GenerateUUID64());
+	std::atomic<u32> loadCount{ 0 };
+	HObjPtr<HObject> objects[THREAD_COUNT] = {};
+
+	RunOnThreads(THREAD_COUNT, [&](u32 threadIndex) {
+		objects[threadIndex] = registry.GetOrLoad(key, [&loadCount]() -> HObjPtr<HObject> {
+			loadCount++;
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			return new RegistryTestObject();
+		});
+	});
+
+	REQUIRE(loadCount == 1);
+	for (const HObjPtr<HObject> object : objects)
+	{
+		REQUIRE(object == registry.Get(key));
+	}
+}
+
+TEST_CASE("HObjectRegistry stress benchmark", "[benchmark]")
+{
+	using namespace hdn;
+	HObjectRegistry& registry = HObjectRegistry::Get();
+	const vector<hkey> keys = GenerateKeys(256 * KB);
+	for (const hkey key : keys)
+	{
+		registry.Register(key, new RegistryTestObject());
+	}
+
+	BENCHMARK("Get, 1 thread")
+	{
+		u64 foundCount = 0;
+		for (const hkey key : keys)
+		{
+			foundCount += registry.Get(key) != nullptr;
+		}
+		return foundCount;
+	};
+
+	BENCHMARK("Get, 8 threads")
+	{
+		std::atomic<u64> foundCount{ 0 };
+		RunOnThreads(THREAD_COUNT, [&](u32) {
+			u64 threadFoundCount = 0;
+			for (const hkey key : keys)
+			{
+				threadFoundCount += registry.Get(key) != nullptr;
+			}
+			foundCount += threadFoundCount;
+		});
+		return foundCount.load();
+	};
+
+	BENCHMARK("Get with concurrent registrations, 8 threads")
+	{
+		// Half of the threads keep registering new objects while the other half reads
+		std::atomic<u64> foundCount{ 0 };
+		RunOnThreads(THREAD_COUNT, [&](u32 threadIndex) {
+			if (threadIndex % 2 == 0)
+			{
+				for (u32 i = 0; i < 4 * KB; i++)
+				{
+					registry.Register(static_cast<hkey>(GenerateUUID64()), new RegistryTestObject());
+				}
+				return;
+			}
+			u64 threadFoundCount = 0;
+			for (const hkey key : keys)
+			{
+				threadFoundCount += registry.Get(key) != nullptr;
+			}
+			foundCount += threadFoundCount;
+		});
+		return foundCount.load();
+	};
+}
@@ -0,0 +1,33 @@
+#include <catch2/catch_all.hpp>
+
+#include "core/core.h"
+#include "core/allocator/memory_tracker.h"
+
+#if USING(HDN_MEMORY_TRACKING)
+TEST_CASE("MemoryTracker tags", "[allocator]")
+{
+	using namespace hdn;
+
+	const MemoryTag tag = MemoryTracker::RegisterTag("test");
+	REQUIRE(MemoryTracker::RegisterTag("test") == tag);
+	const MemoryTagStat before = MemoryTracker::GetTagStats()[tag];
+
+	char* block = nullptr;
+	{
+		const MemoryTagScope memoryTagScope{ tag };
+		REQUIRE(MemoryTracker::GetCurrentTag() == tag);
+		block = new char[1000];
+	}
+	REQUIRE(MemoryTracker::GetCurrentTag() != tag);
+
+	const MemoryTagStat allocated = MemoryTracker::GetTagStats()[tag];
+	REQUIRE(allocated.liveBytes >= before.liveBytes + 1000);
+	REQUIRE(allocated.peakBytes >= allocated.liveBytes);
+
+	// Freed outside of the scope, the bytes still go back to the tag of the block
+	delete[] block;
+	const MemoryTagStat freed = MemoryTracker::GetTagStats()[tag];
+	REQUIRE(freed.liveBytes == allocated.liveBytes - 1000);
+	REQUIRE(freed.deallocationCount == allocated.deallocationCount + 1);
+}
+#endif
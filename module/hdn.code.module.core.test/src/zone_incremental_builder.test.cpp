@@ -0,0 +1,196 @@
+#include <catch2/catch_all.hpp>
+
+#include "core/core.h"
+#include "core/hash.h"
+#include "core/stl/map.h"
+#include "core/stl/vector.h"
+#include "core/io/buffer_reader.h"
+#include "core/io/dynamic_buffer_writer.h"
+
+#include "hzone/zone_serializer.h"
+#include "hzone/zone_manifest.h"
+#include "hzone/zone_incremental_builder.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	struct ZoneTestProp
+	{
+		float x, y, z;
+		hdn::u32 mesh;
+	};
+
+	struct ZoneTestLight
+	{
+		float radius;
+		hdn::u8 color;
+		double intensity;
+	};
+
+	struct ZoneTestTag
+	{
+		hdn::u32 a, b;
+	};
+
+	// The entries of a zone, by type in the order of the zone, to build it again from scratch after every edit
+	struct ZoneTestContent
+	{
+		hdn::vector<hdn::hash64_t> types;
+		hdn::map<hdn::hash64_t, hdn::vector<hdn::vector<hdn::byte>>> entries;
+
+		template<typename T>
+		void Set(hdn::u64 entryIndex, const T& value)
+		{
+			const hdn::hash64_t typeHash = hdn::GenerateTypeHash<T>();
+			if (std::find(types.begin(), types.end(), typeHash) == types.end())
+			{
+				types.push_back(typeHash);
+			}
+			hdn::vector<hdn::vector<hdn::byte>>& typeEntries = entries[typeHash];
+			const hdn::byte* data = reinterpret_cast<const hdn::byte*>(&value);
+			if (entryIndex == typeEntries.size())
+			{
+				typeEntries.emplace_back(data, data + sizeof(T));
+			}
+			else
+			{
+				typeEntries[entryIndex].assign(data, data + sizeof(T));
+			}
+		}
+
+		void Resize(hdn::hash64_t typeHash, hdn::u64 entryCount)
+		{
+			entries[typeHash].resize(entryCount);
+			if (entryCount == 0)
+			{
+				entries.erase(typeHash);
+				types.erase(std::find(types.begin(), types.end(), typeHash));
+			}
+		}
+
+		hdn::vector<hdn::byte> Serialize(hdn::u64 blockSize, hdn::ZoneManifest& manifest) const
+		{
+			hdn::ZoneSerializer serializer;
+			serializer.SetMinKeyValue(1);
+			serializer.SetPayloadCompression(blockSize);
+			for (const hdn::hash64_t typeHash : types)
+			{
+				for (const hdn::vector<hdn::byte>& entry : entries.at(typeHash))
+				{
+					serializer.AddEntry(typeHash, entry.data(), entry.size());
+				}
+			}
+			hdn::FDynamicBufferWriter writer;
+			serializer.Serialize(writer);
+			serializer.BuildManifest(manifest);
+			return writer.Detach();
+		}
+	};
+
+	template<typename T>
+	void SetEntry(hdn::ZoneIncrementalBuilder& builder, ZoneTestContent& content, hdn::u64 entryIndex, const T& value)
+	{
+		builder.SetEntry(entryIndex, &value);
+		content.Set(entryIndex, value);
+	}
+
+	void ResizeType(hdn::ZoneIncrementalBuilder& builder, ZoneTestContent& content, hdn::hash64_t typeHash, hdn::u64 entryCount)
+	{
+		builder.ResizeType(typeHash, entryCount);
+		content.Resize(typeHash, entryCount);
+	}
+}
+
+TEST_CASE("ZoneIncrementalBuilder matches a full rebuild", "[hzone]")
+{
+	using namespace hdn;
+	// 0 leaves the payload uncompressed, a small block size makes an edit touch a few blocks out of many
+	const u64 blockSize = GENERATE(0ull, 4ull * KB);
+	constexpr u64 PROP_COUNT = 20000;
+	constexpr u64 LIGHT_COUNT = 3000;
+
+	ZoneTestContent content;
+	for (u64 i = 0; i < PROP_COUNT; i++)
+	{
+		content.Set(i, ZoneTestProp{ static_cast<float>(i % 1024), static_cast<float>(i / 1024), 0.0f, static_cast<u32>(i % 64) });
+		if (i < LIGHT_COUNT)
+		{
+			content.Set(i, ZoneTestLight{ static_cast<float>(i), static_cast<u8>(i), i * 0.5 });
+		}
+	}
+	ZoneManifest manifest;
+	const vector<byte> zone = content.Serialize(blockSize, manifest);
+
+	FBufferReader reader{ zone.data(), zone.size(), true };
+	ZoneIncrementalBuilder builder;
+	REQUIRE(builder.Open(reader, manifest));
+
+	// Builds the edited zone and checks it against the zone a ZoneSerializer builds from the same entries
+	const auto buildAndCompare = [&]() -> const ZoneIncrementalBuildStats& {
+		FDynamicBufferWriter writer;
+		ZoneManifest builtManifest;
+		builder.Build(writer, builtManifest);
+		const vector<byte> built = writer.Detach();
+
+		ZoneManifest expectedManifest;
+		const vector<byte> expected = content.Serialize(blockSize, expectedManifest);
+		CHECK(built.size() == expected.size());
+		CHECK(std::memcmp(built.data(), expected.data(), std::min(built.size(), expected.size())) == 0);
+
+		CHECK(builtManifest.types.size() == expectedManifest.types.size());
+		for (u64 i = 0; i < std::min(builtManifest.types.size(), expectedManifest.types.size()); i++)
+		{
+			CHECK(builtManifest.types[i].typeHash == expectedManifest.types[i].typeHash);
+			CHECK(builtManifest.types[i].entryHashes == expectedManifest.types[i].entryHashes);
+		}
+		return builder.GetStats();
+	};
+
+	SECTION("Patch entries in place") {
+		for (u64 i = 0; i < 50; i++)
+		{
+			SetEntry(builder, content, (i * 7919) % PROP_COUNT, ZoneTestProp{ 1.0f, 2.0f, 3.0f, 4 });
+		}
+		SetEntry(builder, content, 1, ZoneTestProp{ 1.0f, 0.0f, 0.0f, 1 }); // Same content, ignored
+		const ZoneIncrementalBuildStats& stats = buildAndCompare();
+		CHECK(stats.unchangedEntryCount == 1);
+		CHECK(stats.patchedTypeCount == 1);
+		CHECK(stats.reusedTypeCount == 1);
+		CHECK(stats.rewrittenTypeCount == 0);
+		if (blockSize != 0)
+		{
+			CHECK(stats.reusedBlockCount > 0);
+		}
+	}
+
+	SECTION("Rewrite a type") {
+		ResizeType(builder, content, GenerateTypeHash<ZoneTestProp>(), PROP_COUNT - 100);
+		SetEntry(builder, content, PROP_COUNT - 100, ZoneTestProp{ 5.0f, 6.0f, 7.0f, 8 });
+		const ZoneIncrementalBuildStats& stats = buildAndCompare();
+		CHECK(stats.rewrittenTypeCount == 1);
+		CHECK(stats.reusedTypeCount == 1);
+	}
+
+	SECTION("Add a type") {
+		for (u32 i = 0; i < 100; i++)
+		{
+			SetEntry(builder, content, i, ZoneTestTag{ i, 2 * i });
+		}
+		const ZoneIncrementalBuildStats& stats = buildAndCompare();
+		CHECK(stats.changedEntryCount == 100);
+		CHECK(stats.reusedTypeCount == 2);
+		if (blockSize != 0)
+		{
+			CHECK(stats.reusedBlockCount > 0);
+		}
+	}
+
+	SECTION("Remove a type") {
+		ResizeType(builder, content, GenerateTypeHash<ZoneTestProp>(), 0);
+		const ZoneIncrementalBuildStats& stats = buildAndCompare();
+		CHECK(stats.reusedTypeCount == 1);
+		CHECK(stats.patchedTypeCount == 0);
+	}
+}
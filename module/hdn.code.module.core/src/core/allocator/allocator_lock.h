@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+namespace hdn
+{
+	// Lock of the allocator internals: constant initialized and trivially destroyed, usable before the static initialization
+	// and after the static destruction. The critical sections only move a few pointers, a spin is cheaper than putting the
+	// thread to sleep
+	class AllocatorLock
+	{
+	public:
+		void lock()
+		{
+			while (m_Flag.test_and_set(std::memory_order_acquire))
+			{
+				while (m_Flag.test(std::memory_order_relaxed))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		void unlock()
+		{
+			m_Flag.clear(std::memory_order_release);
+		}
+	private:
+		std::atomic_flag m_Flag{};
+	};
+}
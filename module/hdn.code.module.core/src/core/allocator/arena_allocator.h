@@ -0,0 +1,80 @@
+#pragma once
+#include "core/core.h"
+#include "core/allocator/general_allocator.h"
+#include "core/allocator/linear_allocator.h"
+#include "core/stl/ds_base.h"
+
+#include <algorithm>
+
+namespace hdn
+{
+	// EASTL allocator over a LinearAllocator, for containers that do not outlive the arena (see FrameArena)
+	// deallocate() gives nothing back, the memory is reused once the arena is reset
+	// Without an arena, or once it is full, the blocks come from the global operator new like the other EASTL containers,
+	// so they are counted by the MemoryTracker under the tag of the thread
+	class arena_allocator
+	{
+	public:
+		explicit arena_allocator(const char* name = "arena_allocator")
+			: m_Name{ name }
+		{
+		}
+
+		explicit arena_allocator(LinearAllocator* arena, const char* name = "arena_allocator")
+			: m_Arena{ arena }, m_Name{ name }
+		{
+		}
+
+		arena_allocator(const arena_allocator& other) = default;
+		arena_allocator(const arena_allocator& other, const char* name)
+			: m_Arena{ other.m_Arena }, m_Name{ name }
+		{
+		}
+		arena_allocator& operator=(const arena_allocator& other) = default;
+
+		void* allocate(size_t n, int flags = 0)
+		{
+			return allocate(n, GeneralAllocator::DEFAULT_ALIGNMENT, 0, flags);
+		}
+
+		void* allocate(size_t n, size_t alignment, size_t offset, int flags = 0)
+		{
+			if (m_Arena != nullptr && (offset & (alignment - 1)) == 0)
+			{
+				if (void* block = m_Arena->TryAllocate(n, std::max<size_t>(alignment, GeneralAllocator::DEFAULT_ALIGNMENT)))
+				{
+					return block;
+				}
+			}
+			return ::operator new[](n, alignment, offset, m_Name, flags, 0, __FILE__, __LINE__);
+		}
+
+		void deallocate(void* p, size_t n)
+		{
+			MAYBE_UNUSED(n);
+			if (m_Arena == nullptr || !m_Arena->Owns(p))
+			{
+				::operator delete[](p);
+			}
+		}
+
+		const char* get_name() const { return m_Name; }
+		void set_name(const char* name) { m_Name = name; }
+
+		LinearAllocator* GetArena() const { return m_Arena; }
+	private:
+		LinearAllocator* m_Arena = nullptr;
+		const char* m_Name;
+	};
+
+	// Blocks of an arena can only be freed through an allocator of the same arena
+	inline bool operator==(const arena_allocator& lhs, const arena_allocator& rhs)
+	{
+		return lhs.GetArena() == rhs.GetArena();
+	}
+
+	inline bool operator!=(const arena_allocator& lhs, const arena_allocator& rhs)
+	{
+		return lhs.GetArena() != rhs.GetArena();
+	}
+}
@@ -0,0 +1,79 @@
+#include "concurrent_object_pool.h"
+#include "memory_tracker.h"
+
+#include <bit>
+#include <new>
+
+namespace hdn
+{
+	ConcurrentObjectPool::ConcurrentObjectPool(const char* name)
+		: m_Name{ name }
+	{
+		for (u32 sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++)
+		{
+			const size_t blockSize = MIN_OBJECT_SIZE << sizeClass;
+			m_SizeClasses[sizeClass] = new concurrent_slab_allocator(blockSize, FIRST_SLAB_SIZE / blockSize);
+		}
+	}
+
+	ConcurrentObjectPool::~ConcurrentObjectPool()
+	{
+		// Each size class reports its leaks
+		for (concurrent_slab_allocator* sizeClass : m_SizeClasses)
+		{
+			delete sizeClass;
+		}
+	}
+
+	void* ConcurrentObjectPool::Allocate(size_t size)
+	{
+		void* block = size <= MAX_OBJECT_SIZE ? m_SizeClasses[GetSizeClass(size)]->Allocate() : AllocateTrackedBlock(size);
+		if (!block)
+		{
+			throw std::bad_alloc();
+		}
+		return block;
+	}
+
+	void ConcurrentObjectPool::Deallocate(void* block, size_t size)
+	{
+		if (!block)
+		{
+			return;
+		}
+
+		if (size <= MAX_OBJECT_SIZE)
+		{
+			m_SizeClasses[GetSizeClass(size)]->Deallocate(block);
+		}
+		else
+		{
+			DeallocateTrackedBlock(block);
+		}
+	}
+
+	u64 ConcurrentObjectPool::GetLiveObjectCount() const
+	{
+		u64 liveObjectCount = 0;
+		for (const concurrent_slab_allocator* sizeClass : m_SizeClasses)
+		{
+			liveObjectCount += sizeClass->GetLiveBlockCount();
+		}
+		return liveObjectCount;
+	}
+
+	u64 ConcurrentObjectPool::ReportLeaks() const
+	{
+		u64 leakCount = 0;
+		for (const concurrent_slab_allocator* sizeClass : m_SizeClasses)
+		{
+			leakCount += sizeClass->ReportLeaks(m_Name);
+		}
+		return leakCount;
+	}
+
+	u32 ConcurrentObjectPool::GetSizeClass(size_t size)
+	{
+		return size <= MIN_OBJECT_SIZE ? 0 : static_cast<u32>(std::bit_width(size - 1) - std::countr_zero(MIN_OBJECT_SIZE));
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "core/core.h"
+#include "concurrent_slab_allocator.h"
+
+namespace hdn
+{
+	// Blocks for the objects created and destroyed on any thread in large numbers (HObject, ITask), used by their class
+	// operator new: one concurrent_slab_allocator per power of two size from 32 bytes to MAX_OBJECT_SIZE, larger objects
+	// go to the GeneralAllocator. The size given to Deallocate() is the one given to Allocate()
+	class ConcurrentObjectPool
+	{
+	public:
+		explicit ConcurrentObjectPool(const char* name);
+		~ConcurrentObjectPool();
+
+		ConcurrentObjectPool(const ConcurrentObjectPool&) = delete;
+		ConcurrentObjectPool& operator=(const ConcurrentObjectPool&) = delete;
+
+		void* Allocate(size_t size);
+		void Deallocate(void* block, size_t size);
+
+		u64 GetLiveObjectCount() const;
+		u64 ReportLeaks() const;
+
+		static constexpr size_t MIN_OBJECT_SIZE = 32;
+		static constexpr size_t MAX_OBJECT_SIZE = 1 * KB;
+		static constexpr u32 SIZE_CLASS_COUNT = 6;
+		static constexpr size_t FIRST_SLAB_SIZE = 16 * KB; // Per size class, the following slabs double in size
+	private:
+		static u32 GetSizeClass(size_t size);
+	private:
+		const char* m_Name;
+		concurrent_slab_allocator* m_SizeClasses[SIZE_CLASS_COUNT];
+	};
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "core/core.h"
+#include "concurrent_slab_allocator.h"
+
+namespace hdn
+{
+	// pool_allocator that can be used from any thread: blockCount blocks in memory owned by the caller, Allocate() returns
+	// nullptr once they are all in use. The memory must hold blockCount blocks of blockSize rounded up to the alignment
+	class concurrent_pool_allocator : public concurrent_slab_allocator
+	{
+	public:
+		concurrent_pool_allocator(size_t blockSize, size_t blockCount, void* poolMemory, size_t alignment = DEFAULT_ALIGNMENT)
+			: concurrent_slab_allocator(blockSize, blockCount, alignment, poolMemory)
+		{
+		}
+
+		static constexpr size_t GetRequiredMemorySize(size_t blockSize, size_t blockCount, size_t alignment = DEFAULT_ALIGNMENT)
+		{
+			return AlignUp<size_t>(blockSize > 0 ? blockSize : 1, alignment) * blockCount;
+		}
+	};
+}
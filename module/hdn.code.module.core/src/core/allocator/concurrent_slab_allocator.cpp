@@ -0,0 +1,440 @@
+#include "concurrent_slab_allocator.h"
+#include "memory_tracker.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <thread>
+
+namespace hdn
+{
+	static constexpr byte FREED_BLOCK_PATTERN = static_cast<byte>(0xDD);
+	static constexpr byte ALLOCATED_BLOCK_PATTERN = static_cast<byte>(0xCD);
+	static constexpr u32 MAX_REPORTED_LEAK_COUNT = 16;
+
+	static inline u64 PackHead(u32 index, u32 tag)
+	{
+		return (static_cast<u64>(tag) << 32) | index;
+	}
+
+	static inline u32 GetHeadIndex(u64 head)
+	{
+		return static_cast<u32>(head);
+	}
+
+	static inline u32 GetHeadTag(u64 head)
+	{
+		return static_cast<u32>(head >> 32);
+	}
+
+	// Thread indices select the magazines and the shards. An index is given back when its thread exits, the next thread
+	// taking it inherits the magazines of the previous one
+	static constexpr u32 UNASSIGNED_THREAD_INDEX = ~0u;
+	static std::mutex s_ThreadIndexMutex;
+	static u32 s_ThreadIndexCount = 0;
+	static u32 s_FreeThreadIndices[concurrent_slab_allocator::MAX_THREAD_COUNT];
+	static u32 s_FreeThreadIndexCount = 0;
+	static thread_local u32 t_ThreadIndex = UNASSIGNED_THREAD_INDEX;
+
+	struct ThreadIndexOwner
+	{
+		~ThreadIndexOwner()
+		{
+			std::lock_guard<std::mutex> lock{ s_ThreadIndexMutex };
+			if (t_ThreadIndex < concurrent_slab_allocator::MAX_THREAD_COUNT)
+			{
+				s_FreeThreadIndices[s_FreeThreadIndexCount++] = t_ThreadIndex;
+			}
+			// Deallocations from the destructors that run after this one go straight to the shards
+			t_ThreadIndex = concurrent_slab_allocator::MAX_THREAD_COUNT;
+		}
+	};
+
+	static thread_local ThreadIndexOwner t_ThreadIndexOwner;
+
+	static u32 AcquireThreadIndex()
+	{
+		MAYBE_UNUSED(&t_ThreadIndexOwner);
+		std::lock_guard<std::mutex> lock{ s_ThreadIndexMutex };
+		t_ThreadIndex = s_FreeThreadIndexCount > 0 ? s_FreeThreadIndices[--s_FreeThreadIndexCount] : s_ThreadIndexCount++;
+		return t_ThreadIndex;
+	}
+
+	static inline u32 GetThreadIndex()
+	{
+		return t_ThreadIndex != UNASSIGNED_THREAD_INDEX ? t_ThreadIndex : AcquireThreadIndex();
+	}
+
+	concurrent_slab_allocator::concurrent_slab_allocator(size_t blockSize, size_t firstSlabBlockCount, size_t alignment)
+		: m_BlockSize{ blockSize }, m_Stride{ AlignUp<size_t>(std::max<size_t>(blockSize, 1), alignment) }, m_Alignment{ alignment },
+		m_FirstSlabShift{ static_cast<u32>(std::countr_zero(std::bit_ceil(std::max<size_t>(firstSlabBlockCount, 1)))) }, m_OwnsMemory{ true }
+	{
+		m_StrideShift = std::has_single_bit(m_Stride) ? static_cast<u32>(std::countr_zero(m_Stride)) : 0;
+		HASSERT(std::has_single_bit(alignment), "The alignment must be a power of two");
+		InitializeShards();
+	}
+
+	concurrent_slab_allocator::concurrent_slab_allocator(size_t blockSize, size_t blockCount, size_t alignment, void* memory)
+		: m_BlockSize{ blockSize }, m_Stride{ AlignUp<size_t>(std::max<size_t>(blockSize, 1), alignment) }, m_Alignment{ alignment },
+		m_FirstSlabShift{ static_cast<u32>(std::countr_zero(std::bit_ceil(std::max<size_t>(blockCount, 1)))) }, m_OwnsMemory{ false }
+	{
+		m_StrideShift = std::has_single_bit(m_Stride) ? static_cast<u32>(std::countr_zero(m_Stride)) : 0;
+		HASSERT(memory, "The memory of the pool cannot be null");
+		HASSERT(std::has_single_bit(alignment), "The alignment must be a power of two");
+		HASSERT(reinterpret_cast<uintptr_t>(memory) % alignment == 0, "The memory of the pool is not aligned on {0}", alignment);
+		HASSERT(blockCount < ALLOCATED_INDEX, "Too many blocks in the pool");
+		InitializeShards();
+		if (blockCount > 0)
+		{
+			AddSlab(static_cast<byte*>(memory), static_cast<u32>(blockCount), 0);
+		}
+	}
+
+	concurrent_slab_allocator::~concurrent_slab_allocator()
+	{
+		ReportLeaks();
+		const u32 slabCount = m_SlabCount.load(std::memory_order_acquire);
+		for (u32 slabIndex = 0; slabIndex < slabCount; slabIndex++)
+		{
+			// Owned slabs hold their links after the blocks, a pool only allocated the links
+			DeallocateTrackedBlock(m_OwnsMemory ? static_cast<void*>(m_Slabs[slabIndex].blocks) : static_cast<void*>(m_Slabs[slabIndex].links));
+		}
+		for (Magazine* magazine : m_Magazines)
+		{
+			DeallocateTrackedBlock(magazine);
+		}
+	}
+
+	void* concurrent_slab_allocator::Allocate()
+	{
+		const u32 threadIndex = GetThreadIndex();
+		Magazine* magazine = GetMagazine(threadIndex);
+		if (magazine && magazine->count > 0)
+		{
+			return OnAllocate(magazine->indices[--magazine->count]);
+		}
+
+		const u32 shardIndex = threadIndex & m_ShardMask;
+		for (;;)
+		{
+			const u32 batch = PopBatch(shardIndex);
+			if (batch == NULL_INDEX)
+			{
+				if (!Grow(shardIndex))
+				{
+					return nullptr;
+				}
+				continue;
+			}
+
+			// The first block of the batch is returned, the others go to the magazine (or back to the shard without one)
+			const u32 next = GetLink(batch).load(std::memory_order_relaxed);
+			if (magazine)
+			{
+				for (u32 index = next; index != NULL_INDEX; index = GetLink(index).load(std::memory_order_relaxed))
+				{
+					magazine->indices[magazine->count++] = index;
+				}
+			}
+			else if (next != NULL_INDEX)
+			{
+				PushBatches(m_Shards[shardIndex], next, next);
+			}
+			return OnAllocate(batch);
+		}
+	}
+
+	void concurrent_slab_allocator::Deallocate(void* block)
+	{
+		HASSERT(block != nullptr, "Cannot deallocate nullptr");
+		const u32 index = GetIndex(block);
+		HASSERT(index != NULL_INDEX, "Block {0} was not allocated by this allocator", block);
+		std::atomic<u32>& link = GetLink(index);
+		HASSERT(link.load(std::memory_order_relaxed) == ALLOCATED_INDEX, "Block {0} was already deallocated", block);
+#if USING(HDN_ALLOCATOR_POISONING)
+		memset(block, FREED_BLOCK_PATTERN, m_BlockSize);
+#endif
+		link.store(NULL_INDEX, std::memory_order_relaxed);
+
+		const u32 threadIndex = GetThreadIndex();
+		const u32 shardIndex = threadIndex & m_ShardMask;
+		Magazine* magazine = GetMagazine(threadIndex);
+		if (!magazine)
+		{
+			PushBatches(m_Shards[shardIndex], index, index);
+			return;
+		}
+
+		if (magazine->count == MAGAZINE_SIZE)
+		{
+			FlushBatch(*magazine, shardIndex);
+		}
+		magazine->indices[magazine->count++] = index;
+	}
+
+	u64 concurrent_slab_allocator::GetBlockCount() const
+	{
+		u64 blockCount = 0;
+		const u32 slabCount = m_SlabCount.load(std::memory_order_acquire);
+		for (u32 slabIndex = 0; slabIndex < slabCount; slabIndex++)
+		{
+			blockCount += m_Slabs[slabIndex].blockCount;
+		}
+		return blockCount;
+	}
+
+	u64 concurrent_slab_allocator::GetLiveBlockCount() const
+	{
+		u64 liveBlockCount = 0;
+		const u32 slabCount = m_SlabCount.load(std::memory_order_acquire);
+		for (u32 slabIndex = 0; slabIndex < slabCount; slabIndex++)
+		{
+			const Slab& slab = m_Slabs[slabIndex];
+			for (u32 i = 0; i < slab.blockCount; i++)
+			{
+				liveBlockCount += slab.links[i].load(std::memory_order_relaxed) == ALLOCATED_INDEX;
+			}
+		}
+		return liveBlockCount;
+	}
+
+	u64 concurrent_slab_allocator::ReportLeaks(const char* name) const
+	{
+		const u64 leakCount = GetLiveBlockCount();
+		if (leakCount == 0)
+		{
+			return 0;
+		}
+
+		HWARN("{0}: {1} blocks of {2} bytes were not deallocated", name, leakCount, m_BlockSize);
+		u32 reportedCount = 0;
+		const u32 slabCount = m_SlabCount.load(std::memory_order_acquire);
+		for (u32 slabIndex = 0; slabIndex < slabCount && reportedCount < MAX_REPORTED_LEAK_COUNT; slabIndex++)
+		{
+			const Slab& slab = m_Slabs[slabIndex];
+			for (u32 i = 0; i < slab.blockCount && reportedCount < MAX_REPORTED_LEAK_COUNT; i++)
+			{
+				if (slab.links[i].load(std::memory_order_relaxed) == ALLOCATED_INDEX)
+				{
+					HWARN("\tLeaked block {0}", static_cast<const void*>(slab.blocks + i * m_Stride));
+					reportedCount++;
+				}
+			}
+		}
+		return leakCount;
+	}
+
+	void concurrent_slab_allocator::InitializeShards()
+	{
+		const u32 shardCount = std::min(std::bit_ceil(std::max(std::thread::hardware_concurrency(), 1u)), MAX_SHARD_COUNT);
+		m_ShardMask = shardCount - 1;
+		for (Shard& shard : m_Shards)
+		{
+			shard.head.store(PackHead(NULL_INDEX, 0), std::memory_order_relaxed);
+		}
+	}
+
+	void concurrent_slab_allocator::AddSlab(byte* blocks, u32 blockCount, u32 shardIndex)
+	{
+		const u32 slabIndex = m_SlabCount.load(std::memory_order_relaxed);
+		Slab& slab = m_Slabs[slabIndex];
+		slab.blocks = blocks;
+		slab.firstIndex = slabIndex == 0 ? 0 : m_Slabs[slabIndex - 1].firstIndex + m_Slabs[slabIndex - 1].blockCount;
+		slab.blockCount = blockCount;
+		if (m_OwnsMemory)
+		{
+			slab.links = reinterpret_cast<std::atomic<u32>*>(blocks + AlignUp<size_t>(blockCount * m_Stride, alignof(std::atomic<u32>)));
+		}
+		else
+		{
+			slab.links = static_cast<std::atomic<u32>*>(AllocateTrackedBlock(2 * blockCount * sizeof(std::atomic<u32>)));
+			HASSERT(slab.links, "Cannot allocate the free list of the pool");
+		}
+		slab.batchLinks = slab.links + blockCount;
+
+		// The slab is cut in batches, chained in the order of the blocks
+		for (u32 i = 0; i < blockCount; i++)
+		{
+			const bool lastOfBatch = (i + 1) % BATCH_SIZE == 0 || i + 1 == blockCount;
+			const bool firstOfBatch = i % BATCH_SIZE == 0;
+			new (&slab.links[i]) std::atomic<u32>{ lastOfBatch ? NULL_INDEX : slab.firstIndex + i + 1 };
+			new (&slab.batchLinks[i]) std::atomic<u32>{ firstOfBatch && i + BATCH_SIZE < blockCount ? slab.firstIndex + i + BATCH_SIZE : NULL_INDEX };
+		}
+#if USING(HDN_ALLOCATOR_POISONING)
+		memset(blocks, FREED_BLOCK_PATTERN, blockCount * m_Stride);
+#endif
+
+		// Other threads only read the slab once they got one of its indices, or after loading the count
+		m_SlabCount.store(slabIndex + 1, std::memory_order_release);
+		const u32 lastBatch = slab.firstIndex + (blockCount - 1) / BATCH_SIZE * BATCH_SIZE;
+		PushBatches(m_Shards[shardIndex], slab.firstIndex, lastBatch);
+	}
+
+	bool concurrent_slab_allocator::Grow(u32 shardIndex)
+	{
+		std::lock_guard<std::mutex> lock{ m_GrowMutex };
+		// Another thread may have grown the allocator, or blocks were deallocated, while this one was waiting
+		if (HasFreeBlock())
+		{
+			return true;
+		}
+
+		const u32 slabIndex = m_SlabCount.load(std::memory_order_relaxed);
+		if (!m_OwnsMemory || slabIndex == MAX_SLAB_COUNT)
+		{
+			HWARN("No more space available in the {0} bytes block allocator ({1} blocks)", m_BlockSize, GetBlockCount());
+			return false;
+		}
+
+		const u64 blockCount = (1ull << m_FirstSlabShift) << slabIndex;
+		const u64 firstIndex = slabIndex == 0 ? 0 : m_Slabs[slabIndex - 1].firstIndex + m_Slabs[slabIndex - 1].blockCount;
+		if (firstIndex + blockCount >= ALLOCATED_INDEX)
+		{
+			HWARN("The {0} bytes block allocator reached its maximum block count", m_BlockSize);
+			return false;
+		}
+
+		const size_t linksOffset = AlignUp<size_t>(blockCount * m_Stride, alignof(std::atomic<u32>));
+		byte* blocks = static_cast<byte*>(AllocateTrackedBlock(linksOffset + 2 * blockCount * sizeof(std::atomic<u32>), m_Alignment));
+		if (!blocks)
+		{
+			return false;
+		}
+		AddSlab(blocks, static_cast<u32>(blockCount), shardIndex);
+		return true;
+	}
+
+	bool concurrent_slab_allocator::HasFreeBlock() const
+	{
+		for (u32 i = 0; i <= m_ShardMask; i++)
+		{
+			if (GetHeadIndex(m_Shards[i].head.load(std::memory_order_acquire)) != NULL_INDEX)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	u32 concurrent_slab_allocator::PopBatch(u32 shardIndex)
+	{
+		for (u32 i = 0; i <= m_ShardMask; i++)
+		{
+			Shard& shard = m_Shards[(shardIndex + i) & m_ShardMask];
+			u64 head = shard.head.load(std::memory_order_acquire);
+			while (GetHeadIndex(head) != NULL_INDEX)
+			{
+				// The batch may be popped by another thread in between, the link is then stale but the tag makes the exchange fail
+				const u32 next = GetBatchLink(GetHeadIndex(head)).load(std::memory_order_relaxed);
+				if (shard.head.compare_exchange_weak(head, PackHead(next, GetHeadTag(head) + 1), std::memory_order_acquire, std::memory_order_acquire))
+				{
+					return GetHeadIndex(head);
+				}
+			}
+		}
+		return NULL_INDEX;
+	}
+
+	void concurrent_slab_allocator::PushBatches(Shard& shard, u32 firstBatch, u32 lastBatch)
+	{
+		std::atomic<u32>& lastLink = GetBatchLink(lastBatch);
+		u64 head = shard.head.load(std::memory_order_relaxed);
+		do
+		{
+			lastLink.store(GetHeadIndex(head), std::memory_order_relaxed);
+		} while (!shard.head.compare_exchange_weak(head, PackHead(firstBatch, GetHeadTag(head) + 1), std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void concurrent_slab_allocator::FlushBatch(Magazine& magazine, u32 shardIndex)
+	{
+		// The oldest blocks leave, the recently freed ones are more likely to still be in the cache
+		for (u32 i = 0; i + 1 < BATCH_SIZE; i++)
+		{
+			GetLink(magazine.indices[i]).store(magazine.indices[i + 1], std::memory_order_relaxed);
+		}
+		GetLink(magazine.indices[BATCH_SIZE - 1]).store(NULL_INDEX, std::memory_order_relaxed);
+		PushBatches(m_Shards[shardIndex], magazine.indices[0], magazine.indices[0]);
+
+		magazine.count -= BATCH_SIZE;
+		memmove(magazine.indices, magazine.indices + BATCH_SIZE, magazine.count * sizeof(u32));
+	}
+
+	concurrent_slab_allocator::Magazine* concurrent_slab_allocator::GetMagazine(u32 threadIndex)
+	{
+		if (threadIndex >= MAX_THREAD_COUNT)
+		{
+			return nullptr;
+		}
+
+		Magazine*& magazine = m_Magazines[threadIndex];
+		if (!magazine)
+		{
+			magazine = static_cast<Magazine*>(AllocateTrackedBlock(sizeof(Magazine)));
+			if (magazine)
+			{
+				magazine->count = 0;
+			}
+		}
+		return magazine;
+	}
+
+	const concurrent_slab_allocator::Slab& concurrent_slab_allocator::GetSlab(u32 index) const
+	{
+		// The slabs double in size, slab s starts at index ((1 << s) - 1) << m_FirstSlabShift
+		const u32 slabIndex = static_cast<u32>(std::bit_width((index >> m_FirstSlabShift) + 1)) - 1;
+		return m_Slabs[slabIndex];
+	}
+
+	std::atomic<u32>& concurrent_slab_allocator::GetLink(u32 index) const
+	{
+		const Slab& slab = GetSlab(index);
+		return slab.links[index - slab.firstIndex];
+	}
+
+	std::atomic<u32>& concurrent_slab_allocator::GetBatchLink(u32 index) const
+	{
+		const Slab& slab = GetSlab(index);
+		return slab.batchLinks[index - slab.firstIndex];
+	}
+
+	byte* concurrent_slab_allocator::GetBlock(u32 index) const
+	{
+		const Slab& slab = GetSlab(index);
+		return slab.blocks + (index - slab.firstIndex) * m_Stride;
+	}
+
+	u32 concurrent_slab_allocator::GetIndex(const void* block) const
+	{
+		const byte* address = static_cast<const byte*>(block);
+		const u32 slabCount = m_SlabCount.load(std::memory_order_acquire);
+		for (u32 slabIndex = slabCount; slabIndex-- > 0;)
+		{
+			const Slab& slab = m_Slabs[slabIndex];
+			if (address >= slab.blocks && address < slab.blocks + slab.blockCount * m_Stride)
+			{
+				const size_t offset = static_cast<size_t>(address - slab.blocks);
+				HASSERT(offset % m_Stride == 0, "{0} is not the start of a block", block);
+				return slab.firstIndex + static_cast<u32>(m_StrideShift != 0 ? offset >> m_StrideShift : offset / m_Stride);
+			}
+		}
+		return NULL_INDEX;
+	}
+
+	byte* concurrent_slab_allocator::OnAllocate(u32 index)
+	{
+		GetLink(index).store(ALLOCATED_INDEX, std::memory_order_relaxed);
+		byte* block = GetBlock(index);
+#if USING(HDN_ALLOCATOR_POISONING)
+		for (size_t offset = 0; offset < m_BlockSize; offset++)
+		{
+			if (block[offset] != FREED_BLOCK_PATTERN)
+			{
+				HERR("Block {0} of {1} bytes was written to after it was freed (offset {2})", static_cast<const void*>(block), m_BlockSize, offset);
+				break;
+			}
+		}
+		memset(block, ALLOCATED_BLOCK_PATTERN, m_BlockSize);
+#endif
+		return block;
+	}
+}
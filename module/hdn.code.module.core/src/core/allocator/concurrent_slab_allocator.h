@@ -0,0 +1,113 @@
+#pragma once
+
+#include "core/core.h"
+
+#include <atomic>
+#include <mutex>
+
+// Freed blocks are filled with a pattern checked by the next allocation (use after free), and allocated blocks with another
+#define HDN_ALLOCATOR_POISONING USE_IF( USING(DEV) )
+
+namespace hdn
+{
+	// Fixed size blocks allocated and deallocated from any thread without a lock
+	// Every thread keeps a magazine of free blocks per allocator, the allocations and deallocations that fit in it do not
+	// synchronize at all. Magazines exchange batches of blocks with a few lock-free stacks (shards) shared by the threads,
+	// a thread takes from the shard of its index first and only looks at the others when it is empty. A stack head packs
+	// the index of its first batch with a tag changed by every pop and push, a pop working with a stale head fails its
+	// compare exchange instead of corrupting the stack (ABA)
+	// The free list links live in index arrays next to the blocks, the memory of a free block is never written to
+	// When every shard is empty a slab is added under a mutex, each one holding twice the blocks of the previous one
+	class concurrent_slab_allocator
+	{
+	public:
+		// firstSlabBlockCount is rounded up to a power of two, alignment is a power of two
+		concurrent_slab_allocator(size_t blockSize, size_t firstSlabBlockCount, size_t alignment = DEFAULT_ALIGNMENT);
+		// Reports the leaked blocks, the slabs are freed with them
+		virtual ~concurrent_slab_allocator();
+
+		concurrent_slab_allocator(const concurrent_slab_allocator&) = delete;
+		concurrent_slab_allocator& operator=(const concurrent_slab_allocator&) = delete;
+
+		// Returns nullptr when every block is in use or in the magazine of another thread, and the allocator cannot grow
+		void* Allocate();
+		void Deallocate(void* block);
+
+		size_t GetBlockSize() const { return m_BlockSize; }
+		u64 GetBlockCount() const;
+		// Scans every block, meant for statistics and tests
+		u64 GetLiveBlockCount() const;
+		// Logs the blocks still allocated and returns their count
+		u64 ReportLeaks(const char* name = "concurrent_slab_allocator") const;
+
+		static constexpr size_t DEFAULT_ALIGNMENT = 16;
+		static constexpr u32 MAX_SLAB_COUNT = 24;
+		static constexpr u32 MAX_SHARD_COUNT = 16;
+		static constexpr u32 BATCH_SIZE = 16; // Blocks moved between a magazine and the shards at once
+		static constexpr u32 MAGAZINE_SIZE = 2 * BATCH_SIZE;
+		// Thread indices are reused once their thread exits, threads past this count use the shards directly
+		static constexpr u32 MAX_THREAD_COUNT = 128;
+	protected:
+		// A single slab in memory owned by the caller, the allocator never grows (concurrent_pool_allocator)
+		concurrent_slab_allocator(size_t blockSize, size_t blockCount, size_t alignment, void* memory);
+	private:
+		struct Slab
+		{
+			byte* blocks;
+			std::atomic<u32>* links; // Next block of the batch, ALLOCATED_INDEX while the block is in use
+			std::atomic<u32>* batchLinks; // Next batch of the shard, for the first block of a batch
+			u32 firstIndex;
+			u32 blockCount;
+		};
+
+		struct alignas(64) Shard
+		{
+			std::atomic<u64> head; // Tag in the high bits, index of the first block of the first batch in the low bits
+		};
+
+		// Only used by the thread owning the thread index
+		struct Magazine
+		{
+			u32 count;
+			u32 indices[MAGAZINE_SIZE];
+		};
+
+		static constexpr u32 NULL_INDEX = ~0u;
+		static constexpr u32 ALLOCATED_INDEX = ~0u - 1;
+
+		void InitializeShards();
+		void AddSlab(byte* blocks, u32 blockCount, u32 shardIndex);
+		bool Grow(u32 shardIndex);
+		bool HasFreeBlock() const;
+
+		// Returns the first block of a batch taken from the shards, or NULL_INDEX if they are all empty
+		u32 PopBatch(u32 shardIndex);
+		void PushBatches(Shard& shard, u32 firstBatch, u32 lastBatch);
+		void FlushBatch(Magazine& magazine, u32 shardIndex);
+		Magazine* GetMagazine(u32 threadIndex);
+
+		const Slab& GetSlab(u32 index) const;
+		std::atomic<u32>& GetLink(u32 index) const;
+		std::atomic<u32>& GetBatchLink(u32 index) const;
+		byte* GetBlock(u32 index) const;
+		u32 GetIndex(const void* block) const;
+		byte* OnAllocate(u32 index);
+	private:
+		size_t m_BlockSize;
+		size_t m_Stride; // Block size rounded up to the alignment
+		u32 m_StrideShift; // log2 of the stride when it is a power of two, 0 otherwise
+		size_t m_Alignment;
+		u32 m_FirstSlabShift; // Slab s holds (1 << m_FirstSlabShift) << s blocks
+		bool m_OwnsMemory;
+
+		Shard m_Shards[MAX_SHARD_COUNT];
+		u32 m_ShardMask;
+
+		Slab m_Slabs[MAX_SLAB_COUNT]{};
+		std::atomic<u32> m_SlabCount{ 0 }; // A slab is written before the count is released
+		std::mutex m_GrowMutex;
+
+		// By thread index, created by the first allocation or deallocation of the thread
+		Magazine* m_Magazines[MAX_THREAD_COUNT]{};
+	};
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "core/core.h"
+#include "core/allocator/arena_allocator.h"
+#include "core/allocator/linear_allocator.h"
+#include "core/stl/map.h"
+#include "core/stl/vector.h"
+
+namespace hdn
+{
+	// One arena per frame in flight: a frame allocates its scratch data from its arena, which is reset when the frame index
+	// comes back around, once the fence of its previous submission signaled. Main thread only
+	class FrameArena
+	{
+	public:
+		FrameArena(u32 frameCount, size_t arenaSize)
+			: m_Memory{ new byte[frameCount * arenaSize] }
+		{
+			m_Arenas.reserve(frameCount);
+			for (u32 frameIndex = 0; frameIndex < frameCount; frameIndex++)
+			{
+				m_Arenas.emplace_back(arenaSize, m_Memory.get() + frameIndex * arenaSize);
+			}
+		}
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		// Call once the fence of the frame signaled, nothing allocated the last time the frame was in flight is used anymore
+		LinearAllocator* BeginFrame(u32 frameIndex)
+		{
+			LinearAllocator& arena = m_Arenas[frameIndex];
+			m_PeakUsage = std::max(m_PeakUsage, arena.GetUsedMemory());
+			arena.Deallocate();
+			return &arena;
+		}
+
+		LinearAllocator* GetArena(u32 frameIndex) { return &m_Arenas[frameIndex]; }
+		// Most bytes a frame used, an arena that fills up sends the following allocations of the frame to the heap
+		size_t GetPeakUsage() const { return m_PeakUsage; }
+	private:
+		Scope<byte[]> m_Memory;
+		vector<LinearAllocator> m_Arenas;
+		size_t m_PeakUsage = 0;
+	};
+
+	// Containers of the frame scratch data, built with arena_allocator{ frameInfo.frameArena }
+	template<typename T>
+	using frame_vector = vector<T, arena_allocator>;
+
+	template<typename Key, typename T, typename Compare = eastl::less<Key>>
+	using frame_map = map<Key, T, Compare, arena_allocator>;
+}
@@ -0,0 +1,516 @@
+#include "general_allocator.h"
+#include "allocator_lock.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if USING(HDN_PLATFORM_WINDOWS)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace hdn
+{
+	// Nothing below may allocate through the global operator new, and the shared state is constant initialized and
+	// trivially destroyed: allocations happen before the static initialization and after the static destruction
+
+	static constexpr std::array<size_t, GeneralAllocator::SIZE_CLASS_COUNT> s_BlockSizes = []() {
+		std::array<size_t, GeneralAllocator::SIZE_CLASS_COUNT> blockSizes{};
+		for (u32 sizeClass = 0; sizeClass < GeneralAllocator::SIZE_CLASS_COUNT; sizeClass++)
+		{
+			if (sizeClass < 8)
+			{
+				blockSizes[sizeClass] = (sizeClass + 1) * 16;
+				continue;
+			}
+			// (2^power, 2^(power + 1)] in 4 steps
+			const u32 power = (sizeClass - 8) / 4 + 7;
+			blockSizes[sizeClass] = (size_t{ 1 } << power) + ((sizeClass - 8) % 4 + 1) * (size_t{ 1 } << (power - 2));
+		}
+		return blockSizes;
+	}();
+
+	// Blocks a thread keeps for a size class before it flushes half of them to the shared free list
+	static constexpr std::array<u32, GeneralAllocator::SIZE_CLASS_COUNT> s_CacheCapacities = []() {
+		std::array<u32, GeneralAllocator::SIZE_CLASS_COUNT> capacities{};
+		for (u32 sizeClass = 0; sizeClass < GeneralAllocator::SIZE_CLASS_COUNT; sizeClass++)
+		{
+			capacities[sizeClass] = static_cast<u32>(std::clamp<size_t>(GeneralAllocator::THREAD_CACHE_SIZE / s_BlockSizes[sizeClass], 8, 512));
+		}
+		return capacities;
+	}();
+
+	// size in [1, MAX_SMALL_SIZE]
+	static constexpr u32 GetSizeClass(size_t size)
+	{
+		if (size <= 128)
+		{
+			return static_cast<u32>((size - 1) >> 4);
+		}
+		// 2^power < size <= 2^(power + 1)
+		const u32 power = static_cast<u32>(std::bit_width(size - 1)) - 1;
+		return 8 + 4 * (power - 7) + static_cast<u32>((size - 1 - (size_t{ 1 } << power)) >> (power - 2));
+	}
+
+	static_assert(s_BlockSizes[GeneralAllocator::SIZE_CLASS_COUNT - 1] == GeneralAllocator::MAX_SMALL_SIZE);
+	static_assert(GetSizeClass(GeneralAllocator::MAX_SMALL_SIZE) == GeneralAllocator::SIZE_CLASS_COUNT - 1);
+	static_assert(GetSizeClass(129) == 8 && GetSizeClass(160) == 8 && GetSizeClass(161) == 9 && GetSizeClass(257) == 12);
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	// At the start of every chunk, found from a block by rounding its address down to CHUNK_SIZE
+	struct ChunkHeader
+	{
+		u32 sizeClass;
+	};
+
+	// Right before a block allocated from the system heap, maybe unaligned when the block has an alignment offset
+	struct LargeHeader
+	{
+		size_t size;
+		size_t offset; // From what malloc returned
+	};
+
+	struct SizeClass
+	{
+		AllocatorLock lock;
+		FreeBlock* freeList = nullptr;
+		byte* carveCursor = nullptr; // Blocks of the last chunk never allocated yet, carved when needed to not touch the pages before
+		byte* carveEnd = nullptr;
+	};
+
+	struct ThreadStat
+	{
+		// Written by the owner thread only, read by GetMemStat()
+		static void Add(std::atomic<size_t>& counter, size_t value)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		std::atomic<size_t> allocated{ 0 };
+		std::atomic<size_t> allocationCount{ 0 };
+		std::atomic<size_t> deallocated{ 0 };
+		std::atomic<size_t> deallocationCount{ 0 };
+	};
+
+	static SizeClass s_SizeClasses[GeneralAllocator::SIZE_CLASS_COUNT];
+
+	static AllocatorLock s_RegionLock;
+	static bool s_RegionReserved = false; // Reservation attempted
+	static byte* s_RegionCursor = nullptr; // Next chunk
+	static std::atomic<byte*> s_RegionBase{ nullptr };
+	static std::atomic<size_t> s_RegionSize{ 0 }; // Published after the base, 0 until the range is reserved
+
+	struct ThreadCache;
+	static AllocatorLock s_ThreadCacheLock;
+	static ThreadCache* s_ThreadCaches = nullptr;
+	static ThreadStat s_RetiredStat; // Threads that exited, and allocations made without a thread cache (atomic adds)
+
+	static byte* ReserveRegion()
+	{
+#if USING(HDN_PLATFORM_WINDOWS)
+		// Reservations are aligned on the 64KB allocation granularity
+		static_assert(GeneralAllocator::CHUNK_SIZE == 64 * KB);
+		return static_cast<byte*>(VirtualAlloc(nullptr, GeneralAllocator::RESERVED_SIZE, MEM_RESERVE, PAGE_NOACCESS));
+#else
+		void* range = mmap(nullptr, GeneralAllocator::RESERVED_SIZE + GeneralAllocator::CHUNK_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (range == MAP_FAILED)
+		{
+			return nullptr;
+		}
+		const uintptr_t address = reinterpret_cast<uintptr_t>(range);
+		return reinterpret_cast<byte*>((address + GeneralAllocator::CHUNK_SIZE - 1) & ~(GeneralAllocator::CHUNK_SIZE - 1));
+#endif
+	}
+
+	static bool CommitChunk(byte* chunk)
+	{
+#if USING(HDN_PLATFORM_WINDOWS)
+		return VirtualAlloc(chunk, GeneralAllocator::CHUNK_SIZE, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+		return mprotect(chunk, GeneralAllocator::CHUNK_SIZE, PROT_READ | PROT_WRITE) == 0;
+#endif
+	}
+
+	// Returns nullptr once the reserved range is used up, the allocations then go to the system heap
+	static byte* AllocateChunk()
+	{
+		std::lock_guard<AllocatorLock> lock(s_RegionLock);
+		if (!s_RegionReserved)
+		{
+			s_RegionReserved = true;
+			byte* base = ReserveRegion();
+			if (base != nullptr)
+			{
+				s_RegionCursor = base;
+				s_RegionBase.store(base, std::memory_order_relaxed);
+				s_RegionSize.store(GeneralAllocator::RESERVED_SIZE, std::memory_order_release);
+			}
+		}
+
+		byte* base = s_RegionBase.load(std::memory_order_relaxed);
+		if (base == nullptr || s_RegionCursor == base + GeneralAllocator::RESERVED_SIZE || !CommitChunk(s_RegionCursor))
+		{
+			return nullptr;
+		}
+		byte* chunk = s_RegionCursor;
+		s_RegionCursor += GeneralAllocator::CHUNK_SIZE;
+		return chunk;
+	}
+
+	static bool IsSmallBlock(const void* block)
+	{
+		const size_t regionSize = s_RegionSize.load(std::memory_order_acquire);
+		const uintptr_t base = reinterpret_cast<uintptr_t>(s_RegionBase.load(std::memory_order_relaxed));
+		return reinterpret_cast<uintptr_t>(block) - base < regionSize;
+	}
+
+	static u32 GetBlockSizeClass(const void* block)
+	{
+		return reinterpret_cast<const ChunkHeader*>(reinterpret_cast<uintptr_t>(block) & ~(GeneralAllocator::CHUNK_SIZE - 1))->sizeClass;
+	}
+
+	// Takes up to count blocks of the size class, linked, the lock of the class held
+	static FreeBlock* TakeBlocks(u32 sizeClass, u32 count, u32& takenCount)
+	{
+		SizeClass& state = s_SizeClasses[sizeClass];
+		FreeBlock* blocks = nullptr;
+		takenCount = 0;
+		while (takenCount < count && state.freeList != nullptr)
+		{
+			FreeBlock* block = state.freeList;
+			state.freeList = block->next;
+			block->next = blocks;
+			blocks = block;
+			takenCount++;
+		}
+
+		const size_t blockSize = s_BlockSizes[sizeClass];
+		while (takenCount < count)
+		{
+			if (state.carveCursor == state.carveEnd)
+			{
+				byte* chunk = AllocateChunk();
+				if (chunk == nullptr)
+				{
+					break;
+				}
+				reinterpret_cast<ChunkHeader*>(chunk)->sizeClass = sizeClass;
+				// The blocks keep the alignment of their size (its lowest set bit, at least 16): a power of two block is aligned on its size
+				const size_t firstBlockOffset = blockSize & (~blockSize + 1);
+				state.carveCursor = chunk + firstBlockOffset;
+				state.carveEnd = state.carveCursor + (GeneralAllocator::CHUNK_SIZE - firstBlockOffset) / blockSize * blockSize;
+			}
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(state.carveCursor);
+			state.carveCursor += blockSize;
+			block->next = blocks;
+			blocks = block;
+			takenCount++;
+		}
+		return blocks;
+	}
+
+	// Constant initialized and trivially destroyed so the fast paths reach it without going through a TLS init guard, the
+	// ThreadCacheOwner registers it on the first allocation of the thread and releases it when the thread exits
+	struct ThreadCache
+	{
+		enum class State : u8
+		{
+			Unregistered,
+			Registered,
+			Released // The thread may still allocate from the destructors of other thread_local, without a cache
+		};
+
+		void Register()
+		{
+			std::lock_guard<AllocatorLock> lock(s_ThreadCacheLock);
+			next = s_ThreadCaches;
+			s_ThreadCaches = this;
+			state = State::Registered;
+		}
+
+		void Release()
+		{
+			for (u32 sizeClass = 0; sizeClass < GeneralAllocator::SIZE_CLASS_COUNT; sizeClass++)
+			{
+				Flush(sizeClass, counts[sizeClass]);
+			}
+
+			std::lock_guard<AllocatorLock> lock(s_ThreadCacheLock);
+			s_RetiredStat.allocated.fetch_add(stat.allocated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			s_RetiredStat.allocationCount.fetch_add(stat.allocationCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			s_RetiredStat.deallocated.fetch_add(stat.deallocated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			s_RetiredStat.deallocationCount.fetch_add(stat.deallocationCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			ThreadCache** link = &s_ThreadCaches;
+			while (*link != this)
+			{
+				link = &(*link)->next;
+			}
+			*link = next;
+			state = State::Released;
+		}
+
+		void Refill(u32 sizeClass)
+		{
+			SizeClass& sizeClassState = s_SizeClasses[sizeClass];
+			std::lock_guard<AllocatorLock> lock(sizeClassState.lock);
+			u32 takenCount = 0;
+			blocks[sizeClass] = TakeBlocks(sizeClass, s_CacheCapacities[sizeClass] / 2, takenCount);
+			counts[sizeClass] = takenCount;
+		}
+
+		void Flush(u32 sizeClass, u32 count)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+			FreeBlock* first = blocks[sizeClass];
+			FreeBlock* last = first;
+			for (u32 i = 1; i < count; i++)
+			{
+				last = last->next;
+			}
+			blocks[sizeClass] = last->next;
+			counts[sizeClass] -= count;
+
+			SizeClass& sizeClassState = s_SizeClasses[sizeClass];
+			std::lock_guard<AllocatorLock> lock(sizeClassState.lock);
+			last->next = sizeClassState.freeList;
+			sizeClassState.freeList = first;
+		}
+
+		FreeBlock* blocks[GeneralAllocator::SIZE_CLASS_COUNT] = {};
+		u32 counts[GeneralAllocator::SIZE_CLASS_COUNT] = {};
+		ThreadStat stat;
+		State state = State::Unregistered;
+		ThreadCache* next = nullptr; // In s_ThreadCaches
+	};
+
+	static thread_local ThreadCache t_ThreadCache;
+
+	struct ThreadCacheOwner
+	{
+		~ThreadCacheOwner()
+		{
+			t_ThreadCache.Release();
+		}
+	};
+
+	static thread_local ThreadCacheOwner t_ThreadCacheOwner;
+
+	// Registers the cache on the first allocation of the thread, nullptr once the thread released it
+	static ThreadCache* InitThreadCache()
+	{
+		if (t_ThreadCache.state == ThreadCache::State::Released)
+		{
+			return nullptr;
+		}
+		// The first use of the owner constructs it, its destructor runs when the thread exits
+		MAYBE_UNUSED(&t_ThreadCacheOwner);
+		t_ThreadCache.Register();
+		return &t_ThreadCache;
+	}
+
+	static ThreadCache* GetThreadCache()
+	{
+		if (t_ThreadCache.state == ThreadCache::State::Registered) [[likely]]
+		{
+			return &t_ThreadCache;
+		}
+		return InitThreadCache();
+	}
+
+	static void RecordAllocation(ThreadCache* cache, size_t size)
+	{
+		if (cache != nullptr)
+		{
+			ThreadStat::Add(cache->stat.allocated, size);
+			ThreadStat::Add(cache->stat.allocationCount, 1);
+			return;
+		}
+		s_RetiredStat.allocated.fetch_add(size, std::memory_order_relaxed);
+		s_RetiredStat.allocationCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void RecordDeallocation(ThreadCache* cache, size_t size)
+	{
+		if (cache != nullptr)
+		{
+			ThreadStat::Add(cache->stat.deallocated, size);
+			ThreadStat::Add(cache->stat.deallocationCount, 1);
+			return;
+		}
+		s_RetiredStat.deallocated.fetch_add(size, std::memory_order_relaxed);
+		s_RetiredStat.deallocationCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Empty thread cache, or no thread cache
+	static FreeBlock* AllocateSmallSlow(ThreadCache* cache, u32 sizeClass)
+	{
+		if (cache != nullptr)
+		{
+			cache->Refill(sizeClass);
+			FreeBlock* block = cache->blocks[sizeClass];
+			if (block != nullptr)
+			{
+				cache->blocks[sizeClass] = block->next;
+				cache->counts[sizeClass]--;
+			}
+			return block;
+		}
+
+		SizeClass& sizeClassState = s_SizeClasses[sizeClass];
+		std::lock_guard<AllocatorLock> lock(sizeClassState.lock);
+		u32 takenCount = 0;
+		return TakeBlocks(sizeClass, 1, takenCount);
+	}
+
+	static void* AllocateSmall(u32 sizeClass)
+	{
+		ThreadCache* cache = GetThreadCache();
+		FreeBlock* block = cache != nullptr ? cache->blocks[sizeClass] : nullptr;
+		if (block != nullptr) [[likely]]
+		{
+			cache->blocks[sizeClass] = block->next;
+			cache->counts[sizeClass]--;
+		}
+		else
+		{
+			block = AllocateSmallSlow(cache, sizeClass);
+			if (block == nullptr)
+			{
+				return nullptr;
+			}
+		}
+		RecordAllocation(cache, s_BlockSizes[sizeClass]);
+		return block;
+	}
+
+	static void DeallocateSmall(void* pointer)
+	{
+		const u32 sizeClass = GetBlockSizeClass(pointer);
+		FreeBlock* block = static_cast<FreeBlock*>(pointer);
+		ThreadCache* cache = GetThreadCache();
+		RecordDeallocation(cache, s_BlockSizes[sizeClass]);
+		if (cache == nullptr)
+		{
+			SizeClass& sizeClassState = s_SizeClasses[sizeClass];
+			std::lock_guard<AllocatorLock> lock(sizeClassState.lock);
+			block->next = sizeClassState.freeList;
+			sizeClassState.freeList = block;
+			return;
+		}
+
+		if (cache->counts[sizeClass] == s_CacheCapacities[sizeClass])
+		{
+			cache->Flush(sizeClass, s_CacheCapacities[sizeClass] / 2);
+		}
+		block->next = cache->blocks[sizeClass];
+		cache->blocks[sizeClass] = block;
+		cache->counts[sizeClass]++;
+	}
+
+	static void* AllocateLarge(size_t size, size_t alignment, size_t offset)
+	{
+		// malloc returns DEFAULT_ALIGNMENT aligned blocks, the padding makes room for the header and the alignment
+		const bool aligned = alignment <= GeneralAllocator::DEFAULT_ALIGNMENT && (offset & (alignment - 1)) == 0;
+		const size_t padding = sizeof(LargeHeader) + (aligned ? 0 : alignment);
+		if (size > SIZE_MAX - padding)
+		{
+			return nullptr;
+		}
+		byte* allocation = static_cast<byte*>(std::malloc(size + padding));
+		if (allocation == nullptr)
+		{
+			return nullptr;
+		}
+
+		const uintptr_t alignedAddress = (reinterpret_cast<uintptr_t>(allocation) + sizeof(LargeHeader) + offset + alignment - 1) & ~(alignment - 1);
+		byte* block = reinterpret_cast<byte*>(alignedAddress - offset);
+		const LargeHeader header{ size, static_cast<size_t>(block - allocation) };
+		memcpy(block - sizeof(LargeHeader), &header, sizeof(LargeHeader));
+		RecordAllocation(GetThreadCache(), size);
+		return block;
+	}
+
+	static LargeHeader GetLargeHeader(const void* block)
+	{
+		LargeHeader header;
+		memcpy(&header, static_cast<const byte*>(block) - sizeof(LargeHeader), sizeof(LargeHeader));
+		return header;
+	}
+
+	void* GeneralAllocator::Allocate(size_t size, size_t alignment, size_t offset)
+	{
+		HASSERT(std::has_single_bit(alignment), "GeneralAllocator: alignment {0} is not a power of two", alignment);
+#if USING(HDN_GENERAL_ALLOCATOR)
+		if (size <= MAX_SMALL_SIZE && alignment <= MAX_SMALL_SIZE && (offset & (alignment - 1)) == 0)
+		{
+			// A power of two block is aligned on its size
+			const size_t blockSize = alignment <= DEFAULT_ALIGNMENT ? std::max<size_t>(size, 1) : std::max(std::bit_ceil(size), alignment);
+			if (void* block = AllocateSmall(GetSizeClass(blockSize)))
+			{
+				return block;
+			}
+		}
+#endif
+		return AllocateLarge(size, alignment, offset);
+	}
+
+	void GeneralAllocator::Deallocate(void* block)
+	{
+		if (block == nullptr)
+		{
+			return;
+		}
+		if (IsSmallBlock(block))
+		{
+			DeallocateSmall(block);
+			return;
+		}
+		const LargeHeader header = GetLargeHeader(block);
+		RecordDeallocation(GetThreadCache(), header.size);
+		std::free(static_cast<byte*>(block) - header.offset);
+	}
+
+	size_t GeneralAllocator::GetBlockSize(const void* block)
+	{
+		if (block == nullptr)
+		{
+			return 0;
+		}
+		return IsSmallBlock(block) ? s_BlockSizes[GetBlockSizeClass(block)] : GetLargeHeader(block).size;
+	}
+
+	MemStat GeneralAllocator::GetMemStat()
+	{
+		std::lock_guard<AllocatorLock> lock(s_ThreadCacheLock);
+		MemStat memStat;
+		memStat.allocated = s_RetiredStat.allocated.load(std::memory_order_relaxed);
+		memStat.allocationCount = s_RetiredStat.allocationCount.load(std::memory_order_relaxed);
+		memStat.deallocated = s_RetiredStat.deallocated.load(std::memory_order_relaxed);
+		memStat.deallocationCount = s_RetiredStat.deallocationCount.load(std::memory_order_relaxed);
+		for (const ThreadCache* cache = s_ThreadCaches; cache != nullptr; cache = cache->next)
+		{
+			memStat.allocated += cache->stat.allocated.load(std::memory_order_relaxed);
+			memStat.allocationCount += cache->stat.allocationCount.load(std::memory_order_relaxed);
+			memStat.deallocated += cache->stat.deallocated.load(std::memory_order_relaxed);
+			memStat.deallocationCount += cache->stat.deallocationCount.load(std::memory_order_relaxed);
+		}
+		return memStat;
+	}
+}
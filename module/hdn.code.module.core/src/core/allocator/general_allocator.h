@@ -0,0 +1,39 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/stl/ds_base.h"
+
+// The global operator new goes through the size-class slabs of the GeneralAllocator, NOT_IN_USE sends every allocation
+// to the system heap (statistics and alignment are handled the same way)
+#define HDN_GENERAL_ALLOCATOR IN_USE
+
+namespace hdn
+{
+	// Allocator behind the global operator new and the EASTL containers
+	// Small allocations come from size-class slabs: 64KB chunks carved from one reserved address range, each chunk holding
+	// blocks of a single size. Every thread keeps a free list per size class and only takes the lock of the class to refill
+	// or flush half of it, a block freed on another thread than the one it was allocated on goes to the cache of the former
+	// Larger allocations, and the ones with an alignment offset, go to the system heap behind a small header
+	// The chunks are never given back to the system, a freed block is reused by the next allocation of its size class
+	class GeneralAllocator
+	{
+	public:
+		// alignment is a power of two, blocks are always at least DEFAULT_ALIGNMENT aligned
+		// With an offset, it is the address block + offset that is aligned (EASTL aligned allocations)
+		// Returns nullptr when the system is out of memory
+		static void* Allocate(size_t size, size_t alignment = DEFAULT_ALIGNMENT, size_t offset = 0);
+		static void Deallocate(void* block);
+		// Bytes usable in the block, at least the size it was allocated with
+		static size_t GetBlockSize(const void* block);
+
+		// Every thread included, in bytes of blocks: allocated - deallocated is what is in use
+		static MemStat GetMemStat();
+
+		static constexpr size_t DEFAULT_ALIGNMENT = 16;
+		static constexpr size_t CHUNK_SIZE = 64 * KB;
+		static constexpr size_t MAX_SMALL_SIZE = 8 * KB;
+		static constexpr u32 SIZE_CLASS_COUNT = 32; // 16 to 128 by 16, then 4 steps per power of two up to 8KB
+		static constexpr size_t RESERVED_SIZE = 64ull * GB; // Address space only, chunks are committed when needed
+		static constexpr size_t THREAD_CACHE_SIZE = 32 * KB; // Per size class, in bytes of blocks
+	};
+}
@@ -16,12 +16,30 @@ namespace hdn
 
 		void* Allocate(size_t allocSize)
 		{
-			HASSERT(m_Offset + allocSize < m_TotalSize, "LinearAllocator out of memory!");
+			HASSERT(m_Offset + allocSize <= m_TotalSize, "LinearAllocator out of memory!");
 			void* ptr = static_cast<byte*>(m_Memory) + m_Offset;
 			m_Offset += allocSize;
 			return ptr;
 		}
 
+		// Returns nullptr instead of overflowing, alignment is a power of two
+		void* TryAllocate(size_t allocSize, size_t alignment)
+		{
+			const uintptr_t base = reinterpret_cast<uintptr_t>(m_Memory);
+			const size_t alignedOffset = ((base + m_Offset + alignment - 1) & ~(alignment - 1)) - base;
+			if (alignedOffset > m_TotalSize || allocSize > m_TotalSize - alignedOffset)
+			{
+				return nullptr;
+			}
+			m_Offset = alignedOffset + allocSize;
+			return static_cast<byte*>(m_Memory) + alignedOffset;
+		}
+
+		bool Owns(const void* ptr) const
+		{
+			return ptr >= m_Memory && ptr < static_cast<const byte*>(m_Memory) + m_TotalSize;
+		}
+
 		void Deallocate()
 		{
 			m_Offset = 0;
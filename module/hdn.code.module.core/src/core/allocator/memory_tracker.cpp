@@ -0,0 +1,332 @@
+#include "memory_tracker.h"
+#include "general_allocator.h"
+#include "allocator_lock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace hdn
+{
+	// Allocate() and Deallocate() run inside the global operator new: they may not allocate, and the state they use is
+	// constant initialized and trivially destroyed (see GeneralAllocator)
+
+	static constexpr u16 HEADER_CHECK = 0xA110;
+
+	// Right before the block, the allocation of the GeneralAllocator starts offset bytes before the block
+	struct TrackedHeader
+	{
+		size_t size;
+		u32 offset;
+		MemoryTag tag;
+		u16 check;
+	};
+	static_assert(sizeof(TrackedHeader) == MemoryTracker::HEADER_SIZE);
+
+	static void RaisePeak(std::atomic<size_t>& peak, size_t value)
+	{
+		size_t current = peak.load(std::memory_order_relaxed);
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	struct TagState
+	{
+		void Add(size_t size)
+		{
+			const size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+			RaisePeak(peakBytes, live);
+			RaisePeak(framePeakBytes, live);
+			allocationCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void Remove(size_t size)
+		{
+			liveBytes.fetch_sub(size, std::memory_order_relaxed);
+			deallocationCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Starts the high-water mark of the next frame from what is live, returns the one of the frame that ends
+		size_t EndFrame()
+		{
+			const size_t framePeak = framePeakBytes.exchange(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			lastFramePeakBytes.store(framePeak, std::memory_order_relaxed);
+			return framePeak;
+		}
+
+		MemoryTagStat GetStat(const char* tagName) const
+		{
+			MemoryTagStat stat;
+			stat.name = tagName;
+			stat.liveBytes = liveBytes.load(std::memory_order_relaxed);
+			stat.peakBytes = peakBytes.load(std::memory_order_relaxed);
+			stat.framePeakBytes = lastFramePeakBytes.load(std::memory_order_relaxed);
+			stat.allocationCount = allocationCount.load(std::memory_order_relaxed);
+			stat.deallocationCount = deallocationCount.load(std::memory_order_relaxed);
+			return stat;
+		}
+
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<size_t> liveBytes{ 0 };
+		std::atomic<size_t> peakBytes{ 0 };
+		std::atomic<size_t> framePeakBytes{ 0 }; // Of the running frame
+		std::atomic<size_t> lastFramePeakBytes{ 0 };
+		std::atomic<u64> allocationCount{ 0 };
+		std::atomic<u64> deallocationCount{ 0 };
+	};
+
+	// Scopes past MAX_TAG_DEPTH are counted but keep the tag of the deepest stored one
+	struct TagStack
+	{
+		MemoryTag tags[MemoryTracker::MAX_TAG_DEPTH];
+		const char* files[MemoryTracker::MAX_TAG_DEPTH];
+		u32 lines[MemoryTracker::MAX_TAG_DEPTH];
+		u32 depth;
+	};
+
+	struct SiteState
+	{
+		bool used;
+		MemoryTag tag;
+		const char* name;
+		const char* file;
+		u32 line;
+		u64 sampleCount;
+		size_t sampledBytes;
+	};
+
+	static AllocatorLock s_TagLock; // Registrations only
+	static TagState s_Tags[MemoryTracker::MAX_TAG_COUNT];
+	static std::atomic<u32> s_TagCount{ 1 }; // UNTAGGED included
+	static TagState s_Total;
+	static thread_local TagStack t_TagStack;
+
+	static AllocatorLock s_SiteLock;
+	static SiteState s_Sites[MemoryTracker::MAX_SITE_COUNT];
+	static std::atomic<u32> s_SamplingPeriod{ 0 };
+	static thread_local u32 t_AllocationsSinceSample = 0;
+
+	// Main thread only
+	static size_t s_FrameHistory[MemoryTracker::FRAME_HISTORY_SIZE];
+	static u64 s_FrameCount = 0;
+
+	static const char* GetTagName(u32 tag)
+	{
+		return tag == MemoryTracker::UNTAGGED ? "untagged" : s_Tags[tag].name.load(std::memory_order_acquire);
+	}
+
+	static void RecordSample(MemoryTag tag, size_t size, const char* name, const char* file, int line)
+	{
+		const TagStack& stack = t_TagStack;
+		if (stack.depth > 0)
+		{
+			const u32 top = std::min(stack.depth, MemoryTracker::MAX_TAG_DEPTH) - 1;
+			file = stack.files[top];
+			line = static_cast<int>(stack.lines[top]);
+		}
+		if (name == nullptr)
+		{
+			name = "operator new";
+		}
+
+		// The strings are literals, a site is identified by their addresses
+		const u64 hash = (reinterpret_cast<uintptr_t>(name) ^ (reinterpret_cast<uintptr_t>(file) * 31) ^ (static_cast<u64>(line) << 16) ^ tag) * 0x9E3779B97F4A7C15ull;
+		const u64 firstSlot = hash >> 32;
+		std::lock_guard<AllocatorLock> lock(s_SiteLock);
+		for (u32 probe = 0; probe < MemoryTracker::MAX_SITE_COUNT; probe++)
+		{
+			SiteState& site = s_Sites[(firstSlot + probe) % MemoryTracker::MAX_SITE_COUNT];
+			if (!site.used)
+			{
+				site = SiteState{ true, tag, name, file, static_cast<u32>(line), 0, 0 };
+			}
+			else if (site.tag != tag || site.name != name || site.file != file || site.line != static_cast<u32>(line))
+			{
+				continue;
+			}
+			site.sampleCount++;
+			site.sampledBytes += size;
+			return;
+		}
+		// The table is full, the sample is dropped
+	}
+
+	MemoryTag MemoryTracker::RegisterTag(const char* name)
+	{
+		u32 tag = UNTAGGED;
+		{
+			std::lock_guard<AllocatorLock> lock(s_TagLock);
+			const u32 tagCount = s_TagCount.load(std::memory_order_relaxed);
+			for (u32 existingTag = 1; existingTag < tagCount; existingTag++)
+			{
+				if (strcmp(s_Tags[existingTag].name.load(std::memory_order_relaxed), name) == 0)
+				{
+					return static_cast<MemoryTag>(existingTag);
+				}
+			}
+			if (tagCount < MAX_TAG_COUNT)
+			{
+				tag = tagCount;
+				s_Tags[tag].name.store(name, std::memory_order_release);
+				s_TagCount.store(tagCount + 1, std::memory_order_release);
+			}
+		}
+
+		if (tag == UNTAGGED)
+		{
+			HWARN("No more memory tags available, allocations tagged '{0}' are untagged", name);
+		}
+		return static_cast<MemoryTag>(tag);
+	}
+
+	void MemoryTracker::PushTag(MemoryTag tag, const char* file, u32 line)
+	{
+		TagStack& stack = t_TagStack;
+		if (stack.depth < MAX_TAG_DEPTH)
+		{
+			stack.tags[stack.depth] = tag;
+			stack.files[stack.depth] = file;
+			stack.lines[stack.depth] = line;
+		}
+		stack.depth++;
+	}
+
+	void MemoryTracker::PopTag()
+	{
+		HASSERT(t_TagStack.depth > 0, "PopTag() without a PushTag()");
+		t_TagStack.depth--;
+	}
+
+	MemoryTag MemoryTracker::GetCurrentTag()
+	{
+		const TagStack& stack = t_TagStack;
+		return stack.depth == 0 ? UNTAGGED : stack.tags[std::min(stack.depth, MAX_TAG_DEPTH) - 1];
+	}
+
+	void* MemoryTracker::Allocate(size_t size, size_t alignment, size_t offset, const char* name, const char* file, int line)
+	{
+		HASSERT(alignment <= (size_t{ 1 } << 31), "MemoryTracker: alignment {0} is too large", alignment);
+		// The header goes right before the block: with an alignment offset, block + offset is aligned when the allocation
+		// is aligned at offset + HEADER_SIZE, otherwise the header takes a whole alignment for the block to stay aligned
+		const size_t headerSpace = offset == 0 ? std::max(HEADER_SIZE, alignment) : HEADER_SIZE;
+		if (size > SIZE_MAX - headerSpace)
+		{
+			return nullptr;
+		}
+		byte* allocation = static_cast<byte*>(GeneralAllocator::Allocate(size + headerSpace, alignment, offset == 0 ? 0 : offset + HEADER_SIZE));
+		if (allocation == nullptr)
+		{
+			return nullptr;
+		}
+
+		byte* block = allocation + headerSpace;
+		const MemoryTag tag = GetCurrentTag();
+		const TrackedHeader header{ size, static_cast<u32>(headerSpace), tag, HEADER_CHECK };
+		memcpy(block - HEADER_SIZE, &header, HEADER_SIZE);
+		s_Tags[tag].Add(size);
+		s_Total.Add(size);
+
+		const u32 samplingPeriod = s_SamplingPeriod.load(std::memory_order_relaxed);
+		if (samplingPeriod != 0 && ++t_AllocationsSinceSample >= samplingPeriod)
+		{
+			t_AllocationsSinceSample = 0;
+			RecordSample(tag, size, name, file, line);
+		}
+		return block;
+	}
+
+	void MemoryTracker::Deallocate(void* block)
+	{
+		if (block == nullptr)
+		{
+			return;
+		}
+
+		TrackedHeader header;
+		memcpy(&header, static_cast<byte*>(block) - HEADER_SIZE, HEADER_SIZE);
+		HASSERT(header.check == HEADER_CHECK, "MemoryTracker: {0} was not allocated by the global operator new", block);
+		s_Tags[header.tag].Remove(header.size);
+		s_Total.Remove(header.size);
+		GeneralAllocator::Deallocate(static_cast<byte*>(block) - header.offset);
+	}
+
+	void MemoryTracker::BeginFrame()
+	{
+		const u32 tagCount = s_TagCount.load(std::memory_order_acquire);
+		for (u32 tag = 0; tag < tagCount; tag++)
+		{
+			s_Tags[tag].EndFrame();
+		}
+		s_FrameHistory[s_FrameCount % FRAME_HISTORY_SIZE] = s_Total.EndFrame();
+		s_FrameCount++;
+	}
+
+	vector<MemoryTagStat> MemoryTracker::GetTagStats()
+	{
+		const u32 tagCount = s_TagCount.load(std::memory_order_acquire);
+		vector<MemoryTagStat> stats;
+		stats.reserve(tagCount);
+		for (u32 tag = 0; tag < tagCount; tag++)
+		{
+			stats.push_back(s_Tags[tag].GetStat(GetTagName(tag)));
+		}
+		return stats;
+	}
+
+	MemoryTagStat MemoryTracker::GetTotalStat()
+	{
+		return s_Total.GetStat("total");
+	}
+
+	vector<size_t> MemoryTracker::GetFrameHistory()
+	{
+		const u64 frameCount = std::min<u64>(s_FrameCount, FRAME_HISTORY_SIZE);
+		vector<size_t> history;
+		history.reserve(frameCount);
+		for (u64 frame = s_FrameCount - frameCount; frame < s_FrameCount; frame++)
+		{
+			history.push_back(s_FrameHistory[frame % FRAME_HISTORY_SIZE]);
+		}
+		return history;
+	}
+
+	vector<MemorySiteStat> MemoryTracker::GetSiteStats()
+	{
+		// Copied under the lock first, the vector allocates through the operator new that samples
+		SiteState sites[MAX_SITE_COUNT];
+		{
+			std::lock_guard<AllocatorLock> lock(s_SiteLock);
+			memcpy(sites, s_Sites, sizeof(s_Sites));
+		}
+
+		const size_t samplingPeriod = std::max<u32>(s_SamplingPeriod.load(std::memory_order_relaxed), 1);
+		vector<MemorySiteStat> stats;
+		for (const SiteState& site : sites)
+		{
+			if (site.used)
+			{
+				stats.push_back(MemorySiteStat{ GetTagName(site.tag), site.name, site.file, site.line, site.sampleCount, site.sampledBytes * samplingPeriod });
+			}
+		}
+		std::sort(stats.begin(), stats.end(), [](const MemorySiteStat& lhs, const MemorySiteStat& rhs) { return lhs.sampledBytes > rhs.sampledBytes; });
+		return stats;
+	}
+
+	void MemoryTracker::ClearSiteStats()
+	{
+		std::lock_guard<AllocatorLock> lock(s_SiteLock);
+		memset(s_Sites, 0, sizeof(s_Sites));
+	}
+
+	void MemoryTracker::SetSamplingPeriod(u32 samplingPeriod)
+	{
+		s_SamplingPeriod.store(samplingPeriod, std::memory_order_relaxed);
+	}
+
+	u32 MemoryTracker::GetSamplingPeriod()
+	{
+		return s_SamplingPeriod.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/allocator/general_allocator.h"
+#include "core/stl/vector.h"
+
+// The global operator new attributes every allocation to the memory tag of its thread, behind a 16 bytes header
+#define HDN_MEMORY_TRACKING USE_IF( USING(DEV) )
+
+#if USING(HDN_MEMORY_TRACKING)
+#define HMEMORY_TAG_CONCAT_INTERNAL(a, b) a##b
+#define HMEMORY_TAG_CONCAT(a, b) HMEMORY_TAG_CONCAT_INTERNAL(a, b)
+// The allocations of the thread until the end of the scope are attributed to the tag, name is a literal ("hzone", "async", ...)
+#define HMEMORY_TAG(name) \
+	static const ::hdn::MemoryTag HMEMORY_TAG_CONCAT(s_MemoryTag, __LINE__) = ::hdn::MemoryTracker::RegisterTag(name); \
+	const ::hdn::MemoryTagScope HMEMORY_TAG_CONCAT(memoryTagScope, __LINE__){ HMEMORY_TAG_CONCAT(s_MemoryTag, __LINE__), __FILE__, __LINE__ }
+#else
+#define HMEMORY_TAG(name)
+#endif
+
+namespace hdn
+{
+	using MemoryTag = u16;
+
+	struct MemoryTagStat
+	{
+		const char* name = nullptr;
+		size_t liveBytes = 0;
+		size_t peakBytes = 0; // Since the start
+		size_t framePeakBytes = 0; // High-water mark of the last frame
+		u64 allocationCount = 0;
+		u64 deallocationCount = 0;
+	};
+
+	// Allocations sampled at a call site: the innermost tag scope, or the location given to the EASTL operator new[]
+	struct MemorySiteStat
+	{
+		const char* tagName = nullptr;
+		const char* name = nullptr; // EASTL container name, or "operator new"
+		const char* file = nullptr;
+		u32 line = 0;
+		u64 sampleCount = 0;
+		size_t sampledBytes = 0; // Times the sampling period for an estimate of the bytes allocated at the site
+	};
+
+	// Allocation tracking per subsystem: live bytes, peak and counts per tag, the high-water mark of every frame, and the
+	// call sites of one allocation out of the sampling period
+	// The sizes are the ones requested, the block sizes of the GeneralAllocator are in GetMemStat()
+	// The pooled objects (HObject, ITask, see ConcurrentObjectPool) are tracked by slab: a slab, its free list and the
+	// magazines go through AllocateTrackedBlock() and are charged to the tag of the thread that makes the pool grow
+	class MemoryTracker
+	{
+	public:
+		// Returns the tag with this name, registered on its first use, or UNTAGGED once MAX_TAG_COUNT tags exist
+		// name must outlive the tracker
+		static MemoryTag RegisterTag(const char* name);
+		static void PushTag(MemoryTag tag, const char* file = nullptr, u32 line = 0);
+		static void PopTag();
+		static MemoryTag GetCurrentTag();
+
+		// Global operator new and delete, name, file and line are the ones of the EASTL operator new[]
+		// Returns nullptr when the system is out of memory
+		static void* Allocate(size_t size, size_t alignment, size_t offset = 0, const char* name = nullptr, const char* file = nullptr, int line = 0);
+		static void Deallocate(void* block);
+
+		// Closes the high-water marks of the frame, called once per frame by the main loop
+		static void BeginFrame();
+
+		// Indexed by tag
+		static vector<MemoryTagStat> GetTagStats();
+		static MemoryTagStat GetTotalStat();
+		// Total tracked bytes high-water mark of the last FRAME_HISTORY_SIZE frames, oldest first
+		static vector<size_t> GetFrameHistory();
+		// Sorted by sampled bytes, the largest first
+		static vector<MemorySiteStat> GetSiteStats();
+		static void ClearSiteStats();
+
+		// One allocation out of samplingPeriod, per thread, is recorded with its call site, 0 disables the sampling
+		static void SetSamplingPeriod(u32 samplingPeriod);
+		static u32 GetSamplingPeriod();
+
+		static constexpr MemoryTag UNTAGGED = 0;
+		static constexpr u32 MAX_TAG_COUNT = 64;
+		static constexpr u32 MAX_TAG_DEPTH = 32;
+		static constexpr u32 MAX_SITE_COUNT = 256;
+		static constexpr u32 FRAME_HISTORY_SIZE = 120;
+		static constexpr size_t HEADER_SIZE = 16;
+	};
+
+	class MemoryTagScope
+	{
+	public:
+		MemoryTagScope(MemoryTag tag, const char* file = nullptr, u32 line = 0)
+		{
+			MemoryTracker::PushTag(tag, file, line);
+		}
+
+		~MemoryTagScope()
+		{
+			MemoryTracker::PopTag();
+		}
+
+		MemoryTagScope(const MemoryTagScope&) = delete;
+		MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+	};
+
+	// Blocks of the engine allocators that do not come from the global operator new (pool slabs), tracked
+	// like the global allocations under HDN_MEMORY_TRACKING, straight from the GeneralAllocator otherwise
+	inline void* AllocateTrackedBlock(size_t size, size_t alignment = GeneralAllocator::DEFAULT_ALIGNMENT, size_t offset = 0)
+	{
+#if USING(HDN_MEMORY_TRACKING)
+		return MemoryTracker::Allocate(size, alignment, offset);
+#else
+		return GeneralAllocator::Allocate(size, alignment, offset);
+#endif
+	}
+
+	inline void DeallocateTrackedBlock(void* block)
+	{
+#if USING(HDN_MEMORY_TRACKING)
+		MemoryTracker::Deallocate(block);
+#else
+		GeneralAllocator::Deallocate(block);
+#endif
+	}
+}
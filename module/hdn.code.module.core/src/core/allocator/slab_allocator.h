@@ -1,5 +1,6 @@
 #pragma once
 #include "core/core.h"
+#include "core/stl/vector.h"
 
 namespace hdn
 {
@@ -11,7 +12,13 @@ namespace hdn
 		{
 		}
 
-		virtual ~slab_allocator() {}
+		virtual ~slab_allocator()
+		{
+			for (void* slab : m_Slabs)
+			{
+				std::free(slab);
+			}
+		}
 
 		void* Allocate()
 		{
@@ -35,7 +42,7 @@ namespace hdn
 		void CreateSlab()
 		{
 			void* slab = std::malloc(m_BlockSize * m_BlocksPerSlab); // TODO: Fix, should not heap allocate
-			slabs.push_back(slab);
+			m_Slabs.push_back(slab);
 			byte* current = static_cast<byte*>(slab);
 			for (size_t i = 0;i < m_BlocksPerSlab; i++)
 			{
@@ -48,7 +55,7 @@ namespace hdn
 	private:
 		size_t m_BlockSize;
 		size_t m_BlocksPerSlab;
-		TVector<void*> slabs;
+		vector<void*> m_Slabs;
 		void* m_FreeList = nullptr;
 	};
 }
\ No newline at end of file
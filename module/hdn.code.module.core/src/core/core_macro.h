@@ -36,6 +36,13 @@ namespace hdn
 		return static_cast<EnumType>(value);
 	}
 
+	// alignment must be a power of two
+	template<typename T>
+	inline constexpr T AlignUp(T value, T alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
 	template<typename T>
 	using Scope = std::unique_ptr<T>;
 
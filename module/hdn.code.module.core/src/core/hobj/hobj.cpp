@@ -0,0 +1,21 @@
+#include "hobj.h"
+
+namespace hdn
+{
+	void* HObject::operator new(size_t size)
+	{
+		return GetPool().Allocate(size);
+	}
+
+	void HObject::operator delete(void* block, size_t size)
+	{
+		GetPool().Deallocate(block, size);
+	}
+
+	ConcurrentObjectPool& HObject::GetPool()
+	{
+		// Never destroyed, the registry releases its objects during the static destruction
+		static ConcurrentObjectPool* s_Pool = new ConcurrentObjectPool("HObject");
+		return *s_Pool;
+	}
+}
@@ -8,6 +8,10 @@
 #include "core/io/common.h"
 #include "core/io/buffer_writer.h"
 #include "core/io/buffer_reader.h"
+#include "core/io/mapped_file.h"
+#include "core/allocator/concurrent_object_pool.h"
+
+#include <new>
 
 constexpr std::size_t strlen_ct(const char* str) {
 	std::size_t length = 0;
@@ -22,6 +26,9 @@ constexpr std::size_t strlen_ct(const char* str) {
 namespace hdn
 {
 	static constexpr u64 HOBJ_FILE_MAGIC_NUMBER = 0x4A424F48;
+	// Block compressed file: magic number, type hash, size, block count, end of every block, blocks of the .ho file
+	static constexpr u64 HOBJ_COMPRESSED_FILE_MAGIC_NUMBER = 0x5A424F48;
+	static constexpr u64 HOBJ_COMPRESSION_BLOCK_SIZE = 256 * KB;
 	static constexpr u64 HOBJ_NULL_KEY = 0;
 
 	enum class HObjectLoadState
@@ -45,13 +52,19 @@ namespace hdn
 	enum class HObjectLoadFlags
 	{
 		Default = 0,
-		Realize = (1 << 0)
+		Realize = (1 << 0),
+		// Map the file instead of reading it, the object can reference the mapped bytes and keeps the mapping alive
+		MemoryMap = (1 << 1),
+		// Read the file but keep its buffer alive with the object, which can then reference it instead of copying it
+		InPlace = (1 << 2)
 	};
 	ENABLE_ENUM_CLASS_BITWISE_OPERATIONS(HObjectLoadFlags)
 
 	enum class HObjectSaveFlags
 	{
-		Default = 0
+		Default = 0,
+		// Compress the file in blocks, loading it decompresses it to a buffer the object keeps alive (as with InPlace)
+		Compress = (1 << 0)
 	};
 	ENABLE_ENUM_CLASS_BITWISE_OPERATIONS(HObjectSaveFlags)
 
@@ -90,6 +103,13 @@ namespace hdn
 		{
 			HDEBUG("Freeing object '{0}'", m_Path.c_str());
 		}
+
+		// Objects are created by the threads loading them, they come from a shared pool
+		static void* operator new(size_t size);
+		static void operator delete(void* block, size_t size);
+		static void* operator new(size_t size, std::align_val_t alignment) { return ::operator new(size, alignment); }
+		static void operator delete(void* block, size_t size, std::align_val_t alignment) { ::operator delete(block, size, alignment); }
+		static ConcurrentObjectPool& GetPool();
 	protected:
 		HObject()
 			: m_Key{ HOBJ_NULL_KEY }, m_LoadState{ HObjectLoadState::Unloaded }
@@ -110,12 +130,18 @@ namespace hdn
 		{
 			m_LoadState = state;
 		}
+
+		void SetFileData(const Ref<void>& fileData)
+		{
+			m_FileData = fileData;
+		}
 	private:
 		hkey m_Key = HOBJ_NULL_KEY;
 		string m_Path = ""; // TODO: Make this field available only in debug mode?
 
 		// Transient
 		HObjectLoadState m_LoadState = HObjectLoadState::Unloaded;
+		Ref<void> m_FileData; // File mapping or buffer, set when loaded with HObjectLoadFlags::MemoryMap or HObjectLoadFlags::InPlace
 
 		friend class HObjectUtil;
 	};
@@ -2,71 +2,270 @@
 
 namespace hdn
 {
+	HObjectRegistry::Table::Table(u64 capacity)
+		: capacity{ capacity }, slots{ CreateScope<Slot[]>(capacity) }
+	{
+	}
+
 	HObjectRegistry& HObjectRegistry::Get()
 	{
 		static HObjectRegistry s_Instance;
 		return s_Instance;
 	}
 
-	bool HObjectRegistry::Contains(hkey key)
+	HObjectRegistry::HObjectRegistry()
 	{
-		return m_HObjectRegistry.contains(key);
+		for (ObjectShard& shard : m_ObjectShards)
+		{
+			shard.tables.push_back(CreateScope<Table>(INITIAL_TABLE_CAPACITY));
+			shard.table.store(shard.tables.back().get(), std::memory_order_release);
+		}
 	}
 
-	void HObjectRegistry::Register(hkey key, HObjPtr<HObject> object)
+	bool HObjectRegistry::Contains(hkey key) const
 	{
-		if (m_HObjectRegistry.contains(key))
-		{
-			return;
-		}
-		m_HObjectRegistry[key] = object;
+		return Get(key) != nullptr;
 	}
 
-	HObjPtr<HObject> HObjectRegistry::Get(hkey key)
+	HObjPtr<HObject> HObjectRegistry::Register(hkey key, HObjPtr<HObject> object)
 	{
-		if (m_HObjectRegistry.contains(key))
+		HASSERT(key != HOBJ_NULL_KEY, "Cannot register an object with a null key");
+		HASSERT(object, "Cannot register a null object");
+
+		const u64 hash = HashKey(key);
+		ObjectShard& shard = GetObjectShard(hash);
+		std::lock_guard<std::mutex> lock(shard.writeMutex);
+		return Insert(shard, key, object, hash);
+	}
+
+	HObjPtr<HObject> HObjectRegistry::Get(hkey key) const
+	{
+		const u64 hash = HashKey(key);
+		const ObjectShard& shard = GetObjectShard(hash);
+		const Table* table = shard.table.load(std::memory_order_acquire);
+		while (true)
 		{
-			return m_HObjectRegistry.at(key);
+			if (HObjPtr<HObject> object = Find(*table, key, hash))
+			{
+				return object;
+			}
+
+			// The table may have been replaced while we were probing it, the key can then only be in the new one
+			const Table* currentTable = shard.table.load(std::memory_order_acquire);
+			if (currentTable == table)
+			{
+				return nullptr;
+			}
+			table = currentTable;
 		}
-		return nullptr;
 	}
 
 	void HObjectRegistry::RegisterObjectPath(hkey key, const fspath& path)
 	{
 		fspath absolutePath = FileSystem::ToAbsolute(path);
 
-		if (m_HObjectPaths.contains(key))
 		{
-			return;
+			PathShard& shard = m_PathShards[HashKey(key) >> (64 - SHARD_BITS)];
+			std::unique_lock<std::shared_mutex> lock(shard.mutex);
+			if (shard.paths.contains(key))
+			{
+				return;
+			}
+			shard.paths[key] = absolutePath;
 		}
-		m_HObjectPaths[key] = absolutePath;
-		m_HObjectKeys[absolutePath] = key;
+
+		PathShard& shard = m_PathShards[HashKey(std::filesystem::hash_value(absolutePath)) >> (64 - SHARD_BITS)];
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		shard.keys[absolutePath] = key;
 	}
 
-	optional<fspath> HObjectRegistry::GetObjectPath(hkey key)
+	optional<fspath> HObjectRegistry::GetObjectPath(hkey key) const
 	{
-		if (m_HObjectPaths.contains(key))
+		const PathShard& shard = m_PathShards[HashKey(key) >> (64 - SHARD_BITS)];
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		auto it = shard.paths.find(key);
+		if (it != shard.paths.end())
 		{
-			return m_HObjectPaths.at(key);
+			return it->second;
 		}
 		return optional<fspath>{};
 	}
 
-	hkey HObjectRegistry::GetObjectKey(const fspath& path)
+	hkey HObjectRegistry::GetObjectKey(const fspath& path) const
 	{
 		fspath absolutePath = FileSystem::ToAbsolute(path);
-		if (m_HObjectKeys.contains(absolutePath))
+		const PathShard& shard = m_PathShards[HashKey(std::filesystem::hash_value(absolutePath)) >> (64 - SHARD_BITS)];
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		auto it = shard.keys.find(absolutePath);
+		if (it != shard.keys.end())
 		{
-			return m_HObjectKeys.at(absolutePath);
+			return it->second;
 		}
 		return HOBJ_NULL_KEY;
 	}
 
+	u64 HObjectRegistry::GetObjectCount() const
+	{
+		u64 count = 0;
+		for (ObjectShard& shard : m_ObjectShards)
+		{
+			std::lock_guard<std::mutex> lock(shard.writeMutex);
+			count += shard.count;
+		}
+		return count;
+	}
+
 	HObjectRegistry::~HObjectRegistry()
 	{
-		for (const auto& [key, object] : m_HObjectRegistry)
+		for (ObjectShard& shard : m_ObjectShards)
+		{
+			const Table& table = *shard.table.load(std::memory_order_acquire);
+			for (u64 i = 0; i < table.capacity; i++)
+			{
+				if (table.slots[i].key.load(std::memory_order_relaxed) != HOBJ_NULL_KEY)
+				{
+					delete table.slots[i].object.load(std::memory_order_relaxed);
+				}
+			}
+		}
+		// Anything left was created and never registered
+		HObject::GetPool().ReportLeaks();
+	}
+
+	bool HObjectRegistry::AcquireLoad(hkey key, HObjPtr<HObject>& object)
+	{
+		const u64 hash = HashKey(key);
+		ObjectShard& shard = GetObjectShard(hash);
+		Ref<InFlightLoad> inFlightLoad;
+		{
+			std::lock_guard<std::mutex> lock(shard.writeMutex);
+			// Registered between the lock-free lookup and the lock
+			object = Find(*shard.table.load(std::memory_order_relaxed), key, hash);
+			if (object)
+			{
+				return false;
+			}
+
+			auto it = shard.inFlightLoads.find(key);
+			if (it == shard.inFlightLoads.end())
+			{
+				shard.inFlightLoads[key] = CreateRef<InFlightLoad>();
+				return true;
+			}
+			inFlightLoad = it->second;
+		}
+
+		std::unique_lock<std::mutex> lock(inFlightLoad->mutex);
+		inFlightLoad->condition.wait(lock, [&inFlightLoad]() { return inFlightLoad->done; });
+		object = inFlightLoad->object;
+		return false;
+	}
+
+	HObjPtr<HObject> HObjectRegistry::CompleteLoad(hkey key, HObjPtr<HObject> object)
+	{
+		const u64 hash = HashKey(key);
+		ObjectShard& shard = GetObjectShard(hash);
+		Ref<InFlightLoad> inFlightLoad;
+		{
+			std::lock_guard<std::mutex> lock(shard.writeMutex);
+			if (object)
+			{
+				object = Insert(shard, key, object, hash);
+			}
+
+			auto it = shard.inFlightLoads.find(key);
+			HASSERT(it != shard.inFlightLoads.end(), "No load in flight for key '{0}'", key);
+			inFlightLoad = it->second;
+			shard.inFlightLoads.erase(it);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(inFlightLoad->mutex);
+			inFlightLoad->object = object;
+			inFlightLoad->done = true;
+		}
+		inFlightLoad->condition.notify_all();
+		return object;
+	}
+
+	u64 HObjectRegistry::HashKey(hkey key)
+	{
+		// Keys are usually random already, but nothing prevents sequential ones, mix them (splitmix64 finalizer)
+		key ^= key >> 30;
+		key *= 0xBF58476D1CE4E5B9ull;
+		key ^= key >> 27;
+		key *= 0x94D049BB133111EBull;
+		key ^= key >> 31;
+		return key;
+	}
+
+	HObjectRegistry::ObjectShard& HObjectRegistry::GetObjectShard(u64 hash) const
+	{
+		// The top bits pick the shard, the low bits the slot
+		return m_ObjectShards[hash >> (64 - SHARD_BITS)];
+	}
+
+	HObjPtr<HObject> HObjectRegistry::Find(const Table& table, hkey key, u64 hash)
+	{
+		const u64 mask = table.capacity - 1;
+		for (u64 i = hash & mask;; i = (i + 1) & mask)
+		{
+			const hkey slotKey = table.slots[i].key.load(std::memory_order_acquire);
+			if (slotKey == key)
+			{
+				return table.slots[i].object.load(std::memory_order_relaxed);
+			}
+			if (slotKey == HOBJ_NULL_KEY)
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	HObjPtr<HObject> HObjectRegistry::Insert(ObjectShard& shard, hkey key, HObjPtr<HObject> object, u64 hash)
+	{
+		Table* table = shard.table.load(std::memory_order_relaxed);
+		if (HObjPtr<HObject> registeredObject = Find(*table, key, hash))
+		{
+			return registeredObject;
+		}
+
+		// Keep the load factor under 1/2 so the probe sequences stay short (and always end on an empty slot)
+		if ((shard.count + 1) * 2 > table->capacity)
+		{
+			Scope<Table> grownTable = CreateScope<Table>(table->capacity * 2);
+			const u64 mask = grownTable->capacity - 1;
+			for (u64 i = 0; i < table->capacity; i++)
+			{
+				const hkey slotKey = table->slots[i].key.load(std::memory_order_relaxed);
+				if (slotKey == HOBJ_NULL_KEY)
+				{
+					continue;
+				}
+				u64 index = HashKey(slotKey) & mask;
+				while (grownTable->slots[index].key.load(std::memory_order_relaxed) != HOBJ_NULL_KEY)
+				{
+					index = (index + 1) & mask;
+				}
+				grownTable->slots[index].object.store(table->slots[i].object.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				grownTable->slots[index].key.store(slotKey, std::memory_order_relaxed);
+			}
+			table = grownTable.get();
+			shard.tables.push_back(std::move(grownTable));
+			// Publishes the copied slots as well
+			shard.table.store(table, std::memory_order_release);
+		}
+
+		const u64 mask = table->capacity - 1;
+		u64 index = hash & mask;
+		while (table->slots[index].key.load(std::memory_order_relaxed) != HOBJ_NULL_KEY)
 		{
-			delete object;
+			index = (index + 1) & mask;
 		}
+		// The object is written before the key, a reader that sees the key sees the object
+		table->slots[index].object.store(object, std::memory_order_relaxed);
+		table->slots[index].key.store(key, std::memory_order_release);
+		shard.count++;
+		return object;
 	}
 }
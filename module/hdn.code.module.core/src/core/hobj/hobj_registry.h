@@ -1,30 +1,109 @@
 #pragma once
 #include "core/core.h"
 #include "core/stl/unordered_map.h"
+#include "core/stl/hkey_map.h"
 #include "core/stl/optional.h"
+#include "core/stl/vector.h"
 
 #include "hobj.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+
 namespace hdn
 {
+	// Thread-safe registry of the loaded objects and of the object paths
+	// Objects live in sharded open-addressing tables: lookups never take a lock, registrations lock a single shard
+	// Objects are never unregistered, they are released with the registry
 	class HObjectRegistry
 	{
 	public:
 		static HObjectRegistry& Get();
-		bool Contains(hkey key);
-		void Register(hkey key, HObjPtr<HObject> object);
-		HObjPtr<HObject> Get(hkey key);
+		bool Contains(hkey key) const;
+		// The first registration of a key wins, returns the object registered for the key
+		HObjPtr<HObject> Register(hkey key, HObjPtr<HObject> object);
+		HObjPtr<HObject> Get(hkey key) const;
+
+		// Returns the object registered for the key, or calls load() to create it
+		// Threads asking for a key that is being loaded wait on the running load instead of loading the object a second time
+		// load() must not request the key it is loading
+		template<typename LoadFunc>
+		HObjPtr<HObject> GetOrLoad(hkey key, const LoadFunc& load)
+		{
+			HObjPtr<HObject> object = Get(key);
+			if (object || !AcquireLoad(key, object))
+			{
+				return object;
+			}
+			return CompleteLoad(key, load());
+		}
 
 		void RegisterObjectPath(hkey key, const fspath& path);
-		optional<fspath> GetObjectPath(hkey key);
-		hkey GetObjectKey(const fspath& path);
+		optional<fspath> GetObjectPath(hkey key) const;
+		hkey GetObjectKey(const fspath& path) const;
+
+		u64 GetObjectCount() const;
 
 		virtual ~HObjectRegistry();
 	private:
-		HObjectRegistry() = default;
+		struct Slot
+		{
+			std::atomic<hkey> key{ HOBJ_NULL_KEY };
+			std::atomic<HObject*> object{ nullptr };
+		};
+
+		struct Table
+		{
+			Table(u64 capacity);
+
+			u64 capacity;
+			Scope<Slot[]> slots;
+		};
+
+		struct InFlightLoad
+		{
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool done = false;
+			HObjPtr<HObject> object = nullptr;
+		};
+
+		struct alignas(64) ObjectShard
+		{
+			std::mutex writeMutex;
+			std::atomic<Table*> table{ nullptr };
+			u64 count = 0;
+			// Replaced tables are kept alive since lock-free readers can still be probing them (at most as much memory as the current one)
+			vector<Scope<Table>> tables;
+			hkey_map<Ref<InFlightLoad>> inFlightLoads;
+		};
+
+		struct alignas(64) PathShard
+		{
+			mutable std::shared_mutex mutex;
+			hkey_map<fspath> paths;
+			unordered_map<fspath, hkey> keys;
+		};
+
+		HObjectRegistry();
+
+		// Returns true if the caller has to load the object, false if the object was loaded (by this or another thread) in the meantime
+		bool AcquireLoad(hkey key, HObjPtr<HObject>& object);
+		HObjPtr<HObject> CompleteLoad(hkey key, HObjPtr<HObject> object);
+
+		static u64 HashKey(hkey key);
+		ObjectShard& GetObjectShard(u64 hash) const;
+		static HObjPtr<HObject> Find(const Table& table, hkey key, u64 hash);
+		static HObjPtr<HObject> Insert(ObjectShard& shard, hkey key, HObjPtr<HObject> object, u64 hash);
 	private:
-		unordered_map<hkey, HObjPtr<HObject>> m_HObjectRegistry{};
-		unordered_map<hkey, fspath> m_HObjectPaths{};
-		unordered_map<fspath, hkey> m_HObjectKeys{};
+		static constexpr u32 SHARD_BITS = 6;
+		static constexpr u32 SHARD_COUNT = 1 << SHARD_BITS;
+		static constexpr u64 INITIAL_TABLE_CAPACITY = 64;
+
+		mutable ObjectShard m_ObjectShards[SHARD_COUNT];
+		// Path lookups are only done when loading, a reader lock per shard is enough
+		PathShard m_PathShards[SHARD_COUNT];
 	};
-}
\ No newline at end of file
+}
@@ -2,6 +2,9 @@
 #include "hobj.h"
 #include "hobj_registry.h"
 
+#include "core/io/growable_buffer_writer.h"
+#include "core/io/block_compression.h"
+
 namespace hdn
 {
 	class HObjectUtil
@@ -10,7 +13,7 @@ namespace hdn
 		template<typename T>
 		static HObjPtr<T> Create(HObjectCreateFlags flags = HObjectCreateFlags::InitForCreate)
 		{
-			HObjPtr<T> object = new T(); // TODO: Allocate to HObject pool instead
+			HObjPtr<T> object = new T(); // From HObject::GetPool()
 			if (static_cast<utype<HObjectCreateFlags>>(flags & HObjectCreateFlags::GenerateUUID) != 0)
 			{
 				object->SetKey(HObjectUtil::GenerateKey());
@@ -27,20 +30,37 @@ namespace hdn
 			fspath absoluteSavePath = FileSystem::ToAbsolute(savePath);
 			object->SetPath(absoluteSavePath.string());
 
-			byte* serializationBuffer = new byte[1024]; // TODO: Use a per-frame linear allocator
-			FBufferWriter writer{ serializationBuffer };
+			FGrowableBufferWriter writer{ 1 * KB };
 			object->Serialize(writer, flags);
-			std::ofstream outFile(absoluteSavePath, std::ios::binary);
+			if (writer.IsOverflowed())
+			{
+				HERR("Could not serialize the object to '{0}'", absoluteSavePath.string().c_str());
+				return false;
+			}
+			return WriteFile(writer.begin<byte>(), writer.BytesWritten(), absoluteSavePath, flags);
+		}
+
+		// Writes a serialized object, for objects whose content is appended after HObject::Serialize() (e.g. zones)
+		static bool WriteFile(const byte* data, u64 size, const fspath& path, HObjectSaveFlags flags = HObjectSaveFlags::Default)
+		{
+			if (BitOn(flags, HObjectSaveFlags::Compress))
+			{
+				FGrowableBufferWriter compressedWriter{ size / 2 + 1 * KB };
+				CompressFile(data, size, compressedWriter);
+				return WriteFile(compressedWriter.begin<byte>(), compressedWriter.BytesWritten(), path);
+			}
+
+			std::ofstream outFile(path, std::ios::binary);
 			if (!outFile)
 			{
-				HERR("Could not open file '{0}' for writing", absoluteSavePath.string().c_str());
+				HERR("Could not open file '{0}' for writing", path.string().c_str());
 				return false;
 			}
-			outFile.write(writer.begin<char>(), writer.BytesWritten());
+			outFile.write(reinterpret_cast<const char*>(data), size);
 			outFile.close();
 			if (outFile.fail())
 			{
-				HERR("Failed to write to file '{0}'", absoluteSavePath.string().c_str());
+				HERR("Failed to write to file '{0}'", path.string().c_str());
 				return false;
 			}
 			return true;
@@ -49,31 +69,25 @@ namespace hdn
 		template<typename T>
 		static HObjPtr<T> GetObjectFromKey(hkey key, HObjectLoadFlags flags = HObjectLoadFlags::Default)
 		{
-			HObjPtr<T> object = static_cast<T*>(HObjectRegistry::Get().Get(key));
-			if (object == nullptr)
-			{
-				// THe object was not found in the in-memory registry, we need to retreive the object from the persistent registry
+			// If the object is not in the in-memory registry we need to retrieve it from the persistent registry,
+			// concurrent requests for the same key share the same load
+			return static_cast<T*>(HObjectRegistry::Get().GetOrLoad(key, [key, flags]() -> HObjPtr<HObject> {
 				optional<fspath> path = HObjectRegistry::Get().GetObjectPath(key);
-				if (path)
-				{
-					object = HObjectUtil::LoadFromPath<T>(path->string().c_str(), flags);
-				}
-				else
+				if (!path)
 				{
 					HERR("Object with key '{0}' not found", key);
+					return nullptr;
 				}
-			}
-			return object;
+				return HObjectUtil::LoadFromPath<T>(path->string().c_str(), flags);
+			}));
 		}
 
 		template<typename T>
 		static HObjPtr<T> GetObjectFromPath(const char* path, HObjectLoadFlags flags = HObjectLoadFlags::Default)
 		{
-			MAYBE_UNUSED(flags);
-
 			hkey key = HObjectRegistry::Get().GetObjectKey(path);
 			HASSERT(key != HOBJ_NULL_KEY, "HObject not found");
-			return HObjectUtil::GetObjectFromKey<T>(key);
+			return HObjectUtil::GetObjectFromKey<T>(key, flags);
 		}
 
 		static hkey GenerateKey()
@@ -81,33 +95,77 @@ namespace hdn
 			hkey key = static_cast<hkey>(GenerateUUID64());
 			return key;
 		}
-	private:
+
+		// Loads a new instance of the object without registering it, the caller owns it and deletes it when done
+		// Meant for objects loaded and released repeatedly (e.g. streamed zones), the registry never releases its objects
 		template<typename T>
-		static HObjPtr<T> LoadFromPath(const char* path, HObjectLoadFlags flags = HObjectLoadFlags::Default)
+		static HObjPtr<T> LoadDetached(const char* path, HObjectLoadFlags flags = HObjectLoadFlags::Default)
 		{
 			string absoluteSavePath = FileSystem::ToAbsolute(path).string();
-			std::ifstream inFile(absoluteSavePath, std::ios::binary | std::ios::ate);
 
-			if (!inFile) {
-				HERR("Could not open file '{0}' for reading", absoluteSavePath.c_str());
-				return nullptr;
+			// Either the file is mapped and the reader views the mapping, or it is read into a buffer
+			// The object keeps the mapping or the buffer alive if it is allowed to reference it
+			Ref<void> fileData;
+			Ref<std::vector<char>> buffer; // Alive until the object is read, kept by the object only when it can reference it
+			const byte* data = nullptr;
+			u64 dataSize = 0;
+			if (BitOn(flags, HObjectLoadFlags::MemoryMap))
+			{
+				Ref<FMappedFile> mappedFile = CreateRef<FMappedFile>();
+				if (!mappedFile->Map(absoluteSavePath))
+				{
+					return nullptr;
+				}
+				data = mappedFile->Data();
+				dataSize = mappedFile->Size();
+				fileData = mappedFile;
 			}
+			else
+			{
+				std::ifstream inFile(absoluteSavePath, std::ios::binary | std::ios::ate);
 
-			// Get the file size
-			std::streamsize fileSize = inFile.tellg();
-			inFile.seekg(0, std::ios::beg);
+				if (!inFile) {
+					HERR("Could not open file '{0}' for reading", absoluteSavePath.c_str());
+					return nullptr;
+				}
 
-			// Create a buffer of the appropriate size
-			std::vector<char> buffer(fileSize);
+				// Get the file size
+				std::streamsize fileSize = inFile.tellg();
+				inFile.seekg(0, std::ios::beg);
 
-			// Read the file into the buffer
-			if (!inFile.read(buffer.data(), fileSize)) {
-				HERR("Failed to read the file", absoluteSavePath.c_str());
-				return nullptr;
+				// Create a buffer of the appropriate size
+				buffer = CreateRef<std::vector<char>>(fileSize);
+
+				// Read the file into the buffer
+				if (!inFile.read(buffer->data(), fileSize)) {
+					HERR("Failed to read the file", absoluteSavePath.c_str());
+					return nullptr;
+				}
+				inFile.close();
+				data = reinterpret_cast<const byte*>(buffer->data());
+				dataSize = buffer->size();
+				if (BitOn(flags, HObjectLoadFlags::InPlace))
+				{
+					fileData = buffer;
+				}
+			}
+
+			if (dataSize >= sizeof(u64) && *reinterpret_cast<const u64*>(data) == HOBJ_COMPRESSED_FILE_MAGIC_NUMBER)
+			{
+				// The object can reference the decompressed bytes, they are not shared with anything
+				buffer = DecompressFile(data, dataSize);
+				if (buffer == nullptr)
+				{
+					HERR("The compressed file '{0}' is corrupted", absoluteSavePath.c_str());
+					return nullptr;
+				}
+				data = reinterpret_cast<const byte*>(buffer->data());
+				dataSize = buffer->size();
+				fileData = buffer;
 			}
-			inFile.close();
-			FBufferReader reader{ reinterpret_cast<byte*>(buffer.data()) };
-			HObjPtr<T> object = HObjectUtil::Create<T>(HObjectCreateFlags::InitForLoad); // TODO: Allocate to HObject pool instead
+
+			FBufferReader reader{ data, dataSize, fileData != nullptr };
+			HObjPtr<T> object = HObjectUtil::Create<T>(HObjectCreateFlags::InitForLoad);
 
 			u64 magicNumber = reader.Read<u64>();
 			if (magicNumber != HOBJ_FILE_MAGIC_NUMBER)
@@ -126,13 +184,109 @@ namespace hdn
 				HFATAL("Invalid deserialization instruction: trying to interpret and object of type '{0}' with an object of type '{1}'!", serializedTypeHash, typeHash);
 				return nullptr;
 			}
+			// Set before deserializing, the object may reference the file bytes from there on
+			object->SetFileData(fileData);
 			object->Deserialize(reader, flags);
+			if (reader.IsTruncated())
+			{
+				HERR("The file '{0}' is truncated, could not load the object", absoluteSavePath.c_str());
+				delete object;
+				return nullptr;
+			}
 			object->SetPath(absoluteSavePath);
 			object->SetLoadState(HObjectLoadState::Realized);
+			return object;
+		}
+	private:
+		static void CompressFile(const byte* data, u64 size, FBufferWriter& archive)
+		{
+			const u64 blockCount = (size + HOBJ_COMPRESSION_BLOCK_SIZE - 1) / HOBJ_COMPRESSION_BLOCK_SIZE;
+			vector<u64> blockEnds(blockCount);
+			std::vector<byte> blocks(size);
+			u64 storedSize = 0;
+			for (u64 blockIndex = 0; blockIndex < blockCount; blockIndex++)
+			{
+				const u64 blockStart = blockIndex * HOBJ_COMPRESSION_BLOCK_SIZE;
+				const u64 blockSize = std::min(HOBJ_COMPRESSION_BLOCK_SIZE, size - blockStart);
+				storedSize += PackBlock(data + blockStart, blockSize, blocks.data() + storedSize);
+				blockEnds[blockIndex] = storedSize;
+			}
 
-			HObjectRegistry::Get().Register(object->GetKey(), object);
+			// The type hash stays readable without decompressing the file
+			bin::Write(archive, HOBJ_COMPRESSED_FILE_MAGIC_NUMBER);
+			bin::Write(archive, size >= 2 * sizeof(u64) ? reinterpret_cast<const hash64_t*>(data)[1] : hash64_t{ 0 });
+			bin::Write(archive, size);
+			bin::Write(archive, blockCount);
+			archive.Write(blockEnds.data(), blockCount);
+			archive.Write(blocks.data(), storedSize);
+		}
 
-			return object;
+		static Ref<std::vector<char>> DecompressFile(const byte* data, u64 size)
+		{
+			FBufferReader reader{ data, size };
+			reader.Advance<u64>(); // Magic number
+			reader.Advance<hash64_t>();
+			const u64 rawSize = reader.Read<u64>();
+			const u64 blockCount = reader.Read<u64>();
+			// The sizes come from the file, they are validated before anything is allocated (like ZoneDeserializer::ValidatePayloadBlocks)
+			// The block count matches the raw size, so rawSize <= blockCount * HOBJ_COMPRESSION_BLOCK_SIZE
+			if (reader.IsTruncated() || blockCount != rawSize / HOBJ_COMPRESSION_BLOCK_SIZE + (rawSize % HOBJ_COMPRESSION_BLOCK_SIZE != 0))
+			{
+				return nullptr;
+			}
+			const u64* blockEnds = reader.Read<u64>(blockCount);
+			if (blockEnds == nullptr)
+			{
+				return nullptr;
+			}
+			// Every block is stored in at most its uncompressed size, see PackBlock()
+			u64 storedSize = 0;
+			for (u64 blockIndex = 0; blockIndex < blockCount; blockIndex++)
+			{
+				const u64 rawBlockSize = std::min(HOBJ_COMPRESSION_BLOCK_SIZE, rawSize - blockIndex * HOBJ_COMPRESSION_BLOCK_SIZE);
+				if (blockEnds[blockIndex] < storedSize || blockEnds[blockIndex] - storedSize > rawBlockSize)
+				{
+					return nullptr;
+				}
+				storedSize = blockEnds[blockIndex];
+			}
+			if (storedSize > reader.Remaining())
+			{
+				return nullptr;
+			}
+			const byte* blocks = reader.Read<byte>(storedSize);
+
+			Ref<std::vector<char>> buffer = CreateRef<std::vector<char>>(rawSize);
+			byte* destination = reinterpret_cast<byte*>(buffer->data());
+			for (u64 blockIndex = 0; blockIndex < blockCount; blockIndex++)
+			{
+				const u64 blockStart = blockIndex == 0 ? 0 : blockEnds[blockIndex - 1];
+				const u64 rawStart = blockIndex * HOBJ_COMPRESSION_BLOCK_SIZE;
+				const u64 rawBlockSize = std::min(HOBJ_COMPRESSION_BLOCK_SIZE, rawSize - rawStart);
+				if (!UnpackBlock(blocks + blockStart, blockEnds[blockIndex] - blockStart, destination + rawStart, rawBlockSize))
+				{
+					return nullptr;
+				}
+			}
+			return buffer;
+		}
+
+		template<typename T>
+		static HObjPtr<T> LoadFromPath(const char* path, HObjectLoadFlags flags = HObjectLoadFlags::Default)
+		{
+			HObjPtr<T> object = LoadDetached<T>(path, flags);
+			if (object == nullptr)
+			{
+				return nullptr;
+			}
+
+			HObjPtr<HObject> registeredObject = HObjectRegistry::Get().Register(object->GetKey(), object);
+			if (registeredObject != object)
+			{
+				// Loaded concurrently outside of HObjectRegistry::GetOrLoad(), keep the object that was registered first
+				delete object;
+			}
+			return static_cast<T*>(registeredObject);
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "block_compression.h"
+
+#include <cstring>
+
+namespace hdn
+{
+	static constexpr u64 MIN_MATCH = 4;
+	static constexpr u64 LAST_LITERALS = 5; // A block always ends with literals
+	static constexpr u64 MATCH_FIND_LIMIT = 12; // No match starts in the last bytes of a block
+	static constexpr u64 MAX_OFFSET = 65535;
+	static constexpr u32 HASH_LOG = 12;
+	static constexpr u64 RUN_MASK = 15; // Lengths of a token nibble, longer ones continue in extra bytes
+	static constexpr u64 WILD_COPY = 16;
+
+	static inline u32 Read32(const u8* p)
+	{
+		u32 value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	static inline u32 HashSequence(u32 sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HASH_LOG);
+	}
+
+	// Copies length bytes rounded up to WILD_COPY, source and destination must be at least WILD_COPY bytes apart
+	static inline void WildCopy(u8* destination, const u8* source, u64 length)
+	{
+		for (u64 i = 0; i < length; i += WILD_COPY)
+		{
+			memcpy(destination + i, source + i, WILD_COPY);
+		}
+	}
+
+	static inline u8* WriteLength(u8* op, u64 length)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			*op++ = 255;
+		}
+		*op++ = static_cast<u8>(length);
+		return op;
+	}
+
+	static inline bool ReadLength(const u8*& ip, const u8* iend, u64& length)
+	{
+		u8 s;
+		do
+		{
+			if (ip >= iend)
+			{
+				return false;
+			}
+			s = *ip++;
+			length += s;
+		} while (s == 255);
+		return true;
+	}
+
+	u64 CompressBlockBound(u64 size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	u64 CompressBlock(const byte* source, u64 sourceSize, byte* destination, u64 destinationCapacity)
+	{
+		const u8* src = reinterpret_cast<const u8*>(source);
+		const u8* const iend = src + sourceSize;
+		const u8* ip = src;
+		const u8* anchor = src;
+		u8* op = reinterpret_cast<u8*>(destination);
+		u8* const oend = op + destinationCapacity;
+
+		// Position of the last sequence seen for every hash, relative to src
+		u32 table[1 << HASH_LOG] = {};
+		if (sourceSize > MATCH_FIND_LIMIT)
+		{
+			const u8* const matchFindLimit = iend - MATCH_FIND_LIMIT;
+			const u8* const matchLimit = iend - LAST_LITERALS;
+			ip++;
+			while (ip < matchFindLimit)
+			{
+				const u32 sequence = Read32(ip);
+				const u32 hash = HashSequence(sequence);
+				const u8* match = src + table[hash];
+				table[hash] = static_cast<u32>(ip - src);
+				if (static_cast<u64>(ip - match) > MAX_OFFSET || Read32(match) != sequence)
+				{
+					// The longer nothing matches, the faster the data is skipped
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+
+				while (ip > anchor && match > src && ip[-1] == match[-1])
+				{
+					ip--;
+					match--;
+				}
+				const u8* matchEnd = ip + MIN_MATCH;
+				const u8* matchRef = match + MIN_MATCH;
+				while (matchEnd < matchLimit && *matchEnd == *matchRef)
+				{
+					matchEnd++;
+					matchRef++;
+				}
+
+				const u64 literalLength = ip - anchor;
+				const u64 matchLength = matchEnd - ip - MIN_MATCH;
+				if (static_cast<u64>(oend - op) < 1 + literalLength + literalLength / 255 + 1 + 2 + matchLength / 255 + 1)
+				{
+					return 0;
+				}
+
+				u8* token = op++;
+				if (literalLength >= RUN_MASK)
+				{
+					*token = static_cast<u8>(RUN_MASK << 4);
+					op = WriteLength(op, literalLength - RUN_MASK);
+				}
+				else
+				{
+					*token = static_cast<u8>(literalLength << 4);
+				}
+				memcpy(op, anchor, literalLength);
+				op += literalLength;
+
+				const u64 offset = ip - match;
+				*op++ = static_cast<u8>(offset);
+				*op++ = static_cast<u8>(offset >> 8);
+				if (matchLength >= RUN_MASK)
+				{
+					*token |= static_cast<u8>(RUN_MASK);
+					op = WriteLength(op, matchLength - RUN_MASK);
+				}
+				else
+				{
+					*token |= static_cast<u8>(matchLength);
+				}
+
+				ip = matchEnd;
+				anchor = ip;
+				// The bytes the match skipped are not hashed, this one helps the next match
+				table[HashSequence(Read32(ip - 2))] = static_cast<u32>(ip - 2 - src);
+			}
+		}
+
+		const u64 literalLength = iend - anchor;
+		if (static_cast<u64>(oend - op) < 1 + literalLength + literalLength / 255 + 1)
+		{
+			return 0;
+		}
+		if (literalLength >= RUN_MASK)
+		{
+			*op++ = static_cast<u8>(RUN_MASK << 4);
+			op = WriteLength(op, literalLength - RUN_MASK);
+		}
+		else
+		{
+			*op++ = static_cast<u8>(literalLength << 4);
+		}
+		memcpy(op, anchor, literalLength);
+		op += literalLength;
+		return op - reinterpret_cast<u8*>(destination);
+	}
+
+	bool DecompressBlock(const byte* source, u64 sourceSize, byte* destination, u64 destinationSize)
+	{
+		const u8* ip = reinterpret_cast<const u8*>(source);
+		const u8* const iend = ip + sourceSize;
+		u8* const dst = reinterpret_cast<u8*>(destination);
+		u8* op = dst;
+		u8* const oend = dst + destinationSize;
+
+		while (ip < iend)
+		{
+			const u8 token = *ip++;
+			u64 literalLength = token >> 4;
+			if (literalLength == RUN_MASK && !ReadLength(ip, iend, literalLength))
+			{
+				return false;
+			}
+			if (literalLength > static_cast<u64>(iend - ip) || literalLength > static_cast<u64>(oend - op))
+			{
+				return false;
+			}
+			// Away from the ends literals are copied by WILD_COPY chunks, the bytes written past them are overwritten next
+			if (static_cast<u64>(iend - ip) >= literalLength + WILD_COPY && static_cast<u64>(oend - op) >= literalLength + WILD_COPY)
+			{
+				WildCopy(op, ip, literalLength);
+			}
+			else
+			{
+				memcpy(op, ip, literalLength);
+			}
+			op += literalLength;
+			ip += literalLength;
+			if (ip == iend)
+			{
+				// The last sequence has no match
+				break;
+			}
+
+			if (iend - ip < 2)
+			{
+				return false;
+			}
+			const u64 offset = ip[0] | (static_cast<u64>(ip[1]) << 8);
+			ip += 2;
+			u64 matchLength = token & RUN_MASK;
+			if (matchLength == RUN_MASK && !ReadLength(ip, iend, matchLength))
+			{
+				return false;
+			}
+			matchLength += MIN_MATCH;
+			if (offset == 0 || offset > static_cast<u64>(op - dst) || matchLength > static_cast<u64>(oend - op))
+			{
+				return false;
+			}
+
+			const u8* match = op - offset;
+			if (offset >= WILD_COPY && static_cast<u64>(oend - op) >= matchLength + WILD_COPY)
+			{
+				WildCopy(op, match, matchLength);
+			}
+			else if (offset >= matchLength)
+			{
+				memcpy(op, match, matchLength);
+			}
+			else
+			{
+				// Overlapping match, repeats the last offset bytes
+				for (u64 i = 0; i < matchLength; i++)
+				{
+					op[i] = match[i];
+				}
+			}
+			op += matchLength;
+		}
+		return op == oend;
+	}
+
+	u64 PackBlock(const byte* source, u64 sourceSize, byte* destination)
+	{
+		const u64 compressedSize = sourceSize > 0 ? CompressBlock(source, sourceSize, destination, sourceSize - 1) : 0;
+		if (compressedSize != 0)
+		{
+			return compressedSize;
+		}
+		memcpy(destination, source, sourceSize);
+		return sourceSize;
+	}
+
+	bool UnpackBlock(const byte* source, u64 storedSize, byte* destination, u64 destinationSize)
+	{
+		if (storedSize == destinationSize)
+		{
+			memcpy(destination, source, storedSize);
+			return true;
+		}
+		return storedSize < destinationSize && DecompressBlock(source, storedSize, destination, destinationSize);
+	}
+}
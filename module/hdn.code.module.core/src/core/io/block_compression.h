@@ -0,0 +1,26 @@
+#pragma once
+
+#include "core/core.h"
+
+namespace hdn
+{
+	// Byte oriented LZ77 codec (LZ4 like sequences: token, literals, 16 bits match offset) for blocks compressed and
+	// decompressed independently, which keeps random access and lets the blocks of a buffer be decompressed in parallel
+	// Favors decompression speed over ratio, meant for data read at load time
+
+	// Largest compressed size of a block of size bytes (incompressible data grows slightly)
+	u64 CompressBlockBound(u64 size);
+
+	// Returns the compressed size, 0 if the result does not fit in destinationCapacity
+	// PackBlock() stores the block as is instead when it returns 0
+	u64 CompressBlock(const byte* source, u64 sourceSize, byte* destination, u64 destinationCapacity);
+
+	// destinationSize is the exact size of the uncompressed block, returns false on corrupted input
+	bool DecompressBlock(const byte* source, u64 sourceSize, byte* destination, u64 destinationSize);
+
+	// Compresses the block, or copies it as is when it does not shrink: destination must hold sourceSize bytes
+	// Returns the stored size, equal to sourceSize for a block stored as is
+	u64 PackBlock(const byte* source, u64 sourceSize, byte* destination);
+	// Reverts PackBlock(), destinationSize is the size of the block before PackBlock()
+	bool UnpackBlock(const byte* source, u64 storedSize, byte* destination, u64 destinationSize);
+}
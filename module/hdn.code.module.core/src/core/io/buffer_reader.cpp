@@ -6,6 +6,27 @@ namespace hdn
 	{
 		m_BufferBase = buffer;
 		m_CurrentPtr = m_BufferBase;
+		m_BufferEnd = reinterpret_cast<const byte*>(UINTPTR_MAX);
+	}
+
+	FBufferReader::FBufferReader(const byte* buffer, u64 size, bool persistent)
+	{
+		m_BufferBase = buffer;
+		m_CurrentPtr = m_BufferBase;
+		m_BufferEnd = m_BufferBase + size;
+		m_Persistent = persistent;
+	}
+
+	bool FBufferReader::Truncate(u64 size)
+	{
+		// Report the first truncation only, the following reads fail because of it
+		if (!m_Truncated)
+		{
+			HERR("FBufferReader truncated: reading {0} bytes at offset {1} but only {2} bytes remain", size, BytesRead(), Remaining());
+			m_Truncated = true;
+		}
+		m_CurrentPtr = m_BufferEnd;
+		return false;
 	}
 
 	namespace bin
@@ -13,9 +34,13 @@ namespace hdn
 		void Read(FBufferReader& reader, string& object)
 		{
 			size_t length = reader.Read<size_t>();
-			object.reserve(length);
-
 			const char* str = reader.Read<char>(length);
+			if (str == nullptr)
+			{
+				return;
+			}
+
+			object.reserve(length);
 			object.append(str, length);
 		}
 	}
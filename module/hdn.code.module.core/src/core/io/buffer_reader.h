@@ -3,18 +3,31 @@
 #include "core/core.h"
 #include "common.h"
 
+#include <cstdint>
+
 namespace hdn
 {
+	// Reads from a caller provided buffer
+	// With a size every read is bounds-checked: a read past the end marks the reader truncated, returns zeroed values
+	// (nullptr for arrays) and moves the read pointer to the end, check IsTruncated() once the object is read
 	class FBufferReader
 	{
 	public:
+		// Reading past the end of a buffer without size is not detected, prefer giving the size
 		FBufferReader(const byte* buffer);
+		// persistent: the buffer outlives the objects deserialized from it (e.g. a mapped file they keep alive),
+		// they can then reference its bytes instead of copying them
+		FBufferReader(const byte* buffer, u64 size, bool persistent = false);
 
 		// Same as read but does not increment the read pointer
 		template<typename T>
 		inline T Look()
 		{
 			const auto size = sizeof(T);
+			if (!CanRead(size))
+			{
+				return T{};
+			}
 			const T* out = reinterpret_cast<const T*>(m_CurrentPtr);
 			return *out;
 		}
@@ -22,26 +35,31 @@ namespace hdn
 		template<typename T>
 		inline void Read(T* out)
 		{
-			const auto size = sizeof(T);
-			*out = *reinterpret_cast<const T*>(m_CurrentPtr);
-			m_CurrentPtr += size;
+			*out = Read<T>();
 		}
 
 		template<typename T>
 		inline T Read()
 		{
 			const auto size = sizeof(T);
+			if (!Require(size))
+			{
+				return T{};
+			}
 			const T* out = reinterpret_cast<const T*>(m_CurrentPtr);
 			m_CurrentPtr += size;
 			return *out;
 		}
 
 		template<typename T>
-		inline const T* Read(size_t count)
+		inline const T* Read(u64 count)
 		{
-			const auto size = sizeof(T) * count;
+			if (!RequireCount<T>(count))
+			{
+				return nullptr;
+			}
 			const T* out = reinterpret_cast<const T*>(m_CurrentPtr);
-			m_CurrentPtr += size;
+			m_CurrentPtr += sizeof(T) * count;
 			return out;
 		}
 
@@ -55,15 +73,23 @@ namespace hdn
 		template<typename T>
 		inline void Advance()
 		{
-			const auto size = sizeof(T);
-			m_CurrentPtr += size;
+			Advance<T>(1);
 		}
 
 		template<typename T>
-		inline void Advance(u32 count)
+		inline void Advance(u64 count)
 		{
-			const auto size = sizeof(T) * count;
-			m_CurrentPtr += size;
+			if (!RequireCount<T>(count))
+			{
+				return;
+			}
+			m_CurrentPtr += sizeof(T) * count;
+		}
+
+		// Skips the padding written by FBufferWriter::Align()
+		inline void Align(u64 alignment)
+		{
+			Advance<byte>(AlignUp(BytesRead(), alignment) - BytesRead());
 		}
 
 		template<typename T>
@@ -83,10 +109,58 @@ namespace hdn
 			return m_BufferBase != nullptr;
 		}
 
+		inline bool IsPersistent() const
+		{
+			return m_Persistent;
+		}
+
+		inline u64 BytesRead() const
+		{
+			return m_CurrentPtr - m_BufferBase;
+		}
+
+		inline u64 Remaining() const
+		{
+			return static_cast<u64>(reinterpret_cast<uintptr_t>(m_BufferEnd) - reinterpret_cast<uintptr_t>(m_CurrentPtr));
+		}
+
+		inline bool CanRead(u64 size) const
+		{
+			return size <= Remaining();
+		}
+
+		// A read went past the end of the buffer, the object read from it is incomplete
+		inline bool IsTruncated() const
+		{
+			return m_Truncated;
+		}
+
 		~FBufferReader() = default;
+	private:
+		inline bool Require(u64 size)
+		{
+			return CanRead(size) || Truncate(size);
+		}
+
+		// count comes from the buffer, a corrupted one must not overflow the size in bytes and pass the check
+		template<typename T>
+		inline bool RequireCount(u64 count)
+		{
+			if (count <= Remaining() / sizeof(T))
+			{
+				return true;
+			}
+			return Truncate(count <= UINT64_MAX / sizeof(T) ? sizeof(T) * count : UINT64_MAX);
+		}
+
+		// Always returns false
+		bool Truncate(u64 size);
 	private:
 		const byte* m_BufferBase = nullptr;
 		const byte* m_CurrentPtr = nullptr;
+		const byte* m_BufferEnd = nullptr;
+		bool m_Persistent = false;
+		bool m_Truncated = false;
 	};
 
 	namespace bin
@@ -99,4 +173,4 @@ namespace hdn
 
 		void Read(FBufferReader& reader, string& object);
 	}
-}
\ No newline at end of file
+}
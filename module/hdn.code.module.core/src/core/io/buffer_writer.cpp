@@ -2,6 +2,16 @@
 
 namespace hdn
 {
+	bool FBufferWriter::Grow(u64 size)
+	{
+		// A fixed buffer cannot grow, report the first overflow only
+		if (!m_Overflowed)
+		{
+			HERR("FBufferWriter overflow: {0} bytes do not fit in the {1} remaining bytes (capacity {2})", size, Remaining(), Capacity());
+			m_Overflowed = true;
+		}
+		return false;
+	}
 
 	namespace bin
 	{
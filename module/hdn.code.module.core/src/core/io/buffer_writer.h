@@ -3,48 +3,97 @@
 #include "core/core.h"
 #include "common.h"
 
+#include <cstdint>
+
 namespace hdn
 {
-
+	// Writes to a caller provided buffer
+	// With a capacity every write is bounds-checked: a write that does not fit calls Grow(), which reports the overflow
+	// and drops the write unless a derived writer can grow its buffer (see FGrowableBufferWriter)
+	// Hot loops can Reserve() the bytes they need once and then use the unchecked writes
 	class FBufferWriter
 	{
 	public:
+		static constexpr u64 UNBOUNDED_CAPACITY = UINT64_MAX;
+
+		// Writing past the end of a buffer without capacity is not detected, prefer giving the capacity
 		FBufferWriter(byte* buffer)
-			: m_BufferBase{ buffer }, m_CurrentPtr{ buffer }
+			: m_BufferBase{ buffer }, m_CurrentPtr{ buffer }, m_BufferEnd{ UnboundedEnd() }
 		{
 		}
 
+		FBufferWriter(byte* buffer, u64 capacity)
+		{
+			SetBase(buffer, capacity);
+		}
+
 		FBufferWriter()
 		{
-			SetBase(nullptr);
+			SetBase(nullptr, 0);
 		}
 	public:
-		void SetBase(byte* buffer)
+		void SetBase(byte* buffer, u64 capacity = UNBOUNDED_CAPACITY)
 		{
 			m_BufferBase = buffer;
 			m_CurrentPtr = m_BufferBase;
+			m_BufferEnd = capacity == UNBOUNDED_CAPACITY ? UnboundedEnd() : m_BufferBase + capacity;
+			m_Overflowed = false;
+		}
+
+		// Makes sure the next size bytes fit, returns false if they do not and the buffer cannot grow
+		inline bool Reserve(u64 size)
+		{
+			return size <= Remaining() || Grow(size);
 		}
 
 		inline void Copy(const FBufferWriter& writer)
 		{
 			const auto size = writer.BytesWritten();
+			if (!Reserve(size))
+			{
+				return;
+			}
 			memcpy(m_CurrentPtr, writer.m_BufferBase, size);
 			m_CurrentPtr += size;
 		}
 
 		template<typename T>
 		inline void Write(const T& value)
+		{
+			if (!Reserve(sizeof(T)))
+			{
+				return;
+			}
+			WriteUnchecked(value);
+		}
+
+		// The returned pointer is invalidated if the buffer grows, returns nullptr on overflow
+		template<typename T>
+		inline T* Write(T* values, size_t count)
+		{
+			if (!Reserve(sizeof(T) * count))
+			{
+				return nullptr;
+			}
+			return WriteUnchecked(values, count);
+		}
+
+		// Only checked in dev builds, the bytes must have been reserved
+		template<typename T>
+		inline void WriteUnchecked(const T& value)
 		{
 			const auto size = sizeof(T);
+			HASSERT(size <= Remaining(), "FBufferWriter: unchecked write of {0} bytes past the reserved capacity", size);
 			memcpy(m_CurrentPtr, &value, size);
 			m_CurrentPtr += size;
 		}
 
 		template<typename T>
-		inline T* Write(T* values, size_t count)
+		inline T* WriteUnchecked(T* values, size_t count)
 		{
 			T* base = end<T>();
 			const auto size = sizeof(T) * count;
+			HASSERT(size <= Remaining(), "FBufferWriter: unchecked write of {0} bytes past the reserved capacity", size);
 			memcpy(m_CurrentPtr, values, size);
 			m_CurrentPtr += size;
 			return base;
@@ -53,17 +102,32 @@ namespace hdn
 		template<typename T>
 		inline void Advance()
 		{
-			const auto size = sizeof(T);
-			m_CurrentPtr += size;
+			Advance<T>(1);
 		}
 
 		template<typename T>
-		inline void Advance(u32 count)
+		inline void Advance(u64 count)
 		{
 			const auto size = sizeof(T) * count;
+			if (!Reserve(size))
+			{
+				return;
+			}
 			m_CurrentPtr += size;
 		}
 
+		// Pads with zeros until the write offset (from the start of the buffer) is a multiple of alignment
+		inline void Align(u64 alignment)
+		{
+			const u64 padding = AlignUp(BytesWritten(), alignment) - BytesWritten();
+			if (!Reserve(padding))
+			{
+				return;
+			}
+			memset(m_CurrentPtr, 0, padding);
+			m_CurrentPtr += padding;
+		}
+
 		template<typename T>
 		inline T* end()
 		{
@@ -76,6 +140,12 @@ namespace hdn
 			return reinterpret_cast<T*>(m_BufferBase);
 		}
 
+		template<typename T>
+		inline const T* begin() const
+		{
+			return reinterpret_cast<const T*>(m_BufferBase);
+		}
+
 		inline u64 BytesWritten(const byte* startOffset = nullptr) const
 		{
 			if (startOffset == nullptr)
@@ -85,15 +155,41 @@ namespace hdn
 			return m_CurrentPtr - startOffset;
 		}
 
+		inline u64 Capacity() const
+		{
+			return m_BufferEnd == UnboundedEnd() ? UNBOUNDED_CAPACITY : static_cast<u64>(m_BufferEnd - m_BufferBase);
+		}
+
+		inline u64 Remaining() const
+		{
+			return static_cast<u64>(reinterpret_cast<uintptr_t>(m_BufferEnd) - reinterpret_cast<uintptr_t>(m_CurrentPtr));
+		}
+
+		// A write did not fit and was dropped, the buffer content is incomplete
+		inline bool IsOverflowed() const
+		{
+			return m_Overflowed;
+		}
+
 		inline bool ValidBase()
 		{
 			return m_BufferBase != nullptr;
 		}
 
 		virtual ~FBufferWriter() = default;
+	protected:
+		// Called when size bytes do not fit in the remaining capacity, returns true if they fit after growing
+		virtual bool Grow(u64 size);
+
+		static byte* UnboundedEnd()
+		{
+			return reinterpret_cast<byte*>(UINTPTR_MAX);
+		}
 	protected:
 		byte* m_BufferBase = nullptr;
 		byte* m_CurrentPtr = nullptr;
+		byte* m_BufferEnd = nullptr;
+		bool m_Overflowed = false;
 	};
 
 	namespace bin
@@ -107,4 +203,4 @@ namespace hdn
 		void Write(FBufferWriter& writer, const char& object);
 		void Write(FBufferWriter& writer, const string& object);
 	}
-}
\ No newline at end of file
+}
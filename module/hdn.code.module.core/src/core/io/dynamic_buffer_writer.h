@@ -5,67 +5,79 @@
 #include "core/io/common.h"
 #include "core/io/buffer_writer.h"
 
+#include <algorithm>
+
 namespace hdn
 {
-	class FDynamicBufferWriter
+	// FBufferWriter writing straight into a vector it grows on demand (doubling), the bin::Write functions of
+	// FBufferWriter apply as is and Write(values, count) copies a whole array at once
+	// Pointers into the buffer (begin(), end(), Write() results) are invalidated when it grows
+	class FDynamicBufferWriter : public FBufferWriter
 	{
 	public:
-		FDynamicBufferWriter(u64 tempBufferSize, u64 reservedSize = 16)
-			: m_TempBufferSize{ tempBufferSize }
+		FDynamicBufferWriter(u64 reservedSize = 1 * KB)
 		{
-			m_Vector.reserve(reservedSize);
-			m_TempBuffer = new byte[m_TempBufferSize];
+			m_Vector.resize(std::max<u64>(reservedSize, 1));
+			SetBase(m_Vector.data(), m_Vector.size());
 		}
 
-		template<typename T>
-		inline void Write(const T& value)
+		FDynamicBufferWriter(const FDynamicBufferWriter&) = delete;
+		FDynamicBufferWriter& operator=(const FDynamicBufferWriter&) = delete;
+
+		FDynamicBufferWriter(FDynamicBufferWriter&& other) noexcept
 		{
-			FBufferWriter writer(m_TempBuffer);
-			bin::Write(writer, value);
-			m_Vector.insert(m_Vector.end(), writer.begin<byte>(), writer.end<byte>());
+			*this = std::move(other);
 		}
 
-		template<typename T>
-		inline T* Write(T* values, size_t count)
+		FDynamicBufferWriter& operator=(FDynamicBufferWriter&& other) noexcept
 		{
-			FBufferWriter writer(m_TempBuffer);
-			writer.Write<T>(values, count);
-			m_Vector.insert(m_Vector.end(), writer.begin<byte>(), writer.end<byte>());
+			// The vector keeps its storage when moved, the pointers stay valid
+			m_BufferBase = other.m_BufferBase;
+			m_CurrentPtr = other.m_CurrentPtr;
+			m_BufferEnd = other.m_BufferEnd;
+			m_Overflowed = other.m_Overflowed;
+			m_Vector = std::move(other.m_Vector);
+			other.m_Vector.clear();
+			other.SetBase(nullptr, 0);
+			return *this;
 		}
 
-		template<typename T>
-		inline T* end()
+		// Keeps the storage, only rewinds the write pointer
+		void Reset()
 		{
-			return m_Vector.data() + m_Vector.size();
+			m_CurrentPtr = m_BufferBase;
+			m_Overflowed = false;
 		}
 
-		template<typename T>
-		inline T* begin()
+		// Drops the bytes written after the first size ones, the storage is kept
+		void Truncate(u64 size)
 		{
-			return m_Vector.data();
+			HASSERT(size <= BytesWritten(), "FDynamicBufferWriter: cannot truncate {0} bytes to {1}", BytesWritten(), size);
+			m_CurrentPtr = m_BufferBase + size;
 		}
 
-		void Reset()
+		// Hands over the written bytes without copying them, the writer is empty afterwards
+		vector<byte> Detach()
 		{
-			m_Vector.clear();
+			m_Vector.resize(BytesWritten());
+			vector<byte> buffer = std::move(m_Vector);
+			m_Vector = vector<byte>();
+			SetBase(nullptr, 0);
+			return buffer;
 		}
 
-		~FDynamicBufferWriter()
+		virtual ~FDynamicBufferWriter() = default;
+	protected:
+		bool Grow(u64 size) override
 		{
-			delete[] m_TempBuffer;
+			const u64 bytesWritten = BytesWritten();
+			m_Vector.resize(std::max<u64>(m_Vector.size() * 2, bytesWritten + size));
+			m_BufferBase = m_Vector.data();
+			m_CurrentPtr = m_BufferBase + bytesWritten;
+			m_BufferEnd = m_BufferBase + m_Vector.size();
+			return true;
 		}
 	private:
 		vector<byte> m_Vector;
-		byte* m_TempBuffer;
-		u64 m_TempBufferSize;
 	};
-
-	namespace bin
-	{
-		template<typename T>
-		inline void Write(FDynamicBufferWriter& writer, const T& object)
-		{
-			writer.Write(object);
-		}
-	}
-}
\ No newline at end of file
+}
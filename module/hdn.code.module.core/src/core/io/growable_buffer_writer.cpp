@@ -0,0 +1,61 @@
+#include "growable_buffer_writer.h"
+
+#include <algorithm>
+
+namespace hdn
+{
+	FGrowableBufferWriter::FGrowableBufferWriter(u64 initialCapacity, LinearAllocator* arena)
+		: m_Arena{ arena }
+	{
+		HASSERT(initialCapacity > 0, "FGrowableBufferWriter needs a non null initial capacity");
+		byte* buffer = Allocate(initialCapacity);
+		SetBase(buffer, buffer != nullptr ? initialCapacity : 0);
+	}
+
+	FGrowableBufferWriter::~FGrowableBufferWriter()
+	{
+		Free(m_BufferBase);
+	}
+
+	bool FGrowableBufferWriter::Grow(u64 size)
+	{
+		const u64 bytesWritten = BytesWritten();
+		const u64 capacity = std::max<u64>(Capacity() * 2, bytesWritten + size);
+
+		byte* buffer = Allocate(capacity);
+		if (buffer == nullptr)
+		{
+			return FBufferWriter::Grow(size);
+		}
+		memcpy(buffer, m_BufferBase, bytesWritten);
+		Free(m_BufferBase);
+
+		m_BufferBase = buffer;
+		m_CurrentPtr = buffer + bytesWritten;
+		m_BufferEnd = buffer + capacity;
+		return true;
+	}
+
+	byte* FGrowableBufferWriter::Allocate(u64 capacity)
+	{
+		if (m_Arena == nullptr)
+		{
+			return new byte[capacity];
+		}
+		if (m_Arena->GetUsedMemory() + capacity > m_Arena->GetTotalSize())
+		{
+			HERR("FGrowableBufferWriter: the arena cannot fit a buffer of {0} bytes ({1} / {2} bytes used)", capacity, m_Arena->GetUsedMemory(), m_Arena->GetTotalSize());
+			return nullptr;
+		}
+		return static_cast<byte*>(m_Arena->Allocate(capacity));
+	}
+
+	void FGrowableBufferWriter::Free(byte* buffer)
+	{
+		// Arena buffers are released with the arena
+		if (m_Arena == nullptr)
+		{
+			delete[] buffer;
+		}
+	}
+}
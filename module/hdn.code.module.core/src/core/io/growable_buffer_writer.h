@@ -0,0 +1,35 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/allocator/linear_allocator.h"
+#include "buffer_writer.h"
+
+namespace hdn
+{
+	// FBufferWriter owning its buffer, the buffer doubles when a write does not fit so the content stays contiguous
+	// With an arena the buffers are allocated from it and released with it: the outgrown buffers are not reused,
+	// give an initial capacity close to the expected size
+	class FGrowableBufferWriter : public FBufferWriter
+	{
+	public:
+		FGrowableBufferWriter(u64 initialCapacity = 1 * KB, LinearAllocator* arena = nullptr);
+		FGrowableBufferWriter(const FGrowableBufferWriter&) = delete;
+		FGrowableBufferWriter& operator=(const FGrowableBufferWriter&) = delete;
+
+		// Keeps the buffer, only rewinds the write pointer
+		void Reset()
+		{
+			m_CurrentPtr = m_BufferBase;
+			m_Overflowed = false;
+		}
+
+		virtual ~FGrowableBufferWriter();
+	protected:
+		bool Grow(u64 size) override;
+	private:
+		byte* Allocate(u64 capacity);
+		void Free(byte* buffer);
+	private:
+		LinearAllocator* m_Arena = nullptr;
+	};
+}
@@ -0,0 +1,105 @@
+#include "mapped_file.h"
+
+#if USING(HDN_PLATFORM_WINDOWS)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hdn
+{
+	bool FMappedFile::Map(const fspath& path)
+	{
+		Unmap();
+
+#if USING(HDN_PLATFORM_WINDOWS)
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			HERR("Could not open file '{0}' for mapping", path.string().c_str());
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			// Empty files cannot be mapped
+			HERR("Could not map file '{0}', the file is empty", path.string().c_str());
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+		{
+			HERR("Could not create the mapping of file '{0}' (error {1})", path.string().c_str(), GetLastError());
+			return false;
+		}
+
+		// The view keeps the mapping and the file alive, the handles are not needed anymore
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (data == nullptr)
+		{
+			HERR("Could not map a view of file '{0}' (error {1})", path.string().c_str(), GetLastError());
+			return false;
+		}
+		m_Size = static_cast<u64>(fileSize.QuadPart);
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			HERR("Could not open file '{0}' for mapping", path.string().c_str());
+			return false;
+		}
+
+		struct stat fileStats;
+		if (fstat(file, &fileStats) != 0 || fileStats.st_size == 0)
+		{
+			HERR("Could not map file '{0}', the file is empty", path.string().c_str());
+			close(file);
+			return false;
+		}
+
+		// The mapping keeps the file alive, the descriptor is not needed anymore
+		void* data = mmap(nullptr, static_cast<size_t>(fileStats.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (data == MAP_FAILED)
+		{
+			HERR("Could not map file '{0}'", path.string().c_str());
+			return false;
+		}
+		m_Size = static_cast<u64>(fileStats.st_size);
+#endif
+		m_Data = static_cast<const byte*>(data);
+		return true;
+	}
+
+	void FMappedFile::Unmap()
+	{
+		if (m_Data == nullptr)
+		{
+			return;
+		}
+
+#if USING(HDN_PLATFORM_WINDOWS)
+		UnmapViewOfFile(m_Data);
+#else
+		munmap(const_cast<byte*>(m_Data), static_cast<size_t>(m_Size));
+#endif
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+	FMappedFile::~FMappedFile()
+	{
+		Unmap();
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/core_filesystem.h"
+
+namespace hdn
+{
+	// Read-only view of a whole file mapped in the address space
+	// Pages are only read from the disk when they are first touched and can be shared with the OS file cache,
+	// the bytes stay valid until the file is unmapped (hold it through a Ref to share it with the objects referencing it)
+	class FMappedFile
+	{
+	public:
+		FMappedFile() = default;
+		FMappedFile(const FMappedFile&) = delete;
+		FMappedFile& operator=(const FMappedFile&) = delete;
+
+		bool Map(const fspath& path);
+		void Unmap();
+
+		inline const byte* Data() const { return m_Data; }
+		inline u64 Size() const { return m_Size; }
+		inline bool IsMapped() const { return m_Data != nullptr; }
+
+		~FMappedFile();
+	private:
+		const byte* m_Data = nullptr;
+		u64 m_Size = 0;
+	};
+}
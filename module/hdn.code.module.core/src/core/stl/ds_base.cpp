@@ -2,23 +2,61 @@
 
 #include "core/core_define.h"
 #include "core/core_filesystem.h"
+#include "core/allocator/general_allocator.h"
+#include "core/allocator/memory_tracker.h"
 
-#include <cstdlib>
+#include <algorithm>
 #include <new>
 
-static MemStat s_MemStat;
+#if USING(HDN_PLATFORM_WINDOWS)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fstream>
+#include <unistd.h>
+#endif
 
-void* operator new[](size_t size, const char* name, int flags, unsigned debugFlags, const char* file, int line)
+// Every global allocation goes through the GeneralAllocator, which falls back to the system heap when HDN_GENERAL_ALLOCATOR is not in use
+// With HDN_MEMORY_TRACKING, the MemoryTracker attributes it to the memory tag of the thread on the way
+static void* AllocateBlock(size_t size, size_t alignment, size_t offset = 0, const char* name = nullptr, const char* file = nullptr, int line = 0)
 {
+#if USING(HDN_MEMORY_TRACKING)
+	return hdn::MemoryTracker::Allocate(size, alignment, offset, name, file, line);
+#else
 	MAYBE_UNUSED(name);
-	MAYBE_UNUSED(flags);
-	MAYBE_UNUSED(debugFlags);
 	MAYBE_UNUSED(file);
 	MAYBE_UNUSED(line);
-	// HDEBUG("Allocating {0} bytes at {1} : {2} (name: {3}, flags: {4}, debugFlags: {5})", size, file, line, name, flags, debugFlags);
+	return hdn::GeneralAllocator::Allocate(size, alignment, offset);
+#endif
+}
+
+static void DeallocateBlock(void* block)
+{
+#if USING(HDN_MEMORY_TRACKING)
+	hdn::MemoryTracker::Deallocate(block);
+#else
+	hdn::GeneralAllocator::Deallocate(block);
+#endif
+}
+
+static void* AllocateOrThrow(size_t size, size_t alignment, size_t offset = 0, const char* name = nullptr, const char* file = nullptr, int line = 0)
+{
+	void* block = AllocateBlock(size, alignment, offset, name, file, line);
+	if (block == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return block;
+}
 
-	// Use the standard new operator for allocation
-	return ::operator new[](size);
+void* operator new[](size_t size, const char* name, int flags, unsigned debugFlags, const char* file, int line)
+{
+	MAYBE_UNUSED(flags);
+	MAYBE_UNUSED(debugFlags);
+	return AllocateOrThrow(size, hdn::GeneralAllocator::DEFAULT_ALIGNMENT, 0, name, file, line);
 }
 
 void operator delete[](void* ptr, const char* name, int flags, unsigned debugFlags, const char* file, int line) noexcept
@@ -28,32 +66,15 @@ void operator delete[](void* ptr, const char* name, int flags, unsigned debugFla
 	MAYBE_UNUSED(debugFlags);
 	MAYBE_UNUSED(file);
 	MAYBE_UNUSED(line);
-	// HDEBUG("Deallocating Memory");
-	::operator delete[](ptr);
+	DeallocateBlock(ptr);
 }
 
 void* operator new[](size_t size, size_t alignment, size_t offset, const char* name, int flags, unsigned debugFlags, const char* file, int line)
 {
-	MAYBE_UNUSED(alignment);
-	MAYBE_UNUSED(offset);
-	MAYBE_UNUSED(name);
 	MAYBE_UNUSED(flags);
 	MAYBE_UNUSED(debugFlags);
-	MAYBE_UNUSED(file);
-	MAYBE_UNUSED(line);
-	// HDEBUG("Allocating {0} bytes with alignment {1} and offset {2} at {3} : {4} (name: {5}, flags: {6} debugFlags: {7})", size, alignment, offset, file, line, name, flags, debugFlags);
-	
-	// Ensure alignment and offset are respected
-	// 	void* ptr = nullptr;
-	// 
-	// #if USING(HDN_PLATFORM_WINDOWS)
-	// 	ptr = _aligned_offset_malloc(size, alignment, offset);
-	// 	if (!ptr) throw std::bad_alloc();
-	// #else
-	// 	if (posix_memalign(&ptr, alignment, size + offset) != 0 || !ptr) throw std::bad_alloc();
-	// #endif
-
-	return new uint8_t[size];
+	// EASTL wants ptr + offset to be aligned, the containers free it with a plain delete[]
+	return AllocateOrThrow(size, std::max<size_t>(alignment, 1), offset, name, file, line);
 }
 
 void operator delete[](void* ptr, size_t alignment, size_t offset, const char* name, int flags, unsigned debugFlags, const char* file, int line) noexcept
@@ -65,31 +86,133 @@ void operator delete[](void* ptr, size_t alignment, size_t offset, const char* n
 	MAYBE_UNUSED(debugFlags);
 	MAYBE_UNUSED(file);
 	MAYBE_UNUSED(line);
-
-	// HDEBUG("Deallocating Aligned Memory");
-	
-	// #if USING(HDN_PLATFORM_WINDOWS)
-	// 	_aligned_free(ptr);
-	// #else
-	// 	std::free(ptr);
-	// #endif
-	delete[] ptr;
+	DeallocateBlock(ptr);
 }
 
 void* operator new(size_t size)
 {
-	s_MemStat.allocated += size;
-	s_MemStat.allocationCount++;
-	return std::malloc(size);
+	return AllocateOrThrow(size, hdn::GeneralAllocator::DEFAULT_ALIGNMENT);
+}
+
+void* operator new[](size_t size)
+{
+	return AllocateOrThrow(size, hdn::GeneralAllocator::DEFAULT_ALIGNMENT);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return AllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return AllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocateBlock(size, hdn::GeneralAllocator::DEFAULT_ALIGNMENT);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocateBlock(size, hdn::GeneralAllocator::DEFAULT_ALIGNMENT);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocateBlock(size, static_cast<size_t>(alignment));
 }
 
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocateBlock(size, static_cast<size_t>(alignment));
+}
+
+// The block knows its size and how it was allocated, every delete ends up in the same place
 void operator delete(void* ptr) noexcept
 {
-	s_MemStat.deallocationCount++;
-	std::free(ptr);
+	DeallocateBlock(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	DeallocateBlock(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	DeallocateBlock(ptr);
 }
 
 MemStat GetMemStat()
 {
-	return s_MemStat;
+	return hdn::GeneralAllocator::GetMemStat();
+}
+
+size_t GetResidentMemory()
+{
+#if USING(HDN_PLATFORM_WINDOWS)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0;
+	}
+	return counters.WorkingSetSize;
+#else
+	// Second field of statm: resident pages
+	std::ifstream statm("/proc/self/statm");
+	size_t totalPages = 0;
+	size_t residentPages = 0;
+	if (!(statm >> totalPages >> residentPages))
+	{
+		return 0;
+	}
+	return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
 }
@@ -5,6 +5,8 @@
 #define HDN_DEFAULT_ALLOCATOR EASTLAllocatorType
 #define HDN_DUMMY_ALLOCATOR EASTLDummyAllocatorType
 
+// Global allocations of every thread since the start, in bytes of blocks (see hdn::GeneralAllocator)
+// The breakdown per subsystem is in hdn::MemoryTracker
 struct MemStat
 {
 	size_t allocated = 0;
@@ -23,4 +25,7 @@ void operator delete[](void* ptr, size_t alignment, size_t offset, const char* n
 void* operator new(size_t size);
 void operator delete(void* ptr) noexcept;
 
-MemStat GetMemStat();
\ No newline at end of file
+MemStat GetMemStat();
+
+// Bytes of the process currently resident in physical memory (working set), mapped file pages included once touched
+size_t GetResidentMemory();
@@ -0,0 +1,486 @@
+#pragma once
+
+#include "ds_base.h"
+#include "core/core.h"
+#include "core/hkey/hkey.h"
+
+#include <EASTL/utility.h>
+#include <emmintrin.h> // SSE2, part of every x64 target
+
+#include <bit>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace hdn
+{
+	// Open addressing map keyed by an hkey, or any u64 that is already random (GenerateUUID64, type hashes), for lookup heavy tables
+	// Keys are not hashed again: the low bits of the key pick its slot and its 7 high bits are a fingerprint kept in a control
+	// byte per slot. Sequential keys spread well too, keys sharing their low bits (multiples of a large power of two) do not
+	// A lookup compares the control bytes of 16 slots at once from the slot of the key and only reads the keys whose
+	// fingerprint matches, it stops at the first group holding an empty slot
+	// Probing is linear, an erase moves the following entries of its cluster back instead of leaving a tombstone, so a table
+	// with many erases does not get slower
+	// Inserts and erases invalidate the iterators and the references to the values
+	template<typename Value, typename Allocator = HDN_DEFAULT_ALLOCATOR>
+	class hkey_map
+	{
+	public:
+		using key_type = hkey;
+		using mapped_type = Value;
+		using value_type = eastl::pair<const hkey, Value>;
+		using size_type = size_t;
+
+		static constexpr size_t GROUP_SIZE = 16;
+		static constexpr size_t MIN_CAPACITY = GROUP_SIZE;
+		// Out of 8, past it the capacity doubles
+		static constexpr size_t MAX_LOAD_FACTOR = 6;
+
+		template<bool IsConst>
+		class iterator_base
+		{
+		public:
+			using map_type = std::conditional_t<IsConst, const hkey_map, hkey_map>;
+			using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+			using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+
+			iterator_base() = default;
+			iterator_base(map_type* map, size_t index)
+				: m_Map{ map }, m_Index{ index }
+			{
+				SkipEmptySlots();
+			}
+
+			// iterator to const_iterator
+			template<bool OtherIsConst, typename = std::enable_if_t<IsConst && !OtherIsConst>>
+			iterator_base(const iterator_base<OtherIsConst>& other)
+				: m_Map{ other.m_Map }, m_Index{ other.m_Index }
+			{
+			}
+
+			reference operator*() const { return m_Map->m_Slots[m_Index]; }
+			pointer operator->() const { return &m_Map->m_Slots[m_Index]; }
+
+			iterator_base& operator++()
+			{
+				m_Index++;
+				SkipEmptySlots();
+				return *this;
+			}
+
+			iterator_base operator++(int)
+			{
+				iterator_base previous = *this;
+				++*this;
+				return previous;
+			}
+
+			bool operator==(const iterator_base& other) const { return m_Index == other.m_Index; }
+			bool operator!=(const iterator_base& other) const { return m_Index != other.m_Index; }
+		private:
+			void SkipEmptySlots()
+			{
+				while (m_Index < m_Map->m_Capacity && m_Map->m_Controls[m_Index] == EMPTY)
+				{
+					m_Index++;
+				}
+			}
+		private:
+			map_type* m_Map = nullptr;
+			size_t m_Index = 0;
+
+			template<bool> friend class iterator_base;
+			friend class hkey_map;
+		};
+
+		using iterator = iterator_base<false>;
+		using const_iterator = iterator_base<true>;
+
+		hkey_map() = default;
+
+		explicit hkey_map(size_t count)
+		{
+			reserve(count);
+		}
+
+		hkey_map(const hkey_map& other)
+			: m_Allocator{ other.m_Allocator }
+		{
+			CopyFrom(other);
+		}
+
+		hkey_map(hkey_map&& other) noexcept
+			: m_Allocator{ std::move(other.m_Allocator) }
+		{
+			Steal(other);
+		}
+
+		hkey_map& operator=(const hkey_map& other)
+		{
+			if (this != &other)
+			{
+				Release();
+				CopyFrom(other);
+			}
+			return *this;
+		}
+
+		hkey_map& operator=(hkey_map&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Release();
+				m_Allocator = std::move(other.m_Allocator);
+				Steal(other);
+			}
+			return *this;
+		}
+
+		~hkey_map()
+		{
+			Release();
+		}
+
+		iterator begin() { return iterator{ this, 0 }; }
+		iterator end() { return iterator{ this, m_Capacity }; }
+		const_iterator begin() const { return const_iterator{ this, 0 }; }
+		const_iterator end() const { return const_iterator{ this, m_Capacity }; }
+
+		size_t size() const { return m_Size; }
+		bool empty() const { return m_Size == 0; }
+		size_t capacity() const { return m_Capacity; }
+
+		// The capacity is kept
+		void clear()
+		{
+			for (size_t i = 0; i < m_Capacity; i++)
+			{
+				if (m_Controls[i] != EMPTY)
+				{
+					m_Slots[i].~value_type();
+				}
+			}
+			if (m_Capacity != 0)
+			{
+				memset(m_Controls, EMPTY, m_Capacity + GROUP_SIZE - 1);
+			}
+			m_Size = 0;
+		}
+
+		// Room for count entries without growing
+		void reserve(size_t count)
+		{
+			size_t capacity = std::bit_ceil(std::max<size_t>(count, 1));
+			while (capacity * MAX_LOAD_FACTOR / 8 < count)
+			{
+				capacity *= 2;
+			}
+			if (capacity > m_Capacity)
+			{
+				Rehash(std::max(capacity, MIN_CAPACITY));
+			}
+		}
+
+		iterator find(hkey key)
+		{
+			const size_t index = FindIndex(key);
+			return iterator{ this, index == NOT_FOUND ? m_Capacity : index };
+		}
+
+		const_iterator find(hkey key) const
+		{
+			const size_t index = FindIndex(key);
+			return const_iterator{ this, index == NOT_FOUND ? m_Capacity : index };
+		}
+
+		bool contains(hkey key) const
+		{
+			return FindIndex(key) != NOT_FOUND;
+		}
+
+		Value& at(hkey key)
+		{
+			const size_t index = FindIndex(key);
+			HASSERT(index != NOT_FOUND, "Key '{0}' is not in the map", key);
+			return m_Slots[index].second;
+		}
+
+		const Value& at(hkey key) const
+		{
+			const size_t index = FindIndex(key);
+			HASSERT(index != NOT_FOUND, "Key '{0}' is not in the map", key);
+			return m_Slots[index].second;
+		}
+
+		Value& operator[](hkey key)
+		{
+			return try_emplace(key).first->second;
+		}
+
+		// The value is only constructed if the key is not in the map yet
+		template<typename... Args>
+		eastl::pair<iterator, bool> try_emplace(hkey key, Args&&... args)
+		{
+			size_t index = FindIndexOrEmpty(key);
+			if (index < m_Capacity && m_Controls[index] != EMPTY)
+			{
+				return { iterator{ this, index }, false };
+			}
+
+			if (m_Capacity == 0 || (m_Size + 1) * 8 > m_Capacity * MAX_LOAD_FACTOR)
+			{
+				Rehash(std::max(m_Capacity * 2, MIN_CAPACITY));
+				index = FindEmptyIndex(key);
+			}
+			new (&m_Slots[index]) value_type(key, Value(std::forward<Args>(args)...));
+			SetControl(index, GetFingerprint(key));
+			m_Size++;
+			return { iterator{ this, index }, true };
+		}
+
+		eastl::pair<iterator, bool> insert(const value_type& value)
+		{
+			return try_emplace(value.first, value.second);
+		}
+
+		// Returns the amount of erased entries
+		size_t erase(hkey key)
+		{
+			const size_t index = FindIndex(key);
+			if (index == NOT_FOUND)
+			{
+				return 0;
+			}
+			EraseIndex(index);
+			return 1;
+		}
+
+		// Entries following the erased one can move back in its slot, erasing while iterating is not supported
+		void erase(const_iterator it)
+		{
+			EraseIndex(it.m_Index);
+		}
+	private:
+		static constexpr i8 EMPTY = -128; // Only control byte with the high bit set, a full slot holds a fingerprint in [0, 127]
+		static constexpr size_t NOT_FOUND = ~size_t(0);
+
+		static i8 GetFingerprint(hkey key)
+		{
+			return static_cast<i8>(key >> 57);
+		}
+
+		size_t GetHomeIndex(hkey key) const
+		{
+			return static_cast<size_t>(key) & (m_Capacity - 1);
+		}
+
+		// Bit i is set when the control byte of the slot (index + i) is the fingerprint / is empty
+		u32 MatchFingerprint(size_t index, i8 fingerprint) const
+		{
+			const __m128i controls = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_Controls + index));
+			return static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(controls, _mm_set1_epi8(fingerprint))));
+		}
+
+		u32 MatchEmpty(size_t index) const
+		{
+			const __m128i controls = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_Controls + index));
+			return static_cast<u32>(_mm_movemask_epi8(controls));
+		}
+
+		size_t FindIndex(hkey key) const
+		{
+			if (m_Size == 0)
+			{
+				return NOT_FOUND;
+			}
+
+			const size_t mask = m_Capacity - 1;
+			const i8 fingerprint = GetFingerprint(key);
+			size_t index = GetHomeIndex(key);
+			while (true)
+			{
+				for (u32 matches = MatchFingerprint(index, fingerprint); matches != 0; matches &= matches - 1)
+				{
+					const size_t slot = (index + std::countr_zero(matches)) & mask;
+					if (m_Slots[slot].first == key)
+					{
+						return slot;
+					}
+				}
+				// The cluster of the key ends at the first empty slot
+				if (MatchEmpty(index) != 0)
+				{
+					return NOT_FOUND;
+				}
+				index = (index + GROUP_SIZE) & mask;
+			}
+		}
+
+		// First empty slot from the home slot of the key, the table has at least one
+		size_t FindEmptyIndex(hkey key) const
+		{
+			size_t index = GetHomeIndex(key);
+			u32 empties = MatchEmpty(index);
+			while (empties == 0)
+			{
+				index = (index + GROUP_SIZE) & (m_Capacity - 1);
+				empties = MatchEmpty(index);
+			}
+			return (index + std::countr_zero(empties)) & (m_Capacity - 1);
+		}
+
+		// Slot of the key, or the empty slot where it would go, NOT_FOUND if the table has no slot
+		size_t FindIndexOrEmpty(hkey key) const
+		{
+			if (m_Capacity == 0)
+			{
+				return NOT_FOUND;
+			}
+
+			const size_t mask = m_Capacity - 1;
+			const i8 fingerprint = GetFingerprint(key);
+			size_t index = GetHomeIndex(key);
+			while (true)
+			{
+				for (u32 matches = MatchFingerprint(index, fingerprint); matches != 0; matches &= matches - 1)
+				{
+					const size_t slot = (index + std::countr_zero(matches)) & mask;
+					if (m_Slots[slot].first == key)
+					{
+						return slot;
+					}
+				}
+				// No empty slot in the previous groups, the first one of this group ends the cluster
+				if (const u32 empties = MatchEmpty(index))
+				{
+					return (index + std::countr_zero(empties)) & mask;
+				}
+				index = (index + GROUP_SIZE) & mask;
+			}
+		}
+
+		// The first GROUP_SIZE - 1 control bytes are copied after the last one, a group starting near the end reads them
+		// instead of wrapping around
+		void SetControl(size_t index, i8 control)
+		{
+			m_Controls[index] = control;
+			if (index < GROUP_SIZE - 1)
+			{
+				m_Controls[m_Capacity + index] = control;
+			}
+		}
+
+		void EraseIndex(size_t index)
+		{
+			HASSERT(index < m_Capacity && m_Controls[index] != EMPTY, "Erasing an empty slot of an hkey_map");
+			m_Slots[index].~value_type();
+			m_Size--;
+
+			// Backward shift: an entry of the cluster moves to the hole if the hole is between its home slot and its slot,
+			// every entry stays reachable from its home slot without tombstones
+			const size_t mask = m_Capacity - 1;
+			size_t hole = index;
+			for (size_t next = (index + 1) & mask; m_Controls[next] != EMPTY; next = (next + 1) & mask)
+			{
+				const size_t home = GetHomeIndex(m_Slots[next].first);
+				if (((next - home) & mask) >= ((next - hole) & mask))
+				{
+					new (&m_Slots[hole]) value_type(std::move(m_Slots[next]));
+					m_Slots[next].~value_type();
+					SetControl(hole, m_Controls[next]);
+					hole = next;
+				}
+			}
+			SetControl(hole, EMPTY);
+		}
+
+		void Allocate(size_t capacity)
+		{
+			// Slots first for their alignment, then the control bytes
+			const size_t slotsSize = capacity * sizeof(value_type);
+			byte* memory = static_cast<byte*>(m_Allocator.allocate(slotsSize + capacity + GROUP_SIZE - 1, std::max<size_t>(alignof(value_type), 16), 0));
+			m_Slots = reinterpret_cast<value_type*>(memory);
+			m_Controls = reinterpret_cast<i8*>(memory + slotsSize);
+			m_Capacity = capacity;
+			memset(m_Controls, EMPTY, capacity + GROUP_SIZE - 1);
+		}
+
+		void Deallocate()
+		{
+			if (m_Capacity != 0)
+			{
+				m_Allocator.deallocate(m_Slots, m_Capacity * sizeof(value_type) + m_Capacity + GROUP_SIZE - 1);
+			}
+			m_Slots = nullptr;
+			m_Controls = nullptr;
+			m_Capacity = 0;
+		}
+
+		void Rehash(size_t capacity)
+		{
+			value_type* oldSlots = m_Slots;
+			i8* oldControls = m_Controls;
+			const size_t oldCapacity = m_Capacity;
+
+			Allocate(capacity);
+			for (size_t i = 0; i < oldCapacity; i++)
+			{
+				if (oldControls[i] != EMPTY)
+				{
+					const size_t index = FindEmptyIndex(oldSlots[i].first);
+					new (&m_Slots[index]) value_type(std::move(oldSlots[i]));
+					SetControl(index, oldControls[i]);
+					oldSlots[i].~value_type();
+				}
+			}
+
+			if (oldCapacity != 0)
+			{
+				m_Allocator.deallocate(oldSlots, oldCapacity * sizeof(value_type) + oldCapacity + GROUP_SIZE - 1);
+			}
+		}
+
+		// Same capacity and same slots as other
+		void CopyFrom(const hkey_map& other)
+		{
+			if (other.m_Capacity == 0)
+			{
+				return;
+			}
+			Allocate(other.m_Capacity);
+			for (size_t i = 0; i < m_Capacity; i++)
+			{
+				if (other.m_Controls[i] != EMPTY)
+				{
+					new (&m_Slots[i]) value_type(other.m_Slots[i]);
+				}
+			}
+			memcpy(m_Controls, other.m_Controls, m_Capacity + GROUP_SIZE - 1);
+			m_Size = other.m_Size;
+		}
+
+		void Steal(hkey_map& other)
+		{
+			m_Slots = other.m_Slots;
+			m_Controls = other.m_Controls;
+			m_Capacity = other.m_Capacity;
+			m_Size = other.m_Size;
+			other.m_Slots = nullptr;
+			other.m_Controls = nullptr;
+			other.m_Capacity = 0;
+			other.m_Size = 0;
+		}
+
+		void Release()
+		{
+			clear();
+			Deallocate();
+		}
+	private:
+		value_type* m_Slots = nullptr;
+		i8* m_Controls = nullptr;
+		size_t m_Capacity = 0; // Power of two, 0 until the first insert
+		size_t m_Size = 0;
+		Allocator m_Allocator;
+	};
+}
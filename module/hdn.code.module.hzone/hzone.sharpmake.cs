@@ -26,5 +26,6 @@ public class HZoneProject : BaseCppProject
         conf.Defines.Add("_CRT_SECURE_NO_WARNINGS");
 
         conf.AddPublicDependency<CoreProject>(target);
+        conf.AddPublicDependency<AsyncProject>(target);
     }
 }
\ No newline at end of file
@@ -6,17 +6,23 @@ namespace hdn
 {
     void HZone::Deserialize(FBufferReader& archive, HObjectLoadFlags flags)
     {
+        HObject::Deserialize(archive, flags);
+
+        // Loaded with HObjectLoadFlags::MemoryMap or HObjectLoadFlags::InPlace the zone references the file bytes the object keeps alive
         ZoneDeserializer deserializer;
         deserializer.Deserialize(archive, m_Zone);
     }
 
     void HZone::Serialize(FBufferWriter& archive, HObjectSaveFlags flags)
 	{
+		// The zone itself is appended by the ZoneSerializer of the build
+		HObject::Serialize(archive, flags);
 		// ZoneSerializer serializer;
 		// serializer.Serialize(archive);
     }
 
     HZone::~HZone()
     {
+        delete[] m_Zone.memoryBase;
     }
 }
\ No newline at end of file
@@ -15,6 +15,9 @@ namespace hdn
         void Deserialize(FBufferReader& archive, HObjectLoadFlags flags = HObjectLoadFlags::Default) override;
         void Serialize(FBufferWriter& archive, HObjectSaveFlags flags = HObjectSaveFlags::Default) override;
 
+        const Zone& GetZone() const { return m_Zone; }
+        Zone& GetZone() { return m_Zone; }
+
         virtual ~HZone();
     private:
 		Zone m_Zone;
@@ -0,0 +1,312 @@
+#include "zone.h"
+#include "zone_config.h"
+
+#include "core/io/block_compression.h"
+
+#include "async/async_parallel_for.h"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+
+#if USING(HDN_PLATFORM_WINDOWS)
+#include <xmmintrin.h>
+#endif
+
+namespace hdn
+{
+	// A hint only, the address may be past the end of the array
+	static inline void PrefetchAddress(const void* address)
+	{
+#if USING(HDN_PLATFORM_WINDOWS)
+		_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+		__builtin_prefetch(address);
+#endif
+	}
+
+	// Descendants of a node three levels down, 8 keys: one cache line
+	static constexpr u64 EYTZINGER_PREFETCH_STRIDE = 64 / sizeof(hkey);
+
+	// In-order traversal of the implicit tree: fills eytzingerKeys[node] with the sorted keys
+	static u64 FillEytzinger(Zone& zone, u64 sortedIndex, u64 node)
+	{
+		if (node <= zone.keyCount)
+		{
+			sortedIndex = FillEytzinger(zone, sortedIndex, 2 * node);
+			zone.eytzingerKeys[node] = zone.sortedKeys[sortedIndex];
+			zone.eytzingerIndices[node] = sortedIndex;
+			sortedIndex = FillEytzinger(zone, sortedIndex + 1, 2 * node + 1);
+		}
+		return sortedIndex;
+	}
+
+	void Zone::InitKeyLookup()
+	{
+		eytzingerKeys.clear();
+		eytzingerIndices.clear();
+
+		// The keys are sorted and unique, they are dense if the first and last are keyCount - 1 apart
+		denseKeys = keyCount > 0 && sortedKeys[keyCount - 1] - sortedKeys[0] == keyCount - 1;
+		minKey = keyCount > 0 ? sortedKeys[0] : nullhkey;
+		if (denseKeys || keyCount == 0)
+		{
+			return;
+		}
+
+		eytzingerKeys.resize(keyCount + 1);
+		eytzingerIndices.resize(keyCount + 1);
+		FillEytzinger(*this, 0, 1);
+	}
+
+	void Zone::InitPayloadBlocks()
+	{
+		payloadBlocks = nullptr;
+		distinctEntryOffsets.clear();
+		if (payloadBlockSize == 0)
+		{
+			return;
+		}
+
+		// The decompressed payload is not touched until its blocks are, untouched pages are not committed
+		payloadBlocks = CreateRef<ZonePayloadBlocks>();
+		payloadBlocks->payload = Scope<byte[]>{ new byte[payloadSize] };
+		payloadBlocks->states = Scope<std::atomic<u8>[]>{ new std::atomic<u8>[payloadBlockCount] };
+		for (u64 blockIndex = 0; blockIndex < payloadBlockCount; blockIndex++)
+		{
+			payloadBlocks->states[blockIndex].store(ZonePayloadBlocks::Compressed, std::memory_order_relaxed);
+		}
+		dataPayload = payloadBlocks->payload.get();
+
+		// Deduplicated entries point back to earlier ones, the offsets of the following keys no longer bound an entry
+		if (std::adjacent_find(dataOffsets, dataOffsets + keyCount, std::greater_equal<u64>{}) != dataOffsets + keyCount)
+		{
+			distinctEntryOffsets.assign(dataOffsets, dataOffsets + keyCount);
+			std::sort(distinctEntryOffsets.begin(), distinctEntryOffsets.end());
+			distinctEntryOffsets.erase(std::unique(distinctEntryOffsets.begin(), distinctEntryOffsets.end()), distinctEntryOffsets.end());
+		}
+	}
+
+	u64 Zone::GetEntryEnd(u64 keyIndex) const
+	{
+		if (distinctEntryOffsets.empty())
+		{
+			return keyIndex + 1 < keyCount ? dataOffsets[keyIndex + 1] : payloadSize;
+		}
+		auto next = std::upper_bound(distinctEntryOffsets.begin(), distinctEntryOffsets.end(), dataOffsets[keyIndex]);
+		return next != distinctEntryOffsets.end() ? *next : payloadSize;
+	}
+
+	void Zone::DecompressPayload(u64 begin, u64 end) const
+	{
+		end = std::min(end, payloadSize);
+		if (payloadBlocks == nullptr || begin >= end)
+		{
+			return;
+		}
+
+		const u64 firstBlock = begin / payloadBlockSize;
+		const u64 endBlock = (end - 1) / payloadBlockSize + 1;
+		if (endBlock - firstBlock == 1)
+		{
+			DecompressPayloadBlock(firstBlock);
+			return;
+		}
+		ParallelFor(firstBlock, endBlock, 1, [this](u64 blockIndex) {
+			DecompressPayloadBlock(blockIndex);
+		});
+	}
+
+	void Zone::DecompressPayloadBlock(u64 blockIndex) const
+	{
+		std::atomic<u8>& state = payloadBlocks->states[blockIndex];
+		u8 expected = ZonePayloadBlocks::Compressed;
+		if (state.load(std::memory_order_acquire) == ZonePayloadBlocks::Decompressed)
+		{
+			return;
+		}
+		if (!state.compare_exchange_strong(expected, ZonePayloadBlocks::Decompressing, std::memory_order_acquire))
+		{
+			// Another thread is decompressing it
+			while (expected != ZonePayloadBlocks::Decompressed)
+			{
+				state.wait(expected, std::memory_order_acquire);
+				expected = state.load(std::memory_order_acquire);
+			}
+			return;
+		}
+
+		const u64 blockStart = blockIndex * payloadBlockSize;
+		const u64 storedStart = blockIndex == 0 ? 0 : payloadBlockEnds[blockIndex - 1];
+		byte* destination = payloadBlocks->payload.get() + blockStart;
+		const u64 blockSize = std::min(payloadBlockSize, payloadSize - blockStart);
+		if (!UnpackBlock(compressedPayload + storedStart, payloadBlockEnds[blockIndex] - storedStart, destination, blockSize))
+		{
+			HERR("Zone: corrupted payload block {0}", blockIndex);
+			memset(destination, 0, blockSize);
+		}
+		state.store(ZonePayloadBlocks::Decompressed, std::memory_order_release);
+		state.notify_all();
+	}
+
+	optional<u64> Zone::GetSparseKeyIndex(hkey key) const
+	{
+		// Branchless descent, node ends up past the last level and its trailing ones are the right turns taken
+		// after the lower bound, they are dropped to get back to it
+		const hkey* keys = eytzingerKeys.data();
+		u64 node = 1;
+		while (node <= keyCount)
+		{
+			PrefetchAddress(reinterpret_cast<const byte*>(keys) + node * EYTZINGER_PREFETCH_STRIDE * sizeof(hkey));
+			node = 2 * node + (keys[node] < key);
+		}
+		node >>= std::countr_one(node) + 1;
+		if (node == 0 || keys[node] != key)
+		{
+			return eastl::nullopt;
+		}
+		return eytzingerIndices[node];
+	}
+
+	void Zone::GetKeyData(span<const hkey> keys, span<const byte*> data) const
+	{
+		HASSERT(keys.size() == data.size(), "Zone::GetKeyData: {0} keys for {1} results", keys.size(), data.size());
+
+		if (denseKeys || keyCount == 0)
+		{
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				data[i] = GetKeyData(keys[i]);
+			}
+			return;
+		}
+
+		// Every search of a batch walks the same number of levels, one level at a time for the whole batch
+		constexpr size_t BATCH_SIZE = 16;
+		const hkey* eytzinger = eytzingerKeys.data();
+		const u64 levelCount = std::bit_width(keyCount);
+		u64 nodes[BATCH_SIZE];
+		for (size_t batchStart = 0; batchStart < keys.size(); batchStart += BATCH_SIZE)
+		{
+			const size_t batchSize = std::min(BATCH_SIZE, keys.size() - batchStart);
+			const hkey* batchKeys = keys.data() + batchStart;
+			for (size_t i = 0; i < batchSize; i++)
+			{
+				nodes[i] = 1;
+			}
+
+			for (u64 level = 0; level < levelCount; level++)
+			{
+				for (size_t i = 0; i < batchSize; i++)
+				{
+					if (nodes[i] <= keyCount)
+					{
+						nodes[i] = 2 * nodes[i] + (eytzinger[nodes[i]] < batchKeys[i]);
+					}
+				}
+			}
+
+			for (size_t i = 0; i < batchSize; i++)
+			{
+				const u64 node = nodes[i] >> (std::countr_one(nodes[i]) + 1);
+				const bool found = batchKeys[i] != nullhkey && node != 0 && eytzinger[node] == batchKeys[i];
+				data[batchStart + i] = found ? &dataPayload[dataOffsets[eytzingerIndices[node]]] : nullptr;
+				if (found && payloadBlocks != nullptr)
+				{
+					const u64 keyIndex = eytzingerIndices[node];
+					DecompressPayload(dataOffsets[keyIndex], GetEntryEnd(keyIndex));
+				}
+			}
+		}
+	}
+
+	optional<u64> Zone::GetTypeIndex(hash64_t typeHash) const
+	{
+		for (u64 typeIndex = 0; typeIndex < typeCount; typeIndex++)
+		{
+			if (sortedTypeHash[typeIndex] == typeHash)
+			{
+				return typeIndex;
+			}
+		}
+		return eastl::nullopt;
+	}
+
+	void Zone::GetTypeEntryRange(u64 typeIndex, u64& firstEntry, u64& endEntry) const
+	{
+		if (denseKeys)
+		{
+			firstEntry = typeIndex == 0 ? 0 : keyMaxPerType[typeIndex - 1] - minKey;
+			endEntry = keyMaxPerType[typeIndex] - minKey;
+			return;
+		}
+		firstEntry = typeIndex == 0 ? 0 : eastl::lower_bound(sortedKeys, sortedKeys + keyCount, keyMaxPerType[typeIndex - 1]) - sortedKeys;
+		endEntry = eastl::lower_bound(sortedKeys, sortedKeys + keyCount, keyMaxPerType[typeIndex]) - sortedKeys;
+	}
+
+	const byte* Zone::GetTypeEntries(hash64_t typeHash, u64 entrySize, u64& entryCount) const
+	{
+		entryCount = 0;
+		optional<u64> typeIndex = GetTypeIndex(typeHash);
+		if (typeIndex == eastl::nullopt)
+		{
+			return nullptr;
+		}
+
+		const ZoneSerializerConfig& config = ZoneSerializerConfig::Get();
+		if (config.GetSerializeFunc(typeHash) != nullptr || config.GetColumns(typeHash) != nullptr)
+		{
+			HERR("Zone::View: the entries of this type are not saved as is");
+			return nullptr;
+		}
+
+		u64 firstEntry = 0;
+		u64 endEntry = 0;
+		GetTypeEntryRange(typeIndex.value(), firstEntry, endEntry);
+		if (firstEntry == endEntry)
+		{
+			return nullptr;
+		}
+		// Entries saved as is are packed, the last one ends where the array does, unless the type was deduplicated
+		if (dataOffsets[endEntry - 1] - dataOffsets[firstEntry] != (endEntry - firstEntry - 1) * entrySize)
+		{
+			HERR("Zone::View: the entries are not {0} bytes apart, they may share their data", entrySize);
+			return nullptr;
+		}
+		entryCount = endEntry - firstEntry;
+		DecompressPayload(dataOffsets[firstEntry], dataOffsets[firstEntry] + entryCount * entrySize);
+		return &dataPayload[dataOffsets[firstEntry]];
+	}
+
+	const byte* Zone::GetColumnEntries(hash64_t typeHash, u64 columnIndex, u64 valueSize, u64& entryCount) const
+	{
+		entryCount = 0;
+		optional<u64> typeIndex = GetTypeIndex(typeHash);
+		const vector<ZoneColumn>* columns = ZoneSerializerConfig::Get().GetColumns(typeHash);
+		if (typeIndex == eastl::nullopt || columns == nullptr || columnIndex >= columns->size())
+		{
+			return nullptr;
+		}
+		if ((*columns)[columnIndex].size != valueSize)
+		{
+			HERR("Zone::Column: column {0} holds {1} byte values, not {2}", columnIndex, (*columns)[columnIndex].size, valueSize);
+			return nullptr;
+		}
+
+		u64 firstEntry = 0;
+		u64 endEntry = 0;
+		GetTypeEntryRange(typeIndex.value(), firstEntry, endEntry);
+		if (firstEntry == endEntry)
+		{
+			return nullptr;
+		}
+
+		// The first entry points to the start of the first column, which is the start of the type payload
+		vector<u64> columnOffsets;
+		ComputeColumnOffsets(*columns, endEntry - firstEntry, columnOffsets);
+		entryCount = endEntry - firstEntry;
+		const u64 columnStart = dataOffsets[firstEntry] + columnOffsets[columnIndex];
+		DecompressPayload(columnStart, columnStart + entryCount * valueSize);
+		return &dataPayload[columnStart];
+	}
+}
@@ -5,38 +5,157 @@
 #include "core/hkey/hkey.h"
 #include "core/stl/vector.h"
 #include "core/stl/optional.h"
+#include "core/stl/span.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 
 namespace hdn
 {
+	// Serialized layout, every section can be used in place as long as the buffer start is ZONE_PAYLOAD_ALIGNMENT aligned:
+	// [padding] keyCount, sortedKeys[keyCount], payloadSize, typeCount, sortedTypeHash[typeCount], keyMaxPerType[typeCount], dataOffsets[keyCount],
+	//           payloadBlockSize, payloadBlockEnds[payloadBlockCount]
+	// [padding] payload[payloadSize], the payload of every type starts on a ZONE_PAYLOAD_ALIGNMENT boundary
+	// The padding is relative to the start of the buffer, so the zone can follow a header of any size (e.g. the HObject one)
+	// A compressed payload (payloadBlockSize != 0) is cut in blocks of payloadBlockSize bytes compressed independently (see PackBlock()),
+	// the payload section then holds the blocks back to back and payloadBlockEnds the end of every one of them
+	static constexpr u64 ZONE_SECTION_ALIGNMENT = 8;
+	static constexpr u64 ZONE_PAYLOAD_ALIGNMENT = 16;
+	static constexpr u64 ZONE_DEFAULT_PAYLOAD_BLOCK_SIZE = 64 * KB;
+
+	// A field of a type stored in columns, see ZoneSerializerConfig::RegisterColumns()
+	struct ZoneColumn
+	{
+		u64 offset; // In the type
+		u64 size;
+	};
+
+#define HZONE_COLUMN(Type, Field) ::hdn::ZoneColumn{ offsetof(Type, Field), sizeof(Type::Field) }
+
+	// The payload of a columnar type is one array per column, each starting on a ZONE_PAYLOAD_ALIGNMENT boundary
+	// Fills the offset of every column in the type payload and returns the type payload size
+	inline u64 ComputeColumnOffsets(const vector<ZoneColumn>& columns, u64 entryCount, vector<u64>& columnOffsets)
+	{
+		u64 offset = 0;
+		columnOffsets.clear();
+		for (const ZoneColumn& column : columns)
+		{
+			offset = AlignUp(offset, ZONE_PAYLOAD_ALIGNMENT);
+			columnOffsets.push_back(offset);
+			offset += column.size * entryCount;
+		}
+		return offset;
+	}
+
+	// Copies the field of rowCount entries saved as is to an array
+	inline void GatherColumn(const byte* rows, u64 rowCount, u64 rowSize, const ZoneColumn& column, byte* values)
+	{
+		for (u64 i = 0; i < rowCount; i++)
+		{
+			memcpy(values + i * column.size, rows + i * rowSize + column.offset, column.size);
+		}
+	}
+
+	// Decompressed payload of a zone, filled block by block the first time a block is accessed
+	struct ZonePayloadBlocks
+	{
+		enum BlockState : u8
+		{
+			Compressed,
+			Decompressing,
+			Decompressed
+		};
+
+		Scope<byte[]> payload;
+		Scope<std::atomic<u8>[]> states; // BlockState of every block
+	};
+
 	class Zone
 	{
 	public:
-		optional<u64> GetKeyIndex(hkey key)
+		// Picks the key lookup once the sections are set, must be called again if they change
+		// Zones built by ZoneSerializer hand out keys sequentially and use the O(1) dense lookup
+		// Other zones get an Eytzinger copy of their keys, which makes their load O(keyCount)
+		void InitKeyLookup();
+
+		optional<u64> GetKeyIndex(hkey key) const
 		{
 			if (key == nullhkey)
 			{
 				return eastl::nullopt;
 			}
 
-			const hkey* keyPtr = eastl::lower_bound(sortedKeys, sortedKeys + keyCount, key);
-			if (keyPtr == sortedKeys + keyCount || *keyPtr != key)
+			if (denseKeys)
 			{
-				return eastl::nullopt;
+				// Unsigned, keys below minKey wrap around and fail the range check too
+				const u64 keyIndex = key - minKey;
+				if (keyIndex >= keyCount)
+				{
+					return eastl::nullopt;
+				}
+				return keyIndex;
 			}
-			return static_cast<u64>(keyPtr - sortedKeys);
+			return GetSparseKeyIndex(key);
 		}
 
-		const byte* GetKeyData(hkey key)
+		// Sets up the decompression of a compressed payload once the sections are set, compressedPayload holds the blocks
+		void InitPayloadBlocks();
+
+		// For a type saved in columns, the data of a key is its value in the first column
+		// With a compressed payload the blocks of the entry are decompressed on first access
+		const byte* GetKeyData(hkey key) const
 		{
 			optional<u64> keyIndex = GetKeyIndex(key);
 			if (keyIndex == eastl::nullopt)
 			{
 				return nullptr;
 			}
-			return &dataPayload[dataOffsets[keyIndex.value()]];
+			const u64 offset = dataOffsets[keyIndex.value()];
+			if (payloadBlocks != nullptr)
+			{
+				DecompressPayload(offset, GetEntryEnd(keyIndex.value()));
+			}
+			return &dataPayload[offset];
+		}
+
+		// Resolves keys[i] into data[i] (nullptr if the key is not in the zone)
+		// On sparse zones the searches of a batch are interleaved, their cache misses overlap
+		void GetKeyData(span<const hkey> keys, span<const byte*> data) const;
+
+		// Every entry of type T as an array, T must be saved as is: without serialize callback nor columns
+		template<typename T>
+		span<const T> View() const
+		{
+			static_assert(alignof(T) <= ZONE_PAYLOAD_ALIGNMENT, "The zone payload is not aligned enough for this type");
+			u64 entryCount = 0;
+			const byte* entries = GetTypeEntries(GenerateTypeHash<T>(), sizeof(T), entryCount);
+			return span<const T>{ reinterpret_cast<const T*>(entries), entryCount };
 		}
 
-		byte* memoryBase;
+		// A column of a type saved in columns: the field of every entry of type T as an array of F
+		template<typename T, typename F>
+		span<const F> Column(u64 columnIndex) const
+		{
+			static_assert(alignof(F) <= ZONE_PAYLOAD_ALIGNMENT, "The zone payload is not aligned enough for this type");
+			u64 entryCount = 0;
+			const byte* values = GetColumnEntries(GenerateTypeHash<T>(), columnIndex, sizeof(F), entryCount);
+			return span<const F>{ reinterpret_cast<const F*>(values), entryCount };
+		}
+
+		bool IsPayloadCompressed() const { return payloadBlockSize != 0; }
+		// Decompresses the blocks holding the payload bytes [begin, end) that are not yet, on the async workers when there are several
+		// Thread safe, a block being decompressed by another thread is waited for
+		void DecompressPayload(u64 begin, u64 end) const;
+		// Whole payload, for code reading dataPayload directly
+		void DecompressPayload() const { DecompressPayload(0, payloadSize); }
+
+		optional<u64> GetTypeIndex(hash64_t typeHash) const;
+
+		// Entries of a type are the keys [keyMaxPerType[typeIndex - 1], keyMaxPerType[typeIndex])
+		void GetTypeEntryRange(u64 typeIndex, u64& firstEntry, u64& endEntry) const;
+
+		byte* memoryBase = nullptr; // Owned copy of the zone, null when the zone references the persistent buffer it was read from
 
 		u64 keyCount;
 		const hkey* sortedKeys; // keyCount
@@ -47,6 +166,27 @@ namespace hdn
 		const hash64_t* sortedTypeHash; // typeCount
 		const u64* keyMaxPerType; // typeCount
 		const u64* dataOffsets; // keyCount
-		const byte* dataPayload;
+		const byte* dataPayload; // With a compressed payload, only the decompressed blocks are valid (see DecompressPayload())
+
+		// Compressed payload, see InitPayloadBlocks()
+		u64 payloadBlockSize = 0; // 0 when the payload is not compressed
+		u64 payloadBlockCount = 0;
+		const u64* payloadBlockEnds = nullptr; // payloadBlockCount
+		const byte* compressedPayload = nullptr;
+		Ref<ZonePayloadBlocks> payloadBlocks; // Shared by the copies of the zone
+		vector<u64> distinctEntryOffsets; // Sorted, only when entries of a compressed payload share their data (see GetEntryEnd())
+
+		// Key lookup, see InitKeyLookup()
+		bool denseKeys = false; // sortedKeys is minKey, minKey + 1, ..., minKey + keyCount - 1
+		hkey minKey = nullhkey;
+		vector<hkey> eytzingerKeys; // Sparse zones only, 1-based breadth first order of sortedKeys
+		vector<u64> eytzingerIndices; // Index in sortedKeys of eytzingerKeys[i]
+	private:
+		void DecompressPayloadBlock(u64 blockIndex) const;
+		// Where the payload bytes of an entry end at most: where the next entry starts
+		u64 GetEntryEnd(u64 keyIndex) const;
+		optional<u64> GetSparseKeyIndex(hkey key) const;
+		const byte* GetTypeEntries(hash64_t typeHash, u64 entrySize, u64& entryCount) const;
+		const byte* GetColumnEntries(hash64_t typeHash, u64 columnIndex, u64 valueSize, u64& entryCount) const;
 	};
 }
\ No newline at end of file
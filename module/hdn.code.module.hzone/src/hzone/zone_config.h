@@ -1,11 +1,16 @@
 #pragma once
 
 #include "core/hash.h"
-#include "core/stl/map.h"
+#include "core/stl/hkey_map.h"
 #include "core/stl/multimap.h"
 #include "core/stl/vector.h"
+#include "core/stl/unordered_set.h"
 #include "core/io/dynamic_buffer_writer.h"
 
+#include "zone.h"
+
+#include <initializer_list>
+
 namespace hdn
 {
 	class ZoneSerializerConfig
@@ -24,8 +29,20 @@ namespace hdn
 			return m_SerializeDataFuncs.contains(typeHash);
 		}
 
+		// nullptr if the type has no serialize callback
+		ZoneSerializeDataFunc GetSerializeFunc(hash64_t typeHash) const
+		{
+			auto it = m_SerializeDataFuncs.find(typeHash);
+			return it != m_SerializeDataFuncs.end() ? it->second : nullptr;
+		}
+
 		void RegisterSerializeFunc(hash64_t typeHash, u64 typeSize, const ZoneSerializeDataFunc& func)
 		{
+			if (m_Columns.contains(typeHash))
+			{
+				HERR("A type saved in columns cannot have a serialize callback");
+				return;
+			}
 			if (m_SerializeDataFuncs[typeHash])
 			{
 				HWARN("A serialize callback function already exist for this type!");
@@ -41,6 +58,53 @@ namespace hdn
 			RegisterSerializeFunc(GenerateTypeHash<T>(), sizeof(T), func);
 		}
 
+		// Saves the entries of a POD type in columns, one array per field, for loops going over a few fields of every entry
+		// Such types read through Zone::Column(), the columns must also be registered when the zone is loaded
+		void RegisterColumns(hash64_t typeHash, u64 typeSize, std::initializer_list<ZoneColumn> columns)
+		{
+			if (HasSerializeFunc(typeHash))
+			{
+				HERR("A type with a serialize callback cannot be saved in columns");
+				return;
+			}
+			if (columns.size() == 0)
+			{
+				HERR("A type saved in columns needs at least one column");
+				return;
+			}
+			for (const ZoneColumn& column : columns)
+			{
+				if (column.offset + column.size > typeSize)
+				{
+					HERR("Zone column at offset {0} ({1} bytes) is out of its type ({2} bytes)", column.offset, column.size, typeSize);
+					return;
+				}
+			}
+			m_Columns[typeHash] = vector<ZoneColumn>(columns.begin(), columns.end());
+			m_TypeSize[typeHash] = typeSize;
+		}
+
+		// e.g. RegisterColumns<point_light>({ HZONE_COLUMN(point_light, position), HZONE_COLUMN(point_light, radius) })
+		template<typename T>
+		void RegisterColumns(std::initializer_list<ZoneColumn> columns)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only POD types can be saved in columns");
+			RegisterColumns(GenerateTypeHash<T>(), sizeof(T), columns);
+		}
+
+		// nullptr if the type is not saved in columns
+		const vector<ZoneColumn>* GetColumns(hash64_t typeHash) const
+		{
+			auto it = m_Columns.find(typeHash);
+			return it != m_Columns.end() ? &it->second : nullptr;
+		}
+
+		u64 GetTypeSize(hash64_t typeHash) const
+		{
+			auto it = m_TypeSize.find(typeHash);
+			return it != m_TypeSize.end() ? it->second : 0;
+		}
+
 		u64 Serialize(hash64_t typeHash, const void* dataBuffer, FDynamicBufferWriter& writer)
 		{
 			auto callback = m_SerializeDataFuncs[typeHash];
@@ -57,7 +121,60 @@ namespace hdn
 			return Serialize(GenerateTypeHash<T>(), dataBuffer, writer);
 		}
 
-		void ResolveTypeDependency(vector<uint64_t>& type) {}
+		// Orders the types so that each one comes after the types it depends on, independent types keep their order
+		// Dependencies on types that are not in the list are ignored, returns false and leaves the list as is on a circular dependency
+		bool ResolveTypeDependency(vector<hash64_t>& types) const
+		{
+			const unordered_set<hash64_t> listed(types.begin(), types.end());
+			unordered_set<hash64_t> placed;
+			vector<hash64_t> sortedTypes;
+			sortedTypes.reserve(types.size());
+			while (sortedTypes.size() < types.size())
+			{
+				const u64 placedCount = sortedTypes.size();
+				for (hash64_t typeHash : types)
+				{
+					if (placed.contains(typeHash))
+					{
+						continue;
+					}
+
+					bool resolved = true;
+					auto [begin, end] = m_TypeDependencies.equal_range(typeHash);
+					for (auto it = begin; it != end && resolved; ++it)
+					{
+						// Types depend on themselves once they have a serialize callback
+						resolved = it->second == typeHash || !listed.contains(it->second) || placed.contains(it->second);
+					}
+					if (resolved)
+					{
+						placed.insert(typeHash);
+						sortedTypes.push_back(typeHash);
+					}
+				}
+
+				if (sortedTypes.size() == placedCount)
+				{
+					HERR("Circular dependency between {0} zone types", types.size() - placedCount);
+					return false;
+				}
+			}
+			types = std::move(sortedTypes);
+			return true;
+		}
+
+		// Appends the types typeHash depends on, without itself
+		void GetTypeDependencies(hash64_t typeHash, vector<hash64_t>& dependencies) const
+		{
+			auto [begin, end] = m_TypeDependencies.equal_range(typeHash);
+			for (auto it = begin; it != end; ++it)
+			{
+				if (it->second != typeHash)
+				{
+					dependencies.push_back(it->second);
+				}
+			}
+		}
 
 		inline void AddTypeDependency(hash64_t t0Hash, hash64_t t1Hash)
 		{
@@ -71,9 +188,10 @@ namespace hdn
 			AddTypeDependency(GenerateTypeHash<T0>(), GenerateTypeHash<T1>());
 		}
 	private:
-		map<hash64_t, ZoneSerializeDataFunc> m_SerializeDataFuncs;
+		hkey_map<ZoneSerializeDataFunc> m_SerializeDataFuncs;
+		hkey_map<vector<ZoneColumn>> m_Columns;
 		multimap<hash64_t, hash64_t> m_TypeDependencies;
-		map<hash64_t, u64> m_TypeSize;
+		hkey_map<u64> m_TypeSize;
 	};
 
 
@@ -101,6 +219,21 @@ namespace hdn
 				HWARN("An unload callback function already exist for this type!");
 			}
 			m_LoadDataFuncs[typeHash] = func;
+			m_TypeSize[typeHash] = typeSize;
+		}
+
+		// nullptr if the type has no load callback
+		ZoneLoadDataFunc GetLoadFunc(hash64_t typeHash) const
+		{
+			auto it = m_LoadDataFuncs.find(typeHash);
+			return it != m_LoadDataFuncs.end() ? it->second : nullptr;
+		}
+
+		// Size of the runtime instance the load callback writes
+		u64 GetTypeSize(hash64_t typeHash) const
+		{
+			auto it = m_TypeSize.find(typeHash);
+			return it != m_TypeSize.end() ? it->second : 0;
 		}
 
 		template<typename T>
@@ -125,14 +258,22 @@ namespace hdn
 			m_UnloadDataFuncs[typeHash] = func;
 		}
 
+		// nullptr if the type has no unload callback
+		ZoneUnloadDataFunc GetUnloadFunc(hash64_t typeHash) const
+		{
+			auto it = m_UnloadDataFuncs.find(typeHash);
+			return it != m_UnloadDataFuncs.end() ? it->second : nullptr;
+		}
+
 		template<typename T>
 		void RegisterUnloadFunc(const ZoneUnloadDataFunc& func)
 		{
 			RegisterUnloadFunc(GenerateTypeHash<T>(), sizeof(T), func);
 		}
 	private:
-		map<hash64_t, ZoneLoadDataFunc> m_LoadDataFuncs;
-		map<hash64_t, ZoneUnloadDataFunc> m_UnloadDataFuncs;
+		hkey_map<ZoneLoadDataFunc> m_LoadDataFuncs;
+		hkey_map<ZoneUnloadDataFunc> m_UnloadDataFuncs;
+		hkey_map<u64> m_TypeSize;
 	};
 
 }
\ No newline at end of file
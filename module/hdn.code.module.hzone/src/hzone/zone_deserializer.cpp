@@ -6,10 +6,13 @@
 #include "core/io/buffer_reader.h"
 #include "core/io/buffer_writer.h"
 
+#include <algorithm>
+
 namespace hdn
 {
 	void ZoneDeserializer::Deserialize(FBufferReader& archive, Zone& zone)
 	{
+		archive.Align(ZONE_SECTION_ALIGNMENT);
 		zone.keyCount = archive.Read<u64>();
 		const hkey* sortedKeys = archive.Read<hkey>(zone.keyCount);
 
@@ -18,30 +21,81 @@ namespace hdn
 		const hash64_t* sortedTypeHash = archive.Read<hash64_t>(zone.typeCount);
 		const u64* keyMaxPerType = archive.Read<u64>(zone.typeCount);
 		const u64* dataOffsets = archive.Read<u64>(zone.keyCount);
-		const byte* dataPayload = archive.Read<byte>(zone.payloadSize);
+		zone.payloadBlockSize = archive.Read<u64>();
+		zone.payloadBlockCount = zone.payloadBlockSize != 0 ? (zone.payloadSize + zone.payloadBlockSize - 1) / zone.payloadBlockSize : 0;
+		const u64* payloadBlockEnds = archive.Read<u64>(zone.payloadBlockCount);
+		const bool validBlocks = !archive.IsTruncated() && ValidatePayloadBlocks(zone, payloadBlockEnds);
+		const u64 storedPayloadSize = zone.payloadBlockCount > 0 && validBlocks ? payloadBlockEnds[zone.payloadBlockCount - 1] : zone.payloadSize;
+		archive.Align(ZONE_PAYLOAD_ALIGNMENT);
+		const byte* dataPayload = archive.Read<byte>(storedPayloadSize);
+		if (archive.IsTruncated() || !validBlocks)
+		{
+			HERR("Truncated zone: {0} keys, {1} payload bytes announced", zone.keyCount, zone.payloadSize);
+			zone.keyCount = 0;
+			zone.typeCount = 0;
+			zone.payloadSize = 0;
+			zone.payloadBlockSize = 0;
+			zone.payloadBlockCount = 0;
+			zone.InitKeyLookup();
+			zone.InitPayloadBlocks();
+			return;
+		}
+
+		if (archive.IsPersistent())
+		{
+			// Every section is POD and aligned, reference the buffer in place: nothing but the counts is read
+			zone.memoryBase = nullptr;
+			zone.sortedKeys = sortedKeys;
+			zone.sortedTypeHash = sortedTypeHash;
+			zone.keyMaxPerType = keyMaxPerType;
+			zone.dataOffsets = dataOffsets;
+			zone.payloadBlockEnds = payloadBlockEnds;
+			zone.compressedPayload = zone.payloadBlockCount > 0 ? dataPayload : nullptr;
+			zone.dataPayload = dataPayload;
+			zone.InitKeyLookup();
+			zone.InitPayloadBlocks();
+			return;
+		}
 
-		const u64 runtimeZoneByteSize = 
+		// Same layout as the serialized one, new[] is aligned enough for the payload alignment
+		const u64 headerByteSize =
 			zone.keyCount * sizeof(hkey) +
-			zone.keyCount * sizeof(hash64_t) +
+			zone.typeCount * sizeof(hash64_t) +
 			zone.typeCount * sizeof(u64) +
 			zone.keyCount * sizeof(u64) +
-			zone.payloadSize * sizeof(byte);
+			zone.payloadBlockCount * sizeof(u64);
+		const u64 runtimeZoneByteSize = AlignUp(headerByteSize, ZONE_PAYLOAD_ALIGNMENT) + storedPayloadSize * sizeof(byte);
 
 		zone.memoryBase = new byte[runtimeZoneByteSize];
 
-		FBufferWriter writer{ zone.memoryBase };
+		FBufferWriter writer{ zone.memoryBase, runtimeZoneByteSize };
 		zone.sortedKeys = writer.Write<const hkey>(sortedKeys, zone.keyCount);
-		for (int i = 0; i < zone.keyCount; i++)
-		{
-			HINFO("Key {0}", zone.sortedKeys[i]);
-		}
 		zone.sortedTypeHash = writer.Write<const hash64_t>(sortedTypeHash, zone.typeCount);
 		zone.keyMaxPerType = writer.Write<const u64>(keyMaxPerType, zone.typeCount);
 		zone.dataOffsets = writer.Write<const u64>(dataOffsets, zone.keyCount);
-		for (int i = 0; i < zone.keyCount; i++)
+		zone.payloadBlockEnds = writer.Write<const u64>(payloadBlockEnds, zone.payloadBlockCount);
+		writer.Align(ZONE_PAYLOAD_ALIGNMENT);
+		// A compressed payload is copied as is, its blocks are decompressed on access
+		zone.dataPayload = writer.Write<const byte>(dataPayload, storedPayloadSize);
+		zone.compressedPayload = zone.payloadBlockCount > 0 ? zone.dataPayload : nullptr;
+		zone.InitKeyLookup();
+		zone.InitPayloadBlocks();
+	}
+
+	bool ZoneDeserializer::ValidatePayloadBlocks(const Zone& zone, const u64* payloadBlockEnds)
+	{
+		// Every block is stored in at most its uncompressed size, see PackBlock()
+		u64 storedStart = 0;
+		for (u64 blockIndex = 0; blockIndex < zone.payloadBlockCount; blockIndex++)
 		{
-			HINFO("Offset {0}", zone.dataOffsets[i]);
+			const u64 blockSize = std::min(zone.payloadBlockSize, zone.payloadSize - blockIndex * zone.payloadBlockSize);
+			if (payloadBlockEnds[blockIndex] < storedStart || payloadBlockEnds[blockIndex] - storedStart > blockSize)
+			{
+				HERR("Invalid zone payload block {0}", blockIndex);
+				return false;
+			}
+			storedStart = payloadBlockEnds[blockIndex];
 		}
-		zone.dataPayload = writer.Write<const byte>(dataPayload, zone.payloadSize);
+		return true;
 	}
-}
+}
\ No newline at end of file
@@ -9,5 +9,7 @@ namespace hdn
 	{
 	public:
 		void Deserialize(FBufferReader& archive, Zone& zone);
+	private:
+		static bool ValidatePayloadBlocks(const Zone& zone, const u64* payloadBlockEnds);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,560 @@
+#include "zone_incremental_builder.h"
+#include "zone_serializer.h"
+#include "zone_config.h"
+#include "zone_deserializer.h"
+
+#include "core/io/common.h"
+#include "core/io/block_compression.h"
+
+#include "async/async_parallel_for.h"
+
+#include <algorithm>
+
+namespace hdn
+{
+	ZoneIncrementalBuilder::~ZoneIncrementalBuilder()
+	{
+		Reset();
+	}
+
+	void ZoneIncrementalBuilder::Reset()
+	{
+		delete[] m_Previous.memoryBase;
+		m_Previous = Zone{};
+		m_Manifest = ZoneManifest{};
+		m_Types.clear();
+		m_EditData.Reset();
+		m_Patches.clear();
+		m_ChangedRanges.clear();
+		m_Stats = ZoneIncrementalBuildStats{};
+	}
+
+	bool ZoneIncrementalBuilder::Open(FBufferReader& archive, const ZoneManifest& manifest)
+	{
+		Reset();
+		ZoneDeserializer deserializer;
+		deserializer.Deserialize(archive, m_Previous);
+		if (archive.IsTruncated() || m_Previous.typeCount != manifest.types.size())
+		{
+			HERR("ZoneIncrementalBuilder: the manifest has {0} types, the zone {1}", manifest.types.size(), m_Previous.typeCount);
+			Reset();
+			return false;
+		}
+
+		m_Manifest = manifest;
+		m_Types.resize(m_Previous.typeCount);
+		for (u64 typeIndex = 0; typeIndex < m_Previous.typeCount; typeIndex++)
+		{
+			TypeState& type = m_Types[typeIndex];
+			const ZoneManifestType& manifestType = m_Manifest.types[typeIndex];
+			u64 firstEntry = 0;
+			u64 endEntry = 0;
+			m_Previous.GetTypeEntryRange(typeIndex, firstEntry, endEntry);
+			bool valid = m_Previous.sortedTypeHash[typeIndex] == manifestType.typeHash && endEntry - firstEntry == manifestType.entryHashes.size() && firstEntry < endEntry;
+
+			type.typeHash = manifestType.typeHash;
+			type.previous = &manifestType;
+			type.previousFirstEntry = firstEntry;
+			type.entryCount = endEntry - firstEntry;
+			type.previousStart = valid ? m_Previous.dataOffsets[firstEntry] : 0;
+			type.previousEnd = typeIndex + 1 < m_Previous.typeCount && endEntry < m_Previous.keyCount ? m_Previous.dataOffsets[endEntry] : m_Previous.payloadSize;
+
+			// The entries of a type are back to back, deduplicated zones have no manifest
+			for (u64 entryIndex = firstEntry + 1; entryIndex < endEntry && valid; entryIndex++)
+			{
+				valid = m_Previous.dataOffsets[entryIndex - 1] <= m_Previous.dataOffsets[entryIndex];
+			}
+			valid = valid && m_Previous.dataOffsets[endEntry - 1] <= type.previousStart + manifestType.payloadSize && type.previousStart + manifestType.payloadSize <= type.previousEnd;
+			if (!valid)
+			{
+				HERR("ZoneIncrementalBuilder: the manifest does not match the type {0} of the zone", typeIndex);
+				Reset();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	ZoneIncrementalBuilder::TypeState* ZoneIncrementalBuilder::FindType(hash64_t typeHash)
+	{
+		for (TypeState& type : m_Types)
+		{
+			if (type.typeHash == typeHash)
+			{
+				return &type;
+			}
+		}
+		return nullptr;
+	}
+
+	u64 ZoneIncrementalBuilder::GetEntryCount(hash64_t typeHash) const
+	{
+		for (const TypeState& type : m_Types)
+		{
+			if (type.typeHash == typeHash)
+			{
+				return type.entryCount;
+			}
+		}
+		return 0;
+	}
+
+	void ZoneIncrementalBuilder::SetEntry(hash64_t typeHash, u64 entryIndex, const void* data, u64 dataSize)
+	{
+		TypeState* type = FindType(typeHash);
+		if (type == nullptr)
+		{
+			type = &m_Types.emplace_back();
+			type->typeHash = typeHash;
+		}
+		if (entryIndex > type->entryCount)
+		{
+			HERR("ZoneIncrementalBuilder: entry {0} is past the {1} entries of its type", entryIndex, type->entryCount);
+			return;
+		}
+
+		// Serialized like ZoneSerializer::AddEntry() does
+		const u64 editOffset = m_EditData.BytesWritten();
+		if (ZoneSerializerConfig::ZoneSerializeDataFunc serialize = ZoneSerializerConfig::Get().GetSerializeFunc(typeHash))
+		{
+			serialize(data, m_EditData);
+		}
+		else
+		{
+			m_EditData.Write(reinterpret_cast<const byte*>(data), dataSize);
+		}
+		const u64 editSize = m_EditData.BytesWritten() - editOffset;
+		const hash64_t hash = HashZoneEntry(m_EditData.begin<byte>() + editOffset, editSize);
+		type->entryCount = std::max(type->entryCount, entryIndex + 1);
+
+		// Set back to what the previous zone holds, the entry is read from it
+		if (type->previous != nullptr && entryIndex < type->previous->entryHashes.size() && type->previous->entryHashes[entryIndex] == hash)
+		{
+			type->edits.erase(entryIndex);
+			m_EditData.Truncate(editOffset);
+			m_Stats.unchangedEntryCount++;
+			return;
+		}
+		type->edits[entryIndex] = EntryEdit{ editOffset, editSize, hash };
+	}
+
+	void ZoneIncrementalBuilder::ResizeType(hash64_t typeHash, u64 entryCount)
+	{
+		TypeState* type = FindType(typeHash);
+		if (type == nullptr || entryCount > type->entryCount)
+		{
+			HERR("ZoneIncrementalBuilder: cannot resize a type of {0} entries to {1}, entries are added with SetEntry()", type != nullptr ? type->entryCount : 0, entryCount);
+			return;
+		}
+		type->entryCount = entryCount;
+		type->edits.erase(type->edits.lower_bound(entryCount), type->edits.end());
+	}
+
+	u64 ZoneIncrementalBuilder::GetPreviousEntrySize(const TypeState& type, u64 entryIndex) const
+	{
+		const u64 entryEnd = entryIndex + 1 < type.previous->entryHashes.size() ? m_Previous.dataOffsets[type.previousFirstEntry + entryIndex + 1] : type.previousStart + type.previous->payloadSize;
+		return entryEnd - m_Previous.dataOffsets[type.previousFirstEntry + entryIndex];
+	}
+
+	const byte* ZoneIncrementalBuilder::GetPreviousPayload(u64 begin, u64 end) const
+	{
+		m_Previous.DecompressPayload(begin, end);
+		return m_Previous.dataPayload + begin;
+	}
+
+	void ZoneIncrementalBuilder::LayoutType(TypeState& type)
+	{
+		m_Stats.changedEntryCount += type.edits.size();
+		const vector<ZoneColumn>* columns = ZoneSerializerConfig::Get().GetColumns(type.typeHash);
+		bool resized = type.previous == nullptr || type.entryCount != type.previous->entryHashes.size();
+		for (auto it = type.edits.begin(); it != type.edits.end() && !resized && columns == nullptr; ++it)
+		{
+			resized = it->second.size != GetPreviousEntrySize(type, it->first);
+		}
+		if (resized)
+		{
+			type.change = TypeChange::Rewritten;
+			m_Stats.rewrittenTypeCount++;
+			RewriteType(type);
+			return;
+		}
+
+		type.payloadSize = type.previous->payloadSize;
+		if (type.edits.empty())
+		{
+			type.change = TypeChange::None;
+			m_Stats.reusedTypeCount++;
+			return;
+		}
+
+		// Same layout as before, the changed entries are written over the previous ones
+		type.change = TypeChange::Patched;
+		m_Stats.patchedTypeCount++;
+		vector<u64> columnOffsets;
+		if (columns != nullptr)
+		{
+			ComputeColumnOffsets(*columns, type.entryCount, columnOffsets);
+		}
+		for (const auto& [entryIndex, edit] : type.edits)
+		{
+			const byte* data = m_EditData.begin<byte>() + edit.offset;
+			if (columns == nullptr)
+			{
+				m_Patches.push_back({ type.start + m_Previous.dataOffsets[type.previousFirstEntry + entryIndex] - type.previousStart, data, edit.size });
+				continue;
+			}
+			for (u64 c = 0; c < columns->size(); c++)
+			{
+				const ZoneColumn& column = (*columns)[c];
+				m_Patches.push_back({ type.start + columnOffsets[c] + entryIndex * column.size, data + column.offset, column.size });
+			}
+		}
+	}
+
+	void ZoneIncrementalBuilder::RewriteType(TypeState& type)
+	{
+		// Entries not set since Open() come from the previous zone, entries past its count were all set
+		const u64 previousCount = type.previous != nullptr ? std::min<u64>(type.previous->entryHashes.size(), type.entryCount) : 0;
+		if (const vector<ZoneColumn>* columns = ZoneSerializerConfig::Get().GetColumns(type.typeHash))
+		{
+			vector<u64> columnOffsets;
+			vector<u64> previousColumnOffsets;
+			type.payloadSize = ComputeColumnOffsets(*columns, type.entryCount, columnOffsets);
+			type.payload.resize(type.payloadSize);
+			if (type.previous != nullptr)
+			{
+				ComputeColumnOffsets(*columns, type.previous->entryHashes.size(), previousColumnOffsets);
+			}
+			for (u64 c = 0; c < columns->size(); c++)
+			{
+				const ZoneColumn& column = (*columns)[c];
+				const u64 previousColumnStart = type.previousStart + (previousCount > 0 ? previousColumnOffsets[c] : 0);
+				const u64 keptSize = previousCount * column.size;
+				if (keptSize > 0)
+				{
+					memcpy(type.payload.data() + columnOffsets[c], GetPreviousPayload(previousColumnStart, previousColumnStart + keptSize), keptSize);
+				}
+				for (const auto& [entryIndex, edit] : type.edits)
+				{
+					memcpy(type.payload.data() + columnOffsets[c] + entryIndex * column.size, m_EditData.begin<byte>() + edit.offset + column.offset, column.size);
+				}
+			}
+			return;
+		}
+
+		type.entryOffsets.resize(type.entryCount);
+		u64 payloadSize = 0;
+		auto edit = type.edits.begin();
+		for (u64 entryIndex = 0; entryIndex < type.entryCount; entryIndex++)
+		{
+			type.entryOffsets[entryIndex] = payloadSize;
+			const bool edited = edit != type.edits.end() && edit->first == entryIndex;
+			payloadSize += edited ? edit->second.size : GetPreviousEntrySize(type, entryIndex);
+			edit = edited ? std::next(edit) : edit;
+		}
+		type.payloadSize = payloadSize;
+		type.payload.resize(payloadSize);
+
+		// The entries between two edits are back to back in the previous payload as well, they are copied at once
+		u64 runStart = 0;
+		for (auto it = type.edits.begin();; ++it)
+		{
+			const u64 runEnd = it != type.edits.end() ? it->first : previousCount;
+			if (runStart < runEnd)
+			{
+				const u64 previousBegin = m_Previous.dataOffsets[type.previousFirstEntry + runStart];
+				const u64 previousEnd = m_Previous.dataOffsets[type.previousFirstEntry + runEnd - 1] + GetPreviousEntrySize(type, runEnd - 1);
+				memcpy(type.payload.data() + type.entryOffsets[runStart], GetPreviousPayload(previousBegin, previousEnd), previousEnd - previousBegin);
+			}
+			if (it == type.edits.end())
+			{
+				break;
+			}
+			memcpy(type.payload.data() + type.entryOffsets[it->first], m_EditData.begin<byte>() + it->second.offset, it->second.size);
+			runStart = it->first + 1;
+		}
+	}
+
+	void ZoneIncrementalBuilder::AddChangedRanges(const TypeState& type)
+	{
+		if (type.previous == nullptr || type.start != type.previousStart)
+		{
+			m_ChangedRanges.push_back({ type.start, type.end });
+			return;
+		}
+
+		u64 unchangedEnd = type.start + type.payloadSize;
+		if (type.change == TypeChange::Rewritten)
+		{
+			// The entries before the first one set or removed are where they were
+			const u64 previousCount = type.previous->entryHashes.size();
+			u64 firstChanged = std::min<u64>(type.entryCount, previousCount);
+			firstChanged = type.edits.empty() ? firstChanged : std::min(firstChanged, type.edits.begin()->first);
+			const bool columnar = ZoneSerializerConfig::Get().GetColumns(type.typeHash) != nullptr;
+			unchangedEnd = type.start + (columnar ? 0 : firstChanged < type.entryCount ? type.entryOffsets[firstChanged] : type.payloadSize);
+			m_ChangedRanges.push_back({ unchangedEnd, type.end });
+			return;
+		}
+
+		if (type.change == TypeChange::Patched)
+		{
+			for (const PayloadPatch& patch : m_Patches)
+			{
+				if (patch.offset >= type.start && patch.offset < type.end)
+				{
+					m_ChangedRanges.push_back({ patch.offset, patch.offset + patch.size });
+				}
+			}
+		}
+		// The padding is zeros in both, unless the next type moved
+		if (type.end != type.previousEnd)
+		{
+			m_ChangedRanges.push_back({ unchangedEnd, type.end });
+		}
+	}
+
+	void ZoneIncrementalBuilder::Build(FBufferWriter& archive, ZoneManifest& manifest)
+	{
+		// 1. Where every type goes and what changed in it, types left without entries are dropped
+		vector<TypeState*> types;
+		u64 payloadSize = 0;
+		u64 keyCount = 0;
+		for (TypeState& type : m_Types)
+		{
+			if (type.entryCount == 0)
+			{
+				continue;
+			}
+			payloadSize = AlignUp(payloadSize, ZONE_PAYLOAD_ALIGNMENT);
+			type.start = payloadSize;
+			LayoutType(type);
+			payloadSize += type.payloadSize;
+			keyCount += type.entryCount;
+			types.push_back(&type);
+		}
+		for (u64 i = 0; i < types.size(); i++)
+		{
+			types[i]->end = i + 1 < types.size() ? types[i + 1]->start : payloadSize;
+		}
+		std::sort(m_Patches.begin(), m_Patches.end(), [](const PayloadPatch& a, const PayloadPatch& b) {
+			return a.offset < b.offset;
+		});
+		for (const TypeState* type : types)
+		{
+			AddChangedRanges(*type);
+		}
+		std::sort(m_ChangedRanges.begin(), m_ChangedRanges.end(), [](const PayloadRange& a, const PayloadRange& b) {
+			return a.begin < b.begin;
+		});
+		// Merged, a block then only checks the first range ending after its start
+		u64 mergedCount = 0;
+		for (u64 i = 0; i < m_ChangedRanges.size(); i++)
+		{
+			const PayloadRange range = m_ChangedRanges[i];
+			if (range.begin >= range.end)
+			{
+				continue;
+			}
+			if (mergedCount > 0 && range.begin <= m_ChangedRanges[mergedCount - 1].end)
+			{
+				m_ChangedRanges[mergedCount - 1].end = std::max(m_ChangedRanges[mergedCount - 1].end, range.end);
+				continue;
+			}
+			m_ChangedRanges[mergedCount++] = range;
+		}
+		m_ChangedRanges.resize(mergedCount);
+
+		// 2. Same sections as ZoneSerializer::Serialize()
+		archive.Align(ZONE_SECTION_ALIGNMENT);
+		bin::Write(archive, keyCount);
+		if (!archive.Reserve(keyCount * sizeof(hkey)))
+		{
+			return;
+		}
+		for (u64 keyIndex = 0; keyIndex < keyCount; keyIndex++)
+		{
+			archive.WriteUnchecked(static_cast<hkey>(m_Manifest.minKeyValue + keyIndex));
+		}
+
+		bin::Write(archive, payloadSize);
+		bin::Write(archive, static_cast<u64>(types.size()));
+		for (const TypeState* type : types)
+		{
+			bin::Write(archive, type->typeHash);
+		}
+		hkey keyMax = m_Manifest.minKeyValue;
+		for (const TypeState* type : types)
+		{
+			keyMax += type->entryCount;
+			bin::Write(archive, keyMax);
+		}
+
+		archive.Advance<u64>(keyCount);
+		if (archive.IsOverflowed())
+		{
+			return;
+		}
+		u64* typeOffsetBase = archive.end<u64>() - keyCount;
+		const ZoneSerializerConfig& config = ZoneSerializerConfig::Get();
+		for (const TypeState* type : types)
+		{
+			const vector<ZoneColumn>* columns = config.GetColumns(type->typeHash);
+			ParallelFor(0, type->entryCount, ZONE_OFFSET_GRAIN_SIZE, [&](u64 begin, u64 end) {
+				for (u64 j = begin; j < end; j++)
+				{
+					if (columns != nullptr)
+					{
+						typeOffsetBase[j] = type->start + j * (*columns)[0].size;
+					}
+					else if (type->change == TypeChange::Rewritten)
+					{
+						typeOffsetBase[j] = type->start + type->entryOffsets[j];
+					}
+					else
+					{
+						typeOffsetBase[j] = type->start + m_Previous.dataOffsets[type->previousFirstEntry + j] - type->previousStart;
+					}
+				}
+			});
+			typeOffsetBase += type->entryCount;
+		}
+		SerializePayload(archive, payloadSize);
+
+		// 3. The manifest of the new zone, the previous hashes with the changed ones
+		ZoneManifest builtManifest;
+		builtManifest.minKeyValue = m_Manifest.minKeyValue;
+		builtManifest.types.reserve(types.size());
+		for (const TypeState* type : types)
+		{
+			ZoneManifestType& builtType = builtManifest.types.emplace_back();
+			builtType.typeHash = type->typeHash;
+			builtType.payloadSize = type->payloadSize;
+			if (type->previous != nullptr)
+			{
+				builtType.entryHashes.assign(type->previous->entryHashes.begin(), type->previous->entryHashes.begin() + std::min<u64>(type->previous->entryHashes.size(), type->entryCount));
+			}
+			builtType.entryHashes.resize(type->entryCount);
+			for (const auto& [entryIndex, edit] : type->edits)
+			{
+				builtType.entryHashes[entryIndex] = edit.hash;
+			}
+		}
+		manifest = std::move(builtManifest);
+	}
+
+	bool ZoneIncrementalBuilder::IsBlockReusable(u64 blockIndex, u64 payloadSize) const
+	{
+		// The block must cover the same bytes in both payloads, none of them changed
+		const u64 blockSize = m_Previous.payloadBlockSize;
+		const u64 blockStart = blockIndex * blockSize;
+		const u64 blockEnd = std::min(blockStart + blockSize, payloadSize);
+		if (blockIndex >= m_Previous.payloadBlockCount || std::min(blockStart + blockSize, m_Previous.payloadSize) != blockEnd)
+		{
+			return false;
+		}
+		auto range = std::upper_bound(m_ChangedRanges.begin(), m_ChangedRanges.end(), blockStart, [](u64 offset, const PayloadRange& range) {
+			return offset < range.end;
+		});
+		return range == m_ChangedRanges.end() || range->begin >= blockEnd;
+	}
+
+	void ZoneIncrementalBuilder::FillPayload(byte* destination, u64 begin, u64 end) const
+	{
+		for (const TypeState& type : m_Types)
+		{
+			if (type.entryCount == 0 || type.end <= begin || type.start >= end)
+			{
+				continue;
+			}
+
+			const u64 copyBegin = std::max(begin, type.start);
+			const u64 copyEnd = std::min(end, type.start + type.payloadSize);
+			if (copyBegin < copyEnd)
+			{
+				const u64 typeOffset = copyBegin - type.start;
+				const byte* source = type.change == TypeChange::Rewritten ? type.payload.data() + typeOffset : GetPreviousPayload(type.previousStart + typeOffset, type.previousStart + typeOffset + copyEnd - copyBegin);
+				memcpy(destination + copyBegin - begin, source, copyEnd - copyBegin);
+			}
+			const u64 paddingBegin = std::max(begin, type.start + type.payloadSize);
+			const u64 paddingEnd = std::min(end, type.end);
+			if (paddingBegin < paddingEnd)
+			{
+				memset(destination + paddingBegin - begin, 0, paddingEnd - paddingBegin);
+			}
+		}
+
+		// Patches do not overlap, the first one that may reach begin starts before it
+		auto patch = std::upper_bound(m_Patches.begin(), m_Patches.end(), begin, [](u64 offset, const PayloadPatch& patch) {
+			return offset < patch.offset;
+		});
+		patch = patch != m_Patches.begin() ? std::prev(patch) : patch;
+		for (; patch != m_Patches.end() && patch->offset < end; ++patch)
+		{
+			const u64 patchBegin = std::max(begin, patch->offset);
+			const u64 patchEnd = std::min(end, patch->offset + patch->size);
+			if (patchBegin < patchEnd)
+			{
+				memcpy(destination + patchBegin - begin, patch->data + patchBegin - patch->offset, patchEnd - patchBegin);
+			}
+		}
+	}
+
+	void ZoneIncrementalBuilder::SerializePayload(FBufferWriter& archive, u64 payloadSize)
+	{
+		const u64 blockSize = m_Previous.payloadBlockSize;
+		bin::Write(archive, blockSize);
+		if (blockSize == 0)
+		{
+			archive.Align(ZONE_PAYLOAD_ALIGNMENT);
+			archive.Advance<byte>(payloadSize);
+			if (archive.IsOverflowed())
+			{
+				return;
+			}
+			byte* payloadBase = archive.end<byte>() - payloadSize;
+			ParallelFor(0, payloadSize, ZONE_PAYLOAD_COPY_GRAIN_SIZE, [&](u64 begin, u64 end) {
+				FillPayload(payloadBase + begin, begin, end);
+			});
+			return;
+		}
+
+		// Unchanged blocks are copied compressed, the others are filled and compressed again like ZoneSerializer does
+		const u64 blockCount = (payloadSize + blockSize - 1) / blockSize;
+		vector<u64> storedSizes(blockCount);
+		vector<Scope<byte[]>> packedBlocks(blockCount);
+		ParallelFor(0, blockCount, 1, [&](u64 blockIndex) {
+			if (IsBlockReusable(blockIndex, payloadSize))
+			{
+				const u64 previousStoredStart = blockIndex > 0 ? m_Previous.payloadBlockEnds[blockIndex - 1] : 0;
+				storedSizes[blockIndex] = m_Previous.payloadBlockEnds[blockIndex] - previousStoredStart;
+				return;
+			}
+			const u64 blockStart = blockIndex * blockSize;
+			const u64 size = std::min(blockSize, payloadSize - blockStart);
+			Scope<byte[]> block{ new byte[size] };
+			FillPayload(block.get(), blockStart, blockStart + size);
+			packedBlocks[blockIndex] = Scope<byte[]>{ new byte[size] };
+			storedSizes[blockIndex] = PackBlock(block.get(), size, packedBlocks[blockIndex].get());
+		});
+
+		u64 storedEnd = 0;
+		for (u64 blockIndex = 0; blockIndex < blockCount; blockIndex++)
+		{
+			storedEnd += storedSizes[blockIndex];
+			bin::Write(archive, storedEnd);
+		}
+		archive.Align(ZONE_PAYLOAD_ALIGNMENT);
+		for (u64 blockIndex = 0; blockIndex < blockCount; blockIndex++)
+		{
+			if (packedBlocks[blockIndex] != nullptr)
+			{
+				archive.Write(packedBlocks[blockIndex].get(), storedSizes[blockIndex]);
+				m_Stats.compressedBlockCount++;
+				continue;
+			}
+			const u64 previousStoredStart = blockIndex > 0 ? m_Previous.payloadBlockEnds[blockIndex - 1] : 0;
+			archive.Write(m_Previous.compressedPayload + previousStoredStart, storedSizes[blockIndex]);
+			m_Stats.reusedBlockCount++;
+		}
+	}
+}
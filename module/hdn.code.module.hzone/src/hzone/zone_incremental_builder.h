@@ -0,0 +1,133 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/hash.h"
+#include "core/stl/map.h"
+#include "core/stl/vector.h"
+#include "core/io/buffer_reader.h"
+#include "core/io/buffer_writer.h"
+#include "core/io/dynamic_buffer_writer.h"
+
+#include "zone.h"
+#include "zone_manifest.h"
+
+namespace hdn
+{
+	struct ZoneIncrementalBuildStats
+	{
+		u64 changedEntryCount = 0; // Entries set with a content that differs from the manifest, or added
+		u64 unchangedEntryCount = 0; // Entries set again with the content they had, ignored
+		u64 reusedTypeCount = 0; // Payload copied as is from the previous zone, maybe at another offset
+		u64 patchedTypeCount = 0; // Same entry sizes, the changed entries are overwritten in the previous payload
+		u64 rewrittenTypeCount = 0; // Entries added, removed or resized, the type payload is laid out again
+		u64 reusedBlockCount = 0; // Compressed payload blocks copied from the previous zone
+		u64 compressedBlockCount = 0;
+	};
+
+	// Builds a zone again from its previous build and the entries changed since, instead of going through a ZoneSerializer
+	// with every entry: the unchanged types are copied from the previous payload and, for a compressed payload, only the
+	// blocks holding changed bytes are compressed again. The result is the zone a ZoneSerializer would build from the
+	// same entries, keys included: an entry is identified by its type and its index in the type
+	// Usage: Open() the previous zone with its manifest, SetEntry() / ResizeType(), Build(), then Open() again for the next edit
+	class ZoneIncrementalBuilder
+	{
+	public:
+		ZoneIncrementalBuilder() = default;
+		~ZoneIncrementalBuilder();
+
+		ZoneIncrementalBuilder(const ZoneIncrementalBuilder&) = delete;
+		ZoneIncrementalBuilder& operator=(const ZoneIncrementalBuilder&) = delete;
+
+		// The archive is read like ZoneDeserializer does, a persistent buffer must outlive Build()
+		// Returns false if the manifest does not describe the zone
+		bool Open(FBufferReader& archive, const ZoneManifest& manifest);
+
+		// Sets the entry entryIndex of the type, entryIndex equal to the entry count of the type appends the entry
+		// A type that is not in the zone yet is added after the others
+		void SetEntry(hash64_t typeHash, u64 entryIndex, const void* data, u64 size);
+
+		template<typename T>
+		void SetEntry(u64 entryIndex, const T* data)
+		{
+			SetEntry(GenerateTypeHash<T>(), entryIndex, static_cast<const void*>(data), sizeof(T));
+		}
+
+		// Removes the entries of the type from entryCount on, a type left without entries is removed from the zone
+		void ResizeType(hash64_t typeHash, u64 entryCount);
+		u64 GetEntryCount(hash64_t typeHash) const;
+
+		// Writes the zone with the changes, and the manifest that goes with it
+		void Build(FBufferWriter& archive, ZoneManifest& manifest);
+
+		const ZoneIncrementalBuildStats& GetStats() const { return m_Stats; }
+	private:
+		enum class TypeChange
+		{
+			None,
+			Patched,
+			Rewritten
+		};
+
+		struct EntryEdit
+		{
+			u64 offset; // In m_EditData
+			u64 size;
+			hash64_t hash;
+		};
+
+		struct TypeState
+		{
+			hash64_t typeHash = 0;
+			const ZoneManifestType* previous = nullptr; // In m_Manifest, nullptr for a type added since
+			u64 previousStart = 0; // Offset of the type in the previous payload
+			u64 previousEnd = 0; // Where the next type started
+			u64 previousFirstEntry = 0;
+			u64 entryCount = 0;
+			map<u64, EntryEdit> edits; // By entry index
+
+			// Filled by Build()
+			TypeChange change = TypeChange::None;
+			u64 start = 0;
+			u64 payloadSize = 0;
+			u64 end = 0; // Where the next type starts
+			vector<byte> payload; // Rewritten types only
+			vector<u64> entryOffsets; // Rewritten types only, relative to start
+		};
+
+		// A changed range of the new payload, with the bytes that go there
+		struct PayloadPatch
+		{
+			u64 offset;
+			const byte* data;
+			u64 size;
+		};
+
+		struct PayloadRange
+		{
+			u64 begin;
+			u64 end;
+		};
+
+		TypeState* FindType(hash64_t typeHash);
+		u64 GetPreviousEntrySize(const TypeState& type, u64 entryIndex) const;
+		const byte* GetPreviousPayload(u64 begin, u64 end) const;
+		void LayoutType(TypeState& type);
+		void RewriteType(TypeState& type);
+		// Adds the ranges of the new payload that differ from the previous one for the type and its padding
+		void AddChangedRanges(const TypeState& type);
+		bool IsBlockReusable(u64 blockIndex, u64 payloadSize) const;
+		// Fills the bytes [begin, end) of the new payload
+		void FillPayload(byte* destination, u64 begin, u64 end) const;
+		void SerializePayload(FBufferWriter& archive, u64 payloadSize);
+		void Reset();
+	private:
+		Zone m_Previous{};
+		ZoneManifest m_Manifest; // Of the previous zone
+		vector<TypeState> m_Types; // Previous types first, in the order of the zone
+		FDynamicBufferWriter m_EditData; // Serialized entries set since Open()
+
+		vector<PayloadPatch> m_Patches; // Sorted by offset
+		vector<PayloadRange> m_ChangedRanges; // Where the new payload differs from the previous one, sorted and disjoint
+		ZoneIncrementalBuildStats m_Stats;
+	};
+}
@@ -0,0 +1,212 @@
+#include "zone_loader.h"
+#include "zone_config.h"
+
+#include "async/async_task_leaf.h"
+#include "async/async_task_graph.h"
+#include "async/async_orchestrator.h"
+#include "async/async_parallel_for.h"
+#include "async/async_hobj_load_task.h"
+
+#include "core/allocator/memory_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace hdn
+{
+	// Load callbacks may be expensive (GPU uploads, ...), keep the batches small
+	static constexpr u64 ZONE_LOAD_GRAIN_SIZE = 256;
+
+	class ZoneLoader::TypeLoadTask : public ITaskLeaf
+	{
+	public:
+		TypeLoadTask(ZoneLoader& loader, u64 typeIndex)
+			: m_Loader{ loader }, m_TypeIndex{ typeIndex }
+		{
+		}
+
+		virtual void Execute() override
+		{
+			HMEMORY_TAG("hzone");
+			const auto start = std::chrono::steady_clock::now();
+			const Zone& zone = *m_Loader.m_Zone;
+			LoadedType& type = m_Loader.m_LoadedTypes[m_TypeIndex];
+			if (ZoneConfigurator::ZoneLoadDataFunc load = ZoneConfigurator::Get().GetLoadFunc(type.typeHash))
+			{
+				type.instances.resize(type.entryCount * type.instanceSize);
+				ParallelFor(0, type.entryCount, ZONE_LOAD_GRAIN_SIZE, [&](u64 begin, u64 end) {
+					for (u64 i = begin; i < end; i++)
+					{
+						load(&zone.dataPayload[zone.dataOffsets[type.firstEntry + i]], type.instances.data() + i * type.instanceSize);
+					}
+				});
+			}
+			m_LoadTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+			Complete();
+		}
+
+		virtual const char* GetName() const override { return "ZoneTypeLoad"; }
+
+		f64 GetLoadTime() const { return m_LoadTime; }
+	private:
+		ZoneLoader& m_Loader;
+		u64 m_TypeIndex;
+		f64 m_LoadTime = 0.0;
+	};
+
+	ZoneLoader::~ZoneLoader()
+	{
+		Unload();
+	}
+
+	bool ZoneLoader::Load(const char* path, HObjectLoadFlags flags)
+	{
+		HMEMORY_TAG("hzone");
+		Unload();
+
+		// The file is read on the IO workers, the compute workers stay available meanwhile
+		const auto start = std::chrono::steady_clock::now();
+		HObjectLoadTask<HZone> readTask{ path, flags };
+		readTask.Enqueue();
+		AsyncOrchestrator::Get().Wait(&readTask);
+		const f64 readTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		HObjPtr<HZone> zoneObject = readTask.GetObject();
+		if (zoneObject == nullptr)
+		{
+			HERR("Could not read the zone '{0}'", path);
+			return false;
+		}
+
+		const bool loaded = Load(zoneObject->GetZone());
+		m_ZoneObject = zoneObject;
+		m_ReadTime = readTime;
+		return loaded;
+	}
+
+	bool ZoneLoader::Load(const Zone& zone)
+	{
+		HMEMORY_TAG("hzone");
+		Unload();
+
+		const auto start = std::chrono::steady_clock::now();
+		ZoneSerializerConfig& serializerConfig = ZoneSerializerConfig::Get();
+		ZoneConfigurator& configurator = ZoneConfigurator::Get();
+
+		vector<hash64_t> loadOrder(zone.sortedTypeHash, zone.sortedTypeHash + zone.typeCount);
+		if (!serializerConfig.ResolveTypeDependency(loadOrder))
+		{
+			return false;
+		}
+
+		// The load callbacks read the payload directly, every block is decompressed up front on the workers
+		const auto decompressStart = std::chrono::steady_clock::now();
+		zone.DecompressPayload();
+		m_DecompressTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - decompressStart).count();
+
+		m_Zone = &zone;
+		m_LoadedTypes.resize(zone.typeCount);
+		for (u64 typeIndex = 0; typeIndex < zone.typeCount; typeIndex++)
+		{
+			LoadedType& type = m_LoadedTypes[typeIndex];
+			u64 endEntry = 0;
+			zone.GetTypeEntryRange(typeIndex, type.firstEntry, endEntry);
+			type.typeHash = zone.sortedTypeHash[typeIndex];
+			type.entryCount = endEntry - type.firstEntry;
+			type.instanceSize = configurator.GetLoadFunc(type.typeHash) != nullptr ? configurator.GetTypeSize(type.typeHash) : 0;
+		}
+		for (hash64_t typeHash : loadOrder)
+		{
+			m_LoadOrder.push_back(zone.GetTypeIndex(typeHash).value());
+		}
+
+		// Every type is a node, types without callback too: they carry the dependencies of the types they depend on
+		ITaskGraph graph;
+		vector<Scope<TypeLoadTask>> tasks(zone.typeCount);
+		for (u64 typeIndex = 0; typeIndex < zone.typeCount; typeIndex++)
+		{
+			tasks[typeIndex] = CreateScope<TypeLoadTask>(*this, typeIndex);
+			graph.AddTask(tasks[typeIndex].get());
+		}
+		vector<hash64_t> dependencies;
+		for (u64 typeIndex = 0; typeIndex < zone.typeCount; typeIndex++)
+		{
+			dependencies.clear();
+			serializerConfig.GetTypeDependencies(m_LoadedTypes[typeIndex].typeHash, dependencies);
+			for (hash64_t dependency : dependencies)
+			{
+				optional<u64> dependencyIndex = zone.GetTypeIndex(dependency);
+				if (dependencyIndex != eastl::nullopt)
+				{
+					graph.AddEdge(tasks[dependencyIndex.value()].get(), tasks[typeIndex].get());
+				}
+			}
+		}
+
+		if (zone.typeCount > 0)
+		{
+			graph.Enqueue();
+			AsyncOrchestrator::Get().Wait(&graph);
+		}
+
+		for (u64 typeIndex : m_LoadOrder)
+		{
+			const LoadedType& type = m_LoadedTypes[typeIndex];
+			m_TypeReports.push_back({ type.typeHash, type.entryCount, tasks[typeIndex]->GetLoadTime() });
+		}
+		m_LoadTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}
+
+	void ZoneLoader::Unload()
+	{
+		ZoneConfigurator& configurator = ZoneConfigurator::Get();
+		for (auto it = m_LoadOrder.rbegin(); it != m_LoadOrder.rend(); ++it)
+		{
+			LoadedType& type = m_LoadedTypes[*it];
+			ZoneConfigurator::ZoneUnloadDataFunc unload = configurator.GetUnloadFunc(type.typeHash);
+			if (unload == nullptr || type.instances.empty())
+			{
+				continue;
+			}
+			ParallelFor(0, type.entryCount, ZONE_LOAD_GRAIN_SIZE, [&](u64 begin, u64 end) {
+				for (u64 i = begin; i < end; i++)
+				{
+					unload(type.instances.data() + i * type.instanceSize);
+				}
+			});
+		}
+
+		m_Zone = nullptr;
+		m_ZoneObject = nullptr;
+		m_LoadedTypes.clear();
+		m_LoadOrder.clear();
+		m_TypeReports.clear();
+		m_ReadTime = 0.0;
+		m_DecompressTime = 0.0;
+		m_LoadTime = 0.0;
+	}
+
+	const void* ZoneLoader::GetLoadedData(hkey key) const
+	{
+		if (m_Zone == nullptr)
+		{
+			return nullptr;
+		}
+
+		optional<u64> keyIndex = m_Zone->GetKeyIndex(key);
+		if (keyIndex == eastl::nullopt)
+		{
+			return nullptr;
+		}
+
+		// The keys of a type end at its keyMaxPerType
+		const u64 typeIndex = std::upper_bound(m_Zone->keyMaxPerType, m_Zone->keyMaxPerType + m_Zone->typeCount, key) - m_Zone->keyMaxPerType;
+		if (typeIndex >= m_LoadedTypes.size() || m_LoadedTypes[typeIndex].instances.empty())
+		{
+			return nullptr;
+		}
+		const LoadedType& type = m_LoadedTypes[typeIndex];
+		return type.instances.data() + (keyIndex.value() - type.firstEntry) * type.instanceSize;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/hash.h"
+#include "core/hkey/hkey.h"
+#include "core/hobj/hobj.h"
+#include "core/stl/vector.h"
+
+#include "hzone.h"
+#include "zone.h"
+
+namespace hdn
+{
+	struct ZoneTypeLoadReport
+	{
+		hash64_t typeHash;
+		u64 entryCount;
+		f64 loadTime; // Milliseconds, 0 for types without load callback
+	};
+
+	// Runtime side of a zone: reads it on the IO workers, then runs the ZoneConfigurator load callback of every entry
+	// One task per type on the compute workers (the entries of a type are split with ParallelFor), a type only starts
+	// once the types it depends on (ZoneSerializerConfig::AddTypeDependency()) are loaded
+	// The load callbacks write the runtime instances to buffers owned by the loader, types without callback are used in place
+	class ZoneLoader
+	{
+	public:
+		ZoneLoader() = default;
+		~ZoneLoader();
+
+		ZoneLoader(const ZoneLoader&) = delete;
+		ZoneLoader& operator=(const ZoneLoader&) = delete;
+
+		// Blocks until the zone is read and loaded, returns false if it cannot be read or its types have a circular dependency
+		bool Load(const char* path, HObjectLoadFlags flags = HObjectLoadFlags::MemoryMap);
+		// Loads a zone that is already read, it must outlive the loader
+		bool Load(const Zone& zone);
+		// Runs the unload callbacks, dependent types first, and releases the runtime instances
+		void Unload();
+
+		// Runtime instance of the key, nullptr if its type has no load callback (its data is then Zone::GetKeyData())
+		const void* GetLoadedData(hkey key) const;
+
+		const Zone* GetZone() const { return m_Zone; }
+		// In load order
+		const vector<ZoneTypeLoadReport>& GetTypeReports() const { return m_TypeReports; }
+		f64 GetReadTime() const { return m_ReadTime; }
+		// Part of the load time, for zones with a compressed payload
+		f64 GetDecompressTime() const { return m_DecompressTime; }
+		f64 GetLoadTime() const { return m_LoadTime; }
+	private:
+		struct LoadedType
+		{
+			hash64_t typeHash = 0;
+			u64 firstEntry = 0;
+			u64 entryCount = 0;
+			u64 instanceSize = 0;
+			vector<byte> instances; // Empty for types without load callback
+		};
+
+		class TypeLoadTask;
+	private:
+		const Zone* m_Zone = nullptr;
+		HObjPtr<HZone> m_ZoneObject = nullptr; // Set when the loader read the zone itself
+		vector<LoadedType> m_LoadedTypes; // Zone type order
+		vector<u64> m_LoadOrder; // Indices in m_LoadedTypes, dependencies first
+		vector<ZoneTypeLoadReport> m_TypeReports;
+		f64 m_ReadTime = 0.0;
+		f64 m_DecompressTime = 0.0;
+		f64 m_LoadTime = 0.0;
+	};
+}
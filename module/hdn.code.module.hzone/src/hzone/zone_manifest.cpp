@@ -0,0 +1,101 @@
+#include "zone_manifest.h"
+
+#include "core/io/common.h"
+#include "core/io/buffer_reader.h"
+#include "core/io/dynamic_buffer_writer.h"
+
+#include <fstream>
+
+namespace hdn
+{
+	const ZoneManifestType* ZoneManifest::FindType(hash64_t typeHash) const
+	{
+		for (const ZoneManifestType& type : types)
+		{
+			if (type.typeHash == typeHash)
+			{
+				return &type;
+			}
+		}
+		return nullptr;
+	}
+
+	u64 ZoneManifest::GetEntryCount() const
+	{
+		u64 entryCount = 0;
+		for (const ZoneManifestType& type : types)
+		{
+			entryCount += type.entryHashes.size();
+		}
+		return entryCount;
+	}
+
+	bool ZoneManifest::Save(const fspath& path) const
+	{
+		FDynamicBufferWriter writer{ (4 + 3 * types.size() + GetEntryCount()) * sizeof(u64) };
+		bin::Write(writer, ZONE_MANIFEST_MAGIC_NUMBER);
+		bin::Write(writer, minKeyValue);
+		bin::Write(writer, static_cast<u64>(types.size()));
+		for (const ZoneManifestType& type : types)
+		{
+			bin::Write(writer, type.typeHash);
+			bin::Write(writer, type.payloadSize);
+			bin::Write(writer, static_cast<u64>(type.entryHashes.size()));
+			writer.Write(type.entryHashes.data(), type.entryHashes.size());
+		}
+
+		std::ofstream outFile(path, std::ios::binary);
+		outFile.write(writer.begin<char>(), writer.BytesWritten());
+		if (!outFile)
+		{
+			HERR("Could not write the zone manifest '{0}'", path.string().c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool ZoneManifest::Load(const fspath& path, ZoneManifest& manifest)
+	{
+		std::ifstream inFile(path, std::ios::binary | std::ios::ate);
+		if (!inFile)
+		{
+			HERR("Could not open the zone manifest '{0}'", path.string().c_str());
+			return false;
+		}
+		vector<byte> buffer(static_cast<u64>(inFile.tellg()));
+		inFile.seekg(0);
+		inFile.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+
+		FBufferReader reader{ buffer.data(), buffer.size() };
+		if (reader.Read<u64>() != ZONE_MANIFEST_MAGIC_NUMBER)
+		{
+			HERR("'{0}' is not a zone manifest", path.string().c_str());
+			return false;
+		}
+		manifest.minKeyValue = reader.Read<hkey>();
+		// The counts are checked against what is left before anything is allocated
+		const u64 typeCount = reader.Read<u64>();
+		bool valid = typeCount <= reader.Remaining() / (3 * sizeof(u64));
+		manifest.types.resize(valid ? typeCount : 0);
+		for (ZoneManifestType& type : manifest.types)
+		{
+			type.typeHash = reader.Read<hash64_t>();
+			type.payloadSize = reader.Read<u64>();
+			const u64 entryCount = reader.Read<u64>();
+			valid = !reader.IsTruncated() && entryCount <= reader.Remaining() / sizeof(hash64_t);
+			if (!valid)
+			{
+				break;
+			}
+			const hash64_t* entryHashes = reader.Read<hash64_t>(entryCount);
+			type.entryHashes.assign(entryHashes, entryHashes + entryCount);
+		}
+		if (!valid || reader.IsTruncated())
+		{
+			HERR("Truncated zone manifest '{0}'", path.string().c_str());
+			manifest.types.clear();
+			return false;
+		}
+		return true;
+	}
+}
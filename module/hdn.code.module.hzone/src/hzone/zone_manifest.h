@@ -0,0 +1,40 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/core_filesystem.h"
+#include "core/hash.h"
+#include "core/hkey/hkey.h"
+#include "core/stl/vector.h"
+
+namespace hdn
+{
+	// "ZMAN", then minKeyValue, typeCount, and per type: typeHash, payloadSize, entryCount, entryHashes[entryCount]
+	static constexpr u64 ZONE_MANIFEST_MAGIC_NUMBER = 0x4E414D5A;
+
+	// Hash of the bytes of an entry, empty entries included
+	inline hash64_t HashZoneEntry(const void* entry, u64 size)
+	{
+		return size != 0 ? GenerateHash(entry, size) : 0;
+	}
+
+	struct ZoneManifestType
+	{
+		hash64_t typeHash;
+		u64 payloadSize; // Without the padding up to the next type
+		vector<hash64_t> entryHashes; // GenerateHash() of what AddEntry() wrote for the entry, its row for a type saved in columns
+	};
+
+	// Content hash of every entry of a built zone, kept next to it: the next build compares against it to only
+	// redo what changed (see ZoneIncrementalBuilder)
+	struct ZoneManifest
+	{
+		hkey minKeyValue = nullhkey;
+		vector<ZoneManifestType> types; // In the order of the zone
+
+		const ZoneManifestType* FindType(hash64_t typeHash) const;
+		u64 GetEntryCount() const;
+
+		bool Save(const fspath& path) const;
+		static bool Load(const fspath& path, ZoneManifest& manifest);
+	};
+}
@@ -2,6 +2,11 @@
 #include "zone_config.h"
 
 #include "core/io/common.h"
+#include "core/io/block_compression.h"
+
+#include "async/async_parallel_for.h"
+
+#include <algorithm>
 
 namespace hdn
 {
@@ -14,21 +19,48 @@ namespace hdn
 		}
 
 		// 3. Register
-		m_DataOffsets[typeHash].push_back(m_Data[typeHash].size());
-
-		auto& dataVector = m_Data[typeHash];
+		FDynamicBufferWriter& dataWriter = m_Data[typeHash];
+		const u64 entryOffset = dataWriter.BytesWritten();
 
-		if (ZoneSerializerConfig::Get().HasSerializeFunc(typeHash))
+		if (ZoneSerializerConfig::ZoneSerializeDataFunc serialize = ZoneSerializerConfig::Get().GetSerializeFunc(typeHash))
 		{
-			m_TempDynamicSerializationWriter.Reset();
-			ZoneSerializerConfig::Get().Serialize(typeHash, data, m_TempDynamicSerializationWriter);
-			dataVector.insert(dataVector.end(), m_TempDynamicSerializationWriter.begin<byte>(), m_TempDynamicSerializationWriter.end<byte>());
+			serialize(data, dataWriter);
 		}
 		else
 		{
 			// Only work for POD type
-			dataVector.insert(dataVector.end(), reinterpret_cast<const byte*>(data), reinterpret_cast<const byte*>(data) + dataSize);
+			dataWriter.Write(reinterpret_cast<const byte*>(data), dataSize);
 		}
+		m_DataOffsets[typeHash].push_back(m_Deduplicate ? DeduplicateEntry(typeHash, dataWriter, entryOffset) : entryOffset);
+	}
+
+	u64 ZoneSerializer::DeduplicateEntry(hash64_t typeHash, FDynamicBufferWriter& dataWriter, u64 entryOffset)
+	{
+		// Columns are gathered from the rows by entry index, every entry keeps its own row
+		const u64 entrySize = dataWriter.BytesWritten() - entryOffset;
+		if (entrySize == 0 || ZoneSerializerConfig::Get().GetColumns(typeHash) != nullptr)
+		{
+			return entryOffset;
+		}
+
+		// The entry is hashed once, where it was serialized, duplicates are then written and dropped again
+		const byte* entry = dataWriter.begin<byte>() + entryOffset;
+		auto [it, inserted] = m_StoredEntries[typeHash].try_emplace(GenerateHash(entry, entrySize), StoredEntry{ entryOffset, entrySize });
+		if (inserted)
+		{
+			return entryOffset;
+		}
+
+		// Only identical bytes are shared, an entry whose hash collides is kept as is
+		const StoredEntry& stored = it->second;
+		if (stored.size != entrySize || memcmp(dataWriter.begin<byte>() + stored.offset, entry, entrySize) != 0)
+		{
+			return entryOffset;
+		}
+		dataWriter.Truncate(entryOffset);
+		m_DeduplicatedEntryCount++;
+		m_DeduplicatedBytes += entrySize;
+		return stored.offset;
 	}
 
 	u64 ZoneSerializer::GetTotalEntryCount()
@@ -41,27 +73,177 @@ namespace hdn
 		return total;
 	}
 
+	u64 ZoneSerializer::ComputeTypePayloadOffsets(vector<u64>& typePayloadOffsets)
+	{
+		u64 payloadOffset = 0;
+		typePayloadOffsets.clear();
+		typePayloadOffsets.reserve(m_Types.size());
+		for (int i = 0; i < m_Types.size(); i++)
+		{
+			payloadOffset = AlignUp(payloadOffset, ZONE_PAYLOAD_ALIGNMENT);
+			typePayloadOffsets.push_back(payloadOffset);
+			payloadOffset += GetTypePayloadSize(m_Types[i]);
+		}
+		return payloadOffset;
+	}
+
+	u64 ZoneSerializer::GetTypePayloadSize(hash64_t typeHash)
+	{
+		if (const vector<ZoneColumn>* columns = ZoneSerializerConfig::Get().GetColumns(typeHash))
+		{
+			vector<u64> columnOffsets;
+			return ComputeColumnOffsets(*columns, m_DataOffsets[typeHash].size(), columnOffsets);
+		}
+		return m_Data[typeHash].BytesWritten();
+	}
+
+	void ZoneSerializer::SerializeColumns(hash64_t typeHash, const vector<ZoneColumn>& columns, byte* destination)
+	{
+		// The entries were added as is, every column gathers one field of each of them
+		FDynamicBufferWriter& rowWriter = m_Data.at(typeHash);
+		const u64 entryCount = m_DataOffsets.at(typeHash).size();
+		const u64 rowSize = ZoneSerializerConfig::Get().GetTypeSize(typeHash);
+		vector<u64> columnOffsets;
+		const u64 typePayloadSize = ComputeColumnOffsets(columns, entryCount, columnOffsets);
+		for (u64 c = 0; c < columns.size(); c++)
+		{
+			const ZoneColumn& column = columns[c];
+			byte* values = destination + columnOffsets[c];
+			ParallelFor(0, entryCount, ZONE_OFFSET_GRAIN_SIZE, [&](u64 begin, u64 end) {
+				GatherColumn(rowWriter.begin<byte>() + begin * rowSize, end - begin, rowSize, column, values + begin * column.size);
+			});
+
+			const u64 columnEnd = columnOffsets[c] + column.size * entryCount;
+			const u64 nextColumnStart = c + 1 < columns.size() ? columnOffsets[c + 1] : typePayloadSize;
+			memset(destination + columnEnd, 0, nextColumnStart - columnEnd);
+		}
+	}
+
 	void ZoneSerializer::SerializeDataPayload(FBufferWriter& archive)
 	{
+		archive.Align(ZONE_PAYLOAD_ALIGNMENT);
+		if (m_PayloadBlockSize != 0)
+		{
+			archive.Write(m_CompressedPayload.data(), m_CompressedPayload.size());
+			vector<byte>().swap(m_CompressedPayload);
+			return;
+		}
+
+		// Reserve the whole payload up front, then every type copies its bytes to its own slot in parallel
+		vector<u64> typePayloadOffsets;
+		const u64 payloadSize = ComputeTypePayloadOffsets(typePayloadOffsets);
+		// Taken after the advance, the writer may have grown its buffer
+		archive.Advance<byte>(payloadSize);
+		if (archive.IsOverflowed())
+		{
+			return;
+		}
+		FillDataPayload(archive.end<byte>() - payloadSize, typePayloadOffsets, payloadSize);
+	}
+
+	void ZoneSerializer::FillDataPayload(byte* payloadBase, const vector<u64>& typePayloadOffsets, u64 payloadSize)
+	{
+		// Zero the padding between the types, the writer buffer is not necessarily cleared
 		for (int i = 0; i < m_Types.size(); i++)
 		{
-			const auto& currentDataVector = m_Data[m_Types[i]];
-			archive.Write<const byte>(&currentDataVector[0], (u64)currentDataVector.size());
+			const u64 typeEnd = typePayloadOffsets[i] + GetTypePayloadSize(m_Types[i]);
+			const u64 nextTypeStart = i + 1 < m_Types.size() ? typePayloadOffsets[i + 1] : payloadSize;
+			memset(payloadBase + typeEnd, 0, nextTypeStart - typeEnd);
 		}
+
+		const ZoneSerializerConfig& config = ZoneSerializerConfig::Get();
+		ParallelFor(0, m_Types.size(), 1, [&](u64 i) {
+			byte* destination = payloadBase + typePayloadOffsets[i];
+			if (const vector<ZoneColumn>* columns = config.GetColumns(m_Types[i]))
+			{
+				SerializeColumns(m_Types[i], *columns, destination);
+				return;
+			}
+
+			FDynamicBufferWriter& currentDataWriter = m_Data.at(m_Types[i]);
+			const byte* source = currentDataWriter.begin<byte>();
+			ParallelFor(0, currentDataWriter.BytesWritten(), ZONE_PAYLOAD_COPY_GRAIN_SIZE, [&](u64 begin, u64 end) {
+				memcpy(destination + begin, source + begin, end - begin);
+			});
+		});
+	}
+
+	void ZoneSerializer::CompressDataPayload()
+	{
+		vector<u64> typePayloadOffsets;
+		const u64 payloadSize = ComputeTypePayloadOffsets(typePayloadOffsets);
+		Scope<byte[]> payload{ new byte[payloadSize] };
+		FillDataPayload(payload.get(), typePayloadOffsets, payloadSize);
+
+		// Every block is packed at its uncompressed offset, where it always fits, then the blocks are moved back to back
+		const u64 blockCount = (payloadSize + m_PayloadBlockSize - 1) / m_PayloadBlockSize;
+		vector<u64> storedSizes(blockCount);
+		m_CompressedPayload.resize(payloadSize);
+		ParallelFor(0, blockCount, 1, [&](u64 blockIndex) {
+			const u64 blockStart = blockIndex * m_PayloadBlockSize;
+			storedSizes[blockIndex] = PackBlock(payload.get() + blockStart, std::min(m_PayloadBlockSize, payloadSize - blockStart), m_CompressedPayload.data() + blockStart);
+		});
+
+		u64 storedSize = 0;
+		m_PayloadBlockEnds.resize(blockCount);
+		for (u64 blockIndex = 0; blockIndex < blockCount; blockIndex++)
+		{
+			memmove(m_CompressedPayload.data() + storedSize, m_CompressedPayload.data() + blockIndex * m_PayloadBlockSize, storedSizes[blockIndex]);
+			storedSize += storedSizes[blockIndex];
+			m_PayloadBlockEnds[blockIndex] = storedSize;
+		}
+		m_CompressedPayload.resize(storedSize);
+	}
+
+	void ZoneSerializer::SerializePayloadBlocks(FBufferWriter& archive)
+	{
+		bin::Write(archive, m_PayloadBlockSize);
+		if (m_PayloadBlockSize == 0)
+		{
+			return;
+		}
+		CompressDataPayload();
+		archive.Write(m_PayloadBlockEnds.data(), m_PayloadBlockEnds.size());
 	}
 
 	void ZoneSerializer::SerializeDataOffset(FBufferWriter& archive)
 	{
-		u64 globalOffset = 0;
+		const u64 entryCount = GetTotalEntryCount();
+		archive.Advance<u64>(entryCount);
+		if (archive.IsOverflowed())
+		{
+			return;
+		}
+		u64* offsetBase = archive.end<u64>() - entryCount;
+		vector<u64> typePayloadOffsets;
+		ComputeTypePayloadOffsets(typePayloadOffsets);
+		u64 globalEntryIndex = 0;
 		for (int i = 0; i < m_Types.size(); i++)
 		{
-			const auto& currentDataVector = m_Data[m_Types[i]];
+			const u64 globalOffset = typePayloadOffsets[i];
 			const auto& currentDataOffsetVector = m_DataOffsets[m_Types[i]];
-			for (int j = 0; j < currentDataOffsetVector.size(); j++)
+			u64* typeOffsetBase = offsetBase + globalEntryIndex;
+			if (const vector<ZoneColumn>* columns = ZoneSerializerConfig::Get().GetColumns(m_Types[i]))
 			{
-				archive.Write<u64>(globalOffset + currentDataOffsetVector[j]);
+				// An entry points to its value in the first column
+				const u64 valueSize = (*columns)[0].size;
+				ParallelFor(0, currentDataOffsetVector.size(), ZONE_OFFSET_GRAIN_SIZE, [&](u64 begin, u64 end) {
+					for (u64 j = begin; j < end; j++)
+					{
+						typeOffsetBase[j] = globalOffset + j * valueSize;
+					}
+				});
 			}
-			globalOffset += currentDataVector.size();
+			else
+			{
+				ParallelFor(0, currentDataOffsetVector.size(), ZONE_OFFSET_GRAIN_SIZE, [&](u64 begin, u64 end) {
+					for (u64 j = begin; j < end; j++)
+					{
+						typeOffsetBase[j] = globalOffset + currentDataOffsetVector[j];
+					}
+				});
+			}
+			globalEntryIndex += currentDataOffsetVector.size();
 		}
 	}
 
@@ -83,13 +265,20 @@ namespace hdn
 
 	void ZoneSerializer::SerializeSortedKeys(FBufferWriter& archive)
 	{
+		// One key per entry, reserved once so the loop does not check every write
+		if (!archive.Reserve(GetTotalEntryCount() * sizeof(hkey)))
+		{
+			return;
+		}
+
 		hkey currentKey = m_MinKeyValue;
+		m_KeyMaxPerType.clear();
 		m_KeyMaxPerType.reserve(m_DataOffsets.size());
 		for (int i = 0; i < m_Types.size(); i++)
 		{
 			for (int j = 0; j < m_DataOffsets[m_Types[i]].size(); j++)
 			{
-				bin::Write(archive, currentKey);
+				archive.WriteUnchecked(currentKey);
 				currentKey++;
 			}
 			m_KeyMaxPerType.emplace_back(currentKey);
@@ -98,11 +287,8 @@ namespace hdn
 
 	void ZoneSerializer::SerializeTotalDataPayloadSize(FBufferWriter& archive)
 	{
-		u64 totalDataPayloadSize = 0;
-		for (int i = 0; i < m_Types.size(); i++)
-		{
-			totalDataPayloadSize += m_Data[m_Types[i]].size();
-		}
+		vector<u64> typePayloadOffsets;
+		const u64 totalDataPayloadSize = ComputeTypePayloadOffsets(typePayloadOffsets);
 		bin::Write(archive, totalDataPayloadSize);
 	}
 
@@ -118,9 +304,41 @@ namespace hdn
 		bin::Write(archive, keyCount);
 	}
 
+	bool ZoneSerializer::BuildManifest(ZoneManifest& manifest)
+	{
+		if (m_DeduplicatedEntryCount > 0)
+		{
+			HERR("ZoneSerializer: {0} entries share their data, the zone cannot be built incrementally", m_DeduplicatedEntryCount);
+			return false;
+		}
+
+		manifest.minKeyValue = m_MinKeyValue;
+		manifest.types.resize(m_Types.size());
+		for (int i = 0; i < m_Types.size(); i++)
+		{
+			ZoneManifestType& type = manifest.types[i];
+			type.typeHash = m_Types[i];
+			type.payloadSize = GetTypePayloadSize(m_Types[i]);
+
+			// Entries are written back to back, one ends where the next one starts
+			const FDynamicBufferWriter& dataWriter = m_Data.at(m_Types[i]);
+			const vector<u64>& entryOffsets = m_DataOffsets.at(m_Types[i]);
+			type.entryHashes.resize(entryOffsets.size());
+			ParallelFor(0, entryOffsets.size(), ZONE_OFFSET_GRAIN_SIZE, [&](u64 begin, u64 end) {
+				for (u64 j = begin; j < end; j++)
+				{
+					const u64 entryEnd = j + 1 < entryOffsets.size() ? entryOffsets[j + 1] : dataWriter.BytesWritten();
+					type.entryHashes[j] = HashZoneEntry(dataWriter.begin<byte>() + entryOffsets[j], entryEnd - entryOffsets[j]);
+				}
+			});
+		}
+		return true;
+	}
+
 	void ZoneSerializer::Serialize(FBufferWriter& archive)
 	{
 		// TODO: Sort the m_Type vector topologically
+		archive.Align(ZONE_SECTION_ALIGNMENT);
 		SerializeKeyCount(archive);
 		SerializeSortedKeys(archive);
 
@@ -130,6 +348,7 @@ namespace hdn
 		SerializeSortedTypes(archive);
 		SerializeKeyMaxPerType(archive);
 		SerializeDataOffset(archive);
+		SerializePayloadBlocks(archive);
 		SerializeDataPayload(archive);
 	}
 }
\ No newline at end of file
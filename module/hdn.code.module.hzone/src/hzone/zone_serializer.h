@@ -4,12 +4,20 @@
 #include "core/hash.h"
 #include "core/stl/vector.h"
 #include "core/stl/map.h"
+#include "core/stl/unordered_map.h"
 #include "core/io/buffer_writer.h"
 #include "core/io/dynamic_buffer_writer.h"
 #include "core/hkey/hkey.h"
 
+#include "zone.h"
+#include "zone_manifest.h"
+
 namespace hdn
 {
+	// ParallelFor grain sizes of the zone builders, ZoneIncrementalBuilder fills the payload and the offsets like ZoneSerializer does
+	static constexpr u64 ZONE_PAYLOAD_COPY_GRAIN_SIZE = 256 * KB;
+	static constexpr u64 ZONE_OFFSET_GRAIN_SIZE = 16 * KB;
+
 	class ZoneSerializer
 	{
 	public:
@@ -22,9 +30,20 @@ namespace hdn
 		}
 
 		void SetMinKeyValue(hkey minKeyValue) { m_MinKeyValue = minKeyValue; }
+		// Compress the payload in blocks of blockSize bytes (compressed in parallel), 0 saves it uncompressed
+		// Smaller blocks make key lookups decompress less, bigger ones compress better
+		void SetPayloadCompression(u64 blockSize = ZONE_DEFAULT_PAYLOAD_BLOCK_SIZE) { m_PayloadBlockSize = blockSize; }
+		// An entry with the same bytes as an entry of its type already added shares its offset instead of being saved again
+		// Set before adding entries. Types saved in columns are never deduplicated, and a type saved as is that had
+		// duplicates cannot be viewed as an array anymore (see Zone::View())
+		void SetDeduplication(bool enabled) { m_Deduplicate = enabled; }
+		// What the deduplication saved so far
+		u64 GetDeduplicatedEntryCount() const { return m_DeduplicatedEntryCount; }
+		u64 GetDeduplicatedBytes() const { return m_DeduplicatedBytes; }
 
 		void SerializeDataPayload(FBufferWriter& archive);
 		void SerializeDataOffset(FBufferWriter& archive);
+		void SerializePayloadBlocks(FBufferWriter& archive);
 		void SerializeKeyMaxPerType(FBufferWriter& archive);
 		void SerializeSortedTypes(FBufferWriter& archive);
 		void SerializeSortedKeys(FBufferWriter& archive);
@@ -32,16 +51,42 @@ namespace hdn
 		void SerializeTypeCount(FBufferWriter& archive);
 		void SerializeKeyCount(FBufferWriter& archive);
 		void Serialize(FBufferWriter& archive);
+		// Hashes every entry added so the next build of the zone can be incremental (see ZoneIncrementalBuilder)
+		// Fails on a zone with deduplicated entries, they cannot be changed one at a time
+		bool BuildManifest(ZoneManifest& manifest);
 	private:
 		u64 GetTotalEntryCount();
+		// Offset of the payload of every type (aligned to ZONE_PAYLOAD_ALIGNMENT), returns the payload size
+		u64 ComputeTypePayloadOffsets(vector<u64>& typePayloadOffsets);
+		// Entries saved as is, or the size of the columns for a columnar type
+		u64 GetTypePayloadSize(hash64_t typeHash);
+		void SerializeColumns(hash64_t typeHash, const vector<ZoneColumn>& columns, byte* destination);
+		// Copies the payload of every type to its slot in payloadBase
+		void FillDataPayload(byte* payloadBase, const vector<u64>& typePayloadOffsets, u64 payloadSize);
+		void CompressDataPayload();
+		// Called once the entry is written at entryOffset, drops it again if it duplicates a stored one
+		// Returns the offset the entry is found at
+		u64 DeduplicateEntry(hash64_t typeHash, FDynamicBufferWriter& dataWriter, u64 entryOffset);
 	private:
+		struct StoredEntry
+		{
+			u64 offset;
+			u64 size;
+		};
+
 		hkey m_MinKeyValue;
+		u64 m_PayloadBlockSize = 0;
+		vector<u64> m_PayloadBlockEnds;
+		vector<byte> m_CompressedPayload; // Filled by SerializePayloadBlocks(), written by SerializeDataPayload()
 
-		map<hash64_t, vector<byte>> m_Data; // The actual data to be saved per type
+		map<hash64_t, FDynamicBufferWriter> m_Data; // The actual data to be saved per type, entries are serialized straight into it
 		map<hash64_t, vector<u64>> m_DataOffsets;
 		vector<hash64_t> m_Types; // Could we use a set instead?
 
-		FDynamicBufferWriter m_TempDynamicSerializationWriter{ 1024 };
+		bool m_Deduplicate = false;
+		map<hash64_t, unordered_map<hash64_t, StoredEntry>> m_StoredEntries; // Per type, the first entry added with some content hash
+		u64 m_DeduplicatedEntryCount = 0;
+		u64 m_DeduplicatedBytes = 0;
 
 		// 
 		vector<u64> m_KeyMaxPerType;
@@ -0,0 +1,247 @@
+#include "zone_streaming_manager.h"
+
+#include "core/hobj/hobj_util.h"
+
+#include "async/async_task_leaf.h"
+#include "async/async_orchestrator.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace hdn
+{
+	// Streamed zones are not registered: the registry never releases its objects
+	class ZoneStreamingManager::ZoneLoadTask : public ITaskLeaf
+	{
+	public:
+		ZoneLoadTask(ZoneStreamingHandle handle, const fspath& path, HObjectLoadFlags flags)
+			: m_Handle{ handle }, m_Path{ path.string() }, m_Flags{ flags }
+		{
+		}
+
+		virtual void Execute() override
+		{
+			m_Zone = HObjectUtil::LoadDetached<HZone>(m_Path.c_str(), m_Flags);
+			Complete();
+		}
+
+		virtual TaskAffinity Affinity() const override { return TaskAffinity::IO; }
+		virtual const char* GetName() const override { return "ZoneStreamLoad"; }
+
+		ZoneStreamingHandle GetHandle() const { return m_Handle; }
+		// Only valid once the task is completed
+		HObjPtr<HZone> GetZone() const { return m_Zone; }
+	private:
+		ZoneStreamingHandle m_Handle;
+		string m_Path;
+		HObjectLoadFlags m_Flags;
+		HObjPtr<HZone> m_Zone = nullptr;
+	};
+
+	ZoneStreamingManager::ZoneStreamingManager(const ZoneStreamingSettings& settings)
+		: m_Settings{ settings }, m_ResidentZones{ settings.maxResidentZones }
+	{
+		HASSERT(m_Settings.keepDistance >= m_Settings.loadDistance, "ZoneStreamingManager: zones would be evicted as soon as they are loaded");
+		m_ResidentZones.setDeleteCallback([this](const ZoneStreamingHandle& handle) {
+			EvictZone(handle);
+		});
+	}
+
+	ZoneStreamingManager::~ZoneStreamingManager()
+	{
+		Flush();
+		while (m_ResidentZones.size() > 0)
+		{
+			m_ResidentZones.erase_oldest(1);
+		}
+	}
+
+	ZoneStreamingHandle ZoneStreamingManager::RegisterZone(const fspath& path, const vec3f32& boundsMin, const vec3f32& boundsMax, u64 residentSize)
+	{
+		StreamedZone& zone = m_Zones.emplace_back();
+		zone.path = path;
+		zone.boundsMin = boundsMin;
+		zone.boundsMax = boundsMax;
+		zone.residentSize = residentSize != 0 ? residentSize : FileSystem::FileSize(path);
+		m_Stats.registeredZoneCount = m_Zones.size();
+		return static_cast<ZoneStreamingHandle>(m_Zones.size() - 1);
+	}
+
+	void ZoneStreamingManager::SetPointOfInterest(u32 index, const vec3f32& position, const vec3f32& velocity)
+	{
+		if (index >= m_PointsOfInterest.size())
+		{
+			m_PointsOfInterest.resize(index + 1);
+		}
+		m_PointsOfInterest[index] = { position, velocity, true };
+	}
+
+	void ZoneStreamingManager::ClearPointsOfInterest()
+	{
+		m_PointsOfInterest.clear();
+	}
+
+	void ZoneStreamingManager::Update()
+	{
+		CollectLoads();
+
+		m_Requests.clear();
+		m_KeptZones.clear();
+		for (ZoneStreamingHandle handle = 0; handle < m_Zones.size(); handle++)
+		{
+			const StreamedZone& zone = m_Zones[handle];
+			f32 distance = std::numeric_limits<f32>::max();
+			f32 predictedDistance = std::numeric_limits<f32>::max();
+			for (const PointOfInterest& point : m_PointsOfInterest)
+			{
+				if (point.active)
+				{
+					distance = std::min(distance, DistanceToZone(zone, point.position));
+					predictedDistance = std::min(predictedDistance, DistanceToZone(zone, point.position + point.velocity * m_Settings.prefetchTime));
+				}
+			}
+
+			const bool needed = distance <= m_Settings.loadDistance;
+			const bool prefetch = !needed && predictedDistance <= m_Settings.loadDistance;
+			if (needed && (zone.state == ZoneState::Unloaded || zone.state == ZoneState::Loading))
+			{
+				m_Stats.missCount++;
+			}
+			if (zone.state == ZoneState::Resident && (distance <= m_Settings.keepDistance || prefetch))
+			{
+				m_KeptZones.push_back({ handle, std::min(distance, predictedDistance), prefetch });
+			}
+			if (zone.state == ZoneState::Unloaded && (needed || prefetch))
+			{
+				m_Requests.push_back({ handle, needed ? distance : predictedDistance, prefetch });
+			}
+		}
+
+		// The nearest zones are touched last, they are the last ones evicted
+		std::sort(m_KeptZones.begin(), m_KeptZones.end(), [](const ZoneRequest& a, const ZoneRequest& b) {
+			return a.distance > b.distance;
+		});
+		for (const ZoneRequest& kept : m_KeptZones)
+		{
+			m_ResidentZones.touch(kept.handle);
+		}
+		m_KeptResidentCount = m_KeptZones.size();
+
+		// Needed zones first, nearest first
+		std::sort(m_Requests.begin(), m_Requests.end(), [](const ZoneRequest& a, const ZoneRequest& b) {
+			return a.prefetch != b.prefetch ? !a.prefetch : a.distance < b.distance;
+		});
+		for (const ZoneRequest& request : m_Requests)
+		{
+			if (m_PendingLoads.size() >= m_Settings.maxConcurrentLoads)
+			{
+				break;
+			}
+
+			StreamedZone& zone = m_Zones[request.handle];
+			if (!MakeRoom(zone.residentSize))
+			{
+				m_Stats.deferredLoadCount++;
+				continue;
+			}
+
+			zone.state = ZoneState::Loading;
+			m_PendingBytes += zone.residentSize;
+			m_Stats.prefetchLoadCount += request.prefetch ? 1 : 0;
+			Scope<ZoneLoadTask>& task = m_PendingLoads.emplace_back(CreateScope<ZoneLoadTask>(request.handle, zone.path, m_Settings.loadFlags));
+			task->Enqueue();
+		}
+		m_Stats.pendingLoadCount = m_PendingLoads.size();
+	}
+
+	void ZoneStreamingManager::Flush()
+	{
+		for (const Scope<ZoneLoadTask>& task : m_PendingLoads)
+		{
+			AsyncOrchestrator::Get().Wait(task.get());
+		}
+		CollectLoads();
+	}
+
+	bool ZoneStreamingManager::IsResident(ZoneStreamingHandle handle) const
+	{
+		return m_Zones[handle].state == ZoneState::Resident;
+	}
+
+	const Zone* ZoneStreamingManager::GetZone(ZoneStreamingHandle handle) const
+	{
+		const StreamedZone& zone = m_Zones[handle];
+		return zone.state == ZoneState::Resident ? &zone.zone->GetZone() : nullptr;
+	}
+
+	void ZoneStreamingManager::CollectLoads()
+	{
+		for (u64 i = 0; i < m_PendingLoads.size();)
+		{
+			const ZoneLoadTask& task = *m_PendingLoads[i];
+			if (!task.Completed())
+			{
+				i++;
+				continue;
+			}
+
+			StreamedZone& zone = m_Zones[task.GetHandle()];
+			m_PendingBytes -= zone.residentSize;
+			zone.zone = task.GetZone();
+			if (zone.zone == nullptr)
+			{
+				HERR("Could not stream in the zone '{0}'", zone.path.string().c_str());
+				zone.state = ZoneState::Failed;
+				m_Stats.failedLoadCount++;
+			}
+			else
+			{
+				zone.state = ZoneState::Resident;
+				m_ResidentZones.insert(task.GetHandle(), task.GetHandle());
+				m_Stats.residentBytes += zone.residentSize;
+				m_Stats.peakResidentBytes = std::max(m_Stats.peakResidentBytes, m_Stats.residentBytes);
+				m_Stats.residentZoneCount++;
+				m_Stats.loadCount++;
+			}
+
+			m_PendingLoads[i] = std::move(m_PendingLoads.back());
+			m_PendingLoads.pop_back();
+		}
+		m_Stats.pendingLoadCount = m_PendingLoads.size();
+	}
+
+	bool ZoneStreamingManager::MakeRoom(u64 size)
+	{
+		// The kept zones are the newest entries, whatever is older is not needed anymore
+		// The loads in flight count against maxResidentZones: past its capacity, m_ResidentZones would evict its oldest
+		// entry on insert, kept or not
+		while (m_Stats.residentBytes + m_PendingBytes + size > m_Settings.memoryBudget ||
+			m_ResidentZones.size() + m_PendingLoads.size() >= m_Settings.maxResidentZones)
+		{
+			if (m_ResidentZones.size() <= m_KeptResidentCount)
+			{
+				return false;
+			}
+			m_ResidentZones.erase_oldest(1);
+		}
+		return true;
+	}
+
+	void ZoneStreamingManager::EvictZone(ZoneStreamingHandle handle)
+	{
+		// Called by m_ResidentZones when an entry is erased
+		StreamedZone& zone = m_Zones[handle];
+		delete zone.zone;
+		zone.zone = nullptr;
+		zone.state = ZoneState::Unloaded;
+		m_Stats.residentBytes -= zone.residentSize;
+		m_Stats.residentZoneCount--;
+		m_Stats.evictionCount++;
+	}
+
+	f32 ZoneStreamingManager::DistanceToZone(const StreamedZone& zone, const vec3f32& point)
+	{
+		const vec3f32 outside = glm::max(glm::max(zone.boundsMin - point, vec3f32{ 0.0f }), point - zone.boundsMax);
+		return glm::length(outside);
+	}
+}
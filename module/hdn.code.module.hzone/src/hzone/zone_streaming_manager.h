@@ -0,0 +1,128 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/core_filesystem.h"
+#include "core/hobj/hobj.h"
+#include "core/stl/vector.h"
+#include "core/stl/lru_cache.h"
+
+#include "hzone.h"
+
+namespace hdn
+{
+	using ZoneStreamingHandle = u32;
+
+	struct ZoneStreamingSettings
+	{
+		u64 memoryBudget = 512 * MB;
+		f32 loadDistance = 128.0f; // Zones closer than this to a point of interest are loaded
+		f32 keepDistance = 192.0f; // Resident zones closer than this are not evicted, must be >= loadDistance
+		f32 prefetchTime = 2.0f; // Seconds, zones around the position a point of interest reaches at its velocity are prefetched
+		u32 maxConcurrentLoads = 4;
+		u32 maxResidentZones = 4096; // Loading zones included, like the memory budget
+		HObjectLoadFlags loadFlags = HObjectLoadFlags::MemoryMap;
+	};
+
+	struct ZoneStreamingStats
+	{
+		u64 registeredZoneCount = 0;
+		u64 residentZoneCount = 0;
+		u64 pendingLoadCount = 0;
+		u64 residentBytes = 0;
+		u64 peakResidentBytes = 0;
+		u64 loadCount = 0;
+		u64 failedLoadCount = 0;
+		u64 prefetchLoadCount = 0; // Loads started for a predicted position only
+		u64 evictionCount = 0;
+		u64 deferredLoadCount = 0; // Loads postponed because the budget or maxResidentZones is used by zones that are still needed
+		u64 missCount = 0; // Zones within loadDistance of a point of interest that were not resident yet, counted every update
+	};
+
+	// Keeps the zones around points of interest (the camera, ...) resident within a memory budget
+	// Zones are loaded on the IO workers, resident zones are ordered in an lru_cache: every update touches the zones still
+	// needed (the nearest last), the oldest ones are evicted when a load does not fit in the budget
+	// Everything but the loads happens on the thread calling Update()
+	class ZoneStreamingManager
+	{
+	public:
+		ZoneStreamingManager(const ZoneStreamingSettings& settings = ZoneStreamingSettings{});
+		// Waits for the loads in flight and unloads every zone
+		~ZoneStreamingManager();
+
+		ZoneStreamingManager(const ZoneStreamingManager&) = delete;
+		ZoneStreamingManager& operator=(const ZoneStreamingManager&) = delete;
+
+		// residentSize is the memory the zone takes once loaded, the file size if 0
+		ZoneStreamingHandle RegisterZone(const fspath& path, const vec3f32& boundsMin, const vec3f32& boundsMax, u64 residentSize = 0);
+
+		// Set every frame, velocity in units per second
+		void SetPointOfInterest(u32 index, const vec3f32& position, const vec3f32& velocity = vec3f32{ 0.0f });
+		void ClearPointsOfInterest();
+
+		// Once per frame: collects the finished loads, evicts and requests zones around the points of interest
+		void Update();
+		// Blocks until the loads in flight are resident
+		void Flush();
+
+		bool IsResident(ZoneStreamingHandle handle) const;
+		// nullptr if the zone is not resident, only valid until the next Update()
+		const Zone* GetZone(ZoneStreamingHandle handle) const;
+
+		const ZoneStreamingStats& GetStats() const { return m_Stats; }
+		const ZoneStreamingSettings& GetSettings() const { return m_Settings; }
+	private:
+		enum class ZoneState : u8
+		{
+			Unloaded,
+			Loading,
+			Resident,
+			Failed // Not requested again
+		};
+
+		struct StreamedZone
+		{
+			fspath path;
+			vec3f32 boundsMin;
+			vec3f32 boundsMax;
+			u64 residentSize = 0;
+			ZoneState state = ZoneState::Unloaded;
+			HObjPtr<HZone> zone = nullptr;
+		};
+
+		struct PointOfInterest
+		{
+			vec3f32 position{ 0.0f };
+			vec3f32 velocity{ 0.0f };
+			bool active = false;
+		};
+
+		struct ZoneRequest
+		{
+			ZoneStreamingHandle handle;
+			f32 distance;
+			bool prefetch;
+		};
+
+		class ZoneLoadTask;
+
+		void CollectLoads();
+		bool MakeRoom(u64 size);
+		void EvictZone(ZoneStreamingHandle handle);
+		static f32 DistanceToZone(const StreamedZone& zone, const vec3f32& point);
+	private:
+		ZoneStreamingSettings m_Settings;
+		vector<StreamedZone> m_Zones;
+		vector<PointOfInterest> m_PointsOfInterest;
+
+		lru_cache<ZoneStreamingHandle, ZoneStreamingHandle> m_ResidentZones; // Handle to itself, only the order matters
+		u64 m_KeptResidentCount = 0; // The newest entries of m_ResidentZones, touched by the last update
+
+		vector<Scope<ZoneLoadTask>> m_PendingLoads;
+		u64 m_PendingBytes = 0;
+
+		// Reused every update
+		vector<ZoneRequest> m_Requests;
+		vector<ZoneRequest> m_KeptZones;
+		ZoneStreamingStats m_Stats;
+	};
+}
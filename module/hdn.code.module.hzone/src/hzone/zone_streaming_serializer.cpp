@@ -0,0 +1,358 @@
+#include "zone_streaming_serializer.h"
+#include "zone_config.h"
+
+#include "core/random.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+namespace hdn
+{
+	template<typename T>
+	static void WriteValue(std::ostream& out, const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	// Same padding as FBufferWriter::Align(), relative to the start of the stream
+	static void WritePadding(std::ostream& out, u64 alignment)
+	{
+		static constexpr char zeros[ZONE_PAYLOAD_ALIGNMENT] = {};
+		const u64 position = static_cast<u64>(out.tellp());
+		out.write(zeros, AlignUp(position, alignment) - position);
+	}
+
+	ZoneStreamingSerializer::ZoneStreamingSerializer(const fspath& tempDirectory, u64 memoryBudget)
+		: m_TempDirectory{ tempDirectory }, m_MemoryBudget{ memoryBudget }, m_SegmentPrefix{ GenerateUUID64() }
+	{
+		FileSystem::CreateDirectory(m_TempDirectory);
+	}
+
+	ZoneStreamingSerializer::~ZoneStreamingSerializer()
+	{
+		RemoveSegmentFiles();
+	}
+
+	void ZoneStreamingSerializer::AddEntry(hash64_t typeHash, const void* data, u64 dataSize)
+	{
+		TypeSegment& segment = GetSegment(typeHash);
+		const u64 memoryBefore = GetSegmentMemory(segment);
+
+		segment.offsets.push_back(segment.spilledPayloadSize + segment.payload.BytesWritten());
+		if (ZoneSerializerConfig::ZoneSerializeDataFunc serialize = ZoneSerializerConfig::Get().GetSerializeFunc(typeHash))
+		{
+			serialize(data, segment.payload);
+		}
+		else
+		{
+			// Only work for POD type
+			segment.payload.Write(reinterpret_cast<const byte*>(data), dataSize);
+		}
+		segment.entryCount++;
+		segment.payloadSize = segment.spilledPayloadSize + segment.payload.BytesWritten();
+
+		m_MemoryUsed += GetSegmentMemory(segment) - memoryBefore;
+		m_PeakMemory = std::max(m_PeakMemory, m_MemoryUsed);
+		if (m_MemoryUsed > m_MemoryBudget && !Spill())
+		{
+			m_Failed = true;
+		}
+	}
+
+	bool ZoneStreamingSerializer::Serialize(std::ostream& out)
+	{
+		if (m_Failed)
+		{
+			HERR("Cannot serialize the zone, spilling its segments to '{0}' failed", m_TempDirectory.string().c_str());
+			return false;
+		}
+
+		vector<byte> stagingBuffer(STAGING_BUFFER_SIZE);
+		u64 keyCount = 0;
+		u64 payloadSize = 0;
+		vector<u64> typePayloadOffsets;
+		vector<u64> columnOffsets;
+		for (const Scope<TypeSegment>& segment : m_Segments)
+		{
+			keyCount += segment->entryCount;
+			payloadSize = AlignUp(payloadSize, ZONE_PAYLOAD_ALIGNMENT);
+			typePayloadOffsets.push_back(payloadSize);
+			const vector<ZoneColumn>* columns = ZoneSerializerConfig::Get().GetColumns(segment->typeHash);
+			payloadSize += columns != nullptr ? ComputeColumnOffsets(*columns, segment->entryCount, columnOffsets) : segment->payloadSize;
+		}
+
+		// Keys are handed out sequentially, type after type
+		WritePadding(out, ZONE_SECTION_ALIGNMENT);
+		WriteValue(out, keyCount);
+		u64* keys = reinterpret_cast<u64*>(stagingBuffer.data());
+		const u64 keysPerChunk = STAGING_BUFFER_SIZE / sizeof(hkey);
+		for (u64 keyIndex = 0; keyIndex < keyCount; keyIndex += keysPerChunk)
+		{
+			const u64 chunkKeyCount = std::min(keysPerChunk, keyCount - keyIndex);
+			for (u64 i = 0; i < chunkKeyCount; i++)
+			{
+				keys[i] = m_MinKeyValue + keyIndex + i;
+			}
+			out.write(reinterpret_cast<const char*>(keys), chunkKeyCount * sizeof(hkey));
+		}
+
+		// Data layer
+		WriteValue(out, payloadSize);
+		WriteValue(out, static_cast<u64>(m_Segments.size()));
+		for (const Scope<TypeSegment>& segment : m_Segments)
+		{
+			WriteValue(out, segment->typeHash);
+		}
+		hkey currentKey = m_MinKeyValue;
+		for (const Scope<TypeSegment>& segment : m_Segments)
+		{
+			currentKey += segment->entryCount;
+			WriteValue(out, currentKey);
+		}
+
+		for (u64 i = 0; i < m_Segments.size(); i++)
+		{
+			if (!WriteOffsets(*m_Segments[i], typePayloadOffsets[i], out, stagingBuffer))
+			{
+				return false;
+			}
+		}
+		// The payload is streamed uncompressed: the block index would have to be written before the blocks are compressed
+		WriteValue(out, u64{ 0 });
+
+		for (const Scope<TypeSegment>& segment : m_Segments)
+		{
+			WritePadding(out, ZONE_PAYLOAD_ALIGNMENT);
+			if (const vector<ZoneColumn>* columns = ZoneSerializerConfig::Get().GetColumns(segment->typeHash))
+			{
+				if (!WriteColumns(*segment, *columns, out, stagingBuffer))
+				{
+					return false;
+				}
+				continue;
+			}
+			if (!CopySegmentFile(segment->payloadPath, segment->spilledPayloadSize, out, stagingBuffer))
+			{
+				return false;
+			}
+			out.write(segment->payload.begin<char>(), segment->payload.BytesWritten());
+		}
+
+		RemoveSegmentFiles();
+		if (!out)
+		{
+			HERR("Failed to write the zone");
+			return false;
+		}
+		return true;
+	}
+
+	ZoneStreamingSerializer::TypeSegment& ZoneStreamingSerializer::GetSegment(hash64_t typeHash)
+	{
+		auto it = m_SegmentLookup.find(typeHash);
+		if (it != m_SegmentLookup.end())
+		{
+			return *it->second;
+		}
+
+		const std::string segmentName = "zone_" + std::to_string(m_SegmentPrefix) + "_" + std::to_string(m_Segments.size());
+		Scope<TypeSegment> segment = CreateScope<TypeSegment>();
+		segment->typeHash = typeHash;
+		segment->payloadPath = m_TempDirectory / (segmentName + ".payload");
+		segment->offsetPath = m_TempDirectory / (segmentName + ".offsets");
+		m_MemoryUsed += GetSegmentMemory(*segment);
+
+		TypeSegment* segmentPtr = segment.get();
+		m_Segments.push_back(std::move(segment));
+		m_SegmentLookup[typeHash] = segmentPtr;
+		return *segmentPtr;
+	}
+
+	u64 ZoneStreamingSerializer::GetSegmentMemory(const TypeSegment& segment) const
+	{
+		// What is allocated, not what is written: a buffer that doubled counts fully
+		return segment.payload.Capacity() + segment.offsets.capacity() * sizeof(u64);
+	}
+
+	bool ZoneStreamingSerializer::Spill()
+	{
+		for (const Scope<TypeSegment>& segment : m_Segments)
+		{
+			const u64 payloadBytes = segment->payload.BytesWritten();
+			const u64 offsetCount = segment->offsets.size();
+			if (offsetCount == 0)
+			{
+				continue;
+			}
+
+			// The first spill creates the files, the next ones append to them
+			const std::ios::openmode mode = std::ios::binary | (segment->filesCreated ? std::ios::app : std::ios::trunc);
+			segment->filesCreated = true;
+			std::ofstream payloadFile(segment->payloadPath, mode);
+			std::ofstream offsetFile(segment->offsetPath, mode);
+			payloadFile.write(segment->payload.begin<char>(), payloadBytes);
+			offsetFile.write(reinterpret_cast<const char*>(segment->offsets.data()), offsetCount * sizeof(u64));
+			payloadFile.close();
+			offsetFile.close();
+			if (!payloadFile || !offsetFile)
+			{
+				HERR("Failed to spill the zone segment '{0}'", segment->payloadPath.string().c_str());
+				return false;
+			}
+
+			segment->spilledPayloadSize += payloadBytes;
+			segment->spilledEntryCount += offsetCount;
+			m_SpilledBytes += payloadBytes + offsetCount * sizeof(u64);
+
+			// Release the memory instead of keeping the capacity around, the budget counts what is allocated
+			segment->payload.Detach();
+			vector<u64>().swap(segment->offsets);
+		}
+
+		m_MemoryUsed = 0;
+		for (const Scope<TypeSegment>& segment : m_Segments)
+		{
+			m_MemoryUsed += GetSegmentMemory(*segment);
+		}
+		return true;
+	}
+
+	bool ZoneStreamingSerializer::CopySegmentFile(const fspath& path, u64 size, std::ostream& out, vector<byte>& stagingBuffer) const
+	{
+		if (size == 0)
+		{
+			return true;
+		}
+
+		std::ifstream inFile(path, std::ios::binary);
+		for (u64 copied = 0; copied < size && inFile;)
+		{
+			const u64 chunkSize = std::min<u64>(stagingBuffer.size(), size - copied);
+			inFile.read(reinterpret_cast<char*>(stagingBuffer.data()), chunkSize);
+			out.write(reinterpret_cast<const char*>(stagingBuffer.data()), chunkSize);
+			copied += chunkSize;
+		}
+		if (!inFile)
+		{
+			HERR("Failed to read back the zone segment '{0}'", path.string().c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool ZoneStreamingSerializer::WriteColumns(const TypeSegment& segment, const vector<ZoneColumn>& columns, std::ostream& out, vector<byte>& stagingBuffer) const
+	{
+		// One pass over the entries per column: half of the staging buffer reads entries, the other half gathers the column
+		// A row bigger than half of the staging buffer grows it, a chunk holds at least one row
+		const u64 rowSize = ZoneSerializerConfig::Get().GetTypeSize(segment.typeHash);
+		if (stagingBuffer.size() < 2 * rowSize)
+		{
+			stagingBuffer.resize(2 * rowSize);
+		}
+		byte* rows = stagingBuffer.data();
+		byte* values = stagingBuffer.data() + stagingBuffer.size() / 2;
+		const u64 rowsPerChunk = std::max<u64>(1, (stagingBuffer.size() / 2) / rowSize);
+		for (const ZoneColumn& column : columns)
+		{
+			WritePadding(out, ZONE_PAYLOAD_ALIGNMENT);
+
+			std::ifstream inFile;
+			if (segment.spilledEntryCount > 0)
+			{
+				inFile.open(segment.payloadPath, std::ios::binary);
+			}
+			for (u64 rowIndex = 0; rowIndex < segment.spilledEntryCount && inFile; rowIndex += rowsPerChunk)
+			{
+				const u64 chunkRowCount = std::min(rowsPerChunk, segment.spilledEntryCount - rowIndex);
+				inFile.read(reinterpret_cast<char*>(rows), chunkRowCount * rowSize);
+				GatherColumn(rows, chunkRowCount, rowSize, column, values);
+				out.write(reinterpret_cast<const char*>(values), chunkRowCount * column.size);
+			}
+			if (segment.spilledEntryCount > 0 && !inFile)
+			{
+				HERR("Failed to read back the zone segment '{0}'", segment.payloadPath.string().c_str());
+				return false;
+			}
+
+			const u64 memoryRowCount = segment.entryCount - segment.spilledEntryCount;
+			const byte* memoryRows = segment.payload.begin<byte>();
+			for (u64 rowIndex = 0; rowIndex < memoryRowCount; rowIndex += rowsPerChunk)
+			{
+				const u64 chunkRowCount = std::min(rowsPerChunk, memoryRowCount - rowIndex);
+				GatherColumn(memoryRows + rowIndex * rowSize, chunkRowCount, rowSize, column, values);
+				out.write(reinterpret_cast<const char*>(values), chunkRowCount * column.size);
+			}
+		}
+		return true;
+	}
+
+	bool ZoneStreamingSerializer::WriteOffsets(const TypeSegment& segment, u64 globalOffset, std::ostream& out, vector<byte>& stagingBuffer) const
+	{
+		// Offsets are stored relative to the type payload, the zone stores them relative to the whole payload
+		u64* offsets = reinterpret_cast<u64*>(stagingBuffer.data());
+		const u64 offsetsPerChunk = stagingBuffer.size() / sizeof(u64);
+
+		if (const vector<ZoneColumn>* columns = ZoneSerializerConfig::Get().GetColumns(segment.typeHash))
+		{
+			// An entry points to its value in the first column
+			const u64 valueSize = (*columns)[0].size;
+			for (u64 offsetIndex = 0; offsetIndex < segment.entryCount; offsetIndex += offsetsPerChunk)
+			{
+				const u64 chunkOffsetCount = std::min(offsetsPerChunk, segment.entryCount - offsetIndex);
+				for (u64 i = 0; i < chunkOffsetCount; i++)
+				{
+					offsets[i] = globalOffset + (offsetIndex + i) * valueSize;
+				}
+				out.write(reinterpret_cast<const char*>(offsets), chunkOffsetCount * sizeof(u64));
+			}
+			return true;
+		}
+
+		std::ifstream inFile;
+		if (segment.spilledEntryCount > 0)
+		{
+			inFile.open(segment.offsetPath, std::ios::binary);
+		}
+		for (u64 offsetIndex = 0; offsetIndex < segment.spilledEntryCount && inFile; offsetIndex += offsetsPerChunk)
+		{
+			const u64 chunkOffsetCount = std::min(offsetsPerChunk, segment.spilledEntryCount - offsetIndex);
+			inFile.read(reinterpret_cast<char*>(offsets), chunkOffsetCount * sizeof(u64));
+			for (u64 i = 0; i < chunkOffsetCount; i++)
+			{
+				offsets[i] += globalOffset;
+			}
+			out.write(reinterpret_cast<const char*>(offsets), chunkOffsetCount * sizeof(u64));
+		}
+		if (segment.spilledEntryCount > 0 && !inFile)
+		{
+			HERR("Failed to read back the zone segment '{0}'", segment.offsetPath.string().c_str());
+			return false;
+		}
+
+		for (u64 offsetIndex = 0; offsetIndex < segment.offsets.size(); offsetIndex += offsetsPerChunk)
+		{
+			const u64 chunkOffsetCount = std::min<u64>(offsetsPerChunk, segment.offsets.size() - offsetIndex);
+			for (u64 i = 0; i < chunkOffsetCount; i++)
+			{
+				offsets[i] = segment.offsets[offsetIndex + i] + globalOffset;
+			}
+			out.write(reinterpret_cast<const char*>(offsets), chunkOffsetCount * sizeof(u64));
+		}
+		return true;
+	}
+
+	void ZoneStreamingSerializer::RemoveSegmentFiles()
+	{
+		for (const Scope<TypeSegment>& segment : m_Segments)
+		{
+			if (!segment->filesCreated)
+			{
+				continue;
+			}
+			FileSystem::Delete(segment->payloadPath, false);
+			FileSystem::Delete(segment->offsetPath, false);
+			segment->filesCreated = false;
+		}
+	}
+}
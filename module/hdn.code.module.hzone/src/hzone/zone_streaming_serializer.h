@@ -0,0 +1,86 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/hash.h"
+#include "core/core_filesystem.h"
+#include "core/stl/vector.h"
+#include "core/stl/unordered_map.h"
+#include "core/io/dynamic_buffer_writer.h"
+#include "core/hkey/hkey.h"
+
+#include "zone.h"
+
+#include <ostream>
+
+namespace hdn
+{
+	// Builds the same zone as ZoneSerializer without holding it in memory
+	// Entries are serialized to per-type buffers which are spilled to temporary segment files whenever the buffers
+	// use more than the memory budget, Serialize() then assembles the zone with sequential writes to the output stream
+	// Peak memory stays around the budget (plus one buffer growth and the staging buffer used to copy the segments)
+	class ZoneStreamingSerializer
+	{
+	public:
+		// The segment files are created in tempDirectory and removed once the zone is serialized
+		ZoneStreamingSerializer(const fspath& tempDirectory, u64 memoryBudget = 256 * MB);
+		~ZoneStreamingSerializer();
+
+		void AddEntry(hash64_t type, const void* data, u64 size);
+
+		template<typename T>
+		void AddEntry(const T* data)
+		{
+			AddEntry(GenerateTypeHash<T>(), static_cast<const void*>(data), sizeof(T));
+		}
+
+		void SetMinKeyValue(hkey minKeyValue) { m_MinKeyValue = minKeyValue; }
+
+		// Writes the zone at the current position of the stream, the layout is the one of ZoneSerializer::Serialize() without compression
+		// The alignment padding is relative to the start of the stream, the stream must support tellp()
+		bool Serialize(std::ostream& out);
+
+		u64 GetSpilledBytes() const { return m_SpilledBytes; }
+		u64 GetPeakMemory() const { return m_PeakMemory; }
+	private:
+		struct TypeSegment
+		{
+			hash64_t typeHash = 0;
+			u64 entryCount = 0;
+			u64 payloadSize = 0; // Spilled and in memory
+
+			// In memory tails, the offsets are relative to the start of the type payload
+			FDynamicBufferWriter payload{ SEGMENT_INITIAL_CAPACITY };
+			vector<u64> offsets;
+
+			// Opened only while spilling, a zone can have more types than the process can keep files open
+			fspath payloadPath;
+			fspath offsetPath;
+			bool filesCreated = false;
+			u64 spilledPayloadSize = 0;
+			u64 spilledEntryCount = 0;
+		};
+
+		TypeSegment& GetSegment(hash64_t typeHash);
+		u64 GetSegmentMemory(const TypeSegment& segment) const;
+		bool Spill();
+		bool CopySegmentFile(const fspath& path, u64 size, std::ostream& out, vector<byte>& stagingBuffer) const;
+		bool WriteColumns(const TypeSegment& segment, const vector<ZoneColumn>& columns, std::ostream& out, vector<byte>& stagingBuffer) const;
+		bool WriteOffsets(const TypeSegment& segment, u64 globalOffset, std::ostream& out, vector<byte>& stagingBuffer) const;
+		void RemoveSegmentFiles();
+	private:
+		static constexpr u64 SEGMENT_INITIAL_CAPACITY = 4 * KB;
+		static constexpr u64 STAGING_BUFFER_SIZE = 1 * MB;
+
+		fspath m_TempDirectory;
+		u64 m_MemoryBudget;
+		u64 m_SegmentPrefix;
+		hkey m_MinKeyValue = 1;
+
+		vector<Scope<TypeSegment>> m_Segments; // In insertion order, like ZoneSerializer::m_Types
+		unordered_map<hash64_t, TypeSegment*> m_SegmentLookup;
+		u64 m_MemoryUsed = 0;
+		u64 m_PeakMemory = 0;
+		u64 m_SpilledBytes = 0;
+		bool m_Failed = false;
+	};
+}
@@ -0,0 +1,106 @@
+#include "zone_streaming_simulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+namespace hdn
+{
+	bool ZoneStreamingSimulator::LoadCameraPath(const fspath& path, vector<CameraPathSample>& samples)
+	{
+		std::ifstream inFile(path);
+		if (!inFile)
+		{
+			HERR("Could not open the camera path '{0}'", path.string().c_str());
+			return false;
+		}
+
+		samples.clear();
+		CameraPathSample sample;
+		while (inFile >> sample.time >> sample.position.x >> sample.position.y >> sample.position.z)
+		{
+			samples.push_back(sample);
+		}
+		if (!inFile.eof())
+		{
+			HERR("Invalid camera path '{0}' after {1} samples", path.string().c_str(), samples.size());
+			return false;
+		}
+		return true;
+	}
+
+	bool ZoneStreamingSimulator::SaveCameraPath(const fspath& path, const vector<CameraPathSample>& samples)
+	{
+		std::ofstream outFile(path);
+		for (const CameraPathSample& sample : samples)
+		{
+			outFile << sample.time << ' ' << sample.position.x << ' ' << sample.position.y << ' ' << sample.position.z << '\n';
+		}
+		if (!outFile)
+		{
+			HERR("Could not write the camera path '{0}'", path.string().c_str());
+			return false;
+		}
+		return true;
+	}
+
+	ZoneStreamingSimulationReport ZoneStreamingSimulator::Replay(ZoneStreamingManager& manager, const vector<CameraPathSample>& samples, f32 frameTime, bool paceFrames)
+	{
+		using Clock = std::chrono::steady_clock;
+		ZoneStreamingSimulationReport report;
+		if (samples.empty())
+		{
+			return report;
+		}
+
+		f64 totalUpdateTime = 0.0;
+		const f32 endTime = samples.back().time;
+		for (f32 time = samples.front().time; time <= endTime; time += frameTime)
+		{
+			const auto frameStart = Clock::now();
+			const vec3f32 position = GetPosition(samples, time);
+			const vec3f32 velocity = (GetPosition(samples, time + frameTime) - position) / frameTime;
+			manager.SetPointOfInterest(0, position, velocity);
+
+			const u64 missCount = manager.GetStats().missCount;
+			const auto updateStart = Clock::now();
+			manager.Update();
+			const f64 updateTime = std::chrono::duration<f64, std::milli>(Clock::now() - updateStart).count();
+
+			report.frameCount++;
+			report.missFrameCount += manager.GetStats().missCount != missCount ? 1 : 0;
+			report.maxUpdateTime = std::max(report.maxUpdateTime, updateTime);
+			totalUpdateTime += updateTime;
+
+			if (paceFrames)
+			{
+				std::this_thread::sleep_until(frameStart + std::chrono::duration<f32>(frameTime));
+			}
+		}
+
+		report.averageUpdateTime = totalUpdateTime / report.frameCount;
+		report.stats = manager.GetStats();
+		return report;
+	}
+
+	vec3f32 ZoneStreamingSimulator::GetPosition(const vector<CameraPathSample>& samples, f32 time)
+	{
+		// First sample after time, the position is interpolated with the one before
+		auto next = std::upper_bound(samples.begin(), samples.end(), time, [](f32 t, const CameraPathSample& sample) {
+			return t < sample.time;
+		});
+		if (next == samples.begin())
+		{
+			return samples.front().position;
+		}
+		if (next == samples.end())
+		{
+			return samples.back().position;
+		}
+
+		const CameraPathSample& previous = *(next - 1);
+		const f32 t = (time - previous.time) / (next->time - previous.time);
+		return previous.position + (next->position - previous.position) * t;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "core/core.h"
+#include "core/core_filesystem.h"
+#include "core/stl/vector.h"
+
+#include "zone_streaming_manager.h"
+
+namespace hdn
+{
+	struct CameraPathSample
+	{
+		f32 time; // Seconds
+		vec3f32 position;
+	};
+
+	struct ZoneStreamingSimulationReport
+	{
+		u64 frameCount = 0;
+		u64 missFrameCount = 0; // Frames with at least one needed zone not resident
+		f64 averageUpdateTime = 0.0; // Milliseconds
+		f64 maxUpdateTime = 0.0;
+		ZoneStreamingStats stats; // At the end of the replay
+	};
+
+	// Replays recorded camera paths through a ZoneStreamingManager without running the game
+	class ZoneStreamingSimulator
+	{
+	public:
+		// One "time x y z" sample per line, sorted by time
+		static bool LoadCameraPath(const fspath& path, vector<CameraPathSample>& samples);
+		static bool SaveCameraPath(const fspath& path, const vector<CameraPathSample>& samples);
+
+		// Moves the point of interest 0 along the path one frame at a time, the velocity is derived from the path
+		// The replay runs as fast as possible unless paceFrames is set, then each frame lasts frameTime so the loads
+		// take as long relative to the camera movement as they would in game
+		static ZoneStreamingSimulationReport Replay(ZoneStreamingManager& manager, const vector<CameraPathSample>& samples, f32 frameTime = 1.0f / 60.0f, bool paceFrames = false);
+	private:
+		static vec3f32 GetPosition(const vector<CameraPathSample>& samples, f32 time);
+	};
+}
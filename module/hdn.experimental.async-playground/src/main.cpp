@@ -1,9 +1,20 @@
 #include "core/core.h"
 #include "core/stl/vector.h"
 #include "core/stl/ds_base.h"
+#include "core/allocator/general_allocator.h"
+#include "core/allocator/slab_allocator.h"
+#include "core/allocator/concurrent_slab_allocator.h"
 
 #include "async/async.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
 namespace hdn
 {
 	class ExampleTaskLeaf : public ITaskLeaf
@@ -138,6 +149,219 @@ namespace hdn
 		ExampleTaskLeaf simpleTask2_2{ "SIM2_2" };
 		ExampleTaskQueue3 queue1;
 	};
+
+	template<typename Func>
+	long long MeasureMicroseconds(const Func& func)
+	{
+		const auto startTime = std::chrono::steady_clock::now();
+		func();
+		const auto endTime = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+	}
+
+	void ParallelForBenchmark()
+	{
+		constexpr u64 ELEMENT_COUNT = 1 << 24;
+		constexpr u64 GRAIN_SIZE = 4096;
+		constexpr int RUN_COUNT = 5;
+
+		vector<f32> input(ELEMENT_COUNT);
+		vector<f32> output(ELEMENT_COUNT);
+		for (u64 i = 0; i < ELEMENT_COUNT; i++)
+		{
+			input[i] = static_cast<f32>(i % 1000) * 0.001f;
+		}
+
+		const auto transform = [&](u64 i) { output[i] = std::sqrt(input[i]) * 2.0f + 1.0f; };
+		const auto sum = [&](u64 begin, u64 end) {
+			f64 partial = 0.0;
+			for (u64 i = begin; i < end; i++)
+			{
+				partial += input[i];
+			}
+			return partial;
+		};
+
+		// Warm up the workers so the first parallel run does not pay for thread wake-ups
+		ParallelFor(0, ELEMENT_COUNT, GRAIN_SIZE, transform);
+
+		for (int run = 0; run < RUN_COUNT; run++)
+		{
+			const long long serialForTime = MeasureMicroseconds([&]() {
+				for (u64 i = 0; i < ELEMENT_COUNT; i++)
+				{
+					transform(i);
+				}
+			});
+			const long long parallelForTime = MeasureMicroseconds([&]() {
+				ParallelFor(0, ELEMENT_COUNT, GRAIN_SIZE, transform);
+			});
+
+			f64 serialSum = 0.0;
+			f64 parallelSum = 0.0;
+			const long long serialReduceTime = MeasureMicroseconds([&]() {
+				serialSum = sum(0, ELEMENT_COUNT);
+			});
+			const long long parallelReduceTime = MeasureMicroseconds([&]() {
+				parallelSum = ParallelReduce(0, ELEMENT_COUNT, GRAIN_SIZE * 16, 0.0, sum, [](f64 lhs, f64 rhs) { return lhs + rhs; });
+			});
+
+			HINFO("[Run {0}] for: serial {1}us / parallel {2}us | reduce: serial {3}us / parallel {4}us ({5} vs {6})",
+				run, serialForTime, parallelForTime, serialReduceTime, parallelReduceTime, serialSum, parallelSum);
+		}
+	}
+
+	// Replaces the block of a random slot at every step: mostly small objects, one allocation in 16 up to 16KB
+	template<typename AllocateFunc, typename DeallocateFunc>
+	void RunAllocationPattern(u64 seed, const AllocateFunc& allocate, const DeallocateFunc& deallocate)
+	{
+		constexpr u64 OPERATION_COUNT = 1 << 20;
+		constexpr u64 LIVE_COUNT = 256;
+
+		void* blocks[LIVE_COUNT] = {};
+		u64 state = seed;
+		for (u64 i = 0; i < OPERATION_COUNT; i++)
+		{
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			const u64 slot = (state >> 33) % LIVE_COUNT;
+			const size_t size = (state >> 60) == 0 ? 1 + (state >> 20) % (16 * KB) : 8 + (state >> 24) % 248;
+			deallocate(blocks[slot]);
+			blocks[slot] = allocate(size);
+			static_cast<byte*>(blocks[slot])[0] = static_cast<byte>(i);
+		}
+		for (void* block : blocks)
+		{
+			deallocate(block);
+		}
+	}
+
+	// The global operator new (size-class slabs unless HDN_GENERAL_ALLOCATOR is not in use) against malloc, alone then on every worker
+	void AllocationBenchmark()
+	{
+		constexpr int RUN_COUNT = 3;
+		const u64 taskCount = std::max(1u, std::thread::hardware_concurrency());
+
+		const auto globalAllocate = [](size_t size) { return ::operator new(size); };
+		const auto globalDeallocate = [](void* block) { ::operator delete(block); };
+		const auto systemAllocate = [](size_t size) { return std::malloc(size); };
+		const auto systemDeallocate = [](void* block) { std::free(block); };
+
+		HINFO("operator new goes to {0}", USING(HDN_GENERAL_ALLOCATOR) ? "the GeneralAllocator" : "the system heap");
+		for (int run = 0; run < RUN_COUNT; run++)
+		{
+			const long long globalTime = MeasureMicroseconds([&]() {
+				RunAllocationPattern(run, globalAllocate, globalDeallocate);
+			});
+			const long long systemTime = MeasureMicroseconds([&]() {
+				RunAllocationPattern(run, systemAllocate, systemDeallocate);
+			});
+			const long long parallelGlobalTime = MeasureMicroseconds([&]() {
+				ParallelFor(0, taskCount, 1, [&](u64 task) { RunAllocationPattern(run * taskCount + task, globalAllocate, globalDeallocate); });
+			});
+			const long long parallelSystemTime = MeasureMicroseconds([&]() {
+				ParallelFor(0, taskCount, 1, [&](u64 task) { RunAllocationPattern(run * taskCount + task, systemAllocate, systemDeallocate); });
+			});
+
+			HINFO("[Run {0}] 1 thread: operator new {1}us / malloc {2}us | {3} tasks: operator new {4}us / malloc {5}us",
+				run, globalTime, systemTime, taskCount, parallelGlobalTime, parallelSystemTime);
+		}
+	}
+
+	// Blocks of one size allocated on a thread and freed on whichever thread takes their slot, as tasks split on a worker
+	// and executed on another
+	template<typename AllocateFunc, typename DeallocateFunc>
+	long long RunContendedPattern(u32 threadCount, const AllocateFunc& allocate, const DeallocateFunc& deallocate)
+	{
+		constexpr u64 OPERATION_COUNT = 1 << 18; // Per thread
+		constexpr u64 SLOT_COUNT = 4096;
+
+		Scope<std::atomic<void*>[]> slots = CreateScope<std::atomic<void*>[]>(SLOT_COUNT);
+		const long long time = MeasureMicroseconds([&]() {
+			vector<std::thread> threads;
+			for (u32 threadIndex = 0; threadIndex < threadCount; threadIndex++)
+			{
+				threads.emplace_back([&, threadIndex]() {
+					u64 state = threadIndex;
+					for (u64 i = 0; i < OPERATION_COUNT; i++)
+					{
+						state = state * 6364136223846793005ull + 1442695040888963407ull;
+						void* block = allocate();
+						static_cast<byte*>(block)[0] = static_cast<byte>(i);
+						if (void* previous = slots[(state >> 33) % SLOT_COUNT].exchange(block, std::memory_order_acq_rel))
+						{
+							deallocate(previous);
+						}
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		});
+
+		for (u64 slot = 0; slot < SLOT_COUNT; slot++)
+		{
+			if (void* block = slots[slot].exchange(nullptr))
+			{
+				deallocate(block);
+			}
+		}
+		return time;
+	}
+
+	// concurrent_slab_allocator against a slab_allocator behind a mutex and the global operator new, from 1 to 64 threads
+	void ConcurrentSlabBenchmark()
+	{
+		constexpr size_t BLOCK_SIZE = 64;
+
+		for (u32 threadCount = 1; threadCount <= 64; threadCount *= 2)
+		{
+			concurrent_slab_allocator concurrentSlab{ BLOCK_SIZE, 256 };
+			const long long concurrentTime = RunContendedPattern(threadCount,
+				[&]() { return concurrentSlab.Allocate(); },
+				[&](void* block) { concurrentSlab.Deallocate(block); });
+
+			slab_allocator lockedSlab{ BLOCK_SIZE, 256 };
+			std::mutex lockedSlabMutex;
+			const long long lockedTime = RunContendedPattern(threadCount,
+				[&]() { std::lock_guard<std::mutex> lock{ lockedSlabMutex }; return lockedSlab.Allocate(); },
+				[&](void* block) { std::lock_guard<std::mutex> lock{ lockedSlabMutex }; lockedSlab.Deallocate(block); });
+
+			const long long globalTime = RunContendedPattern(threadCount,
+				[]() { return ::operator new(BLOCK_SIZE); },
+				[](void* block) { ::operator delete(block); });
+
+			HINFO("{0} threads: concurrent_slab_allocator {1}us / slab_allocator + mutex {2}us / operator new {3}us",
+				threadCount, concurrentTime, lockedTime, globalTime);
+		}
+	}
+
+	// Same read -> parse -> consume chain an ITaskQueue would need one task class per step for
+	Task<u64> ExampleCountLines(string path)
+	{
+		co_await SwitchToIO();
+		std::ifstream file(path.c_str(), std::ios::binary);
+		std::string content{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+		co_await SwitchToCompute();
+		const u64 lineCount = ParallelReduce(0, content.size(), 64 * KB, u64{ 0 },
+			[&](u64 begin, u64 end) { return static_cast<u64>(std::count(content.begin() + begin, content.begin() + end, '\n')); },
+			[](u64 lhs, u64 rhs) { return lhs + rhs; });
+		co_return lineCount;
+	}
+
+	Task<u64> ExampleCountAllLines()
+	{
+		Task<u64> sourceLines = ExampleCountLines(__FILE__);
+		Task<u64> missingLines = ExampleCountLines("missing_file.txt");
+		co_await WhenAll(sourceLines, missingLines);
+
+		const u64 totalLines = co_await sourceLines + co_await missingLines;
+		co_await SwitchToMainThread();
+		HINFO("{0} lines counted, back on the main thread", totalLines);
+		co_return totalLines;
+	}
 }
 
 int main()
@@ -147,6 +371,10 @@ int main()
 	Log_Init();
 
 	{
+#if USING(HDN_ASYNC_PROFILING)
+		AsyncProfiler::Get().BeginCapture();
+#endif
+
 		ExampleTaskGraph task;
 		task.Enqueue();
 		while (!task.Completed())
@@ -158,10 +386,34 @@ int main()
 
 		task.PrintTimeHierarchy();
 
+		HINFO("-----------------------");
+
+		ParallelForBenchmark();
+
+		HINFO("-----------------------");
+
+		AllocationBenchmark();
+
+		HINFO("-----------------------");
+
+		ConcurrentSlabBenchmark();
+
+		HINFO("-----------------------");
+
+		Task<u64> lineCountTask = ExampleCountAllLines();
+		lineCountTask.Get();
+
+#if USING(HDN_ASYNC_PROFILING)
+		AsyncProfiler::Get().EndCapture();
+		AsyncProfiler::Get().LogSummary();
+		AsyncProfiler::Get().ExportChromeTrace("async_trace.json");
+#endif
+
 		AsyncOrchestrator::Get().Shutdown();
 	}
 
 	HINFO("Allocation Byte: {0}", GetMemStat().allocated);
 	HINFO("Allocation Count: {0}", GetMemStat().allocationCount);
+	HINFO("Deallocation Byte: {0}", GetMemStat().deallocated);
 	HINFO("Deallocation Count: {0}", GetMemStat().deallocationCount);
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "core/core.h"
-#include "core/stl/unordered_map.h"
+#include "core/stl/hkey_map.h"
 
 namespace hdn
 {
@@ -33,6 +33,6 @@ namespace hdn
 	private:
 		ImageRegistry() = default;
 	private:
-		unordered_map<u64, Ref<Image>> m_ImageRegistry{};
+		hkey_map<Ref<Image>> m_ImageRegistry{}; // By hash of the name
 	};
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "core/core.h"
 #include "core/stl/vector.h"
+#include "core/stl/unordered_map.h"
+#include "core/stl/hkey_map.h"
 #include "core/hobj/hobj_util.h"
 #include "core/hobj/hobj_registry.h"
 #include "core/core_filesystem.h"
@@ -10,10 +12,18 @@
 #include "hzone/hzone.h"
 #include "hzone/zone_config.h"
 #include "hzone/zone_serializer.h"
+#include "hzone/zone_streaming_serializer.h"
 #include "hzone/zone_deserializer.h"
+#include "hzone/zone_loader.h"
+#include "hzone/zone_incremental_builder.h"
+#include "hzone/zone_streaming_manager.h"
+#include "hzone/zone_streaming_simulator.h"
 
 #include "point2d.h"
 
+#include <chrono>
+#include <random>
+
 namespace hdn
 {
 
@@ -82,6 +92,677 @@ namespace hdn
 			HObjectRegistry::Get().RegisterObjectPath(key, file);
 		}
 	}
+
+	struct ZoneLoadReport
+	{
+		f64 loadTime; // Milliseconds
+		f64 touchTime;
+		i64 residentDelta; // Bytes
+		f64 checksum;
+	};
+
+	// Loads the zone then reads every entry once, like a level would, so the mapped pages end up resident too
+	ZoneLoadReport LoadZone(const fspath& path, HObjectLoadFlags flags, u64 entryCount)
+	{
+		using Clock = std::chrono::steady_clock;
+		ZoneLoadReport report{};
+		const size_t residentBefore = GetResidentMemory();
+
+		const auto loadStart = Clock::now();
+		HObjPtr<HZone> zone = HObjectUtil::GetObjectFromPath<HZone>(path.string().c_str(), flags);
+		const auto loadEnd = Clock::now();
+
+		for (hkey key = 1; key <= entryCount; key++)
+		{
+			const point2d* point = reinterpret_cast<const point2d*>(zone->GetZone().GetKeyData(key));
+			report.checksum += point->x + point->y;
+		}
+		const auto touchEnd = Clock::now();
+
+		report.loadTime = std::chrono::duration<f64, std::milli>(loadEnd - loadStart).count();
+		report.touchTime = std::chrono::duration<f64, std::milli>(touchEnd - loadEnd).count();
+		report.residentDelta = static_cast<i64>(GetResidentMemory()) - static_cast<i64>(residentBefore);
+		return report;
+	}
+
+	// Builds a zone of 1M entries: half POD, half going through a registered serialize callback
+	void ZoneBuildBenchmark()
+	{
+		using Clock = std::chrono::steady_clock;
+		constexpr u64 ENTRY_COUNT = 1024 * 1024;
+
+		// Own types, the callback must not change how point2d is saved by the other examples
+		struct packed_point { f32 x; u8 c; f32 y; };
+		struct pod_value { u32 value; };
+		ZoneSerializerConfig::Get().RegisterSerializeFunc<packed_point>([](const void* dataBuffer, FDynamicBufferWriter& writer) -> u64 {
+			const packed_point* point = static_cast<const packed_point*>(dataBuffer);
+			bin::Write(writer, point->x);
+			bin::Write(writer, point->c);
+			bin::Write(writer, point->y);
+			return sizeof(point->x) + sizeof(point->c) + sizeof(point->y);
+		});
+
+		vector<packed_point> points(ENTRY_COUNT / 2);
+		vector<pod_value> values(ENTRY_COUNT / 2);
+		for (u64 i = 0; i < ENTRY_COUNT / 2; i++)
+		{
+			points[i] = { static_cast<f32>(i), static_cast<u8>(i), static_cast<f32>(i * 2) };
+			values[i] = { static_cast<u32>(i) };
+		}
+
+		const auto buildStart = Clock::now();
+		ZoneSerializer zoneSerializer;
+		zoneSerializer.SetMinKeyValue(1);
+		for (u64 i = 0; i < ENTRY_COUNT / 2; i++)
+		{
+			zoneSerializer.AddEntry(&points[i]);
+			zoneSerializer.AddEntry(&values[i]);
+		}
+		const auto serializeStart = Clock::now();
+
+		FDynamicBufferWriter zoneWriter{ 1 * MB };
+		zoneSerializer.Serialize(zoneWriter);
+		vector<byte> zoneBuffer = zoneWriter.Detach();
+		const auto serializeEnd = Clock::now();
+
+		HINFO("Zone build of {0} entries: AddEntry {1:.3f} ms, Serialize {2:.3f} ms ({3} KB)", ENTRY_COUNT,
+			std::chrono::duration<f64, std::milli>(serializeStart - buildStart).count(),
+			std::chrono::duration<f64, std::milli>(serializeEnd - serializeStart).count(),
+			zoneBuffer.size() / KB);
+
+		// Same zone streamed to a file with a budget far below its size
+		const auto streamStart = Clock::now();
+		ZoneStreamingSerializer streamingSerializer{ "object/temp", 2 * MB };
+		streamingSerializer.SetMinKeyValue(1);
+		for (u64 i = 0; i < ENTRY_COUNT / 2; i++)
+		{
+			streamingSerializer.AddEntry(&points[i]);
+			streamingSerializer.AddEntry(&values[i]);
+		}
+		std::ofstream zoneFile("object/zone_streamed.bin", std::ios::binary);
+		const bool streamed = streamingSerializer.Serialize(zoneFile);
+		zoneFile.close();
+		const auto streamEnd = Clock::now();
+
+		HINFO("Streamed zone build: {0:.3f} ms, peak memory {1} KB, spilled {2} KB", std::chrono::duration<f64, std::milli>(streamEnd - streamStart).count(),
+			streamingSerializer.GetPeakMemory() / KB, streamingSerializer.GetSpilledBytes() / KB);
+		HASSERT(streamed && FileSystem::FileSize("object/zone_streamed.bin") == zoneBuffer.size(), "The streamed zone differs from the in-memory one");
+	}
+
+	// Compares the buffered and the memory mapped loads of the same zone
+	void MemoryMappedLoadBenchmark()
+	{
+		constexpr u64 ENTRY_COUNT = 1024 * 1024;
+
+		ZoneSerializer zoneSerializer;
+		zoneSerializer.SetMinKeyValue(1);
+		vector<point2d> points(ENTRY_COUNT);
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			points[i] = { static_cast<f32>(i), static_cast<char>(i), static_cast<f32>(i * 2) };
+			zoneSerializer.AddEntry(&points[i]);
+		}
+
+		// Same zone saved under three keys, the registry would otherwise return the first load
+		// The header and the zone go through the same writer, the zone alignment is relative to the start of the file
+		const fspath paths[] = { "object/zone_buffered.ho", "object/zone_mapped.ho", "object/zone_in_place.ho" };
+		u64 fileSize = 0;
+		for (const fspath& path : paths)
+		{
+			HObjPtr<HZone> zone = HObjectUtil::Create<HZone>();
+			FDynamicBufferWriter writer{ ENTRY_COUNT * (sizeof(hkey) + sizeof(u64) + sizeof(point2d)) + 4 * KB };
+			zone->Serialize(writer);
+			zoneSerializer.Serialize(writer);
+			fileSize = writer.BytesWritten();
+
+			std::ofstream outFile(path, std::ios::binary);
+			outFile.write(writer.begin<char>(), writer.BytesWritten());
+			outFile.close();
+			HObjectRegistry::Get().RegisterObjectPath(zone->GetKey(), path);
+			delete zone;
+		}
+
+		// Buffered copies the zone out of the file buffer, mapped and in place point into the file bytes
+		const ZoneLoadReport buffered = LoadZone(paths[0], HObjectLoadFlags::Default, ENTRY_COUNT);
+		const ZoneLoadReport mapped = LoadZone(paths[1], HObjectLoadFlags::MemoryMap, ENTRY_COUNT);
+		const ZoneLoadReport inPlace = LoadZone(paths[2], HObjectLoadFlags::InPlace, ENTRY_COUNT);
+		HINFO("Zone of {0} entries ({1} KB)", ENTRY_COUNT, fileSize / KB);
+		HINFO("Buffered: load {0:.3f} ms, first touch {1:.3f} ms, resident +{2} KB", buffered.loadTime, buffered.touchTime, buffered.residentDelta / KB);
+		HINFO("Mapped:   load {0:.3f} ms, first touch {1:.3f} ms, resident +{2} KB", mapped.loadTime, mapped.touchTime, mapped.residentDelta / KB);
+		HINFO("In place: load {0:.3f} ms, first touch {1:.3f} ms, resident +{2} KB", inPlace.loadTime, inPlace.touchTime, inPlace.residentDelta / KB);
+		HASSERT(buffered.checksum == mapped.checksum && buffered.checksum == inPlace.checksum, "The buffered, mapped and in place zones differ");
+	}
+
+	// Key lookups on a dense zone (what ZoneSerializer builds) and on a sparse one, against the previous lower_bound
+	void ZoneLookupBenchmark()
+	{
+		using Clock = std::chrono::steady_clock;
+		constexpr u64 ENTRY_COUNT = 1024 * 1024;
+		constexpr u64 LOOKUP_COUNT = 4 * ENTRY_COUNT;
+
+		ZoneSerializer zoneSerializer;
+		zoneSerializer.SetMinKeyValue(1);
+		vector<point2d> points(ENTRY_COUNT);
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			points[i] = { static_cast<f32>(i), static_cast<char>(i), static_cast<f32>(i * 2) };
+			zoneSerializer.AddEntry(&points[i]);
+		}
+		FDynamicBufferWriter zoneWriter{ ENTRY_COUNT * (sizeof(hkey) + sizeof(u64) + sizeof(point2d)) + 4 * KB };
+		zoneSerializer.Serialize(zoneWriter);
+		FBufferReader reader{ zoneWriter.begin<byte>(), zoneWriter.BytesWritten() };
+		Zone denseZone;
+		ZoneDeserializer deserializer;
+		deserializer.Deserialize(reader, denseZone);
+
+		// Same entries with every other key missing
+		vector<hkey> sparseKeys(ENTRY_COUNT);
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			sparseKeys[i] = 2 * i + 1;
+		}
+		Zone sparseZone = denseZone;
+		sparseZone.memoryBase = nullptr; // Owned by denseZone
+		sparseZone.sortedKeys = sparseKeys.data();
+		sparseZone.InitKeyLookup();
+
+		std::mt19937_64 random{ 42 };
+		vector<hkey> denseLookups(LOOKUP_COUNT);
+		vector<hkey> sparseLookups(LOOKUP_COUNT);
+		for (u64 i = 0; i < LOOKUP_COUNT; i++)
+		{
+			const u64 index = random() % ENTRY_COUNT;
+			denseLookups[i] = index + 1;
+			sparseLookups[i] = sparseKeys[index];
+		}
+
+		auto measure = [&](const char* name, auto&& lookup) {
+			const auto start = Clock::now();
+			const f64 checksum = lookup();
+			const f64 time = std::chrono::duration<f64, std::nano>(Clock::now() - start).count();
+			HINFO("{0}: {1:.2f} ns/key (checksum {2})", name, time / LOOKUP_COUNT, checksum);
+		};
+		auto lowerBound = [](const Zone& zone, const vector<hkey>& lookups) {
+			f64 checksum = 0;
+			for (hkey key : lookups)
+			{
+				const hkey* keyPtr = eastl::lower_bound(zone.sortedKeys, zone.sortedKeys + zone.keyCount, key);
+				checksum += reinterpret_cast<const point2d*>(&zone.dataPayload[zone.dataOffsets[keyPtr - zone.sortedKeys]])->x;
+			}
+			return checksum;
+		};
+		auto single = [](const Zone& zone, const vector<hkey>& lookups) {
+			f64 checksum = 0;
+			for (hkey key : lookups)
+			{
+				checksum += reinterpret_cast<const point2d*>(zone.GetKeyData(key))->x;
+			}
+			return checksum;
+		};
+		vector<const byte*> results(LOOKUP_COUNT);
+		auto batched = [&results](const Zone& zone, const vector<hkey>& lookups) {
+			zone.GetKeyData(span<const hkey>{ lookups.data(), lookups.size() }, span<const byte*>{ results.data(), results.size() });
+			f64 checksum = 0;
+			for (const byte* data : results)
+			{
+				checksum += reinterpret_cast<const point2d*>(data)->x;
+			}
+			return checksum;
+		};
+
+		HINFO("Zone lookups, {0} random keys among {1}", LOOKUP_COUNT, ENTRY_COUNT);
+		measure("Dense, lower_bound", [&]() { return lowerBound(denseZone, denseLookups); });
+		measure("Dense, key range", [&]() { return single(denseZone, denseLookups); });
+		measure("Dense, batched", [&]() { return batched(denseZone, denseLookups); });
+		measure("Sparse, lower_bound", [&]() { return lowerBound(sparseZone, sparseLookups); });
+		measure("Sparse, Eytzinger", [&]() { return single(sparseZone, sparseLookups); });
+		measure("Sparse, batched", [&]() { return batched(sparseZone, sparseLookups); });
+		delete[] denseZone.memoryBase;
+	}
+
+	// Registry traffic: random keys (as GenerateUUID64 makes them) looked up far more often than they are added, one lookup
+	// out of eight misses
+	void HKeyMapBenchmark()
+	{
+		using Clock = std::chrono::steady_clock;
+		constexpr u64 LOOKUP_COUNT = 8 * 1024 * 1024;
+
+		for (u64 entryCount : { 1024ull, 64 * 1024ull, 1024 * 1024ull })
+		{
+			std::mt19937_64 random{ 42 };
+			vector<hkey> keys(entryCount);
+			for (hkey& key : keys)
+			{
+				key = random();
+			}
+			vector<hkey> lookups(LOOKUP_COUNT);
+			for (u64 i = 0; i < LOOKUP_COUNT; i++)
+			{
+				lookups[i] = i % 8 == 0 ? random() : keys[random() % entryCount];
+			}
+
+			auto measure = [&](const char* name, auto& map) {
+				const auto insertStart = Clock::now();
+				for (const hkey& key : keys)
+				{
+					map[key] = &key;
+				}
+				const auto lookupStart = Clock::now();
+				u64 checksum = 0;
+				for (hkey key : lookups)
+				{
+					auto it = map.find(key);
+					checksum += it != map.end() ? *it->second : 0;
+				}
+				const auto end = Clock::now();
+				HINFO("{0}: insert {1:.2f} ns/key, lookup {2:.2f} ns/key (checksum {3})", name,
+					std::chrono::duration<f64, std::nano>(lookupStart - insertStart).count() / entryCount,
+					std::chrono::duration<f64, std::nano>(end - lookupStart).count() / LOOKUP_COUNT, checksum);
+			};
+
+			HINFO("hkey maps, {0} lookups among {1} keys", LOOKUP_COUNT, entryCount);
+			unordered_map<hkey, const hkey*> unorderedMap;
+			measure("unordered_map", unorderedMap);
+			hkey_map<const hkey*> hkeyMap;
+			measure("hkey_map", hkeyMap);
+		}
+	}
+
+	// Reads a zone and runs its load callbacks through ZoneLoader, point_cloud_cell depends on point2d
+	void ZoneLoadPipelineExample()
+	{
+		constexpr u64 ENTRY_COUNT = 256 * 1024;
+
+		struct point_cloud_cell { u32 firstPoint; u32 pointCount; };
+		ZoneConfigurator::Get().RegisterLoadFunc<point2d>(zone_load_point2d);
+		ZoneConfigurator::Get().RegisterUnloadFunc<point2d>(zone_unload_point2d);
+		ZoneConfigurator::Get().RegisterLoadFunc<point_cloud_cell>([](const void* dataBuffer, void* outBuffer) -> u64 {
+			memcpy(outBuffer, dataBuffer, sizeof(point_cloud_cell));
+			return sizeof(point_cloud_cell);
+		});
+		ZoneSerializerConfig::Get().AddTypeDependency<point_cloud_cell, point2d>();
+
+		ZoneSerializer zoneSerializer;
+		zoneSerializer.SetMinKeyValue(1);
+		vector<point_cloud_cell> cells(ENTRY_COUNT / 64);
+		vector<point2d> points(ENTRY_COUNT);
+		for (u64 i = 0; i < cells.size(); i++)
+		{
+			cells[i] = { static_cast<u32>(i * 64), 64 };
+			zoneSerializer.AddEntry(&cells[i]);
+		}
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			points[i] = { static_cast<f32>(i), static_cast<char>(i), static_cast<f32>(i * 2) };
+			zoneSerializer.AddEntry(&points[i]);
+		}
+
+		const fspath path = "object/zone_pipeline.ho";
+		{
+			HObjPtr<HZone> zone = HObjectUtil::Create<HZone>();
+			FDynamicBufferWriter writer{ ENTRY_COUNT * (sizeof(hkey) + sizeof(u64) + sizeof(point2d)) + 4 * KB };
+			zone->Serialize(writer);
+			zoneSerializer.Serialize(writer);
+			std::ofstream outFile(path, std::ios::binary);
+			outFile.write(writer.begin<char>(), writer.BytesWritten());
+			outFile.close();
+			HObjectRegistry::Get().RegisterObjectPath(zone->GetKey(), path);
+			delete zone;
+		}
+
+		ZoneLoader loader;
+		if (!loader.Load(path.string().c_str()))
+		{
+			return;
+		}
+		HINFO("Zone pipeline: read {0:.3f} ms, load {1:.3f} ms", loader.GetReadTime(), loader.GetLoadTime());
+		for (const ZoneTypeLoadReport& report : loader.GetTypeReports())
+		{
+			HINFO("  Type {0}: {1} entries in {2:.3f} ms", report.typeHash, report.entryCount, report.loadTime);
+		}
+		const point2d* lastPoint = static_cast<const point2d*>(loader.GetLoadedData(cells.size() + ENTRY_COUNT));
+		HASSERT(lastPoint != nullptr && lastPoint->x == static_cast<f32>(ENTRY_COUNT - 1), "The zone pipeline did not load the points");
+	}
+
+	// Sums a field of every entry of a type: key by key, through View() and through a column
+	void ZoneViewBenchmark()
+	{
+		using Clock = std::chrono::steady_clock;
+		constexpr u64 ENTRY_COUNT = 1024 * 1024;
+
+		struct light_row { f32 position[3]; f32 radius; u32 color; };
+		struct light_column { f32 position[3]; f32 radius; u32 color; };
+		ZoneSerializerConfig::Get().RegisterColumns<light_column>({ HZONE_COLUMN(light_column, position), HZONE_COLUMN(light_column, radius), HZONE_COLUMN(light_column, color) });
+
+		ZoneSerializer zoneSerializer;
+		zoneSerializer.SetMinKeyValue(1);
+		vector<light_row> rows(ENTRY_COUNT);
+		vector<light_column> columns(ENTRY_COUNT);
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			rows[i] = { { static_cast<f32>(i), 0.0f, 0.0f }, static_cast<f32>(i % 64), static_cast<u32>(i) };
+			columns[i] = { { static_cast<f32>(i), 0.0f, 0.0f }, static_cast<f32>(i % 64), static_cast<u32>(i) };
+			zoneSerializer.AddEntry(&rows[i]);
+		}
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			zoneSerializer.AddEntry(&columns[i]);
+		}
+		FDynamicBufferWriter zoneWriter{ ENTRY_COUNT * (2 * sizeof(hkey) + 2 * sizeof(u64) + sizeof(light_row) + sizeof(light_column)) + 4 * KB };
+		zoneSerializer.Serialize(zoneWriter);
+		FBufferReader reader{ zoneWriter.begin<byte>(), zoneWriter.BytesWritten(), true };
+		Zone zone;
+		ZoneDeserializer deserializer;
+		deserializer.Deserialize(reader, zone);
+
+		auto measure = [](const char* name, auto&& sum) {
+			const auto start = Clock::now();
+			const f64 radiusSum = sum();
+			HINFO("{0}: {1:.3f} ms (sum {2})", name, std::chrono::duration<f64, std::milli>(Clock::now() - start).count(), radiusSum);
+		};
+		measure("Radius by key", [&]() {
+			f64 sum = 0;
+			for (hkey key = 1; key <= ENTRY_COUNT; key++)
+			{
+				sum += reinterpret_cast<const light_row*>(zone.GetKeyData(key))->radius;
+			}
+			return sum;
+		});
+		measure("Radius from View", [&]() {
+			f64 sum = 0;
+			for (const light_row& light : zone.View<light_row>())
+			{
+				sum += light.radius;
+			}
+			return sum;
+		});
+		measure("Radius from Column", [&]() {
+			f64 sum = 0;
+			for (f32 radius : zone.Column<light_column, f32>(1))
+			{
+				sum += radius;
+			}
+			return sum;
+		});
+	}
+
+	// Streams a grid of zones around a camera flying a recorded path, the budget only fits a part of the grid
+	void ZoneStreamingSimulation()
+	{
+		constexpr u32 GRID_SIZE = 16;
+		constexpr f32 ZONE_SIZE = 64.0f;
+		constexpr u64 POINTS_PER_ZONE = 16 * 1024;
+
+		ZoneStreamingSettings settings;
+		settings.loadDistance = 96.0f;
+		settings.keepDistance = 128.0f;
+		settings.prefetchTime = 1.0f;
+
+		vector<fspath> zonePaths;
+		vector<point2d> points(POINTS_PER_ZONE);
+		u64 zoneFileSize = 0;
+		for (u32 z = 0; z < GRID_SIZE; z++)
+		{
+			for (u32 x = 0; x < GRID_SIZE; x++)
+			{
+				ZoneSerializer zoneSerializer;
+				zoneSerializer.SetMinKeyValue(1);
+				for (u64 i = 0; i < POINTS_PER_ZONE; i++)
+				{
+					points[i] = { x * ZONE_SIZE + (i % 128) * 0.5f, static_cast<char>(i), z * ZONE_SIZE + (i / 128) * 0.5f };
+					zoneSerializer.AddEntry(&points[i]);
+				}
+
+				const fspath path = fspath{ "object" } / ("zone_stream_" + std::to_string(x) + "_" + std::to_string(z) + ".ho");
+				HObjPtr<HZone> zone = HObjectUtil::Create<HZone>();
+				FDynamicBufferWriter writer{ POINTS_PER_ZONE * (sizeof(hkey) + sizeof(u64) + sizeof(point2d)) + 4 * KB };
+				zone->Serialize(writer);
+				zoneSerializer.Serialize(writer);
+				std::ofstream outFile(path, std::ios::binary);
+				outFile.write(writer.begin<char>(), writer.BytesWritten());
+				outFile.close();
+				delete zone;
+
+				zoneFileSize = writer.BytesWritten();
+				zonePaths.push_back(path);
+			}
+		}
+
+		// A lap around the grid, fast enough for the prefetch to matter
+		vector<CameraPathSample> cameraPath;
+		constexpr f32 LAP_TIME = 10.0f;
+		const f32 center = GRID_SIZE * ZONE_SIZE * 0.5f;
+		for (f32 time = 0.0f; time <= LAP_TIME; time += 0.25f)
+		{
+			const f32 angle = time / LAP_TIME * 6.28318531f;
+			cameraPath.push_back({ time, vec3f32{ center + std::cos(angle) * center * 0.75f, 0.0f, center + std::sin(angle) * center * 0.75f } });
+		}
+		const fspath cameraPathFile = "object/zone_stream_camera.txt";
+		ZoneStreamingSimulator::SaveCameraPath(cameraPathFile, cameraPath);
+		if (!ZoneStreamingSimulator::LoadCameraPath(cameraPathFile, cameraPath))
+		{
+			return;
+		}
+
+		for (u64 residentZones : { 12, 24, 48 })
+		{
+			settings.memoryBudget = residentZones * zoneFileSize;
+			ZoneStreamingManager manager{ settings };
+			for (u32 i = 0; i < zonePaths.size(); i++)
+			{
+				const vec3f32 boundsMin{ (i % GRID_SIZE) * ZONE_SIZE, -ZONE_SIZE, (i / GRID_SIZE) * ZONE_SIZE };
+				manager.RegisterZone(zonePaths[i], boundsMin, boundsMin + vec3f32{ ZONE_SIZE, 2.0f * ZONE_SIZE, ZONE_SIZE });
+			}
+
+			const ZoneStreamingSimulationReport report = ZoneStreamingSimulator::Replay(manager, cameraPath, 1.0f / 60.0f, true);
+			const ZoneStreamingStats& stats = report.stats;
+			HINFO("Zone streaming, budget of {0} zones: {1}/{2} frames missed a zone, update {3:.3f} ms (max {4:.3f} ms)", residentZones, report.missFrameCount, report.frameCount, report.averageUpdateTime, report.maxUpdateTime);
+			HINFO("  {0} loads ({1} prefetched, {2} failed, {3} deferred), {4} evictions, peak {5} KB of {6} KB", stats.loadCount, stats.prefetchLoadCount, stats.failedLoadCount, stats.deferredLoadCount, stats.evictionCount, stats.peakResidentBytes / KB, settings.memoryBudget / KB);
+		}
+	}
+
+	struct CompressedZoneLoadReport
+	{
+		u64 fileSize;
+		f64 coldTime; // Milliseconds, load and first pass over every entry
+		f64 hotTime; // Second pass, every block is already decompressed
+		f64 checksum;
+	};
+
+	CompressedZoneLoadReport LoadCompressedZone(const fspath& path, u64 entryCount)
+	{
+		using Clock = std::chrono::steady_clock;
+		CompressedZoneLoadReport report{};
+		report.fileSize = FileSystem::FileSize(path);
+
+		// The OS file cache is not flushed, cold only means the zone itself starts compressed
+		const auto coldStart = Clock::now();
+		HObjPtr<HZone> zone = HObjectUtil::LoadDetached<HZone>(path.string().c_str());
+		if (zone == nullptr)
+		{
+			return report;
+		}
+		for (hkey key = 1; key <= entryCount; key++)
+		{
+			const point2d* point = reinterpret_cast<const point2d*>(zone->GetZone().GetKeyData(key));
+			report.checksum += point->x + point->y;
+		}
+		const auto coldEnd = Clock::now();
+
+		f64 hotChecksum = 0.0;
+		for (hkey key = 1; key <= entryCount; key++)
+		{
+			const point2d* point = reinterpret_cast<const point2d*>(zone->GetZone().GetKeyData(key));
+			hotChecksum += point->x + point->y;
+		}
+		const auto hotEnd = Clock::now();
+		HASSERT(hotChecksum == report.checksum, "The zone changed between two passes");
+
+		report.coldTime = std::chrono::duration<f64, std::milli>(coldEnd - coldStart).count();
+		report.hotTime = std::chrono::duration<f64, std::milli>(hotEnd - coldEnd).count();
+		delete zone;
+		return report;
+	}
+
+	// Compares a raw zone with the zone payload compressed by blocks and with the whole object file compressed
+	void CompressedZoneLoadBenchmark()
+	{
+		constexpr u64 ENTRY_COUNT = 1024 * 1024;
+
+		// Points on a grid, close to what a level stores and compressible like it
+		vector<point2d> points(ENTRY_COUNT);
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			points[i] = { (i % 1024) * 0.5f, static_cast<char>(i % 4), (i / 1024) * 0.5f };
+		}
+
+		const fspath paths[] = { "object/zone_raw.ho", "object/zone_payload_compressed.ho", "object/zone_file_compressed.ho" };
+		for (u32 i = 0; i < 3; i++)
+		{
+			ZoneSerializer zoneSerializer;
+			zoneSerializer.SetMinKeyValue(1);
+			if (i == 1)
+			{
+				zoneSerializer.SetPayloadCompression();
+			}
+			for (const point2d& point : points)
+			{
+				zoneSerializer.AddEntry(&point);
+			}
+
+			HObjPtr<HZone> zone = HObjectUtil::Create<HZone>();
+			FDynamicBufferWriter writer{ ENTRY_COUNT * (sizeof(hkey) + sizeof(u64) + sizeof(point2d)) + 4 * KB };
+			zone->Serialize(writer);
+			zoneSerializer.Serialize(writer);
+			HObjectUtil::WriteFile(writer.begin<byte>(), writer.BytesWritten(), paths[i], i == 2 ? HObjectSaveFlags::Compress : HObjectSaveFlags::Default);
+			delete zone;
+		}
+
+		const CompressedZoneLoadReport raw = LoadCompressedZone(paths[0], ENTRY_COUNT);
+		const CompressedZoneLoadReport payloadCompressed = LoadCompressedZone(paths[1], ENTRY_COUNT);
+		const CompressedZoneLoadReport fileCompressed = LoadCompressedZone(paths[2], ENTRY_COUNT);
+		HINFO("Zone of {0} entries", ENTRY_COUNT);
+		HINFO("Raw:                {0} KB, cold {1:.3f} ms, hot {2:.3f} ms", raw.fileSize / KB, raw.coldTime, raw.hotTime);
+		HINFO("Payload compressed: {0} KB, cold {1:.3f} ms, hot {2:.3f} ms", payloadCompressed.fileSize / KB, payloadCompressed.coldTime, payloadCompressed.hotTime);
+		HINFO("File compressed:    {0} KB, cold {1:.3f} ms, hot {2:.3f} ms", fileCompressed.fileSize / KB, fileCompressed.coldTime, fileCompressed.hotTime);
+		HASSERT(raw.checksum == payloadCompressed.checksum && raw.checksum == fileCompressed.checksum, "The compressed zones differ from the raw one");
+	}
+
+	// Props placed many times share their data once the zone is deduplicated
+	void ZoneDeduplicationExample()
+	{
+		constexpr u64 ENTRY_COUNT = 1024 * 1024;
+		constexpr u64 DISTINCT_PROP_COUNT = 4096;
+
+		vector<point2d> props(ENTRY_COUNT);
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			const u64 prop = i % DISTINCT_PROP_COUNT;
+			props[i] = { static_cast<f32>(prop), static_cast<char>(prop), static_cast<f32>(prop * 2) };
+		}
+
+		using Clock = std::chrono::steady_clock;
+		u64 zoneSizes[2] = {};
+		for (bool deduplicate : { false, true })
+		{
+			ZoneSerializer zoneSerializer;
+			zoneSerializer.SetMinKeyValue(1);
+			zoneSerializer.SetDeduplication(deduplicate);
+			const auto addStart = Clock::now();
+			for (const point2d& prop : props)
+			{
+				zoneSerializer.AddEntry(&prop);
+			}
+			const f64 addTime = std::chrono::duration<f64, std::milli>(Clock::now() - addStart).count();
+
+			FDynamicBufferWriter zoneWriter{ ENTRY_COUNT * (sizeof(hkey) + sizeof(u64) + sizeof(point2d)) + 4 * KB };
+			zoneSerializer.Serialize(zoneWriter);
+			zoneSizes[deduplicate] = zoneWriter.BytesWritten();
+			HINFO("Deduplication {0}: {1} KB, AddEntry {2:.3f} ms, {3} entries ({4} KB) shared", deduplicate ? "on" : "off", zoneWriter.BytesWritten() / KB, addTime, zoneSerializer.GetDeduplicatedEntryCount(), zoneSerializer.GetDeduplicatedBytes() / KB);
+
+			FBufferReader reader{ zoneWriter.begin<byte>(), zoneWriter.BytesWritten() };
+			ZoneDeserializer zoneDeserializer;
+			Zone zone;
+			zoneDeserializer.Deserialize(reader, zone);
+			for (hkey key = 1; key <= ENTRY_COUNT; key += 997)
+			{
+				const point2d* prop = reinterpret_cast<const point2d*>(zone.GetKeyData(key));
+				HASSERT(prop->x == props[key - 1].x && prop->y == props[key - 1].y, "Deduplicated entry {0} differs", key);
+			}
+			delete[] zone.memoryBase;
+		}
+		HINFO("Deduplication saved {0} KB of {1} KB", (zoneSizes[0] - zoneSizes[1]) / KB, zoneSizes[0] / KB);
+	}
+
+	// Edits a few entries of a big zone through its manifest instead of serializing every entry again
+	void ZoneIncrementalBuildExample()
+	{
+		constexpr u64 ENTRY_COUNT = 1024 * 1024;
+		constexpr u64 EDIT_COUNT = 100;
+		using Clock = std::chrono::steady_clock;
+
+		vector<point2d> points(ENTRY_COUNT);
+		for (u64 i = 0; i < ENTRY_COUNT; i++)
+		{
+			points[i] = { (i % 1024) * 0.5f, static_cast<char>(i), (i / 1024) * 0.5f };
+		}
+
+		// Builds the whole zone like the first build of a level does
+		const u64 zoneCapacity = ENTRY_COUNT * (sizeof(hkey) + sizeof(u64) + sizeof(point2d)) + 4 * KB;
+		auto fullBuild = [&](FDynamicBufferWriter& zoneWriter, ZoneManifest& manifest) {
+			ZoneSerializer zoneSerializer;
+			zoneSerializer.SetMinKeyValue(1);
+			zoneSerializer.SetPayloadCompression();
+			for (const point2d& point : points)
+			{
+				zoneSerializer.AddEntry(&point);
+			}
+			zoneSerializer.Serialize(zoneWriter);
+			zoneSerializer.BuildManifest(manifest);
+		};
+
+		FDynamicBufferWriter zoneWriter{ zoneCapacity };
+		ZoneManifest manifest;
+		const auto fullStart = Clock::now();
+		fullBuild(zoneWriter, manifest);
+		const f64 fullTime = std::chrono::duration<f64, std::milli>(Clock::now() - fullStart).count();
+		manifest.Save("object/zone_incremental.manifest");
+
+		// The manifest is read back like the next editor session would
+		ZoneManifest savedManifest;
+		if (!ZoneManifest::Load("object/zone_incremental.manifest", savedManifest))
+		{
+			return;
+		}
+
+		// Moves a few points, the same ones are changed in the source entries to check the result
+		FDynamicBufferWriter incrementalWriter{ zoneCapacity };
+		ZoneManifest incrementalManifest;
+		const auto incrementalStart = Clock::now();
+		FBufferReader reader{ zoneWriter.begin<byte>(), zoneWriter.BytesWritten(), true };
+		ZoneIncrementalBuilder builder;
+		if (!builder.Open(reader, savedManifest))
+		{
+			return;
+		}
+		for (u64 i = 0; i < EDIT_COUNT; i++)
+		{
+			const u64 entryIndex = (i * 9973) % ENTRY_COUNT;
+			points[entryIndex].x += 1.0f;
+			builder.SetEntry(entryIndex, &points[entryIndex]);
+		}
+		builder.Build(incrementalWriter, incrementalManifest);
+		const f64 incrementalTime = std::chrono::duration<f64, std::milli>(Clock::now() - incrementalStart).count();
+
+		const ZoneIncrementalBuildStats& stats = builder.GetStats();
+		HINFO("Full build of {0} entries: {1:.3f} ms", ENTRY_COUNT, fullTime);
+		HINFO("Incremental build of {0} edits: {1:.3f} ms, {2} blocks compressed again, {3} reused", stats.changedEntryCount, incrementalTime, stats.compressedBlockCount, stats.reusedBlockCount);
+
+		FDynamicBufferWriter rebuiltWriter{ zoneCapacity };
+		ZoneManifest rebuiltManifest;
+		fullBuild(rebuiltWriter, rebuiltManifest);
+		HASSERT(rebuiltWriter.BytesWritten() == incrementalWriter.BytesWritten() && memcmp(rebuiltWriter.begin<byte>(), incrementalWriter.begin<byte>(), rebuiltWriter.BytesWritten()) == 0, "The incremental build differs from the full one");
+	}
 }
 
 void Example0()
@@ -124,16 +805,14 @@ int main()
 
 
 		// 2. Serialization
-		byte* buffer = new byte[1024 * 1024];
-		FBufferWriter zoneWriter{buffer};
+		FDynamicBufferWriter zoneWriter;
 		zoneSerializer.Serialize(zoneWriter);
 
 		// 5. Deserialization
-		FBufferReader reader{ zoneWriter.begin<byte>() };
+		FBufferReader reader{ zoneWriter.begin<byte>(), zoneWriter.BytesWritten() };
 		ZoneDeserializer zoneDeserializer;
 		Zone zone;
 		zoneDeserializer.Deserialize(reader, zone);
-		delete[] buffer;
 
 		point2d _point0 = *reinterpret_cast<const point2d*>(zone.GetKeyData(1));
 		point2d _point1 = *reinterpret_cast<const point2d*>(zone.GetKeyData(2));
@@ -153,4 +832,15 @@ int main()
 		HObjPtr<HZone> scene = HObjectUtil::GetObjectFromPath<HZone>("object/zone.ho");
 	}
 
+	ZoneBuildBenchmark();
+	MemoryMappedLoadBenchmark();
+	ZoneLookupBenchmark();
+	HKeyMapBenchmark();
+	ZoneViewBenchmark();
+	ZoneLoadPipelineExample();
+	ZoneStreamingSimulation();
+	CompressedZoneLoadBenchmark();
+	ZoneDeduplicationExample();
+	ZoneIncrementalBuildExample();
+
 }
\ No newline at end of file
@@ -18,9 +18,9 @@ namespace hdn
         return sizeof(point2d);
     }
 
-    void zone_unload_point2d(const void* data)
+    u64 zone_unload_point2d(const void* data)
 	{
 		// const point2d* data = static_cast<const point2d*>(data);
-
+		return 0;
     }
 }
\ No newline at end of file
@@ -14,5 +14,5 @@ namespace hdn
 
 	void zone_serialize_point2d(const void* dataBuffer, FDynamicBufferWriter& writer);
 	u64 zone_load_point2d(const void* dataBuffer, void* outBuffer);
-	void zone_unload_point2d(const void* data);
+	u64 zone_unload_point2d(const void* data);
 }
\ No newline at end of file
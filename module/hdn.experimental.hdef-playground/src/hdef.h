@@ -13,7 +13,7 @@ namespace hdn
 	{
 		hdef(vector<byte>& _payload)
 		{
-			FBufferReader reader(_payload.data());
+			FBufferReader reader(_payload.data(), _payload.size());
 			id = reader.Read<u64>();
 			keyCount = reader.Read<u64>();
 			payloadSize = reader.Read<u64>();
@@ -91,6 +91,7 @@ public class LightthornedProject : BaseCppProject
         conf.IncludePaths.Add(@"[project.SharpmakeCsPath]\src");
         
         conf.AddPublicDependency<CoreProject>(target);
+        conf.AddPublicDependency<AsyncProject>(target);
         conf.AddPublicDependency<TinyObjLoaderProject>(target);
         conf.AddPublicDependency<OpenFBXProject>(target);
         conf.AddPublicDependency<GLFWProject>(target);
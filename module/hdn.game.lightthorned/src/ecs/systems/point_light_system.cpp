@@ -1,7 +1,7 @@
 #include "point_light_system.h"
 
 #include "core/core.h"
-#include "core/stl/map.h"
+#include "core/allocator/frame_arena.h"
 
 #include "ecs/components/transform_component.h"
 #include "ecs/components/color_component.h"
@@ -88,7 +88,7 @@ namespace hdn
 	void PointLightSystem::Render(FrameInfo& frameInfo)
 	{
 		// Sort Lights
-		map<float, flecs::entity> sorted;
+		frame_map<float, flecs::entity> sorted{ arena_allocator{ frameInfo.frameArena } };
 		auto query = frameInfo.ecsWorld->query<TransformComponent, PointLightComponent>();
 		query.each([&](flecs::entity e, TransformComponent& transformC, PointLightComponent& pointLightC) {
 			// Calculate Distance
@@ -22,10 +22,14 @@
 #include "plugins/editor/editor.h"
 #include "plugins/hmm/hmm_imgui.h"
 #include "plugins/idaes/idaes_imgui.h"
+#include "plugins/memory/memory_imgui.h"
 
 #include "hdn_imgui.h"
 
 #include "core/core.h"
+#include "core/stl/ds_base.h"
+#include "core/allocator/memory_tracker.h"
+#include "async/async.h"
 #include <glm/gtc/constants.hpp>
 
 namespace hdn
@@ -117,12 +121,17 @@ namespace hdn
 
 		// IdaesImgui idaesUI;
 		HMMImgui hmmUI;
+		MemoryImgui memoryUI;
 		Editor editor;
 #endif
 
+		u64 lastFrameAllocationCount = 0;
 		while (!m_Window.ShouldClose())
 		{
+			MemoryTracker::BeginFrame();
+			const MemStat frameStartMemStat = GetMemStat();
 			glfwPollEvents();
+			AsyncOrchestrator::Get().DrainMainThreadTasks();
 
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float frameTime = std::chrono::duration<f32, std::chrono::seconds::period>(newTime - currentTime).count();
@@ -148,6 +157,8 @@ namespace hdn
 				frameInfo.camera = &camera;
 				frameInfo.globalDescriptorSet = globalDescriptorSets[frameIndex];
 				frameInfo.ecsWorld = &m_EcsWorld;
+				// BeginFrame() waited for the fence of this frame index
+				frameInfo.frameArena = m_FrameArena.BeginFrame(frameIndex);
 
 				// update
 				GlobalUbo ubo{};
@@ -165,6 +176,7 @@ namespace hdn
 				uboBuffers[frameIndex]->Flush();
 
 				// render
+				HMEMORY_TAG("renderer");
 				m_Renderer.BeginSwapChainRenderPass(commandBuffer);
 
 				// Order Here Matters
@@ -172,25 +184,32 @@ namespace hdn
 				pointLightSystem.Render(frameInfo);
 
 #if USING(HDN_DEBUG)
-				imguiSystem.BeginFrame();
-
-				ImGui::Begin("Hello, world!");
-				ImGui::Text("This is some useful text.");
-				ImGui::Text("dt: %.4f", frameTime * 1000);
-				ImGui::End();
-
-				// ImGui::ShowDemoWindow();
-				// idaesUI.Draw();
-				hmmUI.Draw();
-				editor.RenderEntityTable(m_EcsWorld);
-
-
-				imguiSystem.EndFrame(ImVec4(0.45f, 0.55f, 0.60f, 1.00f), commandBuffer);
+				{
+					// The UI allocations nest in the renderer scope but belong to the editor
+					HMEMORY_TAG("editor");
+					imguiSystem.BeginFrame();
+
+					ImGui::Begin("Hello, world!");
+					ImGui::Text("This is some useful text.");
+					ImGui::Text("dt: %.4f", frameTime * 1000);
+					ImGui::Text("Heap allocations (last frame): %llu", lastFrameAllocationCount);
+					ImGui::Text("Frame arena: %zu / %zu bytes (peak %zu)", frameInfo.frameArena->GetUsedMemory(), frameInfo.frameArena->GetTotalSize(), m_FrameArena.GetPeakUsage());
+					ImGui::End();
+
+					// ImGui::ShowDemoWindow();
+					// idaesUI.Draw();
+					hmmUI.Draw();
+					memoryUI.Draw();
+					editor.RenderEntityTable(m_EcsWorld);
+
+					imguiSystem.EndFrame(ImVec4(0.45f, 0.55f, 0.60f, 1.00f), commandBuffer);
+				}
 #endif
 				m_Renderer.EndSwapChainRenderPass(commandBuffer);
 
 				m_Renderer.EndFrame();
 			}
+			lastFrameAllocationCount = GetMemStat().allocationCount - frameStartMemStat.allocationCount;
 		}
 
 		vkDeviceWaitIdle(m_Device.GetDevice());
@@ -198,7 +217,18 @@ namespace hdn
 
 	void FirstApp::LoadGameObjects()
 	{
-		Ref<HDNModel> hdnModel = HDNModel::CreateModelFromObjFile(&m_Device, "models/flat_vase.obj");
+		// The files are parsed on the IO workers, only the GPU upload stays on the main thread
+		HDNModelLoadTask flatVaseLoadTask{ "models/flat_vase.obj" };
+		HDNModelLoadTask quadLoadTask{ "models/quad.obj" };
+		HDNModelLoadTask cubeLoadTask{ "models/cube.fbx" };
+		ITaskParallel modelLoadTask;
+		modelLoadTask.AddTask(&flatVaseLoadTask);
+		modelLoadTask.AddTask(&quadLoadTask);
+		modelLoadTask.AddTask(&cubeLoadTask);
+		modelLoadTask.Enqueue();
+		AsyncOrchestrator::Get().Wait(&modelLoadTask);
+
+		Ref<HDNModel> hdnModel = CreateRef<HDNModel>(&m_Device, flatVaseLoadTask.GetBuilder());
 
 		auto flatVaseGroup = HDNGameObject::CreateGameObject(m_EcsWorld, "Flat Vase Group");
 		TransformComponent transformC;
@@ -229,7 +259,7 @@ namespace hdn
 		}
 
 		{
-			hdnModel = HDNModel::CreateModelFromObjFile(&m_Device, "models/quad.obj");
+			hdnModel = CreateRef<HDNModel>(&m_Device, quadLoadTask.GetBuilder());
 			auto floor = HDNGameObject::CreateGameObject(m_EcsWorld, "floor");
 
 			TransformComponent transformC;
@@ -252,7 +282,7 @@ namespace hdn
 		}
 
 		{
-			hdnModel = HDNModel::CreateModelFromFbxFile(&m_Device, "models/cube.fbx"); // models/cube.fbx
+			hdnModel = CreateRef<HDNModel>(&m_Device, cubeLoadTask.GetBuilder());
 			auto pot = HDNGameObject::CreateGameObject(m_EcsWorld, "pot");
 
 			TransformComponent transformC;
@@ -8,6 +8,7 @@
 #include "hdn_descriptors.h"
 
 #include "physics/physics_world.h"
+#include "core/allocator/frame_arena.h"
 #include "flecs/flecs.h"
 
 namespace hdn
@@ -18,6 +19,7 @@ namespace hdn
 	public:
 		static constexpr u32 WIDTH = 800;
 		static constexpr u32 HEIGHT = 600;
+		static constexpr size_t FRAME_ARENA_SIZE = 256 * KB;
 	public:
 		FirstApp();
 		virtual ~FirstApp();
@@ -39,5 +41,7 @@ namespace hdn
 		PhysicsWorld m_PhysicsWorld;
 
 		flecs::world m_EcsWorld;
+
+		FrameArena m_FrameArena{ HDNSwapChain::MAX_FRAMES_IN_FLIGHT, FRAME_ARENA_SIZE };
 	};
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "hdn_camera.h"
 #include "hdn_game_object.h"
 
+#include "core/allocator/linear_allocator.h"
+
 #include "vulkan/vulkan.h"
 
 namespace hdn
@@ -34,5 +36,6 @@ namespace hdn
 		HDNCamera* camera;
 		VkDescriptorSet globalDescriptorSet;
 		flecs::world* ecsWorld;
+		LinearAllocator* frameArena; // Scratch memory of the frame, see frame_vector / frame_map
 	};
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include "hdn_utils.h"
 
+#include "async/async_parallel_for.h"
+
 #include <tinyobjloader/tiny_obj_loader.h>
 
 #include <ofbx.h>
@@ -36,6 +38,21 @@ namespace eastl {
 
 namespace hdn
 {
+	static constexpr u64 OBJ_VERTEX_GRAIN_SIZE = 4096;
+
+	// Dedup keys are indices in the expanded vertex array, hashing them only looks up the precomputed vertex hash
+	struct ExpandedVertexHash
+	{
+		const vector<size_t>* hashes;
+		size_t operator()(u32 index) const { return (*hashes)[index]; }
+	};
+
+	struct ExpandedVertexEqual
+	{
+		const vector<HDNModel::Vertex>* vertices;
+		bool operator()(u32 lhs, u32 rhs) const { return (*vertices)[lhs] == (*vertices)[rhs]; }
+	};
+
 	HDNModel::HDNModel(HDNDevice* device, const HDNModel::Builder& builder)
 		: m_Device{device}
 	{
@@ -62,6 +79,24 @@ namespace hdn
 		return CreateScope<HDNModel>(device, builder);
 	}
 
+	HDNModelLoadTask::HDNModelLoadTask(const string& filepath)
+		: m_Filepath{ filepath }
+	{
+	}
+
+	void HDNModelLoadTask::Execute()
+	{
+		if (m_Filepath.size() >= 4 && m_Filepath.compare(m_Filepath.size() - 4, 4, ".fbx") == 0)
+		{
+			m_Builder.LoadFbxModel(m_Filepath);
+		}
+		else
+		{
+			m_Builder.LoadObjModel(m_Filepath);
+		}
+		Complete();
+	}
+
 	void HDNModel::Bind(VkCommandBuffer commandBuffer)
 	{
 		VkBuffer buffers[] = { m_VertexBuffer->GetBuffer()};
@@ -184,53 +219,68 @@ namespace hdn
 		vertices.clear();
 		indices.clear();
 
-		unordered_map<Vertex, u32> uniqueVertices;
-
+		// Flatten the face elements of every shape so the vertices can be assembled (and hashed) in parallel
+		vector<tinyobj::index_t> objIndices;
 		for (const auto& shape : shapes)
 		{
-			for (const auto& index : shape.mesh.indices) // Loop in each face element in the model
+			objIndices.insert(objIndices.end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+		}
+
+		const u64 indexCount = objIndices.size();
+		vector<Vertex> expandedVertices(indexCount);
+		vector<size_t> expandedVertexHashes(indexCount);
+		ParallelFor(0, indexCount, OBJ_VERTEX_GRAIN_SIZE, [&](u64 i) {
+			const tinyobj::index_t& index = objIndices[i];
+			Vertex& vertex = expandedVertices[i];
+
+			if (index.vertex_index >= 0)
 			{
-				Vertex vertex{};
-				
-				if (index.vertex_index >= 0)
-				{
-					vertex.position = {
-						attrib.vertices[3 * index.vertex_index + 0],
-						attrib.vertices[3 * index.vertex_index + 1],
-						attrib.vertices[3 * index.vertex_index + 2]
-					};
-
-					vertex.color = {
-						attrib.colors[3 * index.vertex_index + 0],
-						attrib.colors[3 * index.vertex_index + 1],
-						attrib.colors[3 * index.vertex_index + 2]
-					};
-				}
+				vertex.position = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2]
+				};
 
-				if (index.normal_index >= 0)
-				{
-					vertex.normal = {
-						attrib.normals[3 * index.normal_index + 0],
-						attrib.normals[3 * index.normal_index + 1],
-						attrib.normals[3 * index.normal_index + 2]
-					};
-				}
+				vertex.color = {
+					attrib.colors[3 * index.vertex_index + 0],
+					attrib.colors[3 * index.vertex_index + 1],
+					attrib.colors[3 * index.vertex_index + 2]
+				};
+			}
 
-				if (index.texcoord_index >= 0)
-				{
-					vertex.uv = {
-						attrib.texcoords[2 * index.texcoord_index + 0],
-						attrib.texcoords[2 * index.texcoord_index + 1]
-					};
-				}
+			if (index.normal_index >= 0)
+			{
+				vertex.normal = {
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2]
+				};
+			}
 
-				if (!uniqueVertices.contains(vertex))
-				{
-					uniqueVertices[vertex] = static_cast<u32>(vertices.size());
-					vertices.push_back(vertex);
-				}
-				indices.push_back(uniqueVertices[vertex]);
+			if (index.texcoord_index >= 0)
+			{
+				vertex.uv = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					attrib.texcoords[2 * index.texcoord_index + 1]
+				};
+			}
+
+			expandedVertexHashes[i] = std::hash<Vertex>()(vertex);
+		});
+
+		// The deduplication stays serial to keep the vertex order stable, it only reuses the hashes computed above
+		ExpandedVertexHash hash{ &expandedVertexHashes };
+		ExpandedVertexEqual equal{ &expandedVertices };
+		unordered_map<u32, u32, ExpandedVertexHash, ExpandedVertexEqual> uniqueVertices(indexCount, hash, equal);
+		indices.reserve(indexCount);
+		for (u32 i = 0; i < indexCount; i++)
+		{
+			const auto [it, inserted] = uniqueVertices.insert(eastl::make_pair(i, static_cast<u32>(vertices.size())));
+			if (inserted)
+			{
+				vertices.push_back(expandedVertices[i]);
 			}
+			indices.push_back(it->second);
 		}
 	}
 
@@ -6,6 +6,8 @@
 #include "core/core.h"
 #include "core/stl/vector.h"
 
+#include "async/async_task_leaf.h"
+
 namespace hdn
 {
 	class HDNModel
@@ -64,4 +66,20 @@ namespace hdn
 		Scope<HDNBuffer> m_IndexBuffer;
 		u32 m_IndexCount;
 	};
+
+	// Parses a model file (.obj or .fbx) on the IO workers, the GPU buffers are then created on the main thread from the builder
+	class HDNModelLoadTask : public ITaskLeaf
+	{
+	public:
+		HDNModelLoadTask(const string& filepath);
+
+		virtual void Execute() override;
+		virtual TaskAffinity Affinity() const override { return TaskAffinity::IO; }
+		virtual const char* GetName() const override { return m_Filepath.c_str(); }
+
+		const HDNModel::Builder& GetBuilder() const { return m_Builder; }
+	private:
+		string m_Filepath;
+		HDNModel::Builder m_Builder;
+	};
 }
\ No newline at end of file
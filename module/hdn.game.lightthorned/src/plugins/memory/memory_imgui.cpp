@@ -0,0 +1,168 @@
+#include "memory_imgui.h"
+
+#include "core/stl/ds_base.h"
+
+#include "fmt/core.h"
+
+#include <algorithm>
+
+namespace hdn
+{
+	static constexpr f32 BYTES_PER_MB = 1024.0f * 1024.0f;
+
+	static void TextBytes(size_t bytes)
+	{
+		if (bytes < 10 * KB)
+		{
+			ImGui::Text("%zu B", bytes);
+		}
+		else if (bytes < 10 * MB)
+		{
+			ImGui::Text("%.1f KB", static_cast<f64>(bytes) / KB);
+		}
+		else
+		{
+			ImGui::Text("%.1f MB", static_cast<f64>(bytes) / MB);
+		}
+	}
+
+	void MemoryImgui::Draw()
+	{
+		ImGui::Begin("Memory");
+		const MemStat memStat = GetMemStat();
+		ImGui::Text("Heap: %.1f MB in %llu blocks | Resident: %.1f MB",
+			static_cast<f32>(memStat.allocated - memStat.deallocated) / BYTES_PER_MB,
+			static_cast<unsigned long long>(memStat.allocationCount - memStat.deallocationCount),
+			static_cast<f32>(GetResidentMemory()) / BYTES_PER_MB);
+
+#if USING(HDN_MEMORY_TRACKING)
+		const vector<MemoryTagStat> tagStats = MemoryTracker::GetTagStats();
+		DrawTagTable(tagStats);
+		DrawFrameHistory();
+		DrawSites();
+#else
+		ImGui::Text("Memory tracking is disabled (HDN_MEMORY_TRACKING)");
+#endif
+		ImGui::End();
+	}
+
+	void MemoryImgui::DrawTagTable(const vector<MemoryTagStat>& tagStats)
+	{
+		if (m_BudgetsInMB.size() < tagStats.size())
+		{
+			m_BudgetsInMB.resize(tagStats.size(), 0.0f);
+		}
+
+		if (!ImGui::BeginTable("MemoryTags", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			return;
+		}
+		ImGui::TableSetupColumn("Tag", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Live");
+		ImGui::TableSetupColumn("Peak");
+		ImGui::TableSetupColumn("Frame peak");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableSetupColumn("Deallocations");
+		ImGui::TableSetupColumn("Budget (MB)");
+		ImGui::TableHeadersRow();
+
+		const MemoryTagStat total = MemoryTracker::GetTotalStat();
+		for (size_t tag = 0; tag <= tagStats.size(); tag++)
+		{
+			// The total goes last
+			const bool isTotal = tag == tagStats.size();
+			const MemoryTagStat& stat = isTotal ? total : tagStats[tag];
+			const bool overBudget = !isTotal && m_BudgetsInMB[tag] > 0.0f && static_cast<f32>(stat.framePeakBytes) > m_BudgetsInMB[tag] * BYTES_PER_MB;
+
+			ImGui::TableNextRow();
+			if (overBudget)
+			{
+				ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, ImGui::GetColorU32(ImVec4(0.6f, 0.1f, 0.1f, 0.65f)));
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", stat.name);
+			ImGui::TableNextColumn();
+			TextBytes(stat.liveBytes);
+			ImGui::TableNextColumn();
+			TextBytes(stat.peakBytes);
+			ImGui::TableNextColumn();
+			TextBytes(stat.framePeakBytes);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(stat.allocationCount));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(stat.deallocationCount));
+			ImGui::TableNextColumn();
+			if (!isTotal)
+			{
+				ImGui::PushID(static_cast<int>(tag));
+				ImGui::SetNextItemWidth(-1.0f);
+				ImGui::InputFloat("##Budget", &m_BudgetsInMB[tag], 0.0f, 0.0f, "%.1f");
+				ImGui::PopID();
+			}
+		}
+		ImGui::EndTable();
+	}
+
+	void MemoryImgui::DrawFrameHistory()
+	{
+		const vector<size_t> history = MemoryTracker::GetFrameHistory();
+		if (history.empty())
+		{
+			return;
+		}
+
+		vector<f32> historyInMB(history.size());
+		std::transform(history.begin(), history.end(), historyInMB.begin(), [](size_t bytes) { return static_cast<f32>(bytes) / BYTES_PER_MB; });
+		const f32 maxInMB = *std::max_element(historyInMB.begin(), historyInMB.end());
+		const string overlay = fmt::format("Frame high-water mark: {0:.2f} MB (max {1:.2f} MB)", historyInMB.back(), maxInMB);
+		ImGui::PlotLines("##FrameHistory", historyInMB.data(), static_cast<int>(historyInMB.size()), 0, overlay.c_str(), 0.0f, maxInMB * 1.1f, ImVec2(-1.0f, 80.0f));
+	}
+
+	void MemoryImgui::DrawSites()
+	{
+		if (!ImGui::CollapsingHeader("Call sites"))
+		{
+			return;
+		}
+
+		ImGui::SetNextItemWidth(120.0f);
+		if (ImGui::InputInt("Sampling period (0 = off)", &m_SamplingPeriod))
+		{
+			m_SamplingPeriod = std::max(m_SamplingPeriod, 0);
+			MemoryTracker::SetSamplingPeriod(static_cast<u32>(m_SamplingPeriod));
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Clear"))
+		{
+			MemoryTracker::ClearSiteStats();
+		}
+
+		const vector<MemorySiteStat> siteStats = MemoryTracker::GetSiteStats();
+		if (!ImGui::BeginTable("MemorySites", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			return;
+		}
+		ImGui::TableSetupColumn("Tag");
+		ImGui::TableSetupColumn("Name");
+		ImGui::TableSetupColumn("Location", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Samples");
+		ImGui::TableSetupColumn("Estimated bytes");
+		ImGui::TableHeadersRow();
+		for (size_t i = 0; i < std::min<size_t>(siteStats.size(), MAX_DISPLAYED_SITE_COUNT); i++)
+		{
+			const MemorySiteStat& site = siteStats[i];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", site.tagName);
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", site.name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%s:%u", site.file ? site.file : "?", site.line);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(site.sampleCount));
+			ImGui::TableNextColumn();
+			TextBytes(site.sampledBytes);
+		}
+		ImGui::EndTable();
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "imgui.h"
+
+#include "core/core.h"
+#include "core/stl/vector.h"
+#include "core/allocator/memory_tracker.h"
+
+namespace hdn
+{
+	// Memory of every tag of the MemoryTracker: live bytes, peaks, the high-water mark of the last frames and the sampled
+	// call sites. A tag whose last frame high-water mark goes over its budget is highlighted
+	class MemoryImgui
+	{
+	public:
+		static constexpr u32 MAX_DISPLAYED_SITE_COUNT = 32;
+
+		void Draw();
+	private:
+		void DrawTagTable(const vector<MemoryTagStat>& tagStats);
+		void DrawFrameHistory();
+		void DrawSites();
+	private:
+		vector<f32> m_BudgetsInMB; // By tag, 0 = no budget
+		int m_SamplingPeriod = 0;
+	};
+}